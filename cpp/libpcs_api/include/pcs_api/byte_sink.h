@@ -17,7 +17,13 @@
 #ifndef INCLUDE_PCS_API_BYTE_SINK_H_
 #define INCLUDE_PCS_API_BYTE_SINK_H_
 
+#include <cstdint>
 #include <ostream>  // NOLINT(readability/streams)
+#include <stdexcept>
+
+#include "boost/throw_exception.hpp"
+
+#include "pcs_api/types.h"
 
 namespace pcs_api {
 
@@ -39,6 +45,78 @@ class ByteSink {
     */
     virtual void CloseStream() = 0;
 
+    /**
+     * \brief Inquire if this sink accepts blocks of bytes with Write().
+     *
+     * @return true if Write() may be used instead of the opened stream
+     *         (false by default)
+     */
+    virtual bool IsBufferWritable() const {
+        return false;
+    }
+
+    /**
+     * \brief Write a contiguous block of bytes to the currently opened
+     *        stream.
+     *
+     * Downloads hand received buffers to this method without intermediate
+     * copy when IsBufferWritable() returns true ; otherwise bytes are written
+     * to the stream returned by OpenStream().
+     *
+     * @param p_data the bytes to write
+     * @param size the number of bytes to write
+     * @throws std::ios_base::failure if bytes could not be written
+     */
+    virtual void Write(const char* p_data, std::streamsize size) {
+        BOOST_THROW_EXCEPTION(std::logic_error(
+                                    "Write() is not supported by this sink"));
+    }
+
+    /**
+     * \brief Get the number of bytes already held by this sink, left by a
+     *        previously interrupted stream.
+     *
+     * When positive, downloads request only the remaining bytes, provided
+     * that the content has not changed on server (see GetResumeValidator()).
+     *
+     * @return number of bytes a download may be resumed from (0 by default:
+     *         sink does not support resuming)
+     */
+    virtual int64_t GetResumeOffset() const {
+        return 0;
+    }
+
+    /**
+     * \brief Get the validator (ETag or Last-Modified) of the content held
+     *        by this sink.
+     *
+     * @return the validator, or an empty string if unknown
+     */
+    virtual string_t GetResumeValidator() const {
+        return string_t();
+    }
+
+    /**
+     * \brief Defines the validator of the content about to be written.
+     *
+     * Downloads call this method before opening stream.
+     *
+     * @param validator ETag or Last-Modified value (empty if unknown)
+     */
+    virtual void SetResumeValidator(const string_t& validator) {
+    }
+
+    /**
+     * \brief Defines if next opened stream appends to the bytes held.
+     *
+     * Downloads call this method before opening stream, with true if server
+     * sent the remaining bytes only. By default held bytes are overwritten.
+     *
+     * @param resume true if GetResumeOffset() bytes must be kept
+     */
+    virtual void SetResume(bool resume) {
+    }
+
     /**
      * \brief Defines the number of bytes that are expected to be written
      *        to the stream.
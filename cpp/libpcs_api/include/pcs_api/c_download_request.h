@@ -33,6 +33,11 @@ namespace pcs_api {
  */
 class CDownloadRequest {
  public:
+    /**
+     * Default maximum number of bytes handed to byte sink at once (1 MiB).
+     */
+    static const size_t kDefaultChunkSize;
+
     CDownloadRequest(CPath path, std::shared_ptr<ByteSink> byte_sink);
 
     /**
@@ -59,6 +64,25 @@ class CDownloadRequest {
      */
     virtual std::map<string_t, string_t> GetHttpHeaders() const;
 
+    /**
+     * \brief Get the HTTP headers to be used for downloading into the given
+     *        byte sink.
+     *
+     * If the sink already holds the first bytes of the requested content
+     * (a previous attempt was interrupted, see ByteSink::GetResumeOffset()),
+     * only the remaining bytes are requested, provided that content did not
+     * change (If-Range header). Otherwise headers are those of
+     * GetHttpHeaders().
+     *
+     * @param byte_sink the sink data will be written to
+     * @param p_resume_offset (out) number of bytes requested to be skipped
+     *        (0 if download is not resumed)
+     * @return The headers
+     */
+    std::map<string_t, string_t> GetHttpHeaders(
+                                        const ByteSink& byte_sink,
+                                        int64_t *p_resume_offset) const;
+
     /**
      * \brief Defines a range for partial content download.
      * 
@@ -73,6 +97,29 @@ class CDownloadRequest {
      */
     CDownloadRequest& SetRange(int64_t offset, int64_t length);
 
+    /**
+     * @return true if only a range of content is requested
+     */
+    bool IsPartial() const;
+
+    /**
+     * \brief Requires content to be the one identified by given validator.
+     *
+     * Validator is sent as If-Match header (ETag) or If-Unmodified-Since
+     * header (Last-Modified date), so that servers supporting conditional
+     * requests answer 412 Precondition Failed if content has changed.
+     * Used to download several ranges of the same content.
+     *
+     * @param validator ETag or Last-Modified value of a previous response
+     *        (see ByteSink::SetResumeValidator()), or empty for no condition
+     * @return this download request
+     */
+    CDownloadRequest& set_expected_validator(const string_t& validator);
+
+    const string_t& expected_validator() const {
+        return expected_validator_;
+    }
+
     /**
      * Defines an object that will be notified during download.
      *
@@ -82,12 +129,29 @@ class CDownloadRequest {
     CDownloadRequest& set_progress_listener(
                                        std::shared_ptr<ProgressListener> p_pl);
 
+    /**
+     * \brief Defines the maximum number of bytes written to byte sink at once.
+     *
+     * Received data is handed to the sink in blocks of at most this size
+     * (several MB may be used for fast networks, at the cost of memory).
+     *
+     * @param chunk_size the strictly positive chunk size
+     * @return this download request
+     */
+    CDownloadRequest& set_chunk_size(size_t chunk_size);
+
+    size_t chunk_size() const {
+        return chunk_size_;
+    }
+
  private:
     CPath path_;
     std::shared_ptr<ByteSink> p_byte_sink_;
     int64_t range_offset_;
     int64_t range_length_;
     std::shared_ptr<ProgressListener> p_listener_;
+    size_t chunk_size_;
+    string_t expected_validator_;  // empty if none
 };
 
 }  // namespace pcs_api
@@ -17,6 +17,7 @@
 #ifndef INCLUDE_PCS_API_C_PATH_H_
 #define INCLUDE_PCS_API_C_PATH_H_
 
+#include <functional>
 #include <string>
 #include <vector>
 
@@ -61,6 +62,15 @@ class CPath {
     static string_t Normalize(string_t path_name);
 };
 
+/**
+ * \brief Hash function, for using CPath as keys of unordered containers.
+ */
+struct CPathHash {
+    size_t operator()(const CPath& path) const {
+        return std::hash<string_t>()(path.path_name());
+    }
+};
+
 }  // namespace pcs_api
 
 #endif  // INCLUDE_PCS_API_C_PATH_H_
@@ -69,6 +69,50 @@ class CUploadRequest {
     CUploadRequest& set_progress_listener(
                                       std::shared_ptr<ProgressListener> p_pl);
 
+    /**
+     * \brief Defines the size of the chunks sent, for providers uploading
+     *        large sources in several requests (Google Drive resumable
+     *        upload, Dropbox chunked upload).
+     *
+     * If not defined, providers choose their own chunk size.
+     *
+     * @param chunk_size the strictly positive chunk size
+     * @return The upload request
+     */
+    CUploadRequest& set_chunk_size(std::streamsize chunk_size);
+
+    /**
+     * @return the chunk size, or 0 if not defined
+     */
+    std::streamsize chunk_size() const {
+        return chunk_size_;
+    }
+
+    /**
+     * \brief Send upload without checking first what exists at path.
+     *
+     * By default providers check that no folder exists at path before
+     * uploading, which costs at least one request. With this flag, blob is
+     * uploaded at once and conflicts are detected from server response
+     * (or checked afterwards if response is ambiguous). Suitable when
+     * caller knows that no folder exists at path (see also
+     * StorageBuilder::optimistic_uploads()).
+     *
+     * Google Drive ignores this flag: path must be resolved anyway, in
+     * order to update an existing blob instead of creating another one.
+     * hubiC detects a folder replaced by uploaded blob after upload
+     * (blob is then removed), but can not detect a large object replaced
+     * by a small blob (segments of replaced object are then left behind).
+     *
+     * @param optimistic true to skip checks before upload
+     * @return The upload request
+     */
+    CUploadRequest& set_optimistic(bool optimistic);
+
+    bool optimistic() const {
+        return optimistic_;
+    }
+
     /**
      * \brief If no progress listener has been set, return the byte source set
      *        in constructor, otherwise decorate it for progress.
@@ -77,11 +121,32 @@ class CUploadRequest {
      */
     std::shared_ptr<ByteSource> GetByteSource() const;
 
+    /**
+     * \brief Get the byte source set in constructor (never decorated).
+     *
+     * Used by uploads sending several parts of the source concurrently,
+     * that report progress themselves.
+     *
+     * @return the byte source
+     */
+    std::shared_ptr<ByteSource> byte_source() const {
+        return p_byte_source_;
+    }
+
+    /**
+     * @return the progress listener, or an empty pointer if none
+     */
+    std::shared_ptr<ProgressListener> progress_listener() const {
+        return p_listener_;
+    }
+
  private:
     CPath path_;
     std::shared_ptr<ByteSource> p_byte_source_;
     string_t content_type_;
     std::shared_ptr<ProgressListener> p_listener_;
+    std::streamsize chunk_size_;
+    bool optimistic_;
 };
 
 }  // namespace pcs_api
@@ -0,0 +1,171 @@
+/**
+ * Copyright (c) 2014 Netheos (http://www.netheos.net)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef INCLUDE_PCS_API_CACHING_STORAGE_PROVIDER_H_
+#define INCLUDE_PCS_API_CACHING_STORAGE_PROVIDER_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "pcs_api/i_storage_provider.h"
+
+namespace pcs_api {
+
+/**
+ * \brief Counters of a CachingStorageProvider activity.
+ */
+struct MetadataCacheStats {
+    /**
+     * number of GetFile() and ListFolder() served from cache
+     */
+    uint64_t hits;
+    /**
+     * number of GetFile() and ListFolder() forwarded to storage
+     */
+    uint64_t misses;
+    /**
+     * number of write operations (Upload, Delete, CreateFolder) that
+     * invalidated cache entries
+     */
+    uint64_t invalidations;
+};
+
+/**
+ * \brief A storage provider decorator, caching files metadata.
+ *
+ * Results of GetFile() and ListFolder() are kept for a limited time,
+ * including "not found" results (empty pointers). Other operations are
+ * forwarded to the decorated storage.
+ * Upload, Delete and CreateFolder performed through this object invalidate
+ * the entries they may alter: the path itself and its parent folders
+ * (and for Delete, all entries below path). Changes made by other clients
+ * are seen once entries have expired (or after Invalidate()).
+ *
+ * Cached objects are shared by all callers. Cache is split into shards,
+ * each with its own lock and least recently used eviction.
+ *
+ * Example:
+ * \code
+ * std::shared_ptr<IStorageProvider> p_storage =
+ *     std::make_shared<CachingStorageProvider>(
+ *         StorageFacade::ForProvider("hubic")...Build(),
+ *         std::chrono::seconds(30));
+ * \endcode
+ *
+ * This class is thread safe.
+ */
+class CachingStorageProvider : public IStorageProvider {
+ public:
+    static const std::chrono::milliseconds kDefaultTtl;
+    static const size_t kDefaultMaxEntries;
+
+    /**
+     * @param p_storage the decorated storage
+     * @param ttl entries time to live (10 seconds by default)
+     * @param max_entries maximum number of files kept, and of folders
+     *        contents kept (10000 by default)
+     */
+    explicit CachingStorageProvider(
+                        std::shared_ptr<IStorageProvider> p_storage,
+                        std::chrono::milliseconds ttl = kDefaultTtl,
+                        size_t max_entries = kDefaultMaxEntries);
+    ~CachingStorageProvider();
+
+    std::string GetProviderName() const override;
+    std::string GetUserId() override;
+    CQuota GetQuota() override;
+    std::shared_ptr<CFolderContent> ListRootFolder() override;
+    std::shared_ptr<CFolderContent> ListFolder(const CPath& path) override;
+    std::shared_ptr<CFolderContent> ListFolder(const CFolder& folder) override;
+    /**
+     * \brief Streamed listings are not cached (but a cached folder content
+     *        is streamed).
+     */
+    bool ListFolderStream(const CPath& path, file_callback callback) override;
+    /**
+     * \brief Delegated to decorated storage (so that native recursive
+     *        listings are used): not cached.
+     */
+    bool ListRecursive(const CPath& path, file_callback callback) override;
+    bool CreateFolder(const CPath& path) override;
+    bool Delete(const CPath& path) override;
+    std::shared_ptr<CFile> GetFile(const CPath& path) override;
+    void Download(const CDownloadRequest& download_request) override;
+    void Upload(const CUploadRequest& upload_request) override;
+    /**
+     * \brief Returned folder is cached (as if it had been requested).
+     */
+    std::shared_ptr<CFolder> CreateFolderAndGet(const CPath& path) override;
+    /**
+     * \brief Returned blob is cached (as if it had been requested).
+     */
+    std::shared_ptr<CBlob> UploadAndGetBlob(
+                                const CUploadRequest& upload_request) override;
+
+    pplx::task<std::shared_ptr<CFolderContent>> ListFolderAsync(
+                                            const CPath& path) override;
+    pplx::task<bool> CreateFolderAsync(const CPath& path) override;
+    pplx::task<bool> DeleteAsync(const CPath& path) override;
+    pplx::task<std::shared_ptr<CFile>> GetFileAsync(
+                                            const CPath& path) override;
+    pplx::task<void> DownloadAsync(
+                        const CDownloadRequest& download_request) override;
+    pplx::task<void> UploadAsync(
+                        const CUploadRequest& upload_request) override;
+
+    /**
+     * \brief Forget cached entries of given path, of its parent folders
+     *        and of all files below it (for files modified by other
+     *        clients).
+     */
+    void Invalidate(const CPath& path);
+
+    /**
+     * \brief Forget all cached entries.
+     */
+    void Clear();
+
+    /**
+     * @return a snapshot of cache counters
+     */
+    MetadataCacheStats GetStats() const;
+
+ private:
+    struct Caches;
+    std::shared_ptr<IStorageProvider> p_storage_;
+    std::unique_ptr<Caches> p_caches_;
+    std::atomic<uint64_t> hits_;
+    std::atomic<uint64_t> misses_;
+    std::atomic<uint64_t> invalidations_;
+
+    bool LookupFile(const CPath& path, std::shared_ptr<CFile>* p_file);
+    bool LookupFolderContent(const CPath& path,
+                             std::shared_ptr<CFolderContent>* p_content);
+    /**
+     * \brief Invalidate entries after a write operation at given path.
+     *
+     * @param recursive if true, entries below path are also invalidated
+     */
+    void InvalidateAfterWrite(const CPath& path, bool recursive);
+};
+
+}  // namespace pcs_api
+
+#endif  // INCLUDE_PCS_API_CACHING_STORAGE_PROVIDER_H_
@@ -31,18 +31,37 @@ namespace pcs_api {
 /**
  * \brief Implementation of a ByteSink where bytes are written
  *        into a local file.
+ *
+ * When a temporary name is used during write and the sink is not deleted on
+ * abort, an interrupted download leaves a ".part" file that may be resumed:
+ * either by a retry of the same download, or later by another sink created
+ * with resume flag (the content validator is then kept in a
+ * ".part.validator" file).
  */
 class FileByteSink : public ByteSink {
  public:
     /**
      * 
      * @param path will be copied
+     * @param temp_name_during_write if true, bytes are written to a ".part"
+     *        file, renamed once stream is properly closed
+     * @param delete_on_abort if true, file is deleted if stream is aborted
+     * @param resume if true, an existing ".part" file left by an interrupted
+     *        download is completed instead of being overwritten
+     *        (only if temp_name_during_write is set)
      */
     FileByteSink(const boost::filesystem::path& path,
                  bool temp_name_during_write = false,
-                 bool delete_on_abort = false);
+                 bool delete_on_abort = false,
+                 bool resume = false);
     std::ostream* OpenStream() override;
     void CloseStream() override;
+    bool IsBufferWritable() const override;
+    void Write(const char* p_data, std::streamsize size) override;
+    int64_t GetResumeOffset() const override;
+    string_t GetResumeValidator() const override;
+    void SetResumeValidator(const string_t& validator) override;
+    void SetResume(bool resume) override;
     void SetExpectedLength(std::streamsize expected_length) override;
     void Abort() override;
     boost::filesystem::path path() {
@@ -57,7 +76,12 @@ class FileByteSink : public ByteSink {
     std::streamsize expected_length_;
     bool aborted_;
     std::unique_ptr<boost::filesystem::ofstream> p_ofstream_;
-    const boost::filesystem::path GetActualPath();
+    string_t validator_;  // of content held in actual path
+    bool append_;  // for next opened stream
+    const boost::filesystem::path GetActualPath() const;
+    const boost::filesystem::path GetValidatorPath() const;
+    void ReadValidator();
+    void WriteValidator();
 };
 
 
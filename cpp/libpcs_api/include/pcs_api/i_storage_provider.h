@@ -17,10 +17,13 @@
 #ifndef INCLUDE_PCS_API_I_STORAGE_PROVIDER_H_
 #define INCLUDE_PCS_API_I_STORAGE_PROVIDER_H_
 
+#include <functional>
 #include <string>
 #include <map>
 #include <vector>
 
+#include "pplx/pplxtasks.h"
+
 #include "pcs_api/model.h"
 #include "pcs_api/credentials.h"
 
@@ -29,9 +32,27 @@ namespace pcs_api {
 
 /**
  * \brief Common interface for storage providers.
+ *
+ * Main operations also have an asynchronous counterpart, that returns
+ * a task instead of blocking the calling thread (for example ListFolderAsync).
+ * Providers implement these methods with non blocking continuations whenever
+ * possible ; default implementation runs the synchronous method in a thread
+ * owned by provider (at most kMaxBlockingThreads at a time: other calls are
+ * queued). Providers relying on default implementation (all but hubiC and
+ * Dropbox) thus have at most kMaxBlockingThreads operations in flight,
+ * whatever the number of tasks requested: this also bounds TreeWalker and
+ * ParallelDownloader concurrency. Continuations attached to returned tasks
+ * run on the default pplx scheduler, not in these threads.
+ * Storage provider object must not be destroyed before tasks it has returned
+ * are completed.
  */
 class IStorageProvider {
  public:
+    /**
+     * \brief Called by ListFolderStream() for each listed file.
+     */
+    typedef std::function<void(std::shared_ptr<CFile> p_file)> file_callback;
+
     /**
      * \brief Get the provider name.
      *
@@ -91,6 +112,43 @@ class IStorageProvider {
     virtual std::shared_ptr<CFolderContent> ListFolder(
                                                     const CFolder& folder) = 0;
 
+    /**
+     * \brief List files in folder at given path, without holding them all
+     *        in memory.
+     *
+     * Files are given to callback as soon as they are received (page by
+     * page for providers that support it), in no particular order.
+     * Callback may be called from another thread, but calls are never
+     * concurrent.
+     * Throws CInvalidFileTypeException if given path is a blob.
+     * Default implementation lists the whole folder with ListFolder().
+     *
+     * @param path The folder path
+     * @param callback called for each file of folder
+     * @return false if no folder exists at given path
+     * @throws CStorageException Error getting the files in the folder
+     */
+    virtual bool ListFolderStream(const CPath& path, file_callback callback);
+
+    /**
+     * \brief List all files below folder at given path (recursively),
+     *        without holding them all in memory.
+     *
+     * Files are given to callback as soon as they are received, in no
+     * particular order (folder at given path is not given itself).
+     * Callback may be called from another thread, but calls are never
+     * concurrent.
+     * Throws CInvalidFileTypeException if given path is a blob.
+     * hubiC and Dropbox list the whole tree with a few paginated requests ;
+     * default implementation lists folders one by one with a TreeWalker.
+     *
+     * @param path The folder path
+     * @param callback called for each file below folder
+     * @return false if no folder exists at given path
+     * @throws CStorageException Error getting the files
+     */
+    virtual bool ListRecursive(const CPath& path, file_callback callback);
+
     /**
      * \brief Create a folder at given path, with intermediate folders
      *        if needed.
@@ -148,11 +206,111 @@ class IStorageProvider {
      */
     virtual void Upload(const CUploadRequest& uploadRequest) = 0;
 
+    /**
+     * \brief Same as CreateFolder(), but also return the folder.
+     *
+     * hubiC and Dropbox build folder from server responses ;
+     * default implementation requests it with GetFile() after creation.
+     *
+     * @param path The folder path to create
+     * @return the created (or already existing) folder
+     * @throws CStorageException Error creating the folder
+     */
+    virtual std::shared_ptr<CFolder> CreateFolderAndGet(const CPath& path);
+
+    /**
+     * \brief Same as Upload(), but also return the uploaded blob.
+     *
+     * hubiC, Dropbox and Google Drive build blob from upload response
+     * (hubiC needs another request for large blobs, or if request has no
+     * content type) ; default implementation requests it with GetFile()
+     * after upload.
+     *
+     * @param upload_request The upload request object
+     * @return the uploaded blob
+     * @throws CStorageException Upload error
+     */
+    virtual std::shared_ptr<CBlob> UploadAndGetBlob(
+                                        const CUploadRequest& upload_request);
+
+    /**
+     * \brief Asynchronous counterpart of ListFolder(const CPath&).
+     *
+     * @param path The folder path
+     * @return a task holding the folder content
+     */
+    virtual pplx::task<std::shared_ptr<CFolderContent>> ListFolderAsync(
+                                                        const CPath& path);
+
+    /**
+     * \brief Asynchronous counterpart of CreateFolder().
+     *
+     * @param path The folder path to create
+     * @return a task holding true if folder has been created
+     */
+    virtual pplx::task<bool> CreateFolderAsync(const CPath& path);
+
+    /**
+     * \brief Asynchronous counterpart of Delete().
+     *
+     * @param path The file path to delete
+     * @return a task holding true if at least one file was deleted
+     */
+    virtual pplx::task<bool> DeleteAsync(const CPath& path);
+
+    /**
+     * \brief Asynchronous counterpart of GetFile().
+     *
+     * @param path The file path
+     * @return a task holding detailed file information, or empty pointer
+     */
+    virtual pplx::task<std::shared_ptr<CFile>> GetFileAsync(const CPath& path);
+
+    /**
+     * \brief Asynchronous counterpart of Download().
+     *
+     * Byte sink of request is written from scheduler threads.
+     *
+     * @param download_request The download request object (copied)
+     * @return a task that completes once blob has been downloaded
+     */
+    virtual pplx::task<void> DownloadAsync(
+                                    const CDownloadRequest& download_request);
+
+    /**
+     * \brief Asynchronous counterpart of Upload().
+     *
+     * Byte source of request is read from scheduler threads.
+     *
+     * @param upload_request The upload request object (copied)
+     * @return a task that completes once blob has been uploaded
+     */
+    virtual pplx::task<void> UploadAsync(const CUploadRequest& upload_request);
+
+    /**
+     * \brief Maximum number of threads running synchronous methods for
+     *        default asynchronous implementations (8).
+     *
+     * This is the maximum number of concurrent operations of a provider
+     * using default implementations ; further calls are queued.
+     */
+    static const size_t kMaxBlockingThreads;
+
     /**
      * \brief base destructor is virtual.
      */
     virtual ~IStorageProvider() {
     }
+
+ protected:
+    IStorageProvider();
+
+ private:
+    // Runs synchronous methods for default asynchronous implementations:
+    pplx::scheduler_ptr p_blocking_scheduler_;
+
+    template<class T>
+    pplx::task<T> RunBlocking(std::function<T()> func);
 };
 
 }  // namespace pcs_api
@@ -0,0 +1,78 @@
+/**
+ * Copyright (c) 2014 Netheos (http://www.netheos.net)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef INCLUDE_PCS_API_INTERNAL_BOUNDED_SCHEDULER_H_
+#define INCLUDE_PCS_API_INTERNAL_BOUNDED_SCHEDULER_H_
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "pplx/pplxtasks.h"
+
+namespace pcs_api {
+
+/**
+ * \brief A pplx scheduler running tasks in its own threads, with a maximum
+ *        number of threads.
+ *
+ * Used for running synchronous operations: these block a thread for the
+ * whole operation, and must not starve the shared pplx threads pool (that
+ * also completes http requests).
+ * Threads are started on demand, up to the maximum: tasks scheduled when all
+ * threads are busy are queued, and run in order.
+ * Destructor waits for queued tasks, then stops threads.
+ */
+class BoundedScheduler : public pplx::scheduler_interface {
+ public:
+    /**
+     * @param max_threads strictly positive maximum number of threads
+     */
+    explicit BoundedScheduler(size_t max_threads);
+    ~BoundedScheduler();
+
+    void schedule(pplx::TaskProc_t proc, void* param) override;
+
+ private:
+    /**
+     * \brief State shared with threads (that may outlive scheduler, if
+     *        it is destroyed by one of its own tasks).
+     */
+    struct State {
+        std::mutex mutex;  // protects members below
+        std::condition_variable cond;
+        std::deque<std::pair<pplx::TaskProc_t, void*>> tasks;
+        size_t nb_idle_threads;
+        bool stopping;
+    };
+
+    const size_t max_threads_;
+    const std::shared_ptr<State> p_state_;
+    std::vector<std::thread> threads_;  // protected by state mutex
+
+    static void Run(std::shared_ptr<State> p_state);
+
+    BoundedScheduler(const BoundedScheduler&) = delete;
+    BoundedScheduler& operator=(const BoundedScheduler&) = delete;
+};
+
+}  // namespace pcs_api
+
+#endif  // INCLUDE_PCS_API_INTERNAL_BOUNDED_SCHEDULER_H_
@@ -17,6 +17,7 @@
 #ifndef INCLUDE_PCS_API_INTERNAL_C_RESPONSE_H_
 #define INCLUDE_PCS_API_INTERNAL_C_RESPONSE_H_
 
+#include <memory>
 #include <string>
 #include <sstream>
 
@@ -27,6 +28,7 @@
 
 #include "pcs_api/types.h"
 #include "pcs_api/byte_sink.h"
+#include "pcs_api/c_download_request.h"
 #include "pcs_api/c_exceptions.h"
 
 namespace pcs_api {
@@ -41,8 +43,10 @@ namespace pcs_api {
  * a real destructor, or putting client back to a http clients pool).
  * Destructor ensures that http_response is fully read or canceled so that all
  * resources are freed.
+ * Objects of this class must be owned by a shared_ptr (asynchronous methods
+ * keep this object alive until their task completes).
  */
-class CResponse {
+class CResponse : public std::enable_shared_from_this<CResponse> {
  public:
      CResponse(web::http::client::http_client *p_client,
                std::function<void(web::http::client::http_client*)> release_c_f,
@@ -101,6 +105,11 @@ class CResponse {
     */
     const std::string AsString();
 
+    /**
+     * \brief Asynchronous counterpart of AsString().
+     */
+    pplx::task<std::string> AsStringAsync();
+
     /**
      * \brief Inquire if content type is json.
      *
@@ -131,6 +140,11 @@ class CResponse {
      */
     web::json::value AsJson();
 
+    /**
+     * \brief Asynchronous counterpart of AsJson().
+     */
+    pplx::task<web::json::value> AsJsonAsync();
+
     /**
     * \brief Inquire if content type is xml.
     *
@@ -161,9 +175,44 @@ class CResponse {
     /**
      * \brief Blob download: read body and write data into given sink.
      *
+     * Received buffers are handed to the sink without intermediate copy
+     * whenever possible (see ByteSink::IsBufferWritable()).
+     * If the body could not be fully read, a CRetriableException is raised:
+     * the bytes already written may then be resumed by the next attempt.
+     * If a resumed range download gets whole content (content has changed),
+     * bytes held by sink are dropped and a CRetriableException is raised:
+     * next attempt requests the range again.
+     *
+     * @param p_bs destination
+     * @param chunk_size maximum number of bytes written to sink at once
+     * @param resume_offset number of bytes held by sink that were skipped
+     *        by request (see CDownloadRequest::GetHttpHeaders()): they are
+     *        kept only if server sent partial content
+     * @param partial true if request is for a range of content
+     *        (see CDownloadRequest::IsPartial())
+     */
+    void DownloadDataToSink(
+                    ByteSink *p_bs,
+                    size_t chunk_size = CDownloadRequest::kDefaultChunkSize,
+                    int64_t resume_offset = 0,
+                    bool partial = false);
+
+    /**
+     * \brief Asynchronous counterpart of DownloadDataToSink().
+     *
      * @param p_bs destination
+     * @param chunk_size maximum number of bytes written to sink at once
+     * @param resume_offset number of bytes held by sink that were skipped
+     *        by request
+     * @param partial true if request is for a range of content
+     * @return a task that completes once all data has been written
+     *         and sink closed
      */
-    void DownloadDataToSink(ByteSink *p_bs);
+    pplx::task<void> DownloadDataToSinkAsync(
+                    std::shared_ptr<ByteSink> p_bs,
+                    size_t chunk_size = CDownloadRequest::kDefaultChunkSize,
+                    int64_t resume_offset = 0,
+                    bool partial = false);
 
     /**
      * \brief Returns a summary of response as a string
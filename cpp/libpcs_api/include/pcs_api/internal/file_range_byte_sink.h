@@ -0,0 +1,71 @@
+/**
+ * Copyright (c) 2014 Netheos (http://www.netheos.net)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef INCLUDE_PCS_API_INTERNAL_FILE_RANGE_BYTE_SINK_H_
+#define INCLUDE_PCS_API_INTERNAL_FILE_RANGE_BYTE_SINK_H_
+
+#include <memory>
+#include <iostream>  // NOLINT(readability/streams)
+
+#include "boost/filesystem.hpp"
+#include "boost/filesystem/fstream.hpp"
+
+#include "pcs_api/byte_sink.h"
+
+namespace pcs_api {
+
+namespace detail {
+
+/**
+ * \brief A ByteSink writing bytes into an existing local file, starting
+ *        at a given offset (positional writes).
+ *
+ * Several such sinks may write concurrently disjoint ranges of the same file.
+ * File is neither truncated nor renamed ; each OpenStream() starts writing
+ * again at range offset, so that a range download can be retried.
+ */
+class FileRangeByteSink : public ByteSink {
+ public:
+    /**
+     * @param path the existing file (copied)
+     * @param offset position of the first byte to write
+     * @param length number of bytes of the range
+     */
+    FileRangeByteSink(const boost::filesystem::path& path,
+                      int64_t offset,
+                      int64_t length);
+    std::ostream* OpenStream() override;
+    void CloseStream() override;
+    bool IsBufferWritable() const override;
+    void Write(const char* p_data, std::streamsize size) override;
+    void SetExpectedLength(std::streamsize expected_length) override;
+    void Abort() override;
+    ~FileRangeByteSink();
+
+ private:
+    const boost::filesystem::path path_;
+    const int64_t offset_;
+    const int64_t length_;
+    std::streamsize written_;
+    std::unique_ptr<boost::filesystem::fstream> p_fstream_;
+    void ThrowIoFailure(const std::string& msg);
+};
+
+}  // namespace detail
+
+}  // namespace pcs_api
+
+#endif  // INCLUDE_PCS_API_INTERNAL_FILE_RANGE_BYTE_SINK_H_
@@ -17,8 +17,12 @@
 #ifndef INCLUDE_PCS_API_INTERNAL_HTTP_CLIENT_POOL_H_
 #define INCLUDE_PCS_API_INTERNAL_HTTP_CLIENT_POOL_H_
 
+#include <chrono>
 #include <functional>
 #include <list>
+#include <memory>
+#include <mutex>
+#include <set>
 
 #include "cpprest/http_client.h"
 
@@ -35,20 +39,43 @@ namespace pcs_api {
  * nonce somewhere (indirectly, in WinHttp handle for win7 implementation).
  * But this does not work, refer to
  * https://casablanca.codeplex.com/discussions/561171
+ *
+ * Pooled clients are checked before reuse: a client whose last request
+ * failed without any response (connection reset, timeout...) may hold broken
+ * connections, so it is replaced by a new client.
  */
 class HttpClientPool : public ObjectPool<web::http::client::http_client> {
  public:
     HttpClientPool(const web::uri& base_uri,
-        std::shared_ptr<web::http::client::http_client_config> client_config);
+        std::shared_ptr<const web::http::client::http_client_config>
+                                                                client_config,
+        size_t max_clients = 0,
+        std::chrono::milliseconds idle_timeout =
+                                            std::chrono::milliseconds::zero(),
+        std::chrono::milliseconds max_wait =
+                                            std::chrono::milliseconds::zero());
+    ~HttpClientPool();
     HttpClientPool(const HttpClientPool&) = delete;
     HttpClientPool& operator=(const HttpClientPool&) = delete;
 
+    /**
+     * \brief Indicate that a request of a client taken from this pool has
+     *        failed without any response.
+     *
+     * Client may still be given back: it will not be reused.
+     */
+    void ReportFailure(web::http::client::http_client *p_client);
+
  private:
     const web::uri base_uri_;
-    std::shared_ptr<web::http::client::http_client_config>
+    std::shared_ptr<const web::http::client::http_client_config>
                                                          p_http_client_config_;
+    // clients that will fail health check:
+    std::set<const web::http::client::http_client*> failed_clients_;
+    std::mutex failed_clients_mutex_;  // protects failed_clients_
     web::http::client::http_client* CreateClient();
     void DeleteClient(web::http::client::http_client *);
+    bool CheckClient(web::http::client::http_client *p_client);
 };
 
 }  // namespace pcs_api
@@ -0,0 +1,122 @@
+/**
+ * Copyright (c) 2014 Netheos (http://www.netheos.net)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef INCLUDE_PCS_API_INTERNAL_KEYED_HTTP_CLIENT_POOL_H_
+#define INCLUDE_PCS_API_INTERNAL_KEYED_HTTP_CLIENT_POOL_H_
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "cpprest/http_client.h"
+
+#include "pcs_api/types.h"
+#include "pcs_api/internal/http_client_pool.h"
+
+namespace pcs_api {
+
+/**
+ * \brief A set of http_client pools, one per URI authority
+ *        (scheme, host and port).
+ *
+ * Requests may target several hosts (API and content endpoints, Swift
+ * storage...): each host gets its own HttpClientPool, so that connections
+ * to that host are reused by subsequent requests.
+ * Pools are created on first use, and live as long as this object.
+ * The limit of clients applies to each host separately.
+ *
+ * This class is thread safe.
+ */
+class KeyedHttpClientPool {
+ public:
+    /**
+     * @param client_config configuration of created clients
+     * @param max_clients_per_host maximum number of clients per host
+     *        (0 for no limit)
+     * @param idle_timeout idle clients older than this are destroyed
+     *        (zero for no timeout)
+     * @param max_wait maximum time to wait for a client when limit per host
+     *        is reached (zero to wait forever)
+     */
+    KeyedHttpClientPool(
+        std::shared_ptr<const web::http::client::http_client_config>
+                                                                client_config,
+        size_t max_clients_per_host,
+        std::chrono::milliseconds idle_timeout,
+        std::chrono::milliseconds max_wait);
+    KeyedHttpClientPool(const KeyedHttpClientPool&) = delete;
+    KeyedHttpClientPool& operator=(const KeyedHttpClientPool&) = delete;
+
+    /**
+     * \brief Get a client for the authority of the given uri.
+     *
+     * Client is taken from the pool of this authority, or created.
+     */
+    web::http::client::http_client* Get(const web::uri& uri);
+
+    /**
+     * \brief Asynchronous counterpart of Get(): no thread is blocked while
+     *        the pool of this authority is exhausted
+     *        (see ObjectPool::GetAsync()).
+     */
+    pplx::task<web::http::client::http_client*> GetAsync(const web::uri& uri);
+
+    /**
+     * \brief Give back a client, obtained with Get(), to its pool.
+     */
+    void Put(web::http::client::http_client *p_client);
+
+    /**
+     * \brief Destroy a client obtained with Get(), instead of giving it back.
+     */
+    void Discard(web::http::client::http_client *p_client);
+
+    /**
+     * \brief Indicate that a request of a client obtained with Get() has
+     *        failed (see HttpClientPool::ReportFailure()).
+     */
+    void ReportFailure(web::http::client::http_client *p_client);
+
+    /**
+     * @return counters of all pools, summed
+     */
+    ObjectPoolStats GetStats();
+
+ private:
+    const std::shared_ptr<const web::http::client::http_client_config>
+                                                         p_http_client_config_;
+    const size_t max_clients_per_host_;
+    const std::chrono::milliseconds idle_timeout_;
+    const std::chrono::milliseconds max_wait_;
+    typedef std::map<string_t, std::shared_ptr<HttpClientPool>> PoolsMap;
+    /**
+     * Pools by authority (as string). The map is never modified: adding a
+     * pool replaces it with a copy, so that lookups do not lock.
+     * Only accessed through std::atomic_load/atomic_store.
+     */
+    std::shared_ptr<const PoolsMap> p_pools_;
+    /**
+     * mutex serializing pools creation (not held for lookups)
+     */
+    std::mutex pools_mutex_;
+
+    HttpClientPool& GetPool(const web::uri& authority);
+};
+
+}  // namespace pcs_api
+
+#endif  // INCLUDE_PCS_API_INTERNAL_KEYED_HTTP_CLIENT_POOL_H_
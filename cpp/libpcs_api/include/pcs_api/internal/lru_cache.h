@@ -0,0 +1,241 @@
+/**
+ * Copyright (c) 2014 Netheos (http://www.netheos.net)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef INCLUDE_PCS_API_INTERNAL_LRU_CACHE_H_
+#define INCLUDE_PCS_API_INTERNAL_LRU_CACHE_H_
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace pcs_api {
+
+/**
+ * \brief Removal counters of all shards of an LruCache, as read by
+ *        LruCache::generation().
+ */
+typedef std::array<uint64_t, 16> LruCacheGeneration;
+
+/**
+ * \brief A thread safe key/value cache, bounded in size and in time.
+ *
+ * Entries expire once their time to live has elapsed ; when a shard is full,
+ * its least recently used entry is evicted.
+ * Entries are spread into several shards according to their key hash, each
+ * shard with its own lock, so that concurrent threads rarely contend.
+ *
+ * Each removal increments the generation counter of the shards it affects:
+ * a value computed by a caller while entries of its shard were removed may
+ * be outdated, so that Put() ignores it (see generation()).
+ */
+template<class K, class V, class Hash = std::hash<K>>
+class LruCache {
+ public:
+    typedef std::chrono::steady_clock clock;
+
+    /**
+     * @param max_entries maximum number of entries (approximate:
+     *        this bound is split between shards)
+     * @param ttl entries time to live
+     */
+    LruCache(size_t max_entries, std::chrono::milliseconds ttl) :
+        ttl_(ttl),
+        max_entries_per_shard_(std::max(static_cast<size_t>(1),
+                        (max_entries + kNbShards - 1) / kNbShards)),
+        shards_(kNbShards) {
+    }
+
+    LruCache(const LruCache&) = delete;
+    LruCache& operator=(const LruCache&) = delete;
+
+    /**
+     * \brief Get a value, if present and not expired.
+     *
+     * @param key the searched key
+     * @param p_value (out) the cached value, if found
+     * @return true if an entry has been found
+     */
+    bool Get(const K& key, V* p_value) {
+        Shard& shard = GetShard(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.index.find(key);
+        if (it == shard.index.end()) {
+            return false;
+        }
+        if (clock::now() >= it->second->expires_at) {
+            shard.entries.erase(it->second);
+            shard.index.erase(it);
+            return false;
+        }
+        // Entry becomes the most recently used one:
+        shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+        *p_value = it->second->value;
+        return true;
+    }
+
+    /**
+     * \brief Current generation of all shards, to be read before computing
+     *        values that will be given to Put().
+     */
+    LruCacheGeneration generation() const {
+        LruCacheGeneration current;
+        for (size_t i = 0; i < kNbShards; ++i) {
+            current[i] = shards_[i].generation;
+        }
+        return current;
+    }
+
+    /**
+     * \brief Store a value, unless some entries of its shard have been
+     *        removed since given generation.
+     *
+     * @return true if value has been stored
+     */
+    bool Put(const K& key, const V& value,
+             const LruCacheGeneration& expected_generation) {
+        size_t index = GetShardIndex(key);
+        Shard& shard = shards_[index];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        // Removals increment generation while holding shard lock:
+        if (shard.generation != expected_generation[index]) {
+            return false;
+        }
+        clock::time_point expires_at = clock::now() + ttl_;
+        auto it = shard.index.find(key);
+        if (it != shard.index.end()) {
+            it->second->value = value;
+            it->second->expires_at = expires_at;
+            shard.entries.splice(shard.entries.begin(), shard.entries,
+                                 it->second);
+            return true;
+        }
+        shard.entries.push_front(Entry(key, value, expires_at));
+        shard.index[key] = shard.entries.begin();
+        if (shard.entries.size() > max_entries_per_shard_) {
+            shard.index.erase(shard.entries.back().key);
+            shard.entries.pop_back();
+        }
+        return true;
+    }
+
+    /**
+     * \brief Remove an entry (if present).
+     */
+    void Erase(const K& key) {
+        Shard& shard = GetShard(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        ++shard.generation;
+        auto it = shard.index.find(key);
+        if (it != shard.index.end()) {
+            shard.entries.erase(it->second);
+            shard.index.erase(it);
+        }
+    }
+
+    /**
+     * \brief Remove all entries whose key matches given predicate.
+     */
+    void EraseIf(std::function<bool(const K&)> predicate) {
+        for (Shard& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            ++shard.generation;
+            for (auto it = shard.entries.begin();
+                                        it != shard.entries.end();) {
+                if (predicate(it->key)) {
+                    shard.index.erase(it->key);
+                    it = shard.entries.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+    }
+
+    void Clear() {
+        EraseIf([](const K&) { return true; });
+    }
+
+    /**
+     * @return current number of entries (including expired ones
+     *         not removed yet)
+     */
+    size_t size() {
+        size_t count = 0;
+        for (Shard& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            count += shard.entries.size();
+        }
+        return count;
+    }
+
+ protected:
+    static const size_t kNbShards =
+                            std::tuple_size<LruCacheGeneration>::value;
+
+    struct Entry {
+        Entry(const K& entry_key, const V& entry_value,
+              clock::time_point expiration) :
+            key(entry_key), value(entry_value), expires_at(expiration) {
+        }
+        K key;
+        V value;
+        clock::time_point expires_at;
+    };
+
+    struct Shard {
+        Shard() : generation(0) {
+        }
+        /**
+         * Most recently used entries first
+         */
+        std::list<Entry> entries;
+        std::unordered_map<K, typename std::list<Entry>::iterator, Hash> index;
+        /**
+         * mutex for entries and index access, and generation updates
+         */
+        std::mutex mutex;
+        /**
+         * number of removals in this shard (only incremented with mutex
+         * held, may be read without it)
+         */
+        std::atomic<uint64_t> generation;
+    };
+
+    const std::chrono::milliseconds ttl_;
+    const size_t max_entries_per_shard_;
+    std::vector<Shard> shards_;
+    Hash hash_;
+
+    size_t GetShardIndex(const K& key) const {
+        return hash_(key) % kNbShards;
+    }
+
+    Shard& GetShard(const K& key) {
+        return shards_[GetShardIndex(key)];
+    }
+};
+
+}  // namespace pcs_api
+
+#endif  // INCLUDE_PCS_API_INTERNAL_LRU_CACHE_H_
@@ -28,6 +28,8 @@
 #include "pcs_api/user_credentials_repository.h"
 #include "pcs_api/storage_builder.h"
 #include "pcs_api/internal/request_invoker.h"
+#include "pcs_api/internal/keyed_http_client_pool.h"
+#include "pcs_api/internal/token_refresher.h"
 
 namespace pcs_api {
 
@@ -59,11 +61,22 @@ class OAuth2SessionManager {
      */
     std::shared_ptr<CResponse> Execute(::web::http::http_request request);
 
+    /**
+     * \brief Asynchronous counterpart of Execute().
+     *
+     * @param request
+     * @return a task holding the CResponse object
+     */
+    pplx::task<std::shared_ptr<CResponse>> ExecuteAsync(
+                                            ::web::http::http_request request);
+
     /**
      * \brief Execute the given request without modifying request.
      *
      * This is the method to use to perform OAuth2 authorization workflow,
      * for getting tokens.
+     * Client is taken from the pool of request host, and will be put back
+     * in the pool when the returned CResponse object is destroyed.
      *
      * @param request
      * @return a CResponse object, owning client used, some request info
@@ -71,18 +84,38 @@ class OAuth2SessionManager {
      */
     std::shared_ptr<CResponse> RawExecute(::web::http::http_request request);
 
+    /**
+     * \brief Asynchronous counterpart of RawExecute().
+     *
+     * @param request
+     * @return a task holding the CResponse object
+     */
+    pplx::task<std::shared_ptr<CResponse>> RawExecuteAsync(
+                                            ::web::http::http_request request);
+
     /**
      * Refreshes access token after expiration (before sending request) thanks
      * to the refresh token. New access token is then stored in this manager.
      * <p/>
-     * Method is synchronized so that no two threads will attempt to refresh
-     * at the same time. If a locked thread sees that token has already been
-     * refreshed, no refresh is attempted either.
+     * Only one refresh is in progress at a time: a thread that sees that
+     * token is being refreshed, or has already been refreshed, waits for
+     * that refresh instead of sending its own request.
+     * <p/>
+     * Tokens are normally renewed before they expire by a background thread
+     * (see StorageBuilder::token_refresh_margin()): refreshing before a
+     * request only happens if background refresh failed.
      * <p/>
      * Not all providers support tokens refresh (ex: CloudMe).
      */
     void RefreshToken();
 
+    /**
+     * \brief Asynchronous counterpart of RefreshToken().
+     *
+     * @return a task that completes once token has been refreshed
+     */
+    pplx::task<void> RefreshTokenAsync();
+
     /**
      * Fetches user credentials
      *
@@ -91,6 +124,22 @@ class OAuth2SessionManager {
      */
     std::shared_ptr<UserCredentials> FetchUserCredentials(const string_t& code);
 
+    /**
+     * @return provider specific data persisted with user credentials
+     *         (serialized JSON object, empty if none or no credentials)
+     */
+    string_t GetProviderData();
+
+    /**
+     * \brief Store provider specific data with user credentials,
+     *        and save them into user credentials repository.
+     *
+     * Does nothing if there are no user credentials.
+     *
+     * @param json_string serialized JSON object (empty to remove data)
+     */
+    void SaveProviderData(const string_t& json_string);
+
     std::shared_ptr<UserCredentialsRepository> user_credentials_repository() {
         return p_user_credentials_repo_;
     }
@@ -112,14 +161,40 @@ class OAuth2SessionManager {
     const char scope_perms_separator_;
     const OAuth2AppInfo& app_info_;
     const std::shared_ptr<UserCredentialsRepository> p_user_credentials_repo_;
+    // Replaced by FetchUserCredentials() while refresher thread may read it:
+    // only accessed through std::atomic_load/atomic_store
     std::shared_ptr<UserCredentials> p_user_credentials_;
     const std::shared_ptr<const web::http::client::http_client_config>
                                                          p_http_client_config_;
     // Avoids two threads refreshing token at the same time:
     // (pointer for copiable)
     std::shared_ptr<std::mutex> p_refresh_lock_;
+    // Last refresh (protected by refresh lock), and tokens it renews:
+    pplx::task<void> refresh_task_;
+    std::shared_ptr<const OAuth2Credentials::Tokens> p_refreshed_tokens_;
+    // Clients pooled per host, shared by all threads:
+    // (pointer for copiable)
+    std::shared_ptr<KeyedHttpClientPool> p_clients_pool_;
+    // Renews token before expiration (null if disabled); last member,
+    // so that its thread is stopped first:
+    std::shared_ptr<TokenRefresher> p_token_refresher_;
 
     RequestInvoker GetOAuthRequestInvoker();
+    std::shared_ptr<UserCredentials> user_credentials() const {
+        return std::atomic_load(&p_user_credentials_);
+    }
+    /**
+     * @return expiration time of current access token (not_a_date_time if
+     *         no token, or if it does not expire)
+     */
+    boost::posix_time::ptime GetTokenExpiresAt();
+    /**
+     * \brief Send request with given pooled client (given to CResponse, or
+     *        released on failure).
+     */
+    pplx::task<std::shared_ptr<CResponse>> ExecuteWithClientAsync(
+                                    web::http::client::http_client *p_client,
+                                    web::http::http_request request);
     void ReleaseClient(web::http::client::http_client *p_client);
 
     // gtest_prod.h : FRIEND_TEST(BasicTest, TestGetUserId)
@@ -17,32 +17,127 @@
 #ifndef INCLUDE_PCS_API_INTERNAL_OBJECT_POOL_H_
 #define INCLUDE_PCS_API_INTERNAL_OBJECT_POOL_H_
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
 #include <functional>
 #include <list>
+#include <memory>
 #include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "pplx/pplxtasks.h"
 
 #include "pcs_api/internal/logger.h"
+#include "pcs_api/internal/utilities.h"
 
 namespace pcs_api {
 
 /**
- * \brief A simple class for objects pooling.
+ * \brief Counters of an ObjectPool activity.
+ */
+struct ObjectPoolStats {
+    /**
+     * number of Get() or GetAsync() served with a pooled object
+     */
+    uint64_t hits;
+    /**
+     * number of Get() or GetAsync() that had to create a new object
+     */
+    uint64_t misses;
+    /**
+     * number of Get() or GetAsync() that had to wait for an object to be
+     * given back
+     */
+    uint64_t waits;
+    /**
+     * number of objects destroyed by pool (idle for too long, failed health
+     * check, or discarded)
+     */
+    uint64_t evictions;
+    /**
+     * number of Get() or GetAsync() that created an object beyond pool
+     * limit, after having waited for max wait delay
+     */
+    uint64_t overflows;
+};
+
+/**
+ * \brief A class for objects pooling.
  *
- * Object is taken from the pool with method Get(), and given back with Put().
+ * Object is taken from the pool with method Get(), and given back with Put()
+ * (or Discard() if object should not be reused).
  * When pool is empty, new objects are allocated with the given arbitrary
  * function.
  * When pool is destroyed, all objects are destroyed with the given arbitrary
  * function.
  *
+ * The total number of objects (taken or idle) may be limited: when this
+ * limit is reached, Get() waits for an object to be given back. In order to
+ * avoid dead locks (a thread may take several objects), Get() creates an
+ * object anyway once max wait delay has expired: limit is then exceeded
+ * (this is counted in ObjectPoolStats::overflows, and limit is enforced
+ * again once objects are destroyed).
+ * GetAsync() does the same without blocking any thread: its task is queued,
+ * and completed (first queued, first served) when an object is given back.
+ * Objects that have stayed idle for longer than a given timeout are
+ * destroyed, as well as objects that fail the (optional) health check
+ * performed before reuse.
+ *
+ * Idle objects are kept in several shards, each one with its own lock.
+ * A thread always gives back objects to the same shard, and first looks
+ * in it when getting an object, so that threads do not contend on a single
+ * lock and usually reuse their own objects.
+ *
  * This class is thread safe.
  */
 template<class T>
 class ObjectPool {
  public:
+    typedef std::chrono::steady_clock clock;
+
+    /**
+     * @param create_object_function function called to create an object
+     * @param delete_object_function function called to destroy an object
+     * @param max_objects maximum number of objects created by this pool
+     *        and not destroyed yet (0 for no limit)
+     * @param idle_timeout idle objects older than this are destroyed
+     *        (zero for no timeout)
+     * @param max_wait when max_objects is reached, maximum time to wait
+     *        for an object to be given back before creating a new one
+     *        anyway (zero to wait forever)
+     * @param check_object_function (optional) function called before
+     *        an idle object is reused ; object is destroyed if false
+     *        is returned
+     */
     ObjectPool(std::function<T*()> create_object_function,
-               std::function<void(T*)> delete_object_function) :
+               std::function<void(T*)> delete_object_function,
+               size_t max_objects = 0,
+               std::chrono::milliseconds idle_timeout =
+                                            std::chrono::milliseconds::zero(),
+               std::chrono::milliseconds max_wait =
+                                            std::chrono::milliseconds::zero(),
+               std::function<bool(T*)> check_object_function = nullptr) :
         create_function_(create_object_function),
-        delete_function_(delete_object_function) {
+        delete_function_(delete_object_function),
+        check_function_(check_object_function),
+        max_objects_(max_objects),
+        idle_timeout_(idle_timeout),
+        max_wait_(max_wait),
+        shards_(kNbShards),
+        nb_objects_(0),
+        nb_waiters_(0),
+        hits_(0),
+        misses_(0),
+        waits_(0),
+        evictions_(0),
+        overflows_(0) {
     }
 
     ObjectPool(const ObjectPool&) = delete;
@@ -52,29 +147,152 @@ class ObjectPool {
      * Destroy pool and any objects that are currently pooled
      */
     ~ObjectPool() {
+        // tasks must have completed before pool is destroyed:
+        for (const std::shared_ptr<AsyncWaiter>& p_waiter : async_waiters_) {
+            if (!p_waiter->completed.exchange(true)) {
+                p_waiter->tce.set_exception(
+                            std::logic_error("Pool destroyed while waiting"));
+            }
+        }
+        ObjectPoolStats stats = GetStats();
         LOG_TRACE << "Pool destructor will delete "
-                  << pool_.size()
-                  << " pooled client(s)";
-        for (T* p : pool_) {
-            delete_function_(p);
+                  << CountIdleObjects()
+                  << " pooled client(s)"
+                  << " (hits=" << stats.hits
+                  << " misses=" << stats.misses
+                  << " waits=" << stats.waits
+                  << " evictions=" << stats.evictions
+                  << " overflows=" << stats.overflows << ")";
+        for (Shard& shard : shards_) {
+            for (const PooledObject& pooled : shard.idle_objects) {
+                delete_function_(pooled.p_object);
+            }
         }
     }
 
     /**
      * Get an object, either from pool or by constructing a new object.
+     *
+     * If pool is bounded and all objects are taken, waits for an object to be
+     * given back ; after max wait, an object is created beyond the limit
+     * (see ObjectPoolStats::overflows).
      */
     T* Get() {
-        std::lock_guard<std::mutex> pool_lock_guard(this->pool_lock_mutex_);
-        if (pool_.empty()) {
-            LOG_TRACE << "No client in pool: creating one";
-            return create_function_();
-        } else {
-            // return last object from our pool:
-            LOG_TRACE << "Getting client from pool";
-            T* obj = pool_.back();
-            pool_.pop_back();
+        const size_t home = HomeShardIndex();
+        T* obj = TakeIdleObject(home);
+        if (obj != nullptr) {
+            ++hits_;
             return obj;
         }
+        if (ReserveObjectCreation()) {
+            return CreateObject();
+        }
+
+        // Pool is exhausted: wait for an object to be given back
+        // (or destroyed, which frees room for a new one)
+        ++waits_;
+        LOG_TRACE << "Pool exhausted: waiting for a client";
+        const clock::time_point deadline = clock::now() + max_wait_;
+        std::unique_lock<std::mutex> wait_lock(wait_mutex_);
+        ++nb_waiters_;
+        for (;;) {
+            // Objects given back after this scan will notify us,
+            // as we hold wait_mutex_ until we actually wait:
+            obj = TakeIdleObject(home);
+            if (obj != nullptr) {
+                --nb_waiters_;
+                ++hits_;
+                return obj;
+            }
+            if (ReserveObjectCreation()) {
+                break;
+            }
+            if (max_wait_ == std::chrono::milliseconds::zero()) {
+                available_cond_.wait(wait_lock);
+            } else if (available_cond_.wait_until(wait_lock, deadline)
+                            == std::cv_status::timeout) {
+                LOG_WARN << "No client given back to pool after "
+                         << max_wait_.count()
+                         << " ms: pool limit exceeded";
+                ++nb_objects_;
+                ++overflows_;
+                break;
+            }
+        }
+        --nb_waiters_;
+        wait_lock.unlock();
+        return CreateObject();
+    }
+
+    /**
+     * Asynchronous counterpart of Get(): no thread is blocked while pool
+     * is exhausted.
+     *
+     * Returned task is already completed if an object is available ;
+     * otherwise it is queued, and completed when an object is given back
+     * (or after max wait, with an object created beyond the limit).
+     * Pool must not be destroyed before returned tasks are completed.
+     */
+    pplx::task<T*> GetAsync() {
+        const size_t home = HomeShardIndex();
+        T* obj = TakeIdleObject(home);
+        if (obj != nullptr) {
+            ++hits_;
+            return pplx::task_from_result(obj);
+        }
+        if (ReserveObjectCreation()) {
+            return pplx::task_from_result(CreateObject());
+        }
+
+        ++waits_;
+        LOG_TRACE << "Pool exhausted: queuing a client request";
+        std::shared_ptr<AsyncWaiter> p_waiter =
+                                            std::make_shared<AsyncWaiter>();
+        {
+            std::lock_guard<std::mutex> wait_lock_guard(wait_mutex_);
+            // Objects given back after this scan will serve our waiter,
+            // as we hold wait_mutex_ until it is queued:
+            obj = TakeIdleObject(home);
+            if (obj != nullptr) {
+                ++hits_;
+                return pplx::task_from_result(obj);
+            }
+            if (!ReserveObjectCreation()) {
+                async_waiters_.push_back(p_waiter);
+                ++nb_waiters_;
+            } else {
+                p_waiter->completed = true;
+            }
+        }
+        if (p_waiter->completed) {
+            return pplx::task_from_result(CreateObject());
+        }
+
+        if (max_wait_ != std::chrono::milliseconds::zero()) {
+            // Timer does not keep waiter alive once it has been served:
+            std::weak_ptr<AsyncWaiter> p_weak_waiter = p_waiter;
+            utilities::CompleteAfter(max_wait_).then([p_weak_waiter] {
+                std::shared_ptr<AsyncWaiter> p_late = p_weak_waiter.lock();
+                if (p_late && !p_late->completed.exchange(true)) {
+                    p_late->timed_out = true;
+                    p_late->tce.set(nullptr);
+                }
+            });
+        }
+        return pplx::create_task(p_waiter->tce).then(
+                                            [this, p_waiter](T* obj) -> T* {
+            if (obj != nullptr) {
+                return obj;
+            }
+            if (p_waiter->timed_out) {
+                LOG_WARN << "No client given back to pool after "
+                         << max_wait_.count()
+                         << " ms: pool limit exceeded";
+                ++nb_objects_;
+                ++overflows_;
+            }
+            return CreateObject();
+        });
     }
 
     /**
@@ -82,15 +300,121 @@ class ObjectPool {
      */
     void Put(T *obj) {
         LOG_TRACE << "Putting client back in pool";
-        std::lock_guard<std::mutex> pool_lock_guard(this->pool_lock_mutex_);
-        pool_.push_back(obj);
+        PutIdleObject(obj);
+        NotifyWaiters();
+    }
+
+    /**
+     * Destroy an object taken from this pool, instead of giving it back
+     * (for example because object is in a bad state).
+     */
+    void Discard(T *obj) {
+        LOG_TRACE << "Discarding client";
+        std::vector<T*> discarded(1, obj);
+        DestroyObjects(discarded);
+        NotifyWaiters();
+    }
+
+    /**
+     * \brief Destroy all objects that have been idle for too long.
+     *
+     * This is also done on the fly by Get() and Put(), but only for the
+     * shards they access.
+     */
+    void EvictIdleObjects() {
+        std::vector<T*> evicted;
+        clock::time_point now = clock::now();
+        for (Shard& shard : shards_) {
+            std::lock_guard<std::mutex> shard_lock_guard(shard.mutex);
+            EvictIdleObjects(&shard, now, &evicted);
+        }
+        DestroyObjects(evicted);
+        NotifyWaiters();
+    }
+
+    /**
+     * \brief Destroy all idle objects.
+     *
+     * Subclasses whose delete function uses their own members must call
+     * this in their destructor.
+     */
+    void Clear() {
+        std::vector<T*> cleared;
+        for (Shard& shard : shards_) {
+            std::lock_guard<std::mutex> shard_lock_guard(shard.mutex);
+            for (const PooledObject& pooled : shard.idle_objects) {
+                cleared.push_back(pooled.p_object);
+            }
+            shard.idle_objects.clear();
+        }
+        DestroyObjects(cleared);
+        NotifyWaiters();
+    }
+
+    /**
+     * @return a snapshot of this pool counters
+     */
+    ObjectPoolStats GetStats() const {
+        ObjectPoolStats stats;
+        stats.hits = hits_;
+        stats.misses = misses_;
+        stats.waits = waits_;
+        stats.evictions = evictions_;
+        stats.overflows = overflows_;
+        return stats;
+    }
+
+    /**
+     * @return current number of objects created by this pool
+     *         (taken or idle) and not destroyed yet
+     */
+    size_t CountObjects() const {
+        return nb_objects_;
+    }
+
+    /**
+     * @return current number of idle objects
+     */
+    size_t CountIdleObjects() {
+        size_t count = 0;
+        for (Shard& shard : shards_) {
+            std::lock_guard<std::mutex> shard_lock_guard(shard.mutex);
+            count += shard.idle_objects.size();
+        }
+        return count;
     }
 
  protected:
     /**
-     * Objects ready to be taken
+     * Number of shards for idle objects
      */
-    std::list<T*> pool_;
+    static const size_t kNbShards = 8;
+
+    /**
+     * An idle object, with the time it was given back to pool
+     */
+    struct PooledObject {
+        PooledObject(T* p_obj, clock::time_point released) :
+            p_object(p_obj), released_at(released) {
+        }
+        T* p_object;
+        clock::time_point released_at;
+    };
+
+    /**
+     * Idle objects given back by some threads
+     */
+    struct Shard {
+        /**
+         * Objects ready to be taken (least recently used first)
+         */
+        std::list<PooledObject> idle_objects;
+        /**
+         * mutex for idle_objects access
+         */
+        std::mutex mutex;
+    };
+
     /**
      * function to create an object
      */
@@ -100,9 +424,236 @@ class ObjectPool {
      */
     std::function<void(T*)> delete_function_;
     /**
-     * mutex and lock for pool_ access
+     * function to check an idle object before reuse (may be empty)
+     */
+    std::function<bool(T*)> check_function_;
+    /**
+     * maximum number of objects (0 if unlimited)
+     */
+    const size_t max_objects_;
+    /**
+     * idle objects are evicted after this delay (if not zero)
+     */
+    const std::chrono::milliseconds idle_timeout_;
+    /**
+     * maximum wait for an object when pool is exhausted (zero if forever)
+     */
+    const std::chrono::milliseconds max_wait_;
+    std::vector<Shard> shards_;
+    /**
+     * number of objects created and not destroyed yet
+     */
+    std::atomic<size_t> nb_objects_;
+    /**
+     * A GetAsync() call waiting for an object
+     */
+    struct AsyncWaiter {
+        AsyncWaiter() : completed(false), timed_out(false) {
+        }
+        /**
+         * set with an object, or with nullptr if caller must create one
+         * (creation already counted, unless timed_out)
+         */
+        pplx::task_completion_event<T*> tce;
+        /**
+         * set by the first of pool and timer that completes tce
+         */
+        std::atomic<bool> completed;
+        bool timed_out;
+    };
+
+    /**
+     * threads waiting for an object are woken up with available_cond_,
+     * GetAsync() calls are queued in async_waiters_ (protected by
+     * wait_mutex_, and may contain timed out waiters)
+     */
+    std::mutex wait_mutex_;
+    std::condition_variable available_cond_;
+    std::deque<std::shared_ptr<AsyncWaiter>> async_waiters_;
+    std::atomic<int> nb_waiters_;
+    // Statistics:
+    std::atomic<uint64_t> hits_;
+    std::atomic<uint64_t> misses_;
+    std::atomic<uint64_t> waits_;
+    std::atomic<uint64_t> evictions_;
+    std::atomic<uint64_t> overflows_;
+
+    size_t HomeShardIndex() const {
+        return std::hash<std::thread::id>()(std::this_thread::get_id())
+                % shards_.size();
+    }
+
+    /**
+     * Take most recently used healthy idle object, looking first in given
+     * shard then in other shards.
+     *
+     * @return idle object, or nullptr if none available
+     */
+    T* TakeIdleObject(size_t first_shard_index) {
+        for (size_t i = 0; i < shards_.size(); ++i) {
+            Shard& shard = shards_[(first_shard_index + i) % shards_.size()];
+            for (;;) {
+                T* obj = nullptr;
+                std::vector<T*> evicted;
+                {
+                    std::lock_guard<std::mutex> shard_lock_guard(shard.mutex);
+                    EvictIdleObjects(&shard, clock::now(), &evicted);
+                    if (!shard.idle_objects.empty()) {
+                        obj = shard.idle_objects.back().p_object;
+                        shard.idle_objects.pop_back();
+                    }
+                }
+                DestroyObjects(evicted);
+                if (obj == nullptr) {
+                    break;  // nothing in this shard
+                }
+                if (!check_function_ || check_function_(obj)) {
+                    LOG_TRACE << "Getting client from pool";
+                    return obj;
+                }
+                LOG_DEBUG << "Pooled client failed health check";
+                std::vector<T*> unhealthy(1, obj);
+                DestroyObjects(unhealthy);
+            }
+        }
+        return nullptr;
+    }
+
+    /**
+     * Give back an object to the shard of current thread.
+     */
+    void PutIdleObject(T *obj) {
+        std::vector<T*> evicted;
+        {
+            Shard& shard = shards_[HomeShardIndex()];
+            std::lock_guard<std::mutex> shard_lock_guard(shard.mutex);
+            clock::time_point now = clock::now();
+            EvictIdleObjects(&shard, now, &evicted);
+            shard.idle_objects.push_back(PooledObject(obj, now));
+        }
+        DestroyObjects(evicted);
+    }
+
+    /**
+     * Count one more object, unless pool limit has been reached.
+     *
+     * @return true if caller can create an object
+     */
+    bool ReserveObjectCreation() {
+        size_t current = nb_objects_;
+        do {
+            if (max_objects_ > 0 && current >= max_objects_) {
+                return false;
+            }
+        } while (!nb_objects_.compare_exchange_weak(current, current + 1));
+        return true;
+    }
+
+    /**
+     * Create an object (creation must have been counted already)
      */
-    std::mutex pool_lock_mutex_;
+    T* CreateObject() {
+        LOG_TRACE << "No client in pool: creating one";
+        ++misses_;
+        try {
+            return create_function_();
+        }
+        catch (...) {
+            --nb_objects_;
+            NotifyWaiters();
+            throw;
+        }
+    }
+
+    /**
+     * Remove from shard the objects idle for too long (shard lock must be
+     * held). Removed objects are appended to p_evicted, for destruction once
+     * lock is released.
+     */
+    void EvictIdleObjects(Shard *p_shard,
+                          clock::time_point now,
+                          std::vector<T*> *p_evicted) {
+        if (idle_timeout_ == std::chrono::milliseconds::zero()) {
+            return;
+        }
+        std::list<PooledObject>& idle_objects = p_shard->idle_objects;
+        while (!idle_objects.empty()
+               && idle_objects.front().released_at + idle_timeout_ < now) {
+            p_evicted->push_back(idle_objects.front().p_object);
+            idle_objects.pop_front();
+        }
+    }
+
+    /**
+     * Destroy objects that are not in any shard (no lock must be held).
+     */
+    void DestroyObjects(const std::vector<T*>& objects) {
+        for (T* p : objects) {
+            LOG_TRACE << "Deleting evicted client";
+            delete_function_(p);
+            --nb_objects_;
+            ++evictions_;
+        }
+    }
+
+    /**
+     * Wake up threads waiting for an object, and serve queued GetAsync()
+     * calls, if any
+     */
+    void NotifyWaiters() {
+        if (nb_waiters_ <= 0) {
+            return;
+        }
+        std::vector<std::pair<std::shared_ptr<AsyncWaiter>, T*>> served;
+        {
+            std::lock_guard<std::mutex> wait_lock_guard(wait_mutex_);
+            available_cond_.notify_all();
+            ServeAsyncWaiters(&served);
+        }
+        // continuations are not run while holding lock:
+        for (const auto& waiter_and_object : served) {
+            waiter_and_object.first->tce.set(waiter_and_object.second);
+        }
+    }
+
+    /**
+     * Assign available objects (or objects creations) to queued
+     * GetAsync() calls, first queued first ; wait_mutex_ must be held.
+     */
+    void ServeAsyncWaiters(
+            std::vector<std::pair<std::shared_ptr<AsyncWaiter>, T*>>
+                                                                *p_served) {
+        while (!async_waiters_.empty()) {
+            T* obj = TakeIdleObject(HomeShardIndex());
+            if (obj == nullptr && !ReserveObjectCreation()) {
+                return;
+            }
+            // give it to the first waiter that has not timed out:
+            bool given = false;
+            while (!given && !async_waiters_.empty()) {
+                std::shared_ptr<AsyncWaiter> p_waiter =
+                                                    async_waiters_.front();
+                async_waiters_.pop_front();
+                --nb_waiters_;
+                if (!p_waiter->completed.exchange(true)) {
+                    p_served->push_back(std::make_pair(p_waiter, obj));
+                    given = true;
+                }
+            }
+            if (!given) {
+                // only timed out waiters were queued:
+                if (obj != nullptr) {
+                    PutIdleObject(obj);
+                } else {
+                    --nb_objects_;
+                }
+                return;
+            }
+            if (obj != nullptr) {
+                ++hits_;
+            }
+        }
+    }
 };
 
 }  // namespace pcs_api
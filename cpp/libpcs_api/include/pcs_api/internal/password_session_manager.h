@@ -52,8 +52,24 @@ class PasswordSessionManager {
      */
     std::shared_ptr<CResponse> Execute(::web::http::http_request request);
 
+    /**
+     * \brief Asynchronous counterpart of Execute().
+     *
+     * @param request
+     * @return a task holding the CResponse object
+     */
+    pplx::task<std::shared_ptr<CResponse>> ExecuteAsync(
+                                            ::web::http::http_request request);
+
  private:
     HttpClientPool clients_pool_;
+    /**
+     * \brief Send request with given pooled client (given to CResponse, or
+     *        released on failure).
+     */
+    pplx::task<std::shared_ptr<CResponse>> ExecuteWithClientAsync(
+                                    web::http::client::http_client *p_client,
+                                    web::http::http_request request);
     void ReleaseClient(web::http::client::http_client *p_client);
 
     // gtest_prod.h : FRIEND_TEST(BasicTest, TestGetUserId)
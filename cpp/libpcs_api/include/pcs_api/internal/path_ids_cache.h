@@ -0,0 +1,136 @@
+/**
+ * Copyright (c) 2014 Netheos (http://www.netheos.net)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef INCLUDE_PCS_API_INTERNAL_PATH_IDS_CACHE_H_
+#define INCLUDE_PCS_API_INTERNAL_PATH_IDS_CACHE_H_
+
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "boost/filesystem.hpp"
+
+#include "pcs_api/c_path.h"
+#include "pcs_api/types.h"
+
+namespace pcs_api {
+
+/**
+ * \brief A cache of remote files identifiers, for providers that address
+ *        files by id (Google Drive).
+ *
+ * Identifiers are kept in a trie of path segments: each node holds the id
+ * of a file, children are the files of a folder. A path is resolved by
+ * walking the trie from root, so that the longest cached leading part of
+ * any path is found at once.
+ * Cached ids may be outdated (files modified by other clients): callers
+ * revalidate lazily, by resolving again paths whose ids are unknown
+ * to server.
+ *
+ * Cache can be saved to a file and loaded later.
+ *
+ * This class is thread safe.
+ */
+class PathIdsCache {
+ public:
+    /**
+     * \brief Identifier of a remote file.
+     */
+    struct Entry {
+        Entry() : is_folder(false) {
+        }
+        Entry(const string_t& file_id, bool folder) :
+            id(file_id), is_folder(folder) {
+        }
+        string_t id;
+        bool is_folder;
+    };
+
+    PathIdsCache();
+    ~PathIdsCache();
+
+    /**
+     * \brief Get the identifiers of the longest cached leading segments
+     *        of given path.
+     *
+     * @param path the path to resolve
+     * @return entries of the first segments of path (empty vector if even
+     *         first segment is unknown, or if path is root)
+     */
+    std::vector<Entry> Lookup(const CPath& path) const;
+
+    /**
+     * \brief Store the identifiers of the first segments of given path
+     *        (for example a chain of files resolved from server).
+     *
+     * Cached files below a segment whose id has changed are forgotten.
+     * If chain is shorter than path (trailing segments do not exist),
+     * cached files at first missing segment are also forgotten.
+     *
+     * @param path the resolved path
+     * @param chain entries of the first segments of path
+     */
+    void Put(const CPath& path, const std::vector<Entry>& chain);
+
+    /**
+     * \brief Store the identifier of a single file (newly created),
+     *        provided its parent folder is cached.
+     */
+    void PutFile(const CPath& path, const Entry& entry);
+
+    /**
+     * \brief Forget the file at given path, and all files below it.
+     */
+    void Remove(const CPath& path);
+
+    void Clear();
+
+    /**
+     * @return number of cached files
+     */
+    size_t size() const;
+
+    /**
+     * \brief Replace cache content with the content of given file
+     *        (a missing file leaves cache empty).
+     */
+    void Load(const boost::filesystem::path& file_path);
+
+    /**
+     * \brief Write cache content into given file.
+     */
+    void Save(const boost::filesystem::path& file_path) const;
+
+ private:
+    struct Node;
+    mutable std::mutex mutex_;
+    std::unique_ptr<Node> p_root_;
+    size_t size_;
+
+    /**
+     * @return number of nodes in subtree (including given node)
+     */
+    static size_t CountNodes(const Node& node);
+    static void WriteNodes(const Node& node,
+                           const string_t& path_name,
+                           std::ostream* p_os);
+};
+
+}  // namespace pcs_api
+
+#endif  // INCLUDE_PCS_API_INTERNAL_PATH_IDS_CACHE_H_
@@ -34,8 +34,10 @@ class ProgressOutputFilter : public boost::iostreams::multichar_output_filter {
  public:
     /**
      * @param p_pl Only referenced, not owned by this object
+     * @param initial_count number of bytes already written (resumed sink)
      */
-    explicit ProgressOutputFilter(ProgressListener* p_pl);
+    explicit ProgressOutputFilter(ProgressListener* p_pl,
+                                  std::streamsize initial_count = 0);
 
     template<typename Sink>
     std::streamsize write(Sink& sink,  // NOLINT
@@ -60,6 +62,12 @@ class ProgressByteSink : public ByteSink {
                      std::shared_ptr<ProgressListener> p_pl);
     std::ostream* OpenStream() override;
     void CloseStream() override;
+    bool IsBufferWritable() const override;
+    void Write(const char* p_data, std::streamsize size) override;
+    int64_t GetResumeOffset() const override;
+    string_t GetResumeValidator() const override;
+    void SetResumeValidator(const string_t& validator) override;
+    void SetResume(bool resume) override;
     void SetExpectedLength(std::streamsize expected_length) override;
     void Abort() override;
 
@@ -70,6 +78,8 @@ class ProgressByteSink : public ByteSink {
     std::unique_ptr<filtstream> p_sink_stream_;
     std::unique_ptr<ProgressOutputFilter> p_progress_filter_;
     std::shared_ptr<ProgressListener> p_listener_;
+    std::streamsize written_;  // bytes written with Write()
+    std::streamsize resume_offset_;  // bytes kept by delegate
 };
 
 }  // namespace detail
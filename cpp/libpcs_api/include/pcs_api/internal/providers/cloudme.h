@@ -17,7 +17,11 @@
 #ifndef INCLUDE_PCS_API_INTERNAL_PROVIDERS_CLOUDME_H_
 #define INCLUDE_PCS_API_INTERNAL_PROVIDERS_CLOUDME_H_
 
+#include <chrono>
+#include <functional>
+#include <future>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <map>
 #include <vector>
@@ -73,7 +77,7 @@ class CloudMe : public PasswordStorageProvider {
      * (optional) parent + children, with file id.
      * All strings are UTF-8 encoded.
      * Each CMFolder "owns" its children, so destroying the root folder destroys
-     * all CMFolder objects.
+     * all CMFolder objects ; copying a folder deeply copies its children.
      */
     class CMFolder {
      public:
@@ -82,7 +86,11 @@ class CloudMe : public PasswordStorageProvider {
         CMFolder(const CMFolder *p_parent,
                  const std::string& id,
                  const std::string& name);
-        CMFolder(const CMFolder&) = default;
+        /**
+         * \brief Deep copy (children of the copy refer to the copy as
+         *        parent).
+         */
+        CMFolder(const CMFolder& other);
         CMFolder& operator=(const CMFolder&) = delete;
 
         const std::string& id() const {
@@ -97,6 +105,11 @@ class CloudMe : public PasswordStorageProvider {
         const std::shared_ptr<CFolder> ToCFolder() const;
         const CPath GetPath() const;
         CMFolder* AddChild(const std::string& id, const std::string& name);
+        /**
+         * \brief Remove immediate child folder with given name (and all its
+         *        descendants).
+         */
+        void RemoveChild(const std::string& name);
         /**
          * \brief Find in children for a folder with given path.
          *
@@ -105,12 +118,14 @@ class CloudMe : public PasswordStorageProvider {
          * @return folder found, or nullptr if not found
          */
         CMFolder* GetFolder(const CPath& path);
+        const CMFolder* GetFolder(const CPath& path) const;
         /**
          * \brief Find in immediate children for a folder with given base name.
          *
          * @return folder found, or nullptr if not found
          */
         CMFolder* GetChildByName(const std::string& name);
+        const CMFolder* GetChildByName(const std::string& name) const;
 
      private:
         const CMFolder *p_parent_;
@@ -151,7 +166,75 @@ class CloudMe : public PasswordStorageProvider {
         const ::boost::posix_time::ptime updated_;
         const std::string content_type_;
     };
+    /**
+     * Folders structure is cached (shared by all operations, never modified
+     * once published): tree is replaced by a modified copy when folders are
+     * created or deleted, and reloaded when it is too old or after errors.
+     */
+    std::mutex folders_tree_mutex_;
+    std::shared_ptr<const CMFolder> p_folders_tree_;
+    std::chrono::steady_clock::time_point folders_tree_expiry_;
+    /**
+     * incremented each time p_folders_tree_ is replaced
+     */
+    unsigned int folders_tree_version_;
+    /**
+     * A tree and its version (older than current version if tree has been
+     * replaced while it was loaded)
+     */
+    typedef std::pair<std::shared_ptr<const CMFolder>, unsigned int>
+                                                        FoldersTreeSnapshot;
+    /**
+     * Load in progress, shared by threads needing the tree meanwhile
+     * (invalid if none)
+     */
+    std::shared_future<FoldersTreeSnapshot> folders_tree_loading_;
     std::unique_ptr<CMFolder> LoadFoldersStructure();
+    /**
+     * \brief Get a consistent snapshot of folders structure (loaded if
+     *        needed, once for all concurrent callers).
+     *
+     * A loaded structure is cached only if cached structure has not been
+     * replaced during loading (it would be older).
+     *
+     * @param p_version (out, optional) version of returned tree
+     */
+    std::shared_ptr<const CMFolder> GetFoldersTree(
+                                        unsigned int *p_version = nullptr);
+    /**
+     * \brief Get a private copy of folders structure, to be modified.
+     */
+    std::unique_ptr<CMFolder> CloneFoldersTree(unsigned int *p_version);
+    /**
+     * \brief Replace cached folders structure by a modified copy.
+     *
+     * If cached structure has been replaced since the copy was made,
+     * changes may conflict: cache is invalidated instead.
+     */
+    void PublishFoldersTree(std::unique_ptr<CMFolder> p_cm_root,
+                            unsigned int base_version);
+    void InvalidateFoldersTree();
+    /**
+     * @return true if a cached folders structure is still valid
+     */
+    bool HasCachedFoldersTree();
+    /**
+     * \brief Call func ; if func fails because a file is not found while
+     *        folders structure was cached (folder deleted by another client),
+     *        structure is reloaded and func is called again.
+     */
+    template<class T>
+    T WithFoldersTree(std::function<T()> func);
+    /**
+     * \brief Operations below are a single attempt with current folders
+     *        structure (see WithFoldersTree()).
+     */
+    std::shared_ptr<CFolderContent> TryListFolder(const CPath& path);
+    bool TryCreateFolder(const CPath& path);
+    bool TryDelete(const CPath& path);
+    std::shared_ptr<CFile> TryGetFile(const CPath& path);
+    void TryDownload(const CDownloadRequest& download_request);
+    void TryUpload(const CUploadRequest& upload_request);
     void ScanFolderLevel(const boost::property_tree::ptree& element,
                          CloudMe::CMFolder *p_cm_folder);
     std::unique_ptr<CMBlob> GetBlobByName(const CMFolder* p_cm_folder,
@@ -36,11 +36,30 @@ class Dropbox : public OAuth2StorageProvider {
     std::shared_ptr<CFolderContent> ListRootFolder() override;
     std::shared_ptr<CFolderContent> ListFolder(const CPath& path) override;
     std::shared_ptr<CFolderContent> ListFolder(const CFolder& folder) override;
+    /**
+     * \brief Lists the whole tree with delta requests (filtered by
+     *        path_prefix), page by page.
+     */
+    bool ListRecursive(const CPath& path, file_callback callback) override;
     bool CreateFolder(const CPath& path) override;
     bool Delete(const CPath& path) override;
     std::shared_ptr<CFile> GetFile(const CPath& path) override;
     void Download(const CDownloadRequest& downloadRequest) override;
     void Upload(const CUploadRequest& uploadRequest) override;
+    std::shared_ptr<CFolder> CreateFolderAndGet(const CPath& path) override;
+    std::shared_ptr<CBlob> UploadAndGetBlob(
+                                const CUploadRequest& upload_request) override;
+
+    pplx::task<std::shared_ptr<CFolderContent>> ListFolderAsync(
+                                            const CPath& path) override;
+    pplx::task<bool> CreateFolderAsync(const CPath& path) override;
+    pplx::task<bool> DeleteAsync(const CPath& path) override;
+    pplx::task<std::shared_ptr<CFile>> GetFileAsync(
+                                            const CPath& path) override;
+    pplx::task<void> DownloadAsync(
+                        const CDownloadRequest& download_request) override;
+    pplx::task<void> UploadAsync(
+                        const CUploadRequest& upload_request) override;
 
  private:
     /**
@@ -49,6 +68,13 @@ class Dropbox : public OAuth2StorageProvider {
      * Used for building URL
      */
     string_t scope_;
+    const bool optimistic_uploads_;
+    // blobs larger than this are uploaded in chunks:
+    const int64_t chunked_upload_threshold_;
+    const int64_t upload_chunk_size_;  // size of first chunk
+    // root URL of files uploads and downloads (a local server in tests):
+    string_t content_end_point_;
+    struct ChunkedUpload;
     static StorageBuilder::create_provider_func GetCreateInstanceFunction();
     explicit Dropbox(const StorageBuilder& storage_builder);
     void ThrowCStorageException(CResponse *p_response,
@@ -61,6 +87,13 @@ class Dropbox : public OAuth2StorageProvider {
                                     const CPath* p_opt_path);
     RequestInvoker GetApiRequestInvoker(const CPath* p_opt_path = nullptr);
     RequestInvoker GetRequestInvoker(const CPath* p_path);
+    /**
+     * \brief Chunks uploads also accept "400 Bad Request" responses
+     *        (offset mismatch).
+     */
+    void ValidateChunkedUploadResponse(CResponse *p_response,
+                                       const CPath* p_opt_path);
+    RequestInvoker GetChunkedUploadRequestInvoker(const CPath* p_path);
     const web::json::value GetAccount();
     string_t BuildUrl(const string_t& root, const string_t& method_path);
     void AddPathToUrl(string_t* p_url, const CPath& path);
@@ -68,10 +101,62 @@ class Dropbox : public OAuth2StorageProvider {
     string_t BuildFileUrl(const string_t& method_path, const CPath& path);
     string_t BuildContentUrl(string_t method_path, CPath path);
     std::shared_ptr<CFile> ParseCFile(const web::json::object& file_obj);
+    /**
+     * @param p_folder (optional) receives created or existing folder
+     */
+    pplx::task<bool> CreateFolderAsync(
+                            const CPath& path,
+                            std::shared_ptr<std::shared_ptr<CFolder>> p_folder);
+    /**
+     * @param p_blob (optional) receives uploaded blob
+     */
+    pplx::task<void> UploadBlobAsync(
+                            const CUploadRequest& upload_request,
+                            std::shared_ptr<std::shared_ptr<CBlob>> p_blob);
+    /**
+     * \brief Upload a blob, without any check.
+     *
+     * @param autorename false if server must answer "409 Conflict" instead
+     *        of renaming uploaded file in case of conflict
+     * @param p_blob (optional) receives uploaded blob, as described by
+     *        server response
+     */
+    pplx::task<void> RawUploadAsync(
+                            const CUploadRequest& upload_request,
+                            bool autorename,
+                            std::shared_ptr<std::shared_ptr<CBlob>> p_blob);
+    /**
+     * \brief Parse the file metadata returned by an upload request.
+     */
+    pplx::task<void> ParseUploadResponseAsync(
+                            std::shared_ptr<CResponse> p_response,
+                            std::shared_ptr<std::shared_ptr<CBlob>> p_blob);
+    /**
+     * \brief Interpret the result of an upload sent without check:
+     *        a conflict caused by a folder at path is reported as a
+     *        CInvalidFileTypeException (other errors are unchanged).
+     */
+    pplx::task<void> CheckUploadConflictAsync(const CPath& path,
+                                              pplx::task<void> upload_task);
+    /**
+     * \brief Upload a large blob with chunked_upload then
+     *        commit_chunked_upload: after a failure, upload continues
+     *        from the offset acknowledged by server.
+     */
+    pplx::task<void> ChunkedUploadAsync(
+                            const CUploadRequest& upload_request,
+                            bool autorename,
+                            std::shared_ptr<std::shared_ptr<CBlob>> p_blob);
+    pplx::task<void> UploadChunksAsync(std::shared_ptr<ChunkedUpload> p_upload);
+    pplx::task<void> UploadChunkAsync(RequestInvoker ri,
+                                      std::shared_ptr<ChunkedUpload> p_upload);
+    pplx::task<void> CommitChunkedUploadAsync(
+                                    std::shared_ptr<ChunkedUpload> p_upload);
     //
     static std::shared_ptr<IStorageProvider> CreateInstance(
                                         const StorageBuilder& builder);
     friend class StorageFacade;
+    friend class DropboxChunkedUploadTest;
 };
 
 
@@ -17,12 +17,15 @@
 #ifndef INCLUDE_PCS_API_INTERNAL_PROVIDERS_GOOGLEDRIVE_H_
 #define INCLUDE_PCS_API_INTERNAL_PROVIDERS_GOOGLEDRIVE_H_
 
+#include <atomic>
+#include <functional>
 #include <string>
 #include <vector>
 
 #include "pcs_api/storage_builder.h"
 #include "pcs_api/c_exceptions.h"
 #include "pcs_api/internal/oauth2_storage_provider.h"
+#include "pcs_api/internal/path_ids_cache.h"
 
 namespace pcs_api {
 
@@ -32,18 +35,23 @@ namespace pcs_api {
 class GoogleDrive : public OAuth2StorageProvider {
  public:
     static const char* kProviderName;
+    ~GoogleDrive();
     std::string GetUserId() override;
     CQuota GetQuota() override;
     std::shared_ptr<CFolderContent> ListRootFolder() override;
     std::shared_ptr<CFolderContent> ListFolder(const CPath& path) override;
     std::shared_ptr<CFolderContent> ListFolder(const CFolder& folder) override;
+    bool ListFolderStream(const CPath& path, file_callback callback) override;
     bool CreateFolder(const CPath& path) override;
     bool Delete(const CPath& path) override;
     std::shared_ptr<CFile> GetFile(const CPath& path) override;
     void Download(const CDownloadRequest& downloadRequest) override;
     void Upload(const CUploadRequest& uploadRequest) override;
+    std::shared_ptr<CBlob> UploadAndGetBlob(
+                                const CUploadRequest& upload_request) override;
 
  private:
+    class RemotePath;
     static StorageBuilder::create_provider_func GetCreateInstanceFunction();
     explicit GoogleDrive(const StorageBuilder& storage_builder);
     void ThrowCStorageException(CResponse *p_response,
@@ -54,6 +62,73 @@ class GoogleDrive : public OAuth2StorageProvider {
                                         const CPath* p_opt_path);
     RequestInvoker GetRequestInvoker(const CPath* p_path);
     RequestInvoker GetApiRequestInvoker(const CPath* p_path = nullptr);
+    /**
+     * \brief Resumable uploads also accept "308 Resume Incomplete" responses.
+     */
+    void ValidateResumableUploadResponse(CResponse *p_response,
+                                         const CPath* p_opt_path);
+    RequestInvoker GetResumableUploadRequestInvoker(const CPath* p_path);
+    /**
+     * \brief Upload a blob (after checking destination).
+     *
+     * @return json file resource of uploaded blob (null if unknown)
+     */
+    web::json::value UploadFile(const CUploadRequest& upload_request);
+    /**
+     * \brief Check upload destination, create missing parent folders and
+     *        build blob metadata.
+     *
+     * @param upload_request
+     * @param remote_path resolved upload path
+     * @param p_file_id (out) id of the existing blob to update, or empty
+     *        if a new blob is to be created
+     * @return blob metadata
+     */
+    web::json::value PrepareUpload(const CUploadRequest& upload_request,
+                                   const RemotePath& remote_path,
+                                   string_t *p_file_id);
+    /**
+     * \brief Upload metadata and content: at once, or within an upload
+     *        session for blobs larger than resumable upload threshold.
+     *
+     * @return json file resource of uploaded blob (null if unknown)
+     */
+    web::json::value SendBlob(const CUploadRequest& upload_request,
+                              const string_t& file_id,
+                              const web::json::value& json_meta);
+    /**
+     * \brief Upload metadata and content in a single request.
+     *
+     * @return json file resource of uploaded blob
+     */
+    web::json::value MultipartUpload(const CUploadRequest& upload_request,
+                             const string_t& file_id,
+                             const web::json::value& json_meta);
+    /**
+     * \brief Upload content in chunks, within an upload session: after a
+     *        failure, upload continues from the bytes committed by server
+     *        (or from start in a new session if session has expired).
+     *
+     * @return json file resource of uploaded blob (null if unknown)
+     */
+    web::json::value ResumableUpload(const CUploadRequest& upload_request,
+                             const string_t& file_id,
+                             const web::json::value& json_meta);
+    /**
+     * @return the upload session URI
+     */
+    string_t CreateUploadSession(const CUploadRequest& upload_request,
+                                 const string_t& file_id,
+                                 const web::json::value& json_meta);
+    /**
+     * \brief Ask server how many bytes have been committed in session.
+     *
+     * @return committed bytes count, or -1 if session has expired or is
+     *         unknown to server
+     */
+    int64_t QueryUploadOffset(const string_t& session_uri,
+                              const CPath& path,
+                              int64_t length);
     /**
     * \brief Utility class used to convert a CPath
     *        to a list of google drive files ids.
@@ -90,7 +165,8 @@ class GoogleDrive : public OAuth2StorageProvider {
     class RemotePath {
      public:
         RemotePath(const CPath& path,
-                   std::vector<web::json::value> files_chain);
+                   std::vector<web::json::value> files_chain,
+                   bool from_cache = false);
         const std::vector<string_t>& segments() const {
             return segments_;
         }
@@ -99,6 +175,13 @@ class GoogleDrive : public OAuth2StorageProvider {
             return files_chain_;
         }
 
+        /**
+        * Have files ids been read from cache (and may be outdated) ?
+        */
+        bool from_cache() const {
+            return from_cache_;
+        }
+
         /**
         * Does this path exist google side ?
         */
@@ -137,9 +220,82 @@ class GoogleDrive : public OAuth2StorageProvider {
         const CPath path_;
         const std::vector<string_t> segments_;
         const std::vector<web::json::value> files_chain_;
+        const bool from_cache_;
     };
+    /**
+     * \brief Resolve path with cached ids if possible, otherwise
+     *        from server (if only leading segments are cached, the
+     *        other ones are resolved from the deepest cached folder).
+     *
+     * @param check_cached true to check last cached id against server
+     *        even if no details are needed (before modifying files)
+     */
     const GoogleDrive::RemotePath FindRemotePath(const CPath& path,
-                                                 bool detailed);
+                                                 bool detailed,
+                                                 bool check_cached = false);
+    /**
+     * \brief Resolve the segments of path that follow its cached leading
+     *        segments, level by level from the deepest cached folder.
+     *
+     * @param entries cached ids of leading segments (not all segments)
+     * @param p_files_chain (out) resolved files chain
+     * @return false if deepest cached folder is outdated (then path must
+     *         be resolved from root)
+     */
+    bool ResolveFromCachedFolder(
+                            const CPath& path,
+                            const std::vector<string_t>& segments,
+                            const std::vector<PathIdsCache::Entry>& entries,
+                            bool detailed,
+                            std::vector<web::json::value> *p_files_chain);
+    /**
+     * \brief Resolve path from server, and update cached ids.
+     */
+    const GoogleDrive::RemotePath ResolveRemotePath(const CPath& path,
+                                                    bool detailed);
+    /**
+     * \brief Resolve path segments with a single query on all titles.
+     *
+     * @return false if too many files match titles (then files_chain is
+     *         left untouched)
+     */
+    bool ResolveWithTitleQuery(const std::vector<string_t>& segments,
+                               const string_t& fields_filter,
+                               std::vector<web::json::value> *p_files_chain);
+    /**
+     * \brief Resolve path segments one at a time, by querying children of
+     *        last resolved folder.
+     *
+     * @param files_chain already resolved leading segments (resolution
+     *        starts after them)
+     */
+    std::vector<web::json::value> ResolveLevelByLevel(
+                        const CPath& path,
+                        const std::vector<string_t>& segments,
+                        const string_t& fields_filter,
+                        std::vector<web::json::value> files_chain =
+                                            std::vector<web::json::value>());
+    /**
+     * \brief Get detailed information of a file whose id has been cached.
+     *
+     * @return file json object, or null value if id is outdated (file does
+     *         not exist anymore, is trashed, or is not at path anymore)
+     */
+    web::json::value GetCachedFile(const CPath& path,
+                                   const string_t& file_id,
+                                   const string_t& parent_id);
+    /**
+     * \brief Call func with the resolved path ; if ids were read from cache
+     *        and func fails because a file is not found (outdated id),
+     *        path is resolved again from server and func is called again.
+     *
+     * Used by operations that modify files: last cached id is checked
+     * before func is called (trashed files are not found).
+     */
+    template<class T>
+    T WithRemotePath(const CPath& path,
+                     bool detailed,
+                     std::function<T(const RemotePath&)> func);
     std::shared_ptr<CFile> ParseCFile(const CPath& parent_path,
                                       const web::json::value& json);
     string_t RawCreateFolder(const CPath& path, string_t parent_id);
@@ -148,6 +304,24 @@ class GoogleDrive : public OAuth2StorageProvider {
     static std::shared_ptr<IStorageProvider> CreateInstance(
                                                 const StorageBuilder& builder);
     friend class StorageFacade;
+    friend class GoogleDriveResumableUploadTest;
+
+    /**
+     * ids of resolved paths (saved into path_ids_cache_file_ if not empty)
+     */
+    PathIdsCache path_ids_cache_;
+    boost::filesystem::path path_ids_cache_file_;
+    /**
+     * Mean number of files returned per segment by title queries (decays
+     * while level by level resolution is used, so that title queries are
+     * tried again)
+     */
+    std::atomic<int> title_query_files_per_segment_;
+    // blobs larger than this are uploaded within an upload session:
+    const int64_t resumable_upload_threshold_;
+    const int64_t upload_chunk_size_;  // of resumable uploads
+    // root URL of files uploads (a local server in tests):
+    string_t files_upload_end_point_;
 };
 
 
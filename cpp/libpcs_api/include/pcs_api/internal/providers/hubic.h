@@ -17,8 +17,9 @@
 #ifndef INCLUDE_PCS_API_INTERNAL_PROVIDERS_HUBIC_H_
 #define INCLUDE_PCS_API_INTERNAL_PROVIDERS_HUBIC_H_
 
-#include <string>
+#include <memory>
 #include <mutex>
+#include <string>
 
 #include "pcs_api/storage_builder.h"
 #include "pcs_api/c_exceptions.h"
@@ -39,15 +40,44 @@ class Hubic : public OAuth2StorageProvider {
     std::shared_ptr<CFolderContent> ListRootFolder() override;
     std::shared_ptr<CFolderContent> ListFolder(const CFolder& folder) override;
     std::shared_ptr<CFolderContent> ListFolder(const CPath& path) override;
+    bool ListFolderStream(const CPath& path, file_callback callback) override;
+    bool ListRecursive(const CPath& path, file_callback callback) override;
     bool CreateFolder(const CPath& path) override;
     bool Delete(const CPath& path) override;
     std::shared_ptr<CFile> GetFile(const CPath& path) override;
     void Download(const CDownloadRequest& download_request) override;
     void Upload(const CUploadRequest& upload_request) override;
+    std::shared_ptr<CFolder> CreateFolderAndGet(const CPath& path) override;
+    std::shared_ptr<CBlob> UploadAndGetBlob(
+                                const CUploadRequest& upload_request) override;
+
+    pplx::task<std::shared_ptr<CFolderContent>> ListFolderAsync(
+                                            const CPath& path) override;
+    pplx::task<bool> CreateFolderAsync(const CPath& path) override;
+    pplx::task<bool> DeleteAsync(const CPath& path) override;
+    pplx::task<std::shared_ptr<CFile>> GetFileAsync(
+                                            const CPath& path) override;
+    pplx::task<void> DownloadAsync(
+                        const CDownloadRequest& download_request) override;
+    pplx::task<void> UploadAsync(
+                        const CUploadRequest& upload_request) override;
 
  private:
-    std::mutex swift_client_mutex_;
+    // Current swift client, accessed atomically (null until fetched, or
+    // after invalidation):
     std::shared_ptr<SwiftClient> p_swift_client_;
+    std::mutex swift_fetch_mutex_;  // protects members below
+    bool swift_fetch_in_progress_;
+    // Fetch in progress, shared by all callers waiting for a client:
+    pplx::task<std::shared_ptr<SwiftClient>> swift_fetch_task_;
+    // Container chosen by caller (empty to use first container):
+    const string_t pinned_container_;
+    const bool optimistic_uploads_;
+    // Large objects segmentation (segment size is 0 for swift defaults):
+    const int64_t large_object_threshold_;
+    const int64_t segment_size_;
+    const int max_segments_concurrency_;
+    const int listing_page_size_;  // 0 for swift default
 
     explicit Hubic(const StorageBuilder& storage_builder);
     void ThrowCStorageException(CResponse *p_response,
@@ -57,7 +87,48 @@ class Hubic : public OAuth2StorageProvider {
                                   const CPath* p_opt_path);
     RequestInvoker GetApiRequestInvoker(const CPath* p_opt_path = nullptr);
     std::shared_ptr<SwiftClient> GetSwiftClient();
-    void SwiftCall(std::function<void(SwiftClient *p_swift)> user_func);
+    /**
+     * \brief Get current swift client, or fetch a new one.
+     *
+     * A single fetch is in progress at a time: concurrent callers wait for
+     * the same task (mutex is not held during requests).
+     */
+    pplx::task<std::shared_ptr<SwiftClient>> GetSwiftClientAsync();
+    /**
+     * \brief Instantiate a swift client, from persisted swift credentials
+     *        if they have not expired, or else from swift credentials
+     *        requested to hubiC API (synchronous).
+     *
+     * Swift credentials and container are persisted with user credentials,
+     * so that next instances start without any request.
+     */
+    std::shared_ptr<SwiftClient> FetchSwiftClient();
+    std::shared_ptr<SwiftClient> NewSwiftClient(const string_t& endpoint,
+                                                const string_t& token);
+    /**
+     * \brief Forget given client after an authentication error.
+     *
+     * Nothing is done if current client is not p_stale (a new client has
+     * been fetched since p_stale has been used).
+     */
+    void InvalidateSwiftClient(std::shared_ptr<SwiftClient> p_stale);
+    /**
+     * \brief Call a swift client asynchronous operation.
+     *
+     * In case of authentication error, swift client is invalidated and
+     * task fails with a CRetriableException, so that operation is retried
+     * with a new client.
+     */
+    pplx::task<void> SwiftCallAsync(
+            std::function<pplx::task<void>(SwiftClient *p_swift)> user_func);
+    /**
+     * \brief Upload blob (as optimistic if configured so).
+     *
+     * @param p_blob (optional) receives uploaded blob
+     */
+    pplx::task<void> UploadBlobAsync(
+                            const CUploadRequest& request,
+                            std::shared_ptr<std::shared_ptr<CBlob>> p_blob);
     //
     static StorageBuilder::create_provider_func GetCreateInstanceFunction();
     static std::shared_ptr<IStorageProvider> CreateInstance(
@@ -17,16 +17,23 @@
 #ifndef INCLUDE_PCS_API_INTERNAL_PROVIDERS_SWIFT_CLIENT_H_
 #define INCLUDE_PCS_API_INTERNAL_PROVIDERS_SWIFT_CLIENT_H_
 
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <set>
 #include <string>
 #include <vector>
 
 #include "cpprest/http_msg.h"
 
 #include "pcs_api/model.h"
+#include "pcs_api/i_storage_provider.h"
 #include "pcs_api/c_exceptions.h"
 #include "pcs_api/retry_strategy.h"
 #include "pcs_api/internal/request_invoker.h"
 #include "pcs_api/internal/c_response.h"
+#include "pcs_api/internal/c_folder_content_builder.h"
+#include "pcs_api/internal/lru_cache.h"
 
 namespace pcs_api {
 
@@ -44,18 +51,130 @@ namespace pcs_api {
  *
  * This class aims to be general, in case several providers use Swift back-end.
  *
+ * All operations are implemented asynchronously; synchronous methods only
+ * wait for the asynchronous ones. Client must not be destroyed before the
+ * returned tasks complete.
+ *
+ * Large sources are uploaded as Static Large Objects: segments are uploaded
+ * in parallel into a "<container>_segments" container, then a manifest
+ * referencing them is written at object path. When a large object is
+ * overwritten, segments of the replaced version are deleted once the new
+ * version has been written.
+ *
  * See http://docs.openstack.org/api/openstack-object-storage/1.0/content/
  * for reference.
  */
 class SwiftClient {
  public:
+    typedef std::function<pplx::task<std::shared_ptr<CResponse>>(
+                        web::http::http_request request)> execute_function;
+    /**
+     * Called for each page of listed objects ; array is valid only during
+     * the call. Next page is requested once returned task has completed.
+     */
+    typedef std::function<pplx::task<void>(
+                        const web::json::array& objects)> objects_page_callback;
+
+    /**
+     * \brief State of a streamed folder listing, so that it can be resumed
+     *        after an error without giving files twice to callback.
+     */
+    struct ListingProgress {
+        /**
+         * name of last listed object (empty if nothing listed yet)
+         */
+        string_t marker;
+        /**
+         * folders already given to callback (a folder may be listed twice:
+         * as a directory marker and as a sub directory, or as the parent of
+         * listed objects)
+         */
+        std::set<CPath> folders;
+    };
+
+    /**
+     * Default size above which sources are uploaded as segments (256 MiB).
+     */
+    static const int64_t kDefaultLargeObjectThreshold;
+
+    /**
+     * Default size of large objects segments (64 MiB).
+     */
+    static const int64_t kDefaultSegmentSize;
+
+    /**
+     * Default maximum number of segments uploaded at once.
+     */
+    static const int kDefaultMaxSegmentsConcurrency;
+
+    /**
+     * Maximum number of segments of a large object, if server does not
+     * publish its limits (Swift default: 1000).
+     */
+    static const int64_t kDefaultMaxManifestSegments;
+
+    /**
+     * Default maximum number of objects per listing request
+     * (also the maximum allowed by Swift: 10000).
+     */
+    static const int kDefaultListingPageSize;
+
     SwiftClient(const string_t& account_endpoint,
                 const string_t& auth_token,
                 std::unique_ptr<RetryStrategy> p_retry_strategy,
                 bool use_directory_markers,
-                std::function<std::shared_ptr<CResponse>(
-                    web::http::http_request request)> execute_request_function);
+                execute_function execute_request_function);
     void UseFirstContainer();
+
+    /**
+     * \brief Use the given container, without checking it exists.
+     *
+     * @param container_name name of an existing container
+     */
+    void UseContainer(string_t container_name);
+
+    const string_t& current_container() const {
+        return current_container_;
+    }
+
+    /**
+     * \brief Defines how large sources are uploaded.
+     *
+     * Limits published by server (/info) apply: segments are enlarged so
+     * that a manifest does not exceed the maximum number of segments, and
+     * uploads fail before sending any segment if segment size is below the
+     * minimum segment size.
+     *
+     * @param threshold sources strictly larger are uploaded as segments
+     *        (negative to always upload with a single request)
+     * @param segment_size strictly positive size of segments
+     * @param max_concurrency strictly positive maximum number of segments
+     *        uploaded at once
+     */
+    void SetLargeObjectSegmentation(int64_t threshold,
+                                    int64_t segment_size,
+                                    int max_concurrency);
+    /**
+     * \brief Defines how failed segments of large objects are retried.
+     *
+     * Each segment is retried alone, so that a transient failure does not
+     * restart the whole upload. By default segments are retried as other
+     * requests (with the strategy given to constructor).
+     *
+     * @param p_retry_strategy strategy for segments uploads
+     */
+    void SetSegmentsRetryStrategy(
+                            std::shared_ptr<RetryStrategy> p_retry_strategy);
+    /**
+     * \brief Defines how many objects are requested at once when listing
+     *        a container (large folders are listed page by page).
+     *
+     * A page with less objects than requested is the last one, so page
+     * size is limited to kDefaultListingPageSize (Swift maximum).
+     *
+     * @param page_size strictly positive number of objects per request
+     */
+    void SetListingPageSize(int page_size);
     std::shared_ptr<CFolderContent> ListFolder(const CPath& path);
     bool CreateFolder(const CPath& path);
     bool Delete(const CPath& path);
@@ -63,14 +182,95 @@ class SwiftClient {
     void Download(const CDownloadRequest& download_request);
     void Upload(const CUploadRequest& upload_request);
 
+    pplx::task<std::shared_ptr<CFolderContent>> ListFolderAsync(
+                                                        const CPath& path);
+    /**
+     * \brief Streaming counterpart of ListFolderAsync(): listed files are
+     *        given to callback page by page.
+     *
+     * @param p_progress updated after each page ; if listing failed, it can
+     *        be called again with same object to resume listing
+     * @return a task holding false if no folder exists at given path
+     */
+    pplx::task<bool> ListFolderStreamAsync(
+                                    const CPath& path,
+                                    IStorageProvider::file_callback callback,
+                            std::shared_ptr<ListingProgress> p_progress);
+    /**
+     * \brief Recursive counterpart of ListFolderStreamAsync(): all objects
+     *        below path are listed page by page, without delimiter.
+     *
+     * @param p_progress updated after each page ; if listing failed, it can
+     *        be called again with same object to resume listing
+     * @return a task holding false if no folder exists at given path
+     */
+    pplx::task<bool> ListRecursiveStreamAsync(
+                                    const CPath& path,
+                                    IStorageProvider::file_callback callback,
+                            std::shared_ptr<ListingProgress> p_progress);
+    /**
+     * @param path The folder path to create
+     * @param p_folder (optional) receives created or existing folder
+     * @return a task holding true if folder has been created
+     */
+    pplx::task<bool> CreateFolderAsync(
+                const CPath& path,
+                std::shared_ptr<std::shared_ptr<CFolder>> p_folder = nullptr);
+    pplx::task<bool> DeleteAsync(const CPath& path);
+    /**
+     * @param path The file path
+     * @param p_response_headers (optional) receives response headers
+     *        (if file exists)
+     */
+    pplx::task<std::shared_ptr<CFile>> GetFileAsync(
+            const CPath& path,
+            std::shared_ptr<web::http::http_headers> p_response_headers =
+                                                                    nullptr);
+    pplx::task<void> DownloadAsync(const CDownloadRequest& download_request);
+    /**
+     * @param upload_request The upload request object
+     * @param p_blob (optional) receives uploaded blob
+     */
+    pplx::task<void> UploadAsync(
+                const CUploadRequest& upload_request,
+                std::shared_ptr<std::shared_ptr<CBlob>> p_blob = nullptr);
+
  private:
     const string_t account_endpoint_;
     const string_t auth_token_;
     std::unique_ptr<RetryStrategy> p_retry_strategy_;
+    std::shared_ptr<RetryStrategy> p_segments_retry_strategy_;  // may be null
     const bool use_directory_markers_;
-    const std::function<std::shared_ptr<CResponse>(
-            web::http::http_request request)> execute_request_function_;
+    const execute_function execute_request_function_;
     string_t current_container_;
+    int64_t large_object_threshold_;
+    int64_t segment_size_;
+    int max_segments_concurrency_;
+    int listing_page_size_;
+    /**
+     * Large objects limits of server, requested once before first large
+     * upload (defaults if server does not publish them)
+     */
+    std::mutex slo_limits_mutex_;  // protects members below
+    bool slo_limits_requested_;
+    pplx::task<void> slo_limits_task_;
+    int64_t max_manifest_segments_;
+    int64_t min_segment_size_;
+    std::atomic<bool> segments_container_exists_;
+    /**
+     * set once a bulk delete request has been ignored by server
+     * (bulk middleware not installed)
+     */
+    std::atomic<bool> bulk_delete_unsupported_;
+    /**
+     * Folders known to exist (as directory markers) from recent requests:
+     * when a blob is uploaded, only its parent folder is checked, not the
+     * known folders above it. Entries are removed when folders are deleted,
+     * or found missing.
+     */
+    LruCache<CPath, bool, CPathHash> known_folders_;
+
+    struct LargeObjectUpload;
 
     /**
      * \brief add authorization token to request headers
@@ -81,7 +281,7 @@ class SwiftClient {
      * \brief add authorization token to request headers,
      *        and execute request thanks to execute_request_function_().
      */
-    std::shared_ptr<CResponse> ConfigureAndExecuteRequest(
+    pplx::task<std::shared_ptr<CResponse>> ConfigureAndExecuteRequest(
             web::http::http_request request, string_t format);
     void ValidateSwiftResponse(CResponse *p_response, const CPath* p_opt_path);
     void ValidateSwiftApiResponse(CResponse *p_response,
@@ -92,37 +292,252 @@ class SwiftClient {
      * Quick object check: do a HEAD and return headers
      * (or empty pointer if no remote object)
      */
-    std::unique_ptr<web::http::http_headers> HeadOrNull(const CPath& path);
-    void UseContainer(string_t container_name);
+    pplx::task<std::shared_ptr<web::http::http_headers>> HeadOrNullAsync(
+                                                            const CPath& path);
     std::vector<string_t> GetContainers();
     /**
      * \brief Create a folder without creating any higher
      *        level intermediate folders.
      *
      * @param path The folder path
+     * @param p_response_headers (optional) receives response headers
      */
-    void RawCreateFolder(const CPath& path);
+    pplx::task<void> RawCreateFolderAsync(
+            const CPath& path,
+            std::shared_ptr<web::http::http_headers> p_response_headers =
+                                                                    nullptr);
     /**
      * \brief Create any parent folders if they do not exist, to meet old
      *        swift convention.
      *
      * hubiC requires these objects for the sub-objects to be visible in webapp.
      * As an optimization, we consider that if folder a/b/c exists, then a/
-     * and a/b/ also exist so are not checked nor created.
+     * and a/b/ also exist so are not checked nor created ; if a/b/c is
+     * missing, folders above it that are known to exist are not checked
+     * either.
      *
      * @param leaf_folder_path
      */
-    void CreateIntermediateFoldersObjects(const CPath& leaf_folder_path);
-    web::json::value ListObjectsWithinFolder(const CPath& path,
-                                             string_t delimiter);
+    pplx::task<void> CreateIntermediateFoldersObjectsAsync(
+                                                const CPath& leaf_folder_path);
+    /**
+     * \brief Walk from given folder to root, and collect non existing folders.
+     *
+     * @param path the deepest folder to check
+     * @param p_missing_folders missing folders are inserted at beginning
+     */
+    pplx::task<void> FindMissingFoldersAsync(
+                        const CPath& path,
+                        std::shared_ptr<std::vector<CPath>> p_missing_folders);
+    /**
+     * \brief Called when listing a folder returned nothing: checks if an
+     *        empty folder exists at path.
+     *
+     * @return a task holding false if nothing exists at path
+     *         (CInvalidFileTypeException if path is a blob)
+     */
+    pplx::task<bool> CheckEmptyListingAsync(const CPath& path);
+    /**
+     * \brief List objects whose name starts with given folder path,
+     *        page by page (requests limit and marker parameters).
+     *
+     * @param path folder to list
+     * @param delimiter "/" to list only immediate children, "" to list all
+     *        sub-objects
+     * @param callback called for each page of objects
+     * @param marker objects are listed after this name ("" for first page)
+     * @return a task holding the total number of listed objects
+     */
+    pplx::task<size_t> ListObjectsWithinFolderAsync(
+                                            const CPath& path,
+                                            string_t delimiter,
+                                            objects_page_callback callback,
+                                            string_t marker = string_t());
+    /**
+     * \brief Delete objects in no particular order: with bulk delete
+     *        requests if allowed and supported by server, otherwise with
+     *        concurrent DELETE requests.
+     *
+     * @param bulk_allowed false for large objects manifests (bulk delete
+     *        would not delete their segments)
+     * @return a task holding true if at least one object has been deleted
+     */
+    pplx::task<bool> DeleteObjectsAsync(
+                            std::shared_ptr<const std::vector<CPath>> p_paths,
+                            bool bulk_allowed);
+    /**
+     * \brief Delete objects from index, by batches of bulk delete requests
+     *        (falls back to concurrent deletes if server does not support
+     *        bulk delete).
+     */
+    pplx::task<bool> BulkDeleteAsync(
+                            std::shared_ptr<const std::vector<CPath>> p_paths,
+                            size_t index,
+                            bool at_least_one_deleted);
+    /**
+     * \brief Delete objects from index with a bounded number of concurrent
+     *        DELETE requests.
+     *
+     * @param may_be_manifests true if objects may be large objects manifests
+     */
+    pplx::task<bool> ParallelDeleteAsync(
+                            std::shared_ptr<const std::vector<CPath>> p_paths,
+                            size_t index,
+                            bool may_be_manifests);
+    /**
+     * \brief Delete next objects (shared index) one after the other ;
+     *        several such tasks are run concurrently.
+     */
+    pplx::task<void> DeleteNextObjectsAsync(
+                            std::shared_ptr<const std::vector<CPath>> p_paths,
+                            std::shared_ptr<std::atomic<size_t>> p_next,
+                            std::shared_ptr<std::atomic<bool>> p_deleted,
+                            bool may_be_manifests);
+    /**
+     * \brief Delete a single object.
+     *
+     * @param may_be_manifest true if object may be a large object manifest:
+     *        object is checked first, so that segments of a manifest are
+     *        deleted with it
+     * @return a task holding false if object did not exist
+     */
+    pplx::task<bool> DeleteObjectAsync(const CPath& path,
+                                       bool may_be_manifest);
+    /**
+     * \brief Delete a large object manifest and its segments.
+     */
+    pplx::task<void> DeleteManifestAsync(const CPath& path);
+    /**
+     * \brief Upload a blob with a single request.
+     *
+     * @param p_response_headers (optional) receives response headers
+     */
+    pplx::task<void> RawUploadAsync(
+            const CUploadRequest& upload_request,
+            std::shared_ptr<web::http::http_headers> p_response_headers =
+                                                                    nullptr);
+    /**
+     * \brief Check that no folder was hidden by a blob uploaded without
+     *        check (objects named below path): if so, blob is removed
+     *        (directory marker restored) and upload fails.
+     *
+     * @param large_object true if uploaded blob is a large object
+     */
+    pplx::task<void> CheckNoFolderReplacedAsync(const CPath& path,
+                                                bool large_object);
+    /**
+     * \brief Get blob at given path (after an upload).
+     */
+    pplx::task<void> GetUploadedBlobAsync(
+                                const CPath& path,
+                                std::shared_ptr<std::shared_ptr<CBlob>> p_blob);
+    /**
+     * \brief Get large objects limits of server (requested only once,
+     *        never fails).
+     */
+    pplx::task<void> GetLargeObjectLimitsAsync();
+    /**
+     * \brief Size of segments for uploading a large object of given length.
+     *
+     * Configured size is enlarged so that manifest does not exceed the
+     * maximum number of segments of server.
+     *
+     * @throw CStorageException if configured size is below server minimum
+     */
+    int64_t GetSegmentSize(int64_t length);
+    /**
+     * \brief Upload a blob as a Static Large Object.
+     *
+     * @param replaced_task completes once segments of the replaced object
+     *        (if any) are known: manifest is written only afterwards
+     */
+    pplx::task<void> UploadLargeObjectAsync(
+                                        const CUploadRequest& upload_request,
+                                        pplx::task<void> replaced_task);
+    pplx::task<void> UploadSegmentedObjectAsync(
+                                        const CUploadRequest& upload_request,
+                                        pplx::task<void> replaced_task,
+                                        int64_t segment_size);
+    /**
+     * \brief Upload next pending segments, one after the other, until all
+     *        segments have been uploaded or one has failed.
+     *
+     * Several such tasks are run concurrently.
+     */
+    pplx::task<void> UploadSegmentsAsync(
+            std::shared_ptr<LargeObjectUpload> p_upload);
+    /**
+     * \brief Upload a segment object (retried on its own).
+     *
+     * @return a task holding the segment ETag
+     */
+    pplx::task<string_t> UploadSegmentAsync(
+                                    const CPath& path,
+                                    const string_t& segment_name,
+                                    std::shared_ptr<ByteSource> p_source);
+    pplx::task<void> PutManifestAsync(
+            std::shared_ptr<LargeObjectUpload> p_upload);
+    /**
+     * \brief Get the segments of the large object at path, before it is
+     *        overwritten.
+     *
+     * @param p_segments_urls receives urls of segments (nothing if object
+     *        is not a large object, or does not exist)
+     * @param p_headers (optional) headers of object, if already known:
+     *        object is not checked again
+     */
+    pplx::task<void> GetReplacedSegmentsAsync(
+                    const CPath& path,
+                    std::shared_ptr<std::vector<string_t>> p_segments_urls,
+                    std::shared_ptr<web::http::http_headers> p_headers =
+                                                                    nullptr);
+    /**
+     * \brief Get the segments listed by large object manifest at path
+     *        (multipart-manifest=get request).
+     */
+    pplx::task<void> GetManifestSegmentsAsync(
+                    const CPath& path,
+                    std::shared_ptr<std::vector<string_t>> p_segments_urls);
+    /**
+     * \brief Delete segments objects, one after the other (best effort:
+     *        cleanup of a failed upload or of a replaced large object).
+     *
+     * @param path large object path
+     * @param p_segments_urls urls of segments to delete
+     */
+    pplx::task<void> DeleteSegmentsAsync(
+            const CPath& path,
+            std::shared_ptr<const std::vector<string_t>> p_segments_urls);
+    pplx::task<void> CreateSegmentsContainerAsync();
+    /**
+     * \brief Add listed objects to folder content.
+     *
+     * @param generation known folders generation when listing started
+     */
+    void AddToFolderContent(const web::json::array& json_array,
+                            CFolderContentBuilder *p_cfcb,
+                            const LruCacheGeneration& generation);
+    /**
+     * \brief Forget known folders at or below given path.
+     */
+    void ForgetKnownFolders(const CPath& path);
+    /**
+     * \brief Forget known folders above given path (when an object could
+     *        not be created there).
+     */
+    void ForgetParentFolders(const CPath& path);
     string_t GetObjectUrl(const CPath& path);
     string_t GetCurrentContainerUrl();
+    string_t GetSegmentsContainer();
+    string_t GetSegmentUrl(const string_t& segment_name);
 };
 
 namespace swift_details {
     boost::posix_time::ptime ParseLastModified(const web::json::value& val);
     boost::posix_time::ptime ParseTimestamp(
                                        const web::http::http_headers& headers);
+    boost::posix_time::ptime ParseLastModifiedHeader(
+                                       const web::http::http_headers& headers);
 }  // namespace swift_details
 
 }  // namespace pcs_api
@@ -0,0 +1,62 @@
+/**
+ * Copyright (c) 2014 Netheos (http://www.netheos.net)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef INCLUDE_PCS_API_INTERNAL_RANGE_BYTE_SOURCE_H_
+#define INCLUDE_PCS_API_INTERNAL_RANGE_BYTE_SOURCE_H_
+
+#include <cstdint>
+#include <memory>
+#include <istream>  // NOLINT(readability/streams)
+
+#include "pcs_api/byte_source.h"
+
+namespace pcs_api {
+
+namespace detail {
+
+/**
+ * \brief A ByteSource decorator, that only reads a range of bytes of
+ *        a delegate ByteSource.
+ *
+ * Each OpenStream() opens a new delegate stream, so that several ranges
+ * of a same source may be read concurrently (provided that delegate supports
+ * several opened streams, as FileByteSource and MemoryByteSource do).
+ */
+class RangeByteSource : public ByteSource {
+ public:
+    /**
+     * @param p_byte_source the source to read range from
+     * @param offset position of the first byte of the range
+     * @param length number of bytes of the range
+     */
+    RangeByteSource(std::shared_ptr<ByteSource> p_byte_source,
+                    int64_t offset,
+                    std::streamsize length);
+    std::unique_ptr<std::istream> OpenStream() override;
+    std::streamsize Length() const override;
+
+ private:
+    std::shared_ptr<ByteSource> p_byte_source_;
+    const int64_t offset_;
+    const std::streamsize length_;
+};
+
+}  // namespace detail
+
+}  // namespace pcs_api
+
+#endif  // INCLUDE_PCS_API_INTERNAL_RANGE_BYTE_SOURCE_H_
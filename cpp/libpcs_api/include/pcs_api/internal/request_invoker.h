@@ -33,7 +33,9 @@ namespace pcs_api {
  *
  * Request execution is actually delegated to a user function (that may be in
  * charge of adding token or user credentials before sending:
- * see OAuth2SessionManager, PasswordSessionManager).
+ * see OAuth2SessionManager, PasswordSessionManager). This function starts
+ * the request and returns a task, so that requests can be performed either
+ * synchronously (Invoke) or asynchronously (InvokeAsync).
  * If request can not be performed (ex: web::http::http_exception) the exception
  * thrown is wrapped into a CRetriableException.
  *
@@ -50,7 +52,7 @@ namespace pcs_api {
  */
 class RequestInvoker {
  public:
-    typedef std::function<std::shared_ptr<CResponse>(
+    typedef std::function<pplx::task<std::shared_ptr<CResponse>>(
                            web::http::http_request request)> request_function;
     typedef std::function<void(CResponse*, const CPath* p_opt_path)>
                                                              validate_function;
@@ -72,12 +74,30 @@ class RequestInvoker {
      */
     std::shared_ptr<CResponse> Invoke(web::http::http_request request);
 
+    /**
+     * \brief Asynchronous counterpart of Invoke().
+     *
+     * Validation is performed in a continuation of request task. This invoker
+     * may be destroyed before returned task completes.
+     *
+     * @return a task holding validated CResponse, or failing with any kind
+     *         of exception (wrapped into a CRetriableException if request
+     *         should be retried).
+     */
+    pplx::task<std::shared_ptr<CResponse>> InvokeAsync(
+                                    web::http::http_request request) const;
+
  private:
-    web::http::client::http_client *p_client_;
     const request_function request_func_;
     const validate_function validate_func_;
-    const CPath* p_path_;  // optional (may be nullptr)
-    bool IsRetriable(std::exception_ptr e);
+    // optional (may be empty); copied as invoker may outlive caller's path:
+    std::shared_ptr<const CPath> p_path_;
+    static bool IsRetriable(std::exception_ptr e);
+    /**
+     * \brief Rethrow an exception raised while performing request, wrapped
+     *        into a CRetriableException if retriable.
+     */
+    static void RethrowRequestException(std::exception_ptr p_ex);
 };
 
 
@@ -0,0 +1,106 @@
+/**
+ * Copyright (c) 2014 Netheos (http://www.netheos.net)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef INCLUDE_PCS_API_INTERNAL_TOKEN_REFRESHER_H_
+#define INCLUDE_PCS_API_INTERNAL_TOKEN_REFRESHER_H_
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "boost/date_time/posix_time/posix_time_types.hpp"
+
+namespace pcs_api {
+
+/**
+ * \brief Renews a token in a background thread, some time before it
+ *        expires, so that requests never wait for a refresh.
+ *
+ * Thread sleeps until expiration time minus margin (or half of remaining
+ * validity, for short lived tokens), then calls refresh function. A failed
+ * refresh is logged and tried again later: callers must still refresh
+ * expired tokens synchronously.
+ * Thread is stopped when this object is destroyed.
+ */
+class TokenRefresher {
+ public:
+    /**
+     * \brief Returns current token expiration time (not_a_date_time if
+     *        there is no token, or if it never expires).
+     */
+    typedef std::function<boost::posix_time::ptime()> expires_at_function;
+
+    /**
+     * \brief Returns current time (UTC).
+     */
+    typedef std::function<boost::posix_time::ptime()> now_function;
+
+    /**
+     * \brief Delay before trying again after a failed refresh (30 seconds).
+     */
+    static const boost::posix_time::time_duration kRetryDelay;
+
+    /**
+     * @param expires_at_func called to know when token expires
+     * @param refresh_func called in background thread to renew token
+     * @param margin token is renewed this duration before it expires
+     * @param now_func clock used to schedule refreshes (system clock if
+     *        null). Time is read again each time thread wakes up, or is
+     *        notified.
+     */
+    TokenRefresher(expires_at_function expires_at_func,
+                   std::function<void()> refresh_func,
+                   boost::posix_time::time_duration margin,
+                   now_function now_func = nullptr);
+    ~TokenRefresher();
+
+    /**
+     * \brief Indicates that token has changed: expiration time is read again.
+     */
+    void Notify();
+
+ private:
+    const expires_at_function expires_at_func_;
+    const std::function<void()> refresh_func_;
+    const boost::posix_time::time_duration margin_;
+    const now_function now_func_;
+    std::mutex mutex_;  // protects members below
+    std::condition_variable cond_;
+    bool stopping_;
+    bool notified_;
+    // used by background thread only:
+    boost::posix_time::ptime known_expires_at_;
+    boost::posix_time::ptime known_since_;  // when token was first seen
+    boost::posix_time::ptime retry_after_;  // set after a failed refresh
+    std::thread thread_;  // last member: started once others are built
+
+    void Run();
+    /**
+     * \brief Time at which token should be renewed (not_a_date_time if
+     *        never).
+     */
+    boost::posix_time::ptime GetRefreshTime(
+                                        const boost::posix_time::ptime& now);
+
+    TokenRefresher(const TokenRefresher&) = delete;
+    TokenRefresher& operator=(const TokenRefresher&) = delete;
+};
+
+}  // namespace pcs_api
+
+#endif  // INCLUDE_PCS_API_INTERNAL_TOKEN_REFRESHER_H_
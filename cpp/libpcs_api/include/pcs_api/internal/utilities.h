@@ -17,13 +17,19 @@
 #ifndef INCLUDE_PCS_API_INTERNAL_UTILITIES_H_
 #define INCLUDE_PCS_API_INTERNAL_UTILITIES_H_
 
+#include <chrono>
+#include <functional>
+#include <memory>
 #include <string>
 #include <stdexcept>
 #include <system_error>
 
 #include "boost/date_time/posix_time/ptime.hpp"
 
+#include "pplx/pplxtasks.h"
+
 #include "pcs_api/types.h"
+#include "pcs_api/retry_strategy.h"
 
 namespace pcs_api {
 
@@ -75,6 +81,36 @@ int64_t DateTimeToTime_t(const ::boost::posix_time::ptime& pt);
 */
 int64_t DateTimeToTime_t_ms(const ::boost::posix_time::ptime& pt);
 
+/**
+ * \brief Get a task that completes once the given delay has elapsed.
+ *
+ * No thread is blocked while waiting: all delays are handled by a single
+ * background timer thread.
+ *
+ * @param delay the delay (task is already completed if not positive)
+ */
+pplx::task<void> CompleteAfter(std::chrono::milliseconds delay);
+
+/**
+ * \brief Call an asynchronous function with retries, and get the result of
+ *        the first successful call.
+ *
+ * @param p_retry_strategy the retry strategy (must outlive returned task)
+ * @param func the function to call, starting a new trial
+ */
+template<class T>
+pplx::task<T> InvokeRetryAsync(RetryStrategy *p_retry_strategy,
+                               std::function<pplx::task<T>()> func) {
+    std::shared_ptr<T> p_result = std::make_shared<T>();
+    return p_retry_strategy->InvokeRetryAsync([func, p_result] {
+        return func().then([p_result](T result) {
+            *p_result = result;
+        });
+    }).then([p_result] {
+        return *p_result;
+    });
+}
+
 
 }  // namespace utilities
 
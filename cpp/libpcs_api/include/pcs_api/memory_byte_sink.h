@@ -35,6 +35,8 @@ class MemoryByteSink : public ByteSink {
     }
     std::ostream* OpenStream() override;
     void CloseStream() override;
+    bool IsBufferWritable() const override;
+    void Write(const char* p_data, std::streamsize size) override;
     void SetExpectedLength(std::streamsize expected_length) override;
     void Abort() override;
     std::string GetData();
@@ -17,10 +17,10 @@
 #ifndef INCLUDE_PCS_API_OAUTH2_CREDENTIALS_H_
 #define INCLUDE_PCS_API_OAUTH2_CREDENTIALS_H_
 
+#include <chrono>
 #include <string>
 #include <memory>
 #include <vector>
-#include <mutex>
 
 #include "boost/date_time/posix_time/posix_time_types.hpp"
 
@@ -32,8 +32,11 @@ namespace pcs_api {
 /**
  * \brief A specialization of Credentials, for holding OAuth2 tokens.
  *
- * This class has variable members (access_token is refreshed),
- * but is thread safe.
+ * Tokens are refreshed, but never modified in place: each refresh
+ * publishes a new immutable Tokens snapshot (atomic shared pointer swap).
+ * Readers get a consistent snapshot without locking ; a request keeps
+ * the snapshot it has read, even if tokens are refreshed meanwhile.
+ * This class is thread safe.
  */
 class OAuth2Credentials : public Credentials {
  public:
@@ -41,24 +44,82 @@ class OAuth2Credentials : public Credentials {
     static const char_t* kExpiresIn;
     static const char_t* kExpiresAt;
     static const char_t* kTokenType;
+    static const char_t* kProviderData;
+
+    /**
+     * \brief An immutable snapshot of OAuth2 tokens.
+     */
+    struct Tokens {
+        string_t access_token;
+        /**
+         * not_a_date_time if token never expires
+         */
+        boost::posix_time::ptime expires_at;
+        string_t refresh_token;
+        string_t token_type;
+        /**
+         * expires_at, as a clock time point (cheaper to compare)
+         */
+        std::chrono::system_clock::time_point expiry;
+        /**
+         * provider specific data persisted with tokens, as a serialized
+         * JSON object (empty if none) ; kept when tokens are refreshed
+         */
+        string_t provider_data;
+
+        bool HasExpired() const {
+            return std::chrono::system_clock::now() > expiry;
+        }
+    };
+
     static std::unique_ptr<OAuth2Credentials> CreateFromJson(
                                                  const web::json::value& json);
-    bool HasExpired() const;
+
+    /**
+     * @return current tokens snapshot (never null)
+     */
+    std::shared_ptr<const Tokens> tokens() const {
+        return std::atomic_load(&p_tokens_);
+    }
+
+    bool HasExpired() const {
+        return tokens()->HasExpired();
+    }
+
     string_t access_token() const {
-        std::unique_lock<std::mutex>(mutex_);
-        return access_token_;
+        return tokens()->access_token;
     }
 
     string_t refresh_token() const {
-        std::unique_lock<std::mutex>(mutex_);
-        return refresh_token_;
+        return tokens()->refresh_token;
     }
 
     string_t token_type() const {
-        std::unique_lock<std::mutex>(mutex_);
-        return token_type_;
+        return tokens()->token_type;
     }
 
+    /**
+     * @return expiration time of access token (not_a_date_time if token
+     *         never expires)
+     */
+    boost::posix_time::ptime expires_at() const {
+        return tokens()->expires_at;
+    }
+
+    string_t provider_data() const {
+        return tokens()->provider_data;
+    }
+
+    /**
+     * \brief Replace provider specific data (ex: hubiC Swift credentials).
+     *
+     * Tokens are unchanged. Data is persisted with tokens the next time
+     * credentials are saved.
+     *
+     * @param json_string serialized JSON object (empty to remove data)
+     */
+    void SetProviderData(const string_t& json_string);
+
     /**
      * Update the credentials from a JSON request response
      *
@@ -69,15 +130,8 @@ class OAuth2Credentials : public Credentials {
     std::string ToJsonString() const override;
 
  private:
-    string_t access_token_;
-    boost::posix_time::ptime expires_at_;
-    string_t refresh_token_;
-    string_t token_type_;
-    mutable std::mutex mutex_;
-    OAuth2Credentials(string_t access_token,
-                      boost::posix_time::ptime expires_at,
-                      string_t refresh_token,
-                      string_t token_type);
+    std::shared_ptr<const Tokens> p_tokens_;  // accessed atomically
+    explicit OAuth2Credentials(std::shared_ptr<const Tokens> p_tokens);
 };
 
 
@@ -0,0 +1,108 @@
+/**
+ * Copyright (c) 2014 Netheos (http://www.netheos.net)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef INCLUDE_PCS_API_PARALLEL_DOWNLOADER_H_
+#define INCLUDE_PCS_API_PARALLEL_DOWNLOADER_H_
+
+#include <memory>
+
+#include "boost/filesystem.hpp"
+
+#include "pcs_api/i_storage_provider.h"
+
+namespace pcs_api {
+
+/**
+ * \brief Downloads a blob into a local file, with several concurrent range
+ *        requests.
+ *
+ * Blob is split into segments (according to its length, as returned by
+ * GetFile()), downloaded concurrently on pooled connections and written at
+ * their offset into the local file. Each segment is retried independently
+ * of the others. Segments are tied to the version of the first received one
+ * (If-Match requests, and validators of responses are compared): download
+ * fails if blob is replaced meanwhile.
+ * Blob is downloaded into a temporary file (suffixed with ".part"), renamed
+ * once all segments have been written, or removed if download fails ;
+ * small blobs are downloaded with a single request.
+ *
+ * Example:
+ * \code
+ * ParallelDownloader(p_storage).set_segment_size(16 * 1024 * 1024)
+ *                              .set_max_concurrency(8)
+ *                              .Download(CPath(U("/big.iso")), "big.iso");
+ * \endcode
+ */
+class ParallelDownloader {
+ public:
+    static const int64_t kDefaultSegmentSize;
+    static const size_t kDefaultMaxConcurrency;
+    static const int kDefaultNbTriesPerSegment;
+
+    /**
+     * @param p_storage the storage to download from (must outlive this object)
+     */
+    explicit ParallelDownloader(IStorageProvider *p_storage);
+
+    /**
+     * \brief Defines the size of the ranges requested to server
+     *        (8 MiB by default).
+     */
+    ParallelDownloader& set_segment_size(int64_t segment_size);
+
+    /**
+     * \brief Defines the maximum number of segments downloaded at the same
+     *        time (4 by default).
+     *
+     * Note that storage connection pool limits the number of connections per
+     * host (see StorageBuilder::connection_pool()), and that providers using
+     * default asynchronous implementations run at most
+     * IStorageProvider::kMaxBlockingThreads operations at a time.
+     */
+    ParallelDownloader& set_max_concurrency(size_t max_concurrency);
+
+    /**
+     * \brief Defines the number of times a segment is downloaded before
+     *        giving up (3 by default).
+     *
+     * This is in addition to retries of transient errors performed by storage
+     * retry strategy for each request.
+     */
+    ParallelDownloader& set_nb_tries_per_segment(int nb_tries);
+
+    /**
+     * \brief Downloads a blob into a local file.
+     *
+     * Throws CFileNotFoundException if no blob exists at this path,
+     * CInvalidFileTypeException if a folder exists at this path.
+     *
+     * @param path remote blob path
+     * @param local_path destination file (replaced if it exists)
+     * @throws CStorageException Download error (also if blob has changed
+     *         during download)
+     */
+    void Download(const CPath& path, const boost::filesystem::path& local_path);
+
+ private:
+    IStorageProvider *p_storage_;
+    int64_t segment_size_;
+    size_t max_concurrency_;
+    int nb_tries_per_segment_;
+};
+
+}  // namespace pcs_api
+
+#endif  // INCLUDE_PCS_API_PARALLEL_DOWNLOADER_H_
@@ -21,6 +21,9 @@
 #include <map>
 #include <vector>
 #include <chrono>
+#include <functional>
+
+#include "pplx/pplxtasks.h"
 
 #include "pcs_api/types.h"
 
@@ -49,6 +52,22 @@ class RetryStrategy {
      */
     virtual void InvokeRetry(std::function<void()> request_func);
 
+    /**
+     * \brief Asynchronous counterpart of InvokeRetry().
+     *
+     * Calls function until returned task succeeds, fails with a non retriable
+     * error, or max trials has been reached. No thread is blocked while
+     * waiting between trials.
+     * This object must not be destroyed before returned task completes.
+     *
+     * @param request_func The function which starts executing and validating
+     *                     the request
+     * @return a task that completes when request has succeeded, or fails with
+     *         a CStorageException
+     */
+    virtual pplx::task<void> InvokeRetryAsync(
+                            std::function<pplx::task<void>()> request_func);
+
  protected:
     /**
      * \brief Wait some time before retrying function call.
@@ -62,9 +81,41 @@ class RetryStrategy {
                       std::chrono::milliseconds opt_duration_ms =
                                                 std::chrono::milliseconds(-1));
 
+    /**
+     * \brief Asynchronous counterpart of Wait().
+     *
+     * @return a task that completes when function call can be retried.
+     */
+    virtual pplx::task<void> WaitAsync(int current_tries,
+                                       std::chrono::milliseconds
+                                                            opt_duration_ms);
+
+    /**
+     * \brief Compute the time to wait before retrying function call.
+     *
+     * Parameters are the same as Wait().
+     */
+    std::chrono::milliseconds GetWaitDuration(
+                                int current_tries,
+                                std::chrono::milliseconds opt_duration_ms);
+
  private:
     const int nb_tries_max_;
     const int first_sleep_ms_;
+
+    /**
+     * \brief Handle a failed function call.
+     *
+     * @param current_tries number of calls done so far
+     * @param p_ex the exception thrown by function call
+     * @return the delay requested for next call (negative if unspecified)
+     * @throws CStorageException if function should not be called again
+     */
+    std::chrono::milliseconds HandleFailure(int current_tries,
+                                            std::exception_ptr p_ex);
+    pplx::task<void> InvokeRetryAsync(
+                                std::function<pplx::task<void>()> request_func,
+                                int current_tries);
 };
 
 }  // namespace pcs_api
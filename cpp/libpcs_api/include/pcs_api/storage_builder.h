@@ -17,10 +17,13 @@
 #ifndef INCLUDE_PCS_API_STORAGE_BUILDER_H_
 #define INCLUDE_PCS_API_STORAGE_BUILDER_H_
 
+#include <chrono>
 #include <string>
 #include <map>
 #include <vector>
 
+#include "boost/filesystem.hpp"
+
 #include "pcs_api/i_storage_provider.h"
 #include "pcs_api/app_info_repository.h"
 #include "pcs_api/user_credentials_repository.h"
@@ -102,6 +105,159 @@ class StorageBuilder {
     StorageBuilder& retry_strategy(
                             std::shared_ptr<RetryStrategy> p_retry_strategy);
 
+    /**
+     * \brief Set connections pooling parameters.
+     *
+     * http clients (and their connections) are pooled per host, and reused by
+     * subsequent requests to that host.
+     * When the maximum number of clients for a host is reached, requests wait
+     * for a client to be released (queued, without blocking a thread) ;
+     * after max_wait a new client is created anyway.
+     * Default is at most 16 clients per host, closed after one minute of
+     * inactivity, and 30 seconds of maximum wait.
+     *
+     * @param max_clients_per_host maximum number of clients per host
+     *        (0 for no limit)
+     * @param idle_timeout idle clients are closed after this delay
+     *        (zero for no timeout)
+     * @param max_wait maximum time to wait for a client
+     *        (zero to wait forever)
+     * @return this builder
+     */
+    StorageBuilder& connection_pool(size_t max_clients_per_host,
+                                    std::chrono::milliseconds idle_timeout,
+                                    std::chrono::milliseconds max_wait =
+                                                    std::chrono::seconds(30));
+
+    /**
+     * \brief Set the file where remote files identifiers are kept between
+     *        runs (used by Google Drive only).
+     *
+     * Google Drive addresses files by id: ids resolved from paths are
+     * cached in memory. If this file is set, cache is loaded when storage
+     * is instantiated, and saved when storage is destroyed. A file should
+     * not be shared by several users accounts.
+     *
+     * @param cache_file_path the cache file (may not exist yet)
+     * @return this builder
+     */
+    StorageBuilder& path_ids_cache_file(
+                            const boost::filesystem::path& cache_file_path);
+
+    /**
+     * \brief Set how long before their expiration OAuth2 access tokens are
+     *        renewed in background.
+     *
+     * A background thread renews tokens ahead of time, so that requests do
+     * not wait for a refresh. Tokens that have expired anyway (failed
+     * background refresh) are still refreshed before the next request.
+     * Default margin is 2 minutes.
+     *
+     * @param margin renewal delay before expiration
+     *        (zero to disable background renewal)
+     * @return this builder
+     */
+    StorageBuilder& token_refresh_margin(std::chrono::seconds margin);
+
+    /**
+     * \brief Set the Swift container to use (used by hubiC only).
+     *
+     * By default the first container of account is used, which requires
+     * to list containers when storage is instantiated.
+     *
+     * @param container_name name of an existing container
+     * @return this builder
+     */
+    StorageBuilder& swift_container(const std::string& container_name);
+
+    /**
+     * \brief Send all uploads without checking first what exists at path.
+     *
+     * Same as CUploadRequest::set_optimistic() for every upload request.
+     * Default is false.
+     *
+     * hubiC checks after upload (one listing request) that the blob does
+     * not hide a folder: if so, blob is removed, folder marker restored and
+     * upload fails ; a folder may then look like a blob while uploading.
+     * A small blob replacing a large object leaves its segments behind.
+     * Google Drive ignores this setting.
+     *
+     * @param optimistic true to skip checks before uploads
+     * @return this builder
+     */
+    StorageBuilder& optimistic_uploads(bool optimistic);
+
+    /**
+     * \brief Set how large files are uploaded (used by hubiC only).
+     *
+     * Files larger than threshold are uploaded as several segments objects,
+     * sent concurrently, and joined by a manifest object.
+     * Default is segments of 64 MB for files larger than 256 MB, with at most
+     * 4 segments uploaded at once.
+     * Segments are enlarged for files that would exceed the maximum number
+     * of segments of server (1000 by default), and uploads fail if
+     * segment_size is below the minimum segment size of server.
+     *
+     * @param threshold files strictly larger are uploaded as segments
+     *        (negative to always upload with a single request)
+     * @param segment_size strictly positive size of segments
+     * @param max_concurrency strictly positive maximum number of segments
+     *        uploaded at once
+     * @return this builder
+     */
+    StorageBuilder& swift_segmentation(int64_t threshold,
+                                       int64_t segment_size,
+                                       int max_concurrency);
+
+    /**
+     * \brief Set how many objects are listed per request
+     *        (used by hubiC only).
+     *
+     * Large folders are listed page by page. Default is 10000 objects
+     * per page, the maximum allowed by Swift servers: larger values are
+     * lowered to this limit (a server would return less objects than
+     * requested, which would end the listing).
+     *
+     * @param page_size strictly positive number of objects per request
+     * @return this builder
+     */
+    StorageBuilder& swift_listing_page_size(int page_size);
+
+    /**
+     * \brief Set how large files are uploaded (used by Dropbox only).
+     *
+     * Files larger than threshold are sent chunk by chunk: after a failure,
+     * upload continues from the last chunk received by server. Next chunks
+     * sizes adapt to throughput.
+     * Default is a first chunk of 4 MB for files larger than 8 MB.
+     * CUploadRequest::set_chunk_size() overrides chunk_size.
+     *
+     * @param threshold files strictly larger are uploaded in chunks
+     *        (negative to always upload in chunks)
+     * @param chunk_size strictly positive size of first chunk
+     * @return this builder
+     */
+    StorageBuilder& dropbox_chunked_upload(int64_t threshold,
+                                           int64_t chunk_size);
+
+    /**
+     * \brief Set how large files are uploaded (used by Google Drive only).
+     *
+     * Files larger than threshold are sent chunk by chunk within an upload
+     * session: after a failure, upload continues from the bytes committed
+     * by server.
+     * Default is chunks of 8 MB for files larger than 5 MB.
+     * CUploadRequest::set_chunk_size() overrides chunk_size.
+     *
+     * @param threshold files strictly larger are uploaded in chunks
+     *        (negative to always upload in chunks)
+     * @param chunk_size strictly positive size of chunks (rounded down
+     *        to a multiple of 256 KB, at least 256 KB)
+     * @return this builder
+     */
+    StorageBuilder& google_drive_resumable_upload(int64_t threshold,
+                                                  int64_t chunk_size);
+
     /**
      * \brief Instantiate storage provider implementation.
      *
@@ -122,6 +278,66 @@ class StorageBuilder {
         return p_retry_strategy_;
     }
 
+    size_t max_clients_per_host() const {
+        return max_clients_per_host_;
+    }
+
+    std::chrono::milliseconds clients_idle_timeout() const {
+        return clients_idle_timeout_;
+    }
+
+    std::chrono::milliseconds clients_max_wait() const {
+        return clients_max_wait_;
+    }
+
+    const boost::filesystem::path& path_ids_cache_file() const {
+        return path_ids_cache_file_;
+    }
+
+    std::chrono::seconds token_refresh_margin() const {
+        return token_refresh_margin_;
+    }
+
+    const std::string& swift_container() const {
+        return swift_container_;
+    }
+
+    bool optimistic_uploads() const {
+        return optimistic_uploads_;
+    }
+
+    int64_t swift_large_object_threshold() const {
+        return swift_large_object_threshold_;
+    }
+
+    int64_t swift_segment_size() const {
+        return swift_segment_size_;
+    }
+
+    int swift_max_segments_concurrency() const {
+        return swift_max_segments_concurrency_;
+    }
+
+    int swift_listing_page_size() const {
+        return swift_listing_page_size_;
+    }
+
+    int64_t dropbox_chunked_upload_threshold() const {
+        return dropbox_chunked_upload_threshold_;
+    }
+
+    int64_t dropbox_upload_chunk_size() const {
+        return dropbox_upload_chunk_size_;
+    }
+
+    int64_t google_drive_resumable_upload_threshold() const {
+        return google_drive_resumable_upload_threshold_;
+    }
+
+    int64_t google_drive_upload_chunk_size() const {
+        return google_drive_upload_chunk_size_;
+    }
+
     const AppInfo& GetAppInfo() const;
 
     /**
@@ -161,6 +377,23 @@ class StorageBuilder {
     std::shared_ptr<web::http::client::http_client_config>
                                                     p_http_client_config_;
     std::shared_ptr<pcs_api::RetryStrategy> p_retry_strategy_;
+    size_t max_clients_per_host_;
+    std::chrono::milliseconds clients_idle_timeout_;
+    std::chrono::milliseconds clients_max_wait_;
+    boost::filesystem::path path_ids_cache_file_;  // empty if not persisted
+    std::chrono::seconds token_refresh_margin_;
+    std::string swift_container_;  // empty if not pinned
+    bool optimistic_uploads_;
+    // segmentation parameters (segment size is 0 for provider defaults):
+    int64_t swift_large_object_threshold_;
+    int64_t swift_segment_size_;
+    int swift_max_segments_concurrency_;
+    int swift_listing_page_size_;  // 0 for provider default
+    // chunked uploads parameters (chunk size is 0 for provider defaults):
+    int64_t dropbox_chunked_upload_threshold_;
+    int64_t dropbox_upload_chunk_size_;
+    int64_t google_drive_resumable_upload_threshold_;
+    int64_t google_drive_upload_chunk_size_;
 
     StorageBuilder(const std::string& provider_name,
                    create_provider_func create_instance);
@@ -0,0 +1,107 @@
+/**
+ * Copyright (c) 2014 Netheos (http://www.netheos.net)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef INCLUDE_PCS_API_TREE_WALKER_H_
+#define INCLUDE_PCS_API_TREE_WALKER_H_
+
+#include <functional>
+#include <memory>
+
+#include "pcs_api/i_storage_provider.h"
+
+namespace pcs_api {
+
+/**
+ * \brief Walks a folder tree, listing several folders concurrently.
+ *
+ * Folders to be listed are queued ; at most max_concurrency listings are in
+ * flight at the same time (asynchronous ListFolderAsync() calls), each
+ * completed listing queueing the sub folders it has found. Files are given
+ * to visitor as soon as their parent folder has been listed (visitor calls
+ * are never concurrent, but may come from several threads).
+ *
+ * Example:
+ * \code
+ * TreeWalker(p_storage).set_max_concurrency(16)
+ *     .set_prune_predicate([](const CFolder& folder) {
+ *         return folder.path().GetBaseName() == U(".trash");
+ *     })
+ *     .Walk(CPath(U("/")), [](std::shared_ptr<CFile> p_file) {
+ *         std::cout << p_file->path() << std::endl;
+ *     });
+ * \endcode
+ */
+class TreeWalker {
+ public:
+    static const size_t kDefaultMaxConcurrency;
+
+    /**
+     * \brief Called for each file (blob or folder) found below walked path.
+     */
+    typedef std::function<void(std::shared_ptr<CFile> p_file)> visitor;
+
+    /**
+     * \brief Returns true for folders that must not be listed (folder itself
+     *        is still given to visitor).
+     */
+    typedef std::function<bool(const CFolder& folder)> prune_predicate;
+
+    /**
+     * @param p_storage the storage to walk (must outlive this object)
+     */
+    explicit TreeWalker(IStorageProvider *p_storage);
+
+    /**
+     * \brief Defines the maximum number of folders listed at the same time
+     *        (8 by default).
+     *
+     * Note that storage connection pool limits the number of connections per
+     * host (see StorageBuilder::connection_pool()), and that providers using
+     * default asynchronous implementations run at most
+     * IStorageProvider::kMaxBlockingThreads operations at a time.
+     */
+    TreeWalker& set_max_concurrency(size_t max_concurrency);
+
+    /**
+     * \brief Defines which folders are not walked (none by default).
+     */
+    TreeWalker& set_prune_predicate(prune_predicate predicate);
+
+    /**
+     * \brief Walk the folder tree below given path.
+     *
+     * Walk stops at first error (listings in flight are completed, but their
+     * files are not visited). Folders that disappear while walking are
+     * ignored.
+     *
+     * @param path root of walked tree (not visited itself)
+     * @param visitor called for each file found below path
+     * @return false if no folder exists at given path
+     * @throws CStorageException Error listing a folder (or exception thrown
+     *         by visitor)
+     */
+    bool Walk(const CPath& path, visitor visitor);
+
+ private:
+    IStorageProvider *p_storage_;
+    size_t max_concurrency_;
+    prune_predicate prune_predicate_;
+};
+
+}  // namespace pcs_api
+
+#endif  // INCLUDE_PCS_API_TREE_WALKER_H_
@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include <functional>
 #include <mutex>
 
 #include "cpprest/http_msg.h"
@@ -48,7 +49,13 @@ OAuth2SessionManager::OAuth2SessionManager(const string_t& authorize_url,
             p_user_credentials_repo_(builder.user_credentials_repository()),
             p_user_credentials_(builder.GetUserCredentials()),
             p_http_client_config_(builder.http_client_config()),
-            p_refresh_lock_(new std::mutex()) {
+            p_refresh_lock_(new std::mutex()),
+            refresh_task_(pplx::task_from_result()),
+            p_clients_pool_(std::make_shared<KeyedHttpClientPool>(
+                                    builder.http_client_config(),
+                                    builder.max_clients_per_host(),
+                                    builder.clients_idle_timeout(),
+                                    builder.clients_max_wait())) {
     // Check type of credentials, if provided:
     std::shared_ptr<UserCredentials> p_user_creds =
                                                 builder.GetUserCredentials();
@@ -59,6 +66,28 @@ OAuth2SessionManager::OAuth2SessionManager(const string_t& authorize_url,
                     "Invalid credentials type (expected OAuth2Credentials)"));
         }
     }
+    if (!refresh_token_url_.empty()
+            && builder.token_refresh_margin().count() > 0) {
+        p_token_refresher_ = std::make_shared<TokenRefresher>(
+                    std::bind(&OAuth2SessionManager::GetTokenExpiresAt, this),
+                    std::bind(&OAuth2SessionManager::RefreshToken, this),
+                    boost::posix_time::seconds(static_cast<long>(
+                                    builder.token_refresh_margin().count())));
+    }
+}
+
+boost::posix_time::ptime OAuth2SessionManager::GetTokenExpiresAt() {
+    std::shared_ptr<UserCredentials> p_user_credentials = user_credentials();
+    if (!p_user_credentials) {
+        return boost::posix_time::ptime();
+    }
+    std::shared_ptr<const OAuth2Credentials::Tokens> p_tokens =
+                            static_cast<const OAuth2Credentials&>(
+                                p_user_credentials->credentials()).tokens();
+    if (p_tokens->refresh_token.empty()) {
+        return boost::posix_time::ptime();  // can not be refreshed
+    }
+    return p_tokens->expires_at;
 }
 
 static void ThrowCStorageException(CResponse *p_response,
@@ -122,7 +151,7 @@ void ValidateOAuthApiResponse(CResponse *p_response, const CPath* not_used) {
 }
 
 RequestInvoker OAuth2SessionManager::GetOAuthRequestInvoker() {
-    return RequestInvoker(std::bind(&OAuth2SessionManager::RawExecute,
+    return RequestInvoker(std::bind(&OAuth2SessionManager::RawExecuteAsync,
                                     this,
                                     std::placeholders::_1),  // do_request_func
                           std::bind(&ValidateOAuthApiResponse,
@@ -131,29 +160,59 @@ RequestInvoker OAuth2SessionManager::GetOAuthRequestInvoker() {
                           nullptr);
 }
 
+string_t OAuth2SessionManager::GetProviderData() {
+    std::shared_ptr<UserCredentials> p_user_credentials = user_credentials();
+    if (!p_user_credentials) {
+        return string_t();
+    }
+    return static_cast<const OAuth2Credentials&>(
+                        p_user_credentials->credentials()).provider_data();
+}
+
+void OAuth2SessionManager::SaveProviderData(const string_t& json_string) {
+    std::shared_ptr<UserCredentials> p_user_credentials = user_credentials();
+    if (!p_user_credentials) {
+        return;
+    }
+    static_cast<OAuth2Credentials&>(
+                p_user_credentials->credentials()).SetProviderData(json_string);
+    p_user_credentials_repo_->Save(*p_user_credentials);
+}
+
 void OAuth2SessionManager::RefreshToken() {
+    RefreshTokenAsync().get();
+}
+
+pplx::task<void> OAuth2SessionManager::RefreshTokenAsync() {
     if (refresh_token_url_.empty()) {
-        throw CStorageException("Provider does not support token refresh");
+        return pplx::task_from_exception<void>(CStorageException(
+                                "Provider does not support token refresh"));
     }
 
+    std::shared_ptr<UserCredentials> p_user_credentials = user_credentials();
     OAuth2Credentials& oauth_creds = static_cast<OAuth2Credentials&>(
-                                        p_user_credentials_->credentials());
-    const string_t before_lock_access_token = oauth_creds.access_token();
+                                        p_user_credentials->credentials());
+    const std::shared_ptr<const OAuth2Credentials::Tokens> p_before_lock =
+                                                        oauth_creds.tokens();
 
-    // End of this method locks refresh lock
-    // so that only one thread refreshes token at a time
+    // Refresh lock is held until refresh request is sent,
+    // so that only one refresh is in progress at a time
     std::lock_guard<std::mutex> refresh_lock_guard(*p_refresh_lock_);
 
-    if (oauth_creds.access_token() != before_lock_access_token) {
+    if (oauth_creds.tokens() != p_before_lock) {
         // credentials have changed after lock:
         // indicates that another thread has refreshed token
         // during our wait for lock
         LOG_DEBUG << "Not refreshed token in this thread, already done";
-        return;
+        return pplx::task_from_result();
+    }
+    if (p_refreshed_tokens_ == p_before_lock && !refresh_task_.is_done()) {
+        // another thread is refreshing these tokens: wait for its result
+        LOG_DEBUG << "Not refreshed token in this thread, in progress";
+        return refresh_task_;
     }
     LOG_DEBUG << "Refreshing token";
 
-    std::shared_ptr<CResponse> p_response;
     RequestInvoker ri = GetOAuthRequestInvoker();
     // FIXME p_retry_strategy_->InvokeRetry([&] {
         web::http::http_request post(web::http::methods::POST);
@@ -165,18 +224,26 @@ void OAuth2SessionManager::RefreshToken() {
         fbb.AddParameter(
             OAuth2::kClientSecret,
             utility::conversions::to_string_t(app_info_.app_secret()));
-        fbb.AddParameter(OAuth2::kRefreshToken, oauth_creds.refresh_token());
+        fbb.AddParameter(OAuth2::kRefreshToken,
+                         p_before_lock->refresh_token);
         fbb.AddParameter(OAuth2::kScope, GetScopeForAuthorization());
         fbb.AddParameter(OAuth2::kGrantType, OAuth2::kRefreshToken);
         post.set_body(fbb.Build());
         post.headers().set_content_type(fbb.ContentType());
-
-        p_response = ri.Invoke(post);
     // });
 
-    web::json::value json_value = p_response->AsJson();
-    oauth_creds.Update(json_value);
-    p_user_credentials_repo_->Save(*p_user_credentials_);
+    refresh_task_ = ri.InvokeAsync(post).then(
+        [this, p_user_credentials](std::shared_ptr<CResponse> p_response) {
+            web::json::value json_value = p_response->AsJson();
+            static_cast<OAuth2Credentials&>(
+                p_user_credentials->credentials()).Update(json_value);
+            p_user_credentials_repo_->Save(*p_user_credentials);
+            if (p_token_refresher_) {
+                p_token_refresher_->Notify();  // new expiration time
+            }
+        });
+    p_refreshed_tokens_ = p_before_lock;
+    return refresh_task_;
 }
 
 std::shared_ptr<UserCredentials> OAuth2SessionManager::FetchUserCredentials(
@@ -213,11 +280,17 @@ std::shared_ptr<UserCredentials> OAuth2SessionManager::FetchUserCredentials(
               << utility::conversions::to_utf8string(json.serialize());
     std::unique_ptr<Credentials> p_credentials =
                                             Credentials::CreateFromJson(json);
-    p_user_credentials_ = std::make_shared<UserCredentials>(
-                                app_info_,
-                                "",  // userId is unknown yet
-                                *p_credentials);  // is copied in constructor
-    return p_user_credentials_;
+    std::shared_ptr<UserCredentials> p_user_credentials =
+                                std::make_shared<UserCredentials>(
+                                    app_info_,
+                                    "",  // userId is unknown yet
+                                    *p_credentials);  // copied in constructor
+    // Refresher thread may read credentials concurrently:
+    std::atomic_store(&p_user_credentials_, p_user_credentials);
+    if (p_token_refresher_) {
+        p_token_refresher_->Notify();
+    }
+    return p_user_credentials;
 }
 
 const string_t OAuth2SessionManager::GetScopeForAuthorization() const {
@@ -235,58 +308,115 @@ const string_t OAuth2SessionManager::GetScopeForAuthorization() const {
     return utility::conversions::to_string_t(ret);
 }
 
+/**
+ * \brief Add OAuth2 authorization header to request.
+ */
+static void AddAuthorizationHeader(web::http::http_request *p_request,
+                                   const OAuth2Credentials::Tokens& tokens) {
+    // request object is always new even if we retry,
+    // so no need to remove any old authorization header
+    p_request->headers().add(web::http::header_names::authorization,
+                             U("Bearer ") + tokens.access_token);
+}
+
 std::shared_ptr<CResponse> OAuth2SessionManager::Execute(
                                             web::http::http_request request) {
+    return ExecuteAsync(request).get();
+}
+
+pplx::task<std::shared_ptr<CResponse>> OAuth2SessionManager::ExecuteAsync(
+                                            web::http::http_request request) {
     LOG_TRACE << utility::conversions::to_utf8string(request.method())
               << ": "
               << utility::conversions::to_utf8string(
                     request.request_uri().to_string());
 
-    if (!p_user_credentials_) {
+    std::shared_ptr<UserCredentials> p_user_credentials = user_credentials();
+    if (!p_user_credentials) {
         BOOST_THROW_EXCEPTION(std::logic_error(
                                 "No user credentials available"));
     }
-    OAuth2Credentials& oauth_creds = static_cast<OAuth2Credentials&>(
-                                            p_user_credentials_->credentials());
-    if (oauth_creds.HasExpired()) {
-        RefreshToken();
+    // A single snapshot of tokens is used for this request:
+    std::shared_ptr<const OAuth2Credentials::Tokens> p_tokens =
+                            static_cast<const OAuth2Credentials&>(
+                                p_user_credentials->credentials()).tokens();
+    if (!p_tokens->HasExpired()) {
+        AddAuthorizationHeader(&request, *p_tokens);
+        return RawExecuteAsync(request);
     }
 
-    // request object is always new even if we retry,
-    // so no need to remove any old authorization header
-    request.headers().add(web::http::header_names::authorization,
-                          U("Bearer ") + oauth_creds.access_token());
-    return RawExecute(request);
+    return RefreshTokenAsync().then([this, request]() mutable {
+        AddAuthorizationHeader(&request,
+                               *static_cast<const OAuth2Credentials&>(
+                                user_credentials()->credentials()).tokens());
+        return RawExecuteAsync(request);
+    });
 }
 
 std::shared_ptr<CResponse> OAuth2SessionManager::RawExecute(
                                             web::http::http_request request) {
+    return RawExecuteAsync(request).get();
+}
+
+pplx::task<std::shared_ptr<CResponse>> OAuth2SessionManager::RawExecuteAsync(
+                                            web::http::http_request request) {
     // We do not handle exceptions at this level;
     // RequestInvoker will examine them.
-    // Instantiate client now (will be given to CResponse)
-    std::unique_ptr<web::http::client::http_client> p_client(
-        new web::http::client::http_client(request.request_uri().authority(),
-                                           *p_http_client_config_.get()));
+    // Take a client from the pool of this host (will be given to CResponse),
+    // without blocking a thread while all clients are in use:
+    pplx::task<web::http::client::http_client*> client_task =
+                            p_clients_pool_->GetAsync(request.request_uri());
+    if (client_task.is_done()) {
+        return ExecuteWithClientAsync(client_task.get(), request);
+    }
+    return client_task.then([this, request](
+                            web::http::client::http_client *p_client) {
+        return ExecuteWithClientAsync(p_client, request);
+    });
+}
+
+pplx::task<std::shared_ptr<CResponse>>
+        OAuth2SessionManager::ExecuteWithClientAsync(
+                                    web::http::client::http_client *p_client,
+                                    web::http::http_request request) {
     // will be copied when given to CResponse:
     pplx::cancellation_token_source cancel_source;
-    web::http::http_response response = p_client->request(
-                                            request,
-                                            cancel_source.get_token()).get();
-    auto p_response = std::make_shared<CResponse>(
-        p_client.get(),
-        std::bind(&OAuth2SessionManager::ReleaseClient,
-                  this,
-                   std::placeholders::_1),
-        request, &response, cancel_source);
-    p_client.release();  // now owned by p_response
-    return p_response;
+    pplx::task<web::http::http_response> response_task;
+    try {
+        response_task = p_client->request(request, cancel_source.get_token());
+    }
+    catch (...) {
+        // client is still usable for next requests:
+        ReleaseClient(p_client);
+        throw;
+    }
+    return response_task.then([this, p_client, request, cancel_source](
+                        pplx::task<web::http::http_response> response_task)
+                                                -> std::shared_ptr<CResponse> {
+        web::http::http_response response;
+        try {
+            response = response_task.get();
+        }
+        catch (...) {
+            // connections of client may be broken: it will not be reused
+            p_clients_pool_->ReportFailure(p_client);
+            ReleaseClient(p_client);
+            throw;
+        }
+        // give client to response, and function to release client:
+        return std::make_shared<CResponse>(
+            p_client,
+            std::bind(&OAuth2SessionManager::ReleaseClient,
+                      this,
+                      std::placeholders::_1),
+            request, &response, cancel_source);
+    });
 }
 
 void OAuth2SessionManager::ReleaseClient(
                                     web::http::client::http_client *p_client) {
-    // This is how we release OAuth2 clients: we destroy them
-    // (we might pool them instead, as does PasswordSessionManager ?)
-    delete p_client;
+    // This is how we release OAuth2 clients: put them back in our pool
+    p_clients_pool_->Put(p_client);
 }
 
 }  // namespace pcs_api
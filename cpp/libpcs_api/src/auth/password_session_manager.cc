@@ -30,7 +30,11 @@ namespace pcs_api {
 
 PasswordSessionManager::PasswordSessionManager(const StorageBuilder& builder,
                                                const web::uri& base_uri)
-    : clients_pool_(base_uri, builder.http_client_config()) {
+    : clients_pool_(base_uri,
+                    builder.http_client_config(),
+                    builder.max_clients_per_host(),
+                    builder.clients_idle_timeout(),
+                    builder.clients_max_wait()) {
     // Check type of credentials, if provided:
     std::shared_ptr<UserCredentials> p_user_creds =
                                                 builder.GetUserCredentials();
@@ -54,27 +58,64 @@ PasswordSessionManager::PasswordSessionManager(const StorageBuilder& builder,
 
 std::shared_ptr<CResponse> PasswordSessionManager::Execute(
                                             web::http::http_request request) {
+    return ExecuteAsync(request).get();
+}
+
+pplx::task<std::shared_ptr<CResponse>> PasswordSessionManager::ExecuteAsync(
+                                            web::http::http_request request) {
     LOG_TRACE << utility::conversions::to_utf8string(request.method())
               << ": "
               << UriUtils::ShortenUri(request.request_uri());
 
-    // Take a client from the pool:
-    std::unique_ptr<web::http::client::http_client> p_client =
-        std::unique_ptr<web::http::client::http_client>(clients_pool_.Get());
+    // Take a client from the pool, without blocking a thread while all
+    // clients are in use:
+    pplx::task<web::http::client::http_client*> client_task =
+                                                    clients_pool_.GetAsync();
+    if (client_task.is_done()) {
+        return ExecuteWithClientAsync(client_task.get(), request);
+    }
+    return client_task.then([this, request](
+                            web::http::client::http_client *p_client) {
+        return ExecuteWithClientAsync(p_client, request);
+    });
+}
+
+pplx::task<std::shared_ptr<CResponse>>
+        PasswordSessionManager::ExecuteWithClientAsync(
+                                    web::http::client::http_client *p_client,
+                                    web::http::http_request request) {
     // will be copied when given to CResponse:
     pplx::cancellation_token_source cancel_source;
-    web::http::http_response response = p_client->request(
-                                            request,
-                                            cancel_source.get_token()).get();
-    // give client to response, and function to release client:
-    auto p_response = std::make_shared<CResponse>(
-            p_client.get(),
-            std::bind(&PasswordSessionManager::ReleaseClient,
-                      this,
-                      std::placeholders::_1),
-            request, &response, cancel_source);
-    p_client.release();
-    return p_response;
+    pplx::task<web::http::http_response> response_task;
+    try {
+        response_task = p_client->request(request, cancel_source.get_token());
+    }
+    catch (...) {
+        // client is still usable for next requests:
+        ReleaseClient(p_client);
+        throw;
+    }
+    return response_task.then([this, p_client, request, cancel_source](
+                        pplx::task<web::http::http_response> response_task)
+                                                -> std::shared_ptr<CResponse> {
+        web::http::http_response response;
+        try {
+            response = response_task.get();
+        }
+        catch (...) {
+            // connections of client may be broken: it will not be reused
+            clients_pool_.ReportFailure(p_client);
+            ReleaseClient(p_client);
+            throw;
+        }
+        // give client to response, and function to release client:
+        return std::make_shared<CResponse>(
+                p_client,
+                std::bind(&PasswordSessionManager::ReleaseClient,
+                          this,
+                          std::placeholders::_1),
+                request, &response, cancel_source);
+    });
 }
 
 
@@ -0,0 +1,131 @@
+/**
+ * Copyright (c) 2014 Netheos (http://www.netheos.net)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <algorithm>
+#include <chrono>
+
+#include "boost/date_time/posix_time/posix_time_io.hpp"
+
+#include "pcs_api/internal/token_refresher.h"
+#include "pcs_api/c_exceptions.h"
+#include "pcs_api/internal/logger.h"
+
+namespace pcs_api {
+
+const boost::posix_time::time_duration TokenRefresher::kRetryDelay =
+                                            boost::posix_time::seconds(30);
+
+TokenRefresher::TokenRefresher(expires_at_function expires_at_func,
+                               std::function<void()> refresh_func,
+                               boost::posix_time::time_duration margin,
+                               now_function now_func)
+    : expires_at_func_(expires_at_func),
+      refresh_func_(refresh_func),
+      margin_(margin),
+      now_func_(now_func ? now_func : [] {
+          return boost::posix_time::microsec_clock::universal_time();
+      }),
+      stopping_(false),
+      notified_(false),
+      thread_(&TokenRefresher::Run, this) {
+}
+
+TokenRefresher::~TokenRefresher() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cond_.notify_all();
+    thread_.join();
+}
+
+void TokenRefresher::Notify() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        notified_ = true;
+    }
+    cond_.notify_all();
+}
+
+boost::posix_time::ptime TokenRefresher::GetRefreshTime(
+                                        const boost::posix_time::ptime& now) {
+    boost::posix_time::ptime expires_at = expires_at_func_();
+    if (expires_at.is_special()) {
+        return boost::posix_time::ptime();  // nothing to refresh
+    }
+    if (expires_at != known_expires_at_) {
+        // new token:
+        known_expires_at_ = expires_at;
+        known_since_ = now;
+    }
+    // Short lived tokens are renewed at half of their validity, so that
+    // tokens shorter than margin are not renewed continuously:
+    boost::posix_time::time_duration lead =
+                        std::min(margin_, (expires_at - known_since_) / 2);
+    return expires_at - lead;
+}
+
+void TokenRefresher::Run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_) {
+        notified_ = false;
+        lock.unlock();
+        boost::posix_time::ptime now = now_func_();
+        boost::posix_time::ptime refresh_at = GetRefreshTime(now);
+        lock.lock();
+        if (stopping_ || notified_) {
+            continue;
+        }
+        if (refresh_at.is_special()) {
+            // wait for a token:
+            cond_.wait(lock, [this] { return stopping_ || notified_; });
+            continue;
+        }
+        if (!retry_after_.is_special()) {
+            // last refresh failed: notifications do not retry sooner
+            refresh_at = std::max(refresh_at, retry_after_);
+        }
+        if (refresh_at > now) {
+            std::chrono::milliseconds delay(
+                                (refresh_at - now).total_milliseconds());
+            cond_.wait_for(lock, delay, [this] {
+                return stopping_ || notified_;
+            });
+            // token may have changed meanwhile: check again
+            continue;
+        }
+
+        lock.unlock();
+        bool refreshed = false;
+        try {
+            LOG_DEBUG << "Refreshing token in background";
+            refresh_func_();
+            refreshed = true;
+        }
+        catch (...) {
+            LOG_WARN << "Background token refresh failed: "
+                     << CurrentExceptionToString() << " ; will retry in "
+                     << kRetryDelay;
+        }
+        now = now_func_();
+        lock.lock();
+        retry_after_ = refreshed ? boost::posix_time::ptime()
+                                 : now + kRetryDelay;
+    }
+}
+
+}  // namespace pcs_api
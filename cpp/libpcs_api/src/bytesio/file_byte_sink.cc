@@ -30,14 +30,20 @@
 namespace pcs_api {
 FileByteSink::FileByteSink(const boost::filesystem::path& path,
                            bool temp_name_during_write,
-                           bool delete_on_abort)
+                           bool delete_on_abort,
+                           bool resume)
     : path_(path),
       temp_name_during_write_(temp_name_during_write),
       delete_on_abort_(delete_on_abort),
-      aborted_(false) {
+      expected_length_(-1),
+      aborted_(false),
+      append_(false) {
+    if (resume && temp_name_during_write_ && !delete_on_abort_) {
+        ReadValidator();
+    }
 }
 
-const boost::filesystem::path FileByteSink::GetActualPath() {
+const boost::filesystem::path FileByteSink::GetActualPath() const {
     boost::filesystem::path actual = path_;
     if (temp_name_during_write_) {
         actual += ".part";
@@ -45,13 +51,54 @@ const boost::filesystem::path FileByteSink::GetActualPath() {
     return actual;
 }
 
+const boost::filesystem::path FileByteSink::GetValidatorPath() const {
+    boost::filesystem::path validator_path = GetActualPath();
+    validator_path += ".validator";
+    return validator_path;
+}
+
+void FileByteSink::ReadValidator() {
+    boost::filesystem::path validator_path = GetValidatorPath();
+    if (!boost::filesystem::exists(validator_path)
+        || !boost::filesystem::exists(GetActualPath())) {
+        return;
+    }
+    boost::filesystem::ifstream ifs(validator_path);
+    std::string validator;
+    std::getline(ifs, validator);
+    validator_ = utility::conversions::to_string_t(validator);
+    LOG_DEBUG << "Found partial file " << GetActualPath()
+              << " (validator=" << validator << ")";
+}
+
+void FileByteSink::WriteValidator() {
+    // Failure here only prevents later resume: not worth an exception
+    boost::filesystem::ofstream ofs(GetValidatorPath(),
+                                    std::ios_base::out | std::ios_base::trunc);
+    ofs << utility::conversions::to_utf8string(validator_) << std::endl;
+    if (ofs.fail()) {
+        LOG_WARN << "Could not write validator file: " << GetValidatorPath();
+    }
+}
+
 std::ostream *FileByteSink::OpenStream() {
     boost::filesystem::path actual_path = GetActualPath();
     LOG_TRACE << "In FileByteSink::OpenStream(): actual path=" << actual_path;
+    aborted_ = false;  // sink may be reused by a retried download
     p_ofstream_ = std::unique_ptr<boost::filesystem::ofstream>(
                                         new boost::filesystem::ofstream());
-    p_ofstream_->open(actual_path,
-                      ::std::ios_base::out | std::ios_base::binary);
+    std::ios_base::openmode mode = std::ios_base::out | std::ios_base::binary;
+    if (append_) {
+        LOG_DEBUG << "Resuming partial file: " << actual_path;
+        mode |= std::ios_base::app;
+    } else {
+        mode |= std::ios_base::trunc;
+    }
+    append_ = false;
+    // Validator file only makes sense for an interrupted write:
+    boost::system::error_code ec;
+    boost::filesystem::remove(GetValidatorPath(), ec);
+    p_ofstream_->open(actual_path, mode);
     if (p_ofstream_->fail()) {
         std::system_error se(errno, std::system_category());
         const char *p_msg = se.what();
@@ -100,6 +147,10 @@ void FileByteSink::CloseStream() {
                           << actual_path;
                 boost::filesystem::remove(actual_path);
             } else if (boost::filesystem::exists(actual_path)) {
+                if (temp_name_during_write_ && !validator_.empty()) {
+                    // Keep track of content, so that it may be resumed
+                    WriteValidator();
+                }
                 std::streamsize actual_file_length =
                     static_cast<std::streamsize>(
                         boost::filesystem::file_size(actual_path));
@@ -133,6 +184,50 @@ void FileByteSink::CloseStream() {
     }
 }
 
+bool FileByteSink::IsBufferWritable() const {
+    return true;
+}
+
+void FileByteSink::Write(const char* p_data, std::streamsize size) {
+    // Large blocks are not buffered by file stream, but written directly:
+    p_ofstream_->write(p_data, size);
+    if (p_ofstream_->fail()) {
+        std::system_error se(errno, std::system_category());
+        const char *p_msg = se.what();
+        BOOST_THROW_EXCEPTION(std::ios_base::failure(
+                std::string("Could not write to file: ")
+                + utility::conversions::to_utf8string(path_.c_str())
+                + ": " + p_msg));
+    }
+}
+
+int64_t FileByteSink::GetResumeOffset() const {
+    // A file without temp name may be an older complete version,
+    // and we can only resume a content that can be validated:
+    if (!temp_name_during_write_ || delete_on_abort_ || validator_.empty()) {
+        return 0;
+    }
+    boost::filesystem::path actual_path = GetActualPath();
+    boost::system::error_code ec;
+    uintmax_t size = boost::filesystem::file_size(actual_path, ec);
+    if (ec) {
+        return 0;
+    }
+    return static_cast<int64_t>(size);
+}
+
+string_t FileByteSink::GetResumeValidator() const {
+    return validator_;
+}
+
+void FileByteSink::SetResumeValidator(const string_t& validator) {
+    validator_ = validator;
+}
+
+void FileByteSink::SetResume(bool resume) {
+    append_ = resume;
+}
+
 void FileByteSink::SetExpectedLength(std::streamsize length) {
     // LOG_DEBUG << "In FileByteSink::SetExpectedLength(" << length << ")";
     expected_length_ = length;
@@ -0,0 +1,124 @@
+/**
+ * Copyright (c) 2014 Netheos (http://www.netheos.net)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <system_error>
+
+#include "cpprest/asyncrt_utils.h"
+
+#include "pcs_api/internal/file_range_byte_sink.h"
+#include "pcs_api/c_exceptions.h"
+#include "pcs_api/internal/logger.h"
+
+namespace pcs_api {
+
+namespace detail {
+
+FileRangeByteSink::FileRangeByteSink(const boost::filesystem::path& path,
+                                     int64_t offset,
+                                     int64_t length)
+    : path_(path),
+      offset_(offset),
+      length_(length),
+      written_(0) {
+}
+
+void FileRangeByteSink::ThrowIoFailure(const std::string& msg) {
+    std::system_error se(errno, std::system_category());
+    const char *p_msg = se.what();
+    BOOST_THROW_EXCEPTION(std::ios_base::failure(
+            msg + ": " + utility::conversions::to_utf8string(path_.c_str())
+            + " (offset " + std::to_string(offset_) + "): " + p_msg));
+}
+
+std::ostream *FileRangeByteSink::OpenStream() {
+    LOG_TRACE << "In FileRangeByteSink::OpenStream(): path=" << path_
+              << " offset=" << offset_;
+    // in|out so that file is not truncated:
+    p_fstream_.reset(new boost::filesystem::fstream());
+    p_fstream_->open(path_, std::ios_base::in | std::ios_base::out
+                                              | std::ios_base::binary);
+    if (p_fstream_->fail()) {
+        ThrowIoFailure("Could not open file");
+    }
+    p_fstream_->seekp(offset_);
+    if (p_fstream_->fail()) {
+        ThrowIoFailure("Could not seek in file");
+    }
+    written_ = 0;
+    return p_fstream_.get();
+}
+
+void FileRangeByteSink::CloseStream() {
+    if (p_fstream_) {  // close only once
+        p_fstream_->close();
+        bool closed_properly = !p_fstream_->fail();
+        p_fstream_.reset();
+        if (!closed_properly) {
+            ThrowIoFailure("Could not properly close file");
+        }
+    }
+}
+
+bool FileRangeByteSink::IsBufferWritable() const {
+    return true;
+}
+
+void FileRangeByteSink::Write(const char* p_data, std::streamsize size) {
+    if (written_ + size > length_) {
+        // server sent more than requested range: never write beyond range,
+        // as bytes belong to another range
+        BOOST_THROW_EXCEPTION(CStorageException(
+                "Too many bytes received for range at offset "
+                + std::to_string(offset_)));
+    }
+    p_fstream_->write(p_data, size);
+    if (p_fstream_->fail()) {
+        ThrowIoFailure("Could not write to file");
+    }
+    written_ += size;
+}
+
+void FileRangeByteSink::SetExpectedLength(std::streamsize expected_length) {
+    if (expected_length != length_) {
+        // Range has probably been ignored by server:
+        BOOST_THROW_EXCEPTION(CStorageException(
+                "Unexpected length for range at offset "
+                + std::to_string(offset_) + ": "
+                + std::to_string(expected_length) + " bytes instead of "
+                + std::to_string(length_)));
+    }
+}
+
+void FileRangeByteSink::Abort() {
+    // Nothing to clean: range will be written again, or file discarded
+}
+
+FileRangeByteSink::~FileRangeByteSink() {
+    if (p_fstream_) {
+        LOG_ERROR << "Destroying a FileRangeByteSink "
+                     "without having closed stream !";
+        try {
+            CloseStream();
+        }
+        catch (...) {
+            LOG_ERROR << CurrentExceptionToString();
+        }
+    }
+}
+
+}  // namespace detail
+
+}  // namespace pcs_api
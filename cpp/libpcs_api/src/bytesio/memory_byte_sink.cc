@@ -31,6 +31,14 @@ void MemoryByteSink::CloseStream() {
     // Nothing to close with ostringstream
 }
 
+bool MemoryByteSink::IsBufferWritable() const {
+    return true;
+}
+
+void MemoryByteSink::Write(const char* p_data, std::streamsize size) {
+    data_.write(p_data, size);
+}
+
 void MemoryByteSink::SetExpectedLength(std::streamsize length) {
     // ignored for memory byte sink
 }
@@ -21,8 +21,9 @@ namespace pcs_api {
 
 namespace detail {
 
-ProgressOutputFilter::ProgressOutputFilter(ProgressListener* p_pl) :
-    p_listener_(p_pl), counter_(0) {
+ProgressOutputFilter::ProgressOutputFilter(ProgressListener* p_pl,
+                                           std::streamsize initial_count) :
+    p_listener_(p_pl), counter_(initial_count) {
 }
 
 template<typename Sink>
@@ -46,15 +47,19 @@ void ProgressOutputFilter::close(Sink&) {
 
 ProgressByteSink::ProgressByteSink(std::shared_ptr<ByteSink> p_byte_sink,
                                    std::shared_ptr<ProgressListener> p_pl) :
-    p_delegate_(p_byte_sink), p_listener_(p_pl) {
+    p_delegate_(p_byte_sink), p_listener_(p_pl), written_(0),
+    resume_offset_(0) {
 }
 
 
 std::ostream* ProgressByteSink::OpenStream() {
     // We build a boost filter stream, inserting a ProgressFilter in chain
     // and underlying stream last:
+    written_ = resume_offset_;
     p_sink_stream_.reset(new filtstream());
-    p_progress_filter_.reset(new ProgressOutputFilter(p_listener_.get()));
+    p_progress_filter_.reset(new ProgressOutputFilter(p_listener_.get(),
+                                                      resume_offset_));
+    resume_offset_ = 0;
 
     // We set buffer size to 1024 here (default 128 is too small)
     // this value defines how often progress listener is notified
@@ -77,6 +82,35 @@ void ProgressByteSink::CloseStream() {
     p_delegate_->CloseStream();
 }
 
+bool ProgressByteSink::IsBufferWritable() const {
+    return p_delegate_->IsBufferWritable();
+}
+
+void ProgressByteSink::Write(const char* p_data, std::streamsize size) {
+    // Blocks bypass our filtering stream:
+    p_delegate_->Write(p_data, size);
+    written_ += size;
+    p_listener_->Progress(written_);
+}
+
+int64_t ProgressByteSink::GetResumeOffset() const {
+    return p_delegate_->GetResumeOffset();
+}
+
+string_t ProgressByteSink::GetResumeValidator() const {
+    return p_delegate_->GetResumeValidator();
+}
+
+void ProgressByteSink::SetResumeValidator(const string_t& validator) {
+    p_delegate_->SetResumeValidator(validator);
+}
+
+void ProgressByteSink::SetResume(bool resume) {
+    // Progress starts after bytes kept:
+    resume_offset_ = resume ? p_delegate_->GetResumeOffset() : 0;
+    p_delegate_->SetResume(resume);
+}
+
 void ProgressByteSink::SetExpectedLength(std::streamsize expected_length) {
     p_listener_->SetProgressTotal(expected_length);
     p_delegate_->SetExpectedLength(expected_length);
@@ -0,0 +1,146 @@
+/**
+ * Copyright (c) 2014 Netheos (http://www.netheos.net)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <algorithm>
+#include <ios>
+#include <streambuf>
+#include <vector>
+
+#include "boost/throw_exception.hpp"
+
+#include "pcs_api/internal/range_byte_source.h"
+#include "pcs_api/internal/logger.h"
+
+namespace pcs_api {
+
+namespace detail {
+
+namespace {
+
+const std::streamsize kBufferSize = 64 * 1024;
+
+/**
+ * \brief Stream buffer reading at most a given number of bytes
+ *        from an owned delegate stream.
+ */
+class RangeStreamBuf : public std::streambuf {
+ public:
+    RangeStreamBuf(std::unique_ptr<std::istream> p_delegate,
+                   std::streamsize length) :
+        p_delegate_(std::move(p_delegate)),
+        remaining_(length),
+        position_(0),
+        buffer_(static_cast<size_t>(
+                    std::min<std::streamsize>(length, kBufferSize))) {
+    }
+
+ protected:
+    int_type underflow() override {
+        if (gptr() < egptr()) {
+            return traits_type::to_int_type(*gptr());
+        }
+        if (remaining_ <= 0 || buffer_.empty()) {
+            return traits_type::eof();
+        }
+        std::streamsize to_read =
+                std::min<std::streamsize>(remaining_, buffer_.size());
+        p_delegate_->read(buffer_.data(), to_read);
+        std::streamsize nb_read = p_delegate_->gcount();
+        if (nb_read <= 0) {
+            // Delegate is shorter than expected: request will fail
+            // as content length is not reached
+            LOG_WARN << "Unexpected end of source stream ("
+                     << remaining_ << " bytes missing)";
+            return traits_type::eof();
+        }
+        remaining_ -= nb_read;
+        position_ += nb_read;
+        setg(buffer_.data(), buffer_.data(), buffer_.data() + nb_read);
+        return traits_type::to_int_type(*gptr());
+    }
+
+    // Only telling current position is supported
+    // (cpprestsdk asks for it before sending a request body)
+    pos_type seekoff(off_type offset,
+                     std::ios_base::seekdir way,
+                     std::ios_base::openmode which) override {
+        if (offset != 0 || way != std::ios_base::cur
+                || !(which & std::ios_base::in)) {
+            return pos_type(off_type(-1));
+        }
+        return pos_type(position_ - (egptr() - gptr()));
+    }
+
+ private:
+    std::unique_ptr<std::istream> p_delegate_;
+    std::streamsize remaining_;
+    std::streamsize position_;  // in range, of buffer end
+    std::vector<char> buffer_;
+};
+
+/**
+ * \brief Input stream owning its RangeStreamBuf.
+ */
+class RangeIStream : public std::istream {
+ public:
+    RangeIStream(std::unique_ptr<std::istream> p_delegate,
+                 std::streamsize length) :
+        std::istream(nullptr),
+        buf_(std::move(p_delegate), length) {
+        rdbuf(&buf_);
+    }
+
+ private:
+    RangeStreamBuf buf_;
+};
+
+}  // namespace
+
+RangeByteSource::RangeByteSource(std::shared_ptr<ByteSource> p_byte_source,
+                                 int64_t offset,
+                                 std::streamsize length)
+    : p_byte_source_(p_byte_source),
+      offset_(offset),
+      length_(length) {
+}
+
+std::unique_ptr<std::istream> RangeByteSource::OpenStream() {
+    std::unique_ptr<std::istream> p_delegate = p_byte_source_->OpenStream();
+    if (offset_ > 0) {
+        p_delegate->seekg(offset_);
+        if (p_delegate->fail()) {
+            // stream is not seekable: skip bytes
+            p_delegate->clear();
+            p_delegate->ignore(offset_);
+            if (p_delegate->gcount() != offset_) {
+                BOOST_THROW_EXCEPTION(std::ios_base::failure(
+                        "Could not reach range offset "
+                        + std::to_string(offset_) + " of source stream"));
+            }
+        }
+    }
+    return std::unique_ptr<std::istream>(
+                        new RangeIStream(std::move(p_delegate), length_));
+}
+
+std::streamsize RangeByteSource::Length() const {
+    return length_;
+}
+
+}  // namespace detail
+
+}  // namespace pcs_api
@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include <chrono>
 #include <memory>
 
 #include "boost/date_time/posix_time/posix_time_io.hpp"
@@ -35,6 +36,8 @@ const char_t* OAuth2Credentials::kAccessToken =
 const char_t* OAuth2Credentials::kExpiresIn = PCS_API_STRING_T("expires_in");
 const char_t* OAuth2Credentials::kExpiresAt = PCS_API_STRING_T("expires_at");
 const char_t* OAuth2Credentials::kTokenType = PCS_API_STRING_T("token_type");
+const char_t* OAuth2Credentials::kProviderData =
+                                            PCS_API_STRING_T("provider_data");
 
 /**
  * \brief Calculate expiration timestamp, if not defined.
@@ -74,6 +77,32 @@ CalculateExpiresAt(const web::json::value& json) {
     return expires_at;
 }
 
+/**
+ * \brief Build an immutable tokens snapshot.
+ */
+static std::shared_ptr<const OAuth2Credentials::Tokens> MakeTokens(
+                                    const string_t& access_token,
+                                    const boost::posix_time::ptime& expires_at,
+                                    const string_t& refresh_token,
+                                    const string_t& token_type,
+                                    const string_t& provider_data) {
+    std::shared_ptr<OAuth2Credentials::Tokens> p_tokens =
+                                std::make_shared<OAuth2Credentials::Tokens>();
+    p_tokens->access_token = access_token;
+    p_tokens->expires_at = expires_at;
+    p_tokens->refresh_token = refresh_token;
+    p_tokens->token_type = token_type;
+    p_tokens->provider_data = provider_data;
+    if (expires_at.is_special()) {  // never expires
+        p_tokens->expiry = std::chrono::system_clock::time_point::max();
+    } else {
+        p_tokens->expiry = std::chrono::system_clock::from_time_t(
+                        static_cast<time_t>(
+                                utilities::DateTimeToTime_t(expires_at)));
+    }
+    return p_tokens;
+}
+
 std::unique_ptr<OAuth2Credentials> OAuth2Credentials::CreateFromJson(
                                                 const web::json::value& json) {
     string_t access_token =
@@ -85,68 +114,80 @@ std::unique_ptr<OAuth2Credentials> OAuth2Credentials::CreateFromJson(
     string_t token_type = JsonForKey(json,
                                      OAuth2Credentials::kTokenType,
                                      string_t());
+    string_t provider_data;
+    if (json.has_field(OAuth2Credentials::kProviderData)) {
+        provider_data = json.at(OAuth2Credentials::kProviderData).serialize();
+    }
     return std::unique_ptr<OAuth2Credentials>(
-            new OAuth2Credentials(access_token,
-                                  expire_at,
-                                  refresh_token,
-                                  token_type));
+            new OAuth2Credentials(MakeTokens(access_token,
+                                             expire_at,
+                                             refresh_token,
+                                             token_type,
+                                             provider_data)));
 }
 
-OAuth2Credentials::OAuth2Credentials(string_t access_token,
-                   boost::posix_time::ptime expires_at,
-                   string_t refresh_token,
-                   string_t token_type) :
-    access_token_(access_token),
-    expires_at_(expires_at),
-    refresh_token_(refresh_token),
-    token_type_(token_type) {
+OAuth2Credentials::OAuth2Credentials(std::shared_ptr<const Tokens> p_tokens) :
+    p_tokens_(p_tokens) {
 }
 
-
-bool OAuth2Credentials::HasExpired() const {
-    std::unique_lock<std::mutex>(mutex_);
-    if (expires_at_ == boost::posix_time::not_a_date_time) {
-        LOG_TRACE << "HasExpired - token is not expirable";
-        return false;
-    }
-    boost::posix_time::ptime now(
-                            boost::posix_time::second_clock::universal_time());
-    bool ret = now > expires_at_;
-    LOG_TRACE << "HasExpired=" << ret <<" (now=" << now
-              << " expires_at_=" << expires_at_ << ")";
-    return ret;
+void OAuth2Credentials::Update(const web::json::value& json) {
+    string_t access_token = json.at(kAccessToken).as_string();
+    boost::posix_time::ptime expires_at = CalculateExpiresAt(json);
+    std::shared_ptr<const Tokens> p_current = tokens();
+    std::shared_ptr<const Tokens> p_updated;
+    do {
+        // refresh token and type are kept if not renewed:
+        p_updated = MakeTokens(access_token,
+                               expires_at,
+                               JsonForKey(json,
+                                          OAuth2::kRefreshToken,
+                                          p_current->refresh_token),
+                               JsonForKey(json,
+                                          OAuth2Credentials::kTokenType,
+                                          p_current->token_type),
+                               p_current->provider_data);
+    } while (!std::atomic_compare_exchange_weak(&p_tokens_,
+                                                &p_current,
+                                                p_updated));
 }
 
-
-void OAuth2Credentials::Update(const web::json::value& json) {
-    std::unique_lock<std::mutex>(mutex_);
-    access_token_ = json.at(kAccessToken).as_string();
-    token_type_ = JsonForKey(json, OAuth2Credentials::kTokenType, token_type_);
-    expires_at_ = CalculateExpiresAt(json);
-    refresh_token_ = JsonForKey(json, OAuth2::kRefreshToken, refresh_token_);
+void OAuth2Credentials::SetProviderData(const string_t& json_string) {
+    std::shared_ptr<const Tokens> p_current = tokens();
+    std::shared_ptr<const Tokens> p_updated;
+    do {
+        p_updated = MakeTokens(p_current->access_token,
+                               p_current->expires_at,
+                               p_current->refresh_token,
+                               p_current->token_type,
+                               json_string);
+    } while (!std::atomic_compare_exchange_weak(&p_tokens_,
+                                                &p_current,
+                                                p_updated));
 }
 
 OAuth2Credentials *OAuth2Credentials::Clone() const {
-    std::unique_lock<std::mutex>(mutex_);
-    return new OAuth2Credentials(access_token_,
-            expires_at_,
-            refresh_token_,
-            token_type_);
+    // snapshots are immutable, so they can be shared:
+    return new OAuth2Credentials(tokens());
 }
 
 std::string OAuth2Credentials::ToJsonString() const {
-    std::unique_lock<std::mutex>(mutex_);
+    std::shared_ptr<const Tokens> p_tokens = tokens();
     web::json::value tmp = web::json::value::object();
-    tmp[kAccessToken] = web::json::value::string(access_token_);
-    if (expires_at_ != boost::date_time::not_a_date_time) {
+    tmp[kAccessToken] = web::json::value::string(p_tokens->access_token);
+    if (p_tokens->expires_at != boost::date_time::not_a_date_time) {
         tmp[kExpiresAt] = web::json::value::number(
-            static_cast<double>(utilities::DateTimeToTime_t(expires_at_)));
+            static_cast<double>(
+                    utilities::DateTimeToTime_t(p_tokens->expires_at)));
+    }
+    if (!p_tokens->refresh_token.empty()) {
+        tmp[OAuth2::kRefreshToken] =
+                            web::json::value::string(p_tokens->refresh_token);
     }
-    if (!refresh_token_.empty()) {
-        tmp[OAuth2::kRefreshToken] = web::json::value::string(refresh_token_);
+    if (!p_tokens->token_type.empty()) {
+        tmp[kTokenType] = web::json::value::string(p_tokens->token_type);
     }
-    if (!token_type_.empty()) {
-        tmp[kTokenType] = web::json::value::string(token_type_);
+    if (!p_tokens->provider_data.empty()) {
+        tmp[kProviderData] = web::json::value::parse(p_tokens->provider_data);
     }
     return utility::conversions::to_utf8string(tmp.serialize());
 }
@@ -14,7 +14,13 @@
  * limitations under the License.
  */
 
+#include <algorithm>
 #include <sstream>
+#include <stdexcept>
+
+#include "boost/throw_exception.hpp"
+
+#include "cpprest/asyncrt_utils.h"
 
 #include "pcs_api/c_download_request.h"
 #include "pcs_api/internal/progress_byte_sink.h"
@@ -23,12 +29,15 @@
 
 namespace pcs_api {
 
+const size_t CDownloadRequest::kDefaultChunkSize = 1024 * 1024;
+
 CDownloadRequest::CDownloadRequest(CPath path,
                                    std::shared_ptr<ByteSink> p_byte_sink)
     : path_(path),
       p_byte_sink_(p_byte_sink),
       range_offset_(-1),
-      range_length_(-1) {
+      range_length_(-1),
+      chunk_size_(kDefaultChunkSize) {
 }
 
 CDownloadRequest& CDownloadRequest::set_progress_listener(
@@ -37,9 +46,17 @@ CDownloadRequest& CDownloadRequest::set_progress_listener(
     return *this;
 }
 
+CDownloadRequest& CDownloadRequest::set_chunk_size(size_t chunk_size) {
+    if (chunk_size == 0) {
+        BOOST_THROW_EXCEPTION(std::invalid_argument("Chunk size must be > 0"));
+    }
+    chunk_size_ = chunk_size;
+    return *this;
+}
+
 std::map<string_t, string_t> CDownloadRequest::GetHttpHeaders() const {
     std::map<string_t, string_t> headers;
-    if (range_offset_ >= 0 || range_length_ > 0) {
+    if (IsPartial()) {
         std::basic_ostringstream<char_t> range;
         range << PCS_API_STRING_T("bytes=");
 
@@ -59,6 +76,45 @@ std::map<string_t, string_t> CDownloadRequest::GetHttpHeaders() const {
         LOG_TRACE << "Range: " << header_value;
         headers[PCS_API_STRING_T("Range")] = header_value;
     }
+    if (!expected_validator_.empty()) {
+        // Last-Modified validators are dates, other ones are ETags:
+        if (utility::datetime::from_string(expected_validator_,
+                            utility::datetime::RFC_1123).is_initialized()) {
+            headers[PCS_API_STRING_T("If-Unmodified-Since")] =
+                                                        expected_validator_;
+        } else {
+            headers[PCS_API_STRING_T("If-Match")] = expected_validator_;
+        }
+    }
+    return headers;
+}
+
+std::map<string_t, string_t> CDownloadRequest::GetHttpHeaders(
+                                        const ByteSink& byte_sink,
+                                        int64_t *p_resume_offset) const {
+    *p_resume_offset = 0;
+    int64_t resume_offset = byte_sink.GetResumeOffset();
+    string_t validator = byte_sink.GetResumeValidator();
+    if (resume_offset <= 0 || validator.empty()) {
+        return GetHttpHeaders();
+    }
+    if (range_offset_ < 0 && range_length_ > 0) {
+        // Suffix range: bytes to be skipped are not known
+        return GetHttpHeaders();
+    }
+    if (range_length_ > 0 && resume_offset >= range_length_) {
+        // Should not happen (content was complete), so we download again:
+        return GetHttpHeaders();
+    }
+
+    LOG_DEBUG << "Download will be resumed after " << resume_offset
+              << " bytes: " << path_;
+    CDownloadRequest resumed(*this);
+    resumed.SetRange(std::max<int64_t>(range_offset_, 0) + resume_offset,
+                     range_length_ > 0 ? range_length_ - resume_offset : -1);
+    std::map<string_t, string_t> headers = resumed.GetHttpHeaders();
+    headers[PCS_API_STRING_T("If-Range")] = validator;
+    *p_resume_offset = resume_offset;
     return headers;
 }
 
@@ -73,6 +129,16 @@ CDownloadRequest& CDownloadRequest::SetRange(int64_t offset, int64_t length) {
     return *this;
 }
 
+bool CDownloadRequest::IsPartial() const {
+    return range_offset_ >= 0 || range_length_ > 0;
+}
+
+CDownloadRequest& CDownloadRequest::set_expected_validator(
+                                                const string_t& validator) {
+    expected_validator_ = validator;
+    return *this;
+}
+
 std::shared_ptr<ByteSink> CDownloadRequest::GetByteSink() const {
     if (!p_listener_) {
         return p_byte_sink_;
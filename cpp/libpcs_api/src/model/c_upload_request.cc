@@ -14,6 +14,10 @@
  * limitations under the License.
  */
 
+#include <stdexcept>
+
+#include "boost/throw_exception.hpp"
+
 #include "pcs_api/c_upload_request.h"
 #include "pcs_api/internal/progress_byte_source.h"
 
@@ -21,7 +25,8 @@ namespace pcs_api {
 
 CUploadRequest::CUploadRequest(CPath path,
                                std::shared_ptr<ByteSource> p_byte_source)
-    : path_(path), p_byte_source_(p_byte_source) {
+    : path_(path), p_byte_source_(p_byte_source), chunk_size_(0),
+      optimistic_(false) {
 }
 
 /**
@@ -50,6 +55,19 @@ CUploadRequest& CUploadRequest::set_progress_listener(
     return *this;
 }
 
+CUploadRequest& CUploadRequest::set_chunk_size(std::streamsize chunk_size) {
+    if (chunk_size <= 0) {
+        BOOST_THROW_EXCEPTION(std::invalid_argument("Chunk size must be > 0"));
+    }
+    chunk_size_ = chunk_size;
+    return *this;
+}
+
+CUploadRequest& CUploadRequest::set_optimistic(bool optimistic) {
+    optimistic_ = optimistic;
+    return *this;
+}
+
 std::shared_ptr<ByteSource> CUploadRequest::GetByteSource() const {
     if (!p_listener_) {
         return p_byte_source_;
@@ -43,65 +43,124 @@ void RetryStrategy::InvokeRetry(std::function<void()> request_func) {
             }
             request_func();
             return;
-        } catch (const CRetriableException& rex) {
-            if (current_tries >= nb_tries_max_) {
-                LOG_WARN << "Aborting invocations after "
-                         <<  nb_tries_max_ << " failed attempts";
-                std::exception_ptr p_cause = rex.cause();
-                if (!p_cause) {
-                    // This should never happen:
-                    // every CRetriableException should have a cause exception
-                    LOG_ERROR << "CRetriableException has no cause: "
-                              << CurrentExceptionToString();
-                    BOOST_THROW_EXCEPTION(
-                        std::logic_error("CRetriableException without cause"));
-                }
-                // rethrow directly if CStorageException, otherwise wrap:
-                try {
-                    std::rethrow_exception(p_cause);
-                }
-                catch (CStorageException&) {
-                    LOG_ERROR << "Will rethrow cause exception: "
-                              << CurrentExceptionToString();
-                    throw;
-                }
-                catch (...) {
-                    LOG_ERROR << "Will wrap and rethrow cause exception: "
-                              << CurrentExceptionToString();
-                    BOOST_THROW_EXCEPTION(
-                        CStorageException("Invocation failure",
-                                          std::current_exception()));
-                }
-            }
+        } catch (...) {
+            std::chrono::milliseconds delay =
+                        HandleFailure(current_tries, std::current_exception());
+            Wait(current_tries, delay);
+            // and we'll try again
+        }
+    }
+}
 
-            LOG_DEBUG << "Catching a CRetriableException: "
-                    << current_tries << " out of " << nb_tries_max_
-                    << " attempts (cause=" << ExceptionPtrToString(rex.cause())
-                    << ")";
+pplx::task<void> RetryStrategy::InvokeRetryAsync(
+                            std::function<pplx::task<void>()> request_func) {
+    return InvokeRetryAsync(request_func, 1);
+}
 
-            Wait(current_tries, rex.delay());
-            // and we'll try again
-        } catch (const CStorageException&) {
-            throw;
+pplx::task<void> RetryStrategy::InvokeRetryAsync(
+                                std::function<pplx::task<void>()> request_func,
+                                int current_tries) {
+    if (current_tries > 1) {  // no need to log first attempt
+        LOG_DEBUG << "Invocation #" << current_tries << "/" << nb_tries_max_;
+    }
+    // request_func() is called in a continuation, so that exceptions it may
+    // throw synchronously are handled as task failures:
+    return pplx::task_from_result().then([request_func] {
+        return request_func();
+    }).then([this, request_func, current_tries](pplx::task<void> attempt)
+                                                        -> pplx::task<void> {
+        std::chrono::milliseconds delay;
+        try {
+            attempt.get();
+            return pplx::task_from_result();
         } catch (...) {
-            BOOST_THROW_EXCEPTION(CStorageException("Invocation failure",
-                                                    std::current_exception()));
+            delay = HandleFailure(current_tries, std::current_exception());
         }
-    }
+        return WaitAsync(current_tries, delay).then(
+                                        [this, request_func, current_tries] {
+            // and we'll try again
+            return InvokeRetryAsync(request_func, current_tries + 1);
+        });
+    });
 }
 
+std::chrono::milliseconds RetryStrategy::HandleFailure(
+                                                    int current_tries,
+                                                    std::exception_ptr p_ex) {
+    try {
+        std::rethrow_exception(p_ex);
+    } catch (const CRetriableException& rex) {
+        if (current_tries >= nb_tries_max_) {
+            LOG_WARN << "Aborting invocations after "
+                     <<  nb_tries_max_ << " failed attempts";
+            std::exception_ptr p_cause = rex.cause();
+            if (!p_cause) {
+                // This should never happen:
+                // every CRetriableException should have a cause exception
+                LOG_ERROR << "CRetriableException has no cause: "
+                          << CurrentExceptionToString();
+                BOOST_THROW_EXCEPTION(
+                    std::logic_error("CRetriableException without cause"));
+            }
+            // rethrow directly if CStorageException, otherwise wrap:
+            try {
+                std::rethrow_exception(p_cause);
+            }
+            catch (CStorageException&) {
+                LOG_ERROR << "Will rethrow cause exception: "
+                          << CurrentExceptionToString();
+                throw;
+            }
+            catch (...) {
+                LOG_ERROR << "Will wrap and rethrow cause exception: "
+                          << CurrentExceptionToString();
+                BOOST_THROW_EXCEPTION(
+                    CStorageException("Invocation failure",
+                                      std::current_exception()));
+            }
+        }
 
-void RetryStrategy::Wait(int current_tries,
-                         std::chrono::milliseconds opt_duration) {
+        LOG_DEBUG << "Catching a CRetriableException: "
+                << current_tries << " out of " << nb_tries_max_
+                << " attempts (cause=" << ExceptionPtrToString(rex.cause())
+                << ")";
+        return rex.delay();
+    } catch (const CStorageException&) {
+        throw;
+    } catch (...) {
+        BOOST_THROW_EXCEPTION(CStorageException("Invocation failure",
+                                                std::current_exception()));
+    }
+}
+
+std::chrono::milliseconds RetryStrategy::GetWaitDuration(
+                                    int current_tries,
+                                    std::chrono::milliseconds opt_duration) {
     if (opt_duration.count() < 0) {
         double r = utilities::Random() + 0.5;
         opt_duration = std::chrono::milliseconds(static_cast<int>(
                 first_sleep_ms_ * r * ((int64_t)1 << (current_tries-1))));
     }
+    return opt_duration;
+}
+
+void RetryStrategy::Wait(int current_tries,
+                         std::chrono::milliseconds opt_duration) {
+    opt_duration = GetWaitDuration(current_tries, opt_duration);
     LOG_DEBUG << "Will retry request after "
               << opt_duration.count() << " millis";
 
     std::this_thread::sleep_for(opt_duration);
 }
 
+pplx::task<void> RetryStrategy::WaitAsync(
+                                    int current_tries,
+                                    std::chrono::milliseconds opt_duration) {
+    opt_duration = GetWaitDuration(current_tries, opt_duration);
+    LOG_DEBUG << "Will retry request after "
+              << opt_duration.count() << " millis";
+
+    return utilities::CompleteAfter(opt_duration);
+}
+
 }  // namespace pcs_api
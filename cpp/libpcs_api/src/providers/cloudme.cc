@@ -48,6 +48,11 @@ static const char *kSoapHeader = "<SOAP-ENV:Envelope xmlns:"
                     "xmlns:xsd=\"http://www.w3.org/1999/XMLSchema\">"
                     "<SOAP-ENV:Body>";
 static const char *kSoapFooter = "</SOAP-ENV:Body></SOAP-ENV:Envelope>";
+/**
+ * Cached folders structure is reloaded after this delay
+ * (to see changes made by other clients).
+ */
+static const std::chrono::seconds kFoldersTreeTtl(30);
 
 StorageBuilder::create_provider_func CloudMe::GetCreateInstanceFunction() {
     return CloudMe::CreateInstance;
@@ -64,11 +69,16 @@ CloudMe::CloudMe(const StorageBuilder& builder) :
     StorageProvider{builder.provider_name(),
                     std::make_shared<PasswordSessionManager>(builder,
                                               web::uri(kBaseUrl).authority()),
-                    builder.retry_strategy()} {
+                    builder.retry_strategy()},
+    folders_tree_version_(0) {
 }
 
 void CloudMe::ThrowCStorageException(CResponse *p_response,
                                      const CPath* p_opt_path) {
+    // Error may be due to an outdated folders structure (folder deleted
+    // by another client...): it will be reloaded
+    InvalidateFoldersTree();
+
     /**
     * soap errors generates http 500 Internal server errors,
     * and body looks like :
@@ -191,7 +201,7 @@ void CloudMe::ValidateCloudMeApiResponse(CResponse *p_response,
 RequestInvoker CloudMe::GetBasicRequestInvoker(const CPath* p_path) {
     // Request execution is delegated to our session manager,
     // response validation is done here:
-    return RequestInvoker(std::bind(&PasswordSessionManager::Execute,
+    return RequestInvoker(std::bind(&PasswordSessionManager::ExecuteAsync,
                                     p_session_manager_.get(),
                                     std::placeholders::_1),  // do_request_func
                           std::bind(&CloudMe::ValidateCloudMeResponse,
@@ -211,7 +221,7 @@ RequestInvoker CloudMe::GetBasicRequestInvoker(const CPath* p_path) {
 RequestInvoker CloudMe::GetApiRequestInvoker(const CPath* p_opt_path) {
     // Request execution is delegated to our session manager,
     // response validation is done here:
-    return RequestInvoker(std::bind(&PasswordSessionManager::Execute,
+    return RequestInvoker(std::bind(&PasswordSessionManager::ExecuteAsync,
                                     p_session_manager_.get(),
                                     std::placeholders::_1),  // do_request_func
                           std::bind(&CloudMe::ValidateCloudMeApiResponse,
@@ -313,6 +323,124 @@ std::unique_ptr<CloudMe::CMFolder> CloudMe::LoadFoldersStructure() {
     return root_folder;
 }
 
+std::shared_ptr<const CloudMe::CMFolder> CloudMe::GetFoldersTree(
+                                                    unsigned int *p_version) {
+    std::promise<FoldersTreeSnapshot> promise;
+    std::shared_future<FoldersTreeSnapshot> loading;
+    bool loader = false;
+    unsigned int base_version = 0;
+    {
+        std::lock_guard<std::mutex> lock(folders_tree_mutex_);
+        if (p_folders_tree_
+                && std::chrono::steady_clock::now() < folders_tree_expiry_) {
+            if (p_version) {
+                *p_version = folders_tree_version_;
+            }
+            return p_folders_tree_;
+        }
+        if (!folders_tree_loading_.valid()) {
+            loader = true;
+            base_version = folders_tree_version_;
+            folders_tree_loading_ = promise.get_future().share();
+        }
+        loading = folders_tree_loading_;
+    }
+
+    if (loader) {
+        // Structure is loaded without holding lock (errors invalidate tree):
+        std::shared_ptr<const CMFolder> p_cm_root;
+        try {
+            p_cm_root = LoadFoldersStructure();
+        }
+        catch (...) {
+            {
+                std::lock_guard<std::mutex> lock(folders_tree_mutex_);
+                folders_tree_loading_ = std::shared_future<
+                                                    FoldersTreeSnapshot>();
+            }
+            promise.set_exception(std::current_exception());
+            throw;
+        }
+        FoldersTreeSnapshot snapshot(p_cm_root, base_version);
+        {
+            std::lock_guard<std::mutex> lock(folders_tree_mutex_);
+            folders_tree_loading_ = std::shared_future<FoldersTreeSnapshot>();
+            if (folders_tree_version_ == base_version) {
+                p_folders_tree_ = p_cm_root;
+                folders_tree_expiry_ = std::chrono::steady_clock::now()
+                                                            + kFoldersTreeTtl;
+                snapshot.second = ++folders_tree_version_;
+            } else {
+                // structure has been replaced meanwhile (by a modified copy
+                // holding changes of this client, or invalidated): loaded
+                // one is not cached
+                LOG_DEBUG << "Folders structure changed while loading: "
+                          << "loaded structure not cached";
+                if (p_folders_tree_) {
+                    snapshot = FoldersTreeSnapshot(p_folders_tree_,
+                                                   folders_tree_version_);
+                }
+                // otherwise current callers use loaded structure, with an
+                // outdated version so that copies of it are not published
+            }
+        }
+        promise.set_value(snapshot);
+    }
+
+    FoldersTreeSnapshot snapshot = loading.get();
+    if (p_version) {
+        *p_version = snapshot.second;
+    }
+    return snapshot.first;
+}
+
+std::unique_ptr<CloudMe::CMFolder> CloudMe::CloneFoldersTree(
+                                                    unsigned int *p_version) {
+    return std::unique_ptr<CMFolder>(new CMFolder(*GetFoldersTree(p_version)));
+}
+
+void CloudMe::PublishFoldersTree(std::unique_ptr<CMFolder> p_cm_root,
+                                 unsigned int base_version) {
+    std::lock_guard<std::mutex> lock(folders_tree_mutex_);
+    if (p_folders_tree_ && folders_tree_version_ == base_version) {
+        p_folders_tree_ = std::move(p_cm_root);
+    } else {
+        LOG_DEBUG << "Folders structure changed concurrently: invalidated";
+        p_folders_tree_.reset();
+    }
+    folders_tree_version_++;
+}
+
+void CloudMe::InvalidateFoldersTree() {
+    std::lock_guard<std::mutex> lock(folders_tree_mutex_);
+    if (p_folders_tree_) {
+        p_folders_tree_.reset();
+        folders_tree_version_++;
+    }
+}
+
+bool CloudMe::HasCachedFoldersTree() {
+    std::lock_guard<std::mutex> lock(folders_tree_mutex_);
+    return p_folders_tree_
+            && std::chrono::steady_clock::now() < folders_tree_expiry_;
+}
+
+template<class T>
+T CloudMe::WithFoldersTree(std::function<T()> func) {
+    if (!HasCachedFoldersTree()) {
+        return func();  // structure will be loaded now: up to date
+    }
+    try {
+        return func();
+    }
+    catch (const CFileNotFoundException&) {
+        LOG_DEBUG << "Outdated folders structure: "
+                  << CurrentExceptionToString();
+    }
+    InvalidateFoldersTree();
+    return func();
+}
+
 /**
  * Recursive method that parses folders XML and builds CMFolder structure.
  *
@@ -410,13 +538,19 @@ std::shared_ptr<CFolderContent> CloudMe::ListRootFolder() {
 
 /**
  * There are 3 main steps to list a folder :
- * 1 - generate the tree view of CloudMe storage
+ * 1 - get the (cached) tree view of CloudMe storage
  * 2 - list all the subfolders
  * 3 - list all the blobs
  */
 std::shared_ptr<CFolderContent> CloudMe::ListFolder(const CPath& path) {
+    return WithFoldersTree<std::shared_ptr<CFolderContent>>([this, &path] {
+        return TryListFolder(path);
+    });
+}
+
+std::shared_ptr<CFolderContent> CloudMe::TryListFolder(const CPath& path) {
     // 1
-    std::unique_ptr<CMFolder> cm_root = LoadFoldersStructure();
+    std::shared_ptr<const CMFolder> cm_root = GetFoldersTree();
     const CMFolder* p_cm_folder = cm_root->GetFolder(path);
 
     if (p_cm_folder == nullptr) {
@@ -458,11 +592,18 @@ std::shared_ptr<CFolderContent> CloudMe::ListFolder(const CFolder& folder) {
 }
 
 bool CloudMe::CreateFolder(const CPath& path) {
+    return WithFoldersTree<bool>([this, &path] {
+        return TryCreateFolder(path);
+    });
+}
+
+bool CloudMe::TryCreateFolder(const CPath& path) {
     if (path.IsRoot()) {
         return false;
     }
 
-    std::unique_ptr<CMFolder> cm_root = LoadFoldersStructure();
+    unsigned int version;
+    std::unique_ptr<CMFolder> cm_root = CloneFoldersTree(&version);
     const CMFolder *p_cm_folder = cm_root->GetFolder(path);
     if (p_cm_folder) {
         // folder already exists
@@ -470,6 +611,7 @@ bool CloudMe::CreateFolder(const CPath& path) {
     }
 
     CreateIntermediateFolders(cm_root.get(), path);
+    PublishFoldersTree(std::move(cm_root), version);
     return true;
 }
 
@@ -526,7 +668,9 @@ CloudMe::CMFolder* CloudMe::RawCreateFolder(CMFolder *p_cm_parent_folder,
     inner_xml << "<childFolder>"
               << utilities::EscapeXml(base_name)
               << "</childFolder>";
-    RequestInvoker ri = GetApiRequestInvoker();
+    // parent folder may have been deleted:
+    CPath parent_path = p_cm_parent_folder->GetPath();
+    RequestInvoker ri = GetApiRequestInvoker(&parent_path);
     std::shared_ptr<CResponse> p_response;
     p_retry_strategy_->InvokeRetry([&] {
         web::http::http_request request = BuildSoapRequest("newFolder",
@@ -542,19 +686,29 @@ CloudMe::CMFolder* CloudMe::RawCreateFolder(CMFolder *p_cm_parent_folder,
 }
 
 bool CloudMe::Delete(const CPath& path) {
+    return WithFoldersTree<bool>([this, &path] {
+        return TryDelete(path);
+    });
+}
+
+bool CloudMe::TryDelete(const CPath& path) {
     if (path.IsRoot()) {
         BOOST_THROW_EXCEPTION(CStorageException("Can't delete root folder"));
     }
 
-    std::unique_ptr<CMFolder> p_cm_root = LoadFoldersStructure();
-    CMFolder* p_cm_parent_folder = p_cm_root->GetFolder(path.GetParent());
+    unsigned int version;
+    std::shared_ptr<const CMFolder> p_cm_root = GetFoldersTree(&version);
+    const CMFolder* p_cm_parent_folder = p_cm_root->GetFolder(
+                                                            path.GetParent());
     if (!p_cm_parent_folder) {
         // parent folder of given path does exist => path does not exist
         return false;
     }
 
-    CMFolder* p_cm_folder = p_cm_parent_folder->GetChildByName(
-                      utility::conversions::to_utf8string(path.GetBaseName()));
+    const std::string base_name_utf8 =
+                    utility::conversions::to_utf8string(path.GetBaseName());
+    const CMFolder* p_cm_folder = p_cm_parent_folder->GetChildByName(
+                                                            base_name_utf8);
     if (p_cm_folder) {
         // We have to delete a folder
         std::ostringstream inner_xml;
@@ -570,12 +724,19 @@ bool CloudMe::Delete(const CPath& path) {
         boost::property_tree::ptree dom = p_response->AsDom();
         std::string result = dom.get<std::string>(
                 "SOAP-ENV:Envelope.SOAP-ENV:Body.xcr:deleteFolderResponse");
-        return boost::iequals(boost::algorithm::trim_copy(result), "ok");
+        if (!boost::iequals(boost::algorithm::trim_copy(result), "ok")) {
+            return false;
+        }
+        // Deleted folder is removed from a copy of the snapshot we used:
+        std::unique_ptr<CMFolder> p_new_root(new CMFolder(*p_cm_root));
+        p_new_root->GetFolder(path.GetParent())->RemoveChild(base_name_utf8);
+        PublishFoldersTree(std::move(p_new_root), version);
+        return true;
 
     } else {
         // It's not a folder, it should be a blob...
         std::unique_ptr<CMBlob> p_cm_blob = GetBlobByName(p_cm_parent_folder,
-                      utility::conversions::to_utf8string(path.GetBaseName()));
+                                                          base_name_utf8);
         if (!p_cm_blob) {
             // The blob does not exist... nothing to do
             return false;
@@ -603,8 +764,14 @@ const string_t CloudMe::BuildRestUrl(const string_t& method_path) const {
 }
 
 std::shared_ptr<CFile> CloudMe::GetFile(const CPath& path) {
-    std::unique_ptr<CMFolder> cm_root = LoadFoldersStructure();
-    CMFolder* p_cm_parent_folder = cm_root->GetFolder(path.GetParent());
+    return WithFoldersTree<std::shared_ptr<CFile>>([this, &path] {
+        return TryGetFile(path);
+    });
+}
+
+std::shared_ptr<CFile> CloudMe::TryGetFile(const CPath& path) {
+    std::shared_ptr<const CMFolder> cm_root = GetFoldersTree();
+    const CMFolder* p_cm_parent_folder = cm_root->GetFolder(path.GetParent());
 
     if (!p_cm_parent_folder) {
         // parent folder of given path does exist => path does not exist
@@ -630,19 +797,27 @@ std::shared_ptr<CFile> CloudMe::GetFile(const CPath& path) {
 }
 
 void CloudMe::Download(const CDownloadRequest& download_request) {
+    WithFoldersTree<void>([this, &download_request] {
+        TryDownload(download_request);
+    });
+}
+
+void CloudMe::TryDownload(const CDownloadRequest& download_request) {
     const CPath& path = download_request.path();
     const std::string base_name_utf8 =
         utility::conversions::to_utf8string(path.GetBaseName());
 
-    std::unique_ptr<CMFolder> p_cm_root = LoadFoldersStructure();
-    CMFolder* p_cm_parent_folder = p_cm_root->GetFolder(path.GetParent());
+    std::shared_ptr<const CMFolder> p_cm_root = GetFoldersTree();
+    const CMFolder* p_cm_parent_folder = p_cm_root->GetFolder(
+                                                            path.GetParent());
     if (!p_cm_parent_folder) {
         // parent folder of given path does exist => file does not exist
         BOOST_THROW_EXCEPTION(CFileNotFoundException("This file does not exist",
                                                      path));
     }
 
-    CMFolder* p_cm_folder = p_cm_parent_folder->GetChildByName(base_name_utf8);
+    const CMFolder* p_cm_folder =
+                            p_cm_parent_folder->GetChildByName(base_name_utf8);
     if (p_cm_folder) {
         // the path corresponds to a folder
         BOOST_THROW_EXCEPTION(CInvalidFileTypeException(path, true));
@@ -672,36 +847,49 @@ void CloudMe::Download(const CDownloadRequest& download_request) {
         }
         p_response = ri.Invoke(request);
         std::shared_ptr<ByteSink> p_byte_sink = download_request.GetByteSink();
-        p_response->DownloadDataToSink(p_byte_sink.get());
+        p_response->DownloadDataToSink(p_byte_sink.get(),
+                                       download_request.chunk_size());
     });
 }
 
 void CloudMe::Upload(const CUploadRequest& upload_request) {
+    WithFoldersTree<void>([this, &upload_request] {
+        TryUpload(upload_request);
+    });
+}
+
+void CloudMe::TryUpload(const CUploadRequest& upload_request) {
     const CPath& path = upload_request.path();
     std::string base_name_utf8 =
             utility::conversions::to_utf8string(path.GetBaseName());
 
-    std::unique_ptr<CMFolder> p_cm_root = LoadFoldersStructure();
-    CMFolder* p_cm_parent_folder = p_cm_root->GetFolder(path.GetParent());
+    unsigned int version;
+    std::shared_ptr<const CMFolder> p_cm_root = GetFoldersTree(&version);
+    const CMFolder* p_cm_parent_folder = p_cm_root->GetFolder(
+                                                            path.GetParent());
+    std::string parent_id;
     if (!p_cm_parent_folder) {
         // parent folder of given path does not exist =>
-        // folders needs to be created
-        p_cm_parent_folder = CreateIntermediateFolders(p_cm_root.get(),
-                                                       path.GetParent());
+        // folders needs to be created (in a copy of folders structure)
+        std::unique_ptr<CMFolder> p_new_root(new CMFolder(*p_cm_root));
+        parent_id = CreateIntermediateFolders(p_new_root.get(),
+                                              path.GetParent())->id();
+        PublishFoldersTree(std::move(p_new_root), version);
     } else {
         // parent folder already exists:
         // check if a folder exists with same name
-        CMFolder* p_cm_folder = p_cm_parent_folder->
+        const CMFolder* p_cm_folder = p_cm_parent_folder->
                                     GetChildByName(base_name_utf8);
         if (p_cm_folder) {
             // The CPath corresponds to an existing folder,
             // upload is not possible
             BOOST_THROW_EXCEPTION(CInvalidFileTypeException(path, true));
         }
+        parent_id = p_cm_parent_folder->id();
     }
 
     string_t url = BuildRestUrl(U("documents"))
-            + utility::conversions::to_string_t(p_cm_parent_folder->id());
+            + utility::conversions::to_string_t(parent_id);
     web::uri uri(url);
     p_retry_strategy_->InvokeRetry([&] {
         web::http::http_request request(web::http::methods::POST);
@@ -750,6 +938,15 @@ CloudMe::CMFolder::CMFolder(const CMFolder *p_parent,
     p_parent_{p_parent}, id_(id), name_(name) {
 }
 
+CloudMe::CMFolder::CMFolder(const CMFolder& other) :
+    p_parent_{other.p_parent_}, id_(other.id_), name_(other.name_),
+    children_(other.children_) {
+    // copied children still refer to other as parent:
+    for (auto& child : children_) {
+        child.second.p_parent_ = this;
+    }
+}
+
 const std::shared_ptr<CFolder> CloudMe::CMFolder::ToCFolder() const {
     return std::make_shared<CFolder>(GetPath(),
                                      boost::posix_time::not_a_date_time);
@@ -782,14 +979,24 @@ CloudMe::CMFolder* CloudMe::CMFolder::AddChild(const std::string& id,
 }
 
 
+void CloudMe::CMFolder::RemoveChild(const std::string& name) {
+    children_.erase(name);
+}
+
 CloudMe::CMFolder* CloudMe::CMFolder::GetFolder(const CPath& path) {
+    return const_cast<CMFolder*>(
+                        static_cast<const CMFolder*>(this)->GetFolder(path));
+}
+
+const CloudMe::CMFolder* CloudMe::CMFolder::GetFolder(
+                                                const CPath& path) const {
     if (path.IsRoot()) {
         return this;
     }
     std::vector<string_t> base_names = path.Split();
 
-    CMFolder *p_current_folder = this;
-    CMFolder *p_sub_folder = nullptr;
+    const CMFolder *p_current_folder = this;
+    const CMFolder *p_sub_folder = nullptr;
 
     for (string_t base_name : base_names) {
         p_sub_folder = p_current_folder->
@@ -804,6 +1011,12 @@ CloudMe::CMFolder* CloudMe::CMFolder::GetFolder(const CPath& path) {
 }
 
 CloudMe::CMFolder* CloudMe::CMFolder::GetChildByName(const std::string& name) {
+    return const_cast<CMFolder*>(
+                    static_cast<const CMFolder*>(this)->GetChildByName(name));
+}
+
+const CloudMe::CMFolder* CloudMe::CMFolder::GetChildByName(
+                                            const std::string& name) const {
     auto it = children_.find(name);
     if (it != children_.end()) {
         return &it->second;
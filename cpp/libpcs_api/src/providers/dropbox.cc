@@ -14,6 +14,9 @@
  * limitations under the License.
  */
 
+#include <algorithm>
+#include <chrono>
+
 #include "boost/date_time/posix_time/posix_time_io.hpp"
 
 #include "cpprest/json.h"
@@ -31,6 +34,7 @@
 #include "pcs_api/internal/utilities.h"
 #include "pcs_api/internal/form_body_builder.h"
 #include "pcs_api/internal/logger.h"
+#include "pcs_api/internal/range_byte_source.h"
 
 namespace pcs_api {
 
@@ -39,6 +43,48 @@ const char* Dropbox::kProviderName = "dropbox";
 static const char_t * kEndPoint = U("https://api.dropbox.com/1");
 static const char_t * kContentEndPoint = U("https://api-content.dropbox.com/1");
 static const char_t * kMetadata = U("metadata");
+/**
+ * Blobs larger than this are uploaded in chunks (chunked_upload API),
+ * unless set by StorageBuilder::dropbox_chunked_upload().
+ */
+static const int64_t kChunkedUploadThreshold = 8 * 1024 * 1024;
+/**
+ * Default size of first chunk; next chunks sizes adapt to throughput.
+ */
+static const int64_t kDefaultUploadChunkSize = 4 * 1024 * 1024;
+static const int64_t kMinUploadChunkSize = 512 * 1024;
+static const int64_t kMaxUploadChunkSize = 64 * 1024 * 1024;
+/**
+ * Chunks uploaded faster than this (at first try) make next chunk larger.
+ */
+static const std::chrono::seconds kChunkTargetDuration(10);
+
+/**
+ * \brief State of a chunked upload: chunks are sent one after the other.
+ */
+struct Dropbox::ChunkedUpload {
+    CPath path;
+    std::shared_ptr<ByteSource> p_source;
+    std::shared_ptr<ProgressListener> p_listener;
+    int64_t length;
+    string_t upload_id;  // empty until first chunk is acknowledged
+    int64_t offset;  // number of bytes acknowledged by server
+    int64_t chunk_size;  // size of next chunk
+    int tries;  // number of tries of current chunk
+    std::chrono::steady_clock::time_point chunk_start;  // of current try
+    bool autorename;  // false if commit must fail in case of conflict
+    // receives committed blob (if not null):
+    std::shared_ptr<std::shared_ptr<CBlob>> p_blob;
+
+    explicit ChunkedUpload(const CPath& upload_path)
+        : path(upload_path),
+          length(0),
+          offset(0),
+          chunk_size(0),
+          tries(0),
+          autorename(true) {
+    }
+};
 
 StorageBuilder::create_provider_func Dropbox::GetCreateInstanceFunction() {
     return Dropbox::CreateInstance;
@@ -62,7 +108,15 @@ Dropbox::Dropbox(const StorageBuilder& builder) :
                             false,  // scope_in_authorization,
                             ' ',  // scope_perms_separator (not used))
                             builder),
-                    builder.retry_strategy()) {
+                    builder.retry_strategy()),
+    optimistic_uploads_(builder.optimistic_uploads()),
+    chunked_upload_threshold_(builder.dropbox_upload_chunk_size() > 0 ?
+                        builder.dropbox_chunked_upload_threshold() :
+                        kChunkedUploadThreshold),
+    upload_chunk_size_(builder.dropbox_upload_chunk_size() > 0 ?
+                        builder.dropbox_upload_chunk_size() :
+                        kDefaultUploadChunkSize),
+    content_end_point_(kContentEndPoint) {
     std::vector<std::string> perms = p_session_manager_->app_info().scope();
     if (perms.empty()) {
         BOOST_THROW_EXCEPTION(
@@ -141,6 +195,20 @@ void Dropbox::ValidateDropboxResponse(CResponse *p_response,
     // OK, response looks fine
 }
 
+/**
+ * \brief Validate a response of chunked_upload.
+ *
+ * In case of offset mismatch, server answers 400 with a json body holding
+ * the expected offset: such responses are checked by caller.
+ */
+void Dropbox::ValidateChunkedUploadResponse(CResponse *p_response,
+                                            const CPath* p_opt_path) {
+    if (p_response->status() == 400 && p_response->IsJsonContentType()) {
+        return;
+    }
+    ValidateDropboxApiResponse(p_response, p_opt_path);
+}
+
 
 /**
  * \brief An invoker that checks response content type = json:
@@ -152,7 +220,7 @@ void Dropbox::ValidateDropboxResponse(CResponse *p_response,
 RequestInvoker Dropbox::GetApiRequestInvoker(const CPath* p_opt_path) {
     // Request execution is delegated to our session manager,
     // response validation is done here:
-    return RequestInvoker(std::bind(&OAuth2SessionManager::Execute,
+    return RequestInvoker(std::bind(&OAuth2SessionManager::ExecuteAsync,
                                     p_session_manager_.get(),
                                     std::placeholders::_1),  // do_request_func
                           std::bind(&Dropbox::ValidateDropboxApiResponse,
@@ -172,7 +240,7 @@ RequestInvoker Dropbox::GetApiRequestInvoker(const CPath* p_opt_path) {
 RequestInvoker Dropbox::GetRequestInvoker(const CPath* p_path) {
     // Request execution is delegated to our session manager,
     // response validation is done here:
-    return RequestInvoker(std::bind(&OAuth2SessionManager::Execute,
+    return RequestInvoker(std::bind(&OAuth2SessionManager::ExecuteAsync,
                                     p_session_manager_.get(),
                                     std::placeholders::_1),  // do_request_func
                           std::bind(&Dropbox::ValidateDropboxResponse,
@@ -182,6 +250,17 @@ RequestInvoker Dropbox::GetRequestInvoker(const CPath* p_path) {
                           p_path);
 }
 
+RequestInvoker Dropbox::GetChunkedUploadRequestInvoker(const CPath* p_path) {
+    return RequestInvoker(std::bind(&OAuth2SessionManager::ExecuteAsync,
+                                    p_session_manager_.get(),
+                                    std::placeholders::_1),  // do_request_func
+                          std::bind(&Dropbox::ValidateChunkedUploadResponse,
+                                    this,
+                                    std::placeholders::_1,
+                                    std::placeholders::_2),  // validate_func
+                          p_path);
+}
+
 const web::json::value Dropbox::GetAccount() {
     web::uri_builder builder(kEndPoint);
     builder.append_path(U("/account/info"));
@@ -243,7 +322,7 @@ string_t Dropbox::BuildFileUrl(const string_t& method_path, const CPath& path) {
 }
 
 string_t Dropbox::BuildContentUrl(string_t method_path, CPath path) {
-    string_t url = BuildUrl(kContentEndPoint, method_path);
+    string_t url = BuildUrl(content_end_point_, method_path);
     AddPathToUrl(&url, path);
     return url;
 }
@@ -253,44 +332,58 @@ std::shared_ptr<CFolderContent> Dropbox::ListRootFolder() {
 }
 
 std::shared_ptr<CFolderContent> Dropbox::ListFolder(const CPath& path) {
+    return ListFolderAsync(path).get();
+}
+
+pplx::task<std::shared_ptr<CFolderContent>> Dropbox::ListFolderAsync(
+                                                        const CPath& path) {
     string_t url = BuildFileUrl(kMetadata, path);
 
     RequestInvoker ri = GetApiRequestInvoker(&path);
-    std::shared_ptr<CResponse> p_response;
-    try {
-        p_retry_strategy_->InvokeRetry([&] {
-            web::http::http_request request(web::http::methods::GET);
-            request.set_request_uri(url);
-            p_response = ri.Invoke(request);
-        });
-    } catch (CFileNotFoundException&) {
-        // Non existing folder
-        return std::shared_ptr<CFolderContent>();
-    }
-
-    web::json::value jvalue = p_response->AsJson();
-    web::json::object& j_object = jvalue.as_object();
-    auto it = j_object.find(U("is_deleted"));
-    if (it != j_object.end() && it->second.as_bool()) {
-        // File is logically deleted
-        return std::shared_ptr<CFolderContent>();
-    }
-    it = j_object.find(U("is_dir"));
-    if (it == j_object.end()) {
-        p_response->ThrowCStorageException("No 'is_dir' key in JSON metadata",
-                                           &path);
-    }
-    if (!it->second.as_bool()) {
-        BOOST_THROW_EXCEPTION(CInvalidFileTypeException(path, false));
-    }
+    return utilities::InvokeRetryAsync<std::shared_ptr<CResponse>>(
+                                            p_retry_strategy_.get(),
+                                            [ri, url] {
+        web::http::http_request request(web::http::methods::GET);
+        request.set_request_uri(url);
+        return ri.InvokeAsync(request);
+    }).then([this, path](pplx::task<std::shared_ptr<CResponse>> list_task)
+                            -> pplx::task<std::shared_ptr<CFolderContent>> {
+        std::shared_ptr<CResponse> p_response;
+        try {
+            p_response = list_task.get();
+        } catch (CFileNotFoundException&) {
+            // Non existing folder
+            return pplx::task_from_result(std::shared_ptr<CFolderContent>());
+        }
+        return p_response->AsJsonAsync().then([this, path, p_response](
+                                                    web::json::value jvalue)
+                                        -> std::shared_ptr<CFolderContent> {
+            web::json::object& j_object = jvalue.as_object();
+            auto it = j_object.find(U("is_deleted"));
+            if (it != j_object.end() && it->second.as_bool()) {
+                // File is logically deleted
+                return std::shared_ptr<CFolderContent>();
+            }
+            it = j_object.find(U("is_dir"));
+            if (it == j_object.end()) {
+                p_response->ThrowCStorageException(
+                                            "No 'is_dir' key in JSON metadata",
+                                            &path);
+            }
+            if (!it->second.as_bool()) {
+                BOOST_THROW_EXCEPTION(CInvalidFileTypeException(path, false));
+            }
 
-    CFolderContentBuilder cfcb;
-    const web::json::array content = j_object.at(U("contents")).as_array();
-    for (auto ait = content.cbegin() ; ait != content.cend() ; ++ait) {
-        std::shared_ptr<CFile> p_cfile = ParseCFile(ait->as_object());
-        cfcb.Add(p_cfile->path(), p_cfile);
-    }
-    return cfcb.BuildFolderContent();
+            CFolderContentBuilder cfcb;
+            const web::json::array content =
+                                        j_object.at(U("contents")).as_array();
+            for (auto ait = content.cbegin() ; ait != content.cend() ; ++ait) {
+                std::shared_ptr<CFile> p_cfile = ParseCFile(ait->as_object());
+                cfcb.Add(p_cfile->path(), p_cfile);
+            }
+            return cfcb.BuildFolderContent();
+        });
+    });
 }
 
 static boost::posix_time::ptime ParseDateTime(const std::string& date_string) {
@@ -329,26 +422,111 @@ std::shared_ptr<CFolderContent> Dropbox::ListFolder(const CFolder& folder) {
     return ListFolder(folder.path());
 }
 
-bool Dropbox::CreateFolder(const CPath& path) {
+bool Dropbox::ListRecursive(const CPath& path, file_callback callback) {
+    std::shared_ptr<CFile> p_file = GetFile(path);
+    if (!p_file) {
+        return false;
+    }
+    if (p_file->IsBlob()) {
+        BOOST_THROW_EXCEPTION(CInvalidFileTypeException(path, false));
+    }
+
     RequestInvoker ri = GetApiRequestInvoker(&path);
-    std::shared_ptr<CResponse> p_response;
-    try {
+    string_t cursor;
+    bool has_more;
+    do {
+        std::shared_ptr<CResponse> p_response;
         p_retry_strategy_->InvokeRetry([&] {
-            string_t url = BuildApiUrl(U("fileops/create_folder"));
             web::http::http_request request(web::http::methods::POST);
-            request.set_request_uri(url);
+            request.set_request_uri(BuildApiUrl(U("delta")));
             FormBodyBuilder fbb;
-            fbb.AddParameter(U("root"), scope_);
-            fbb.AddParameter(U("path"), path.path_name());
+            if (!cursor.empty()) {
+                fbb.AddParameter(U("cursor"), cursor);
+            }
+            if (!path.IsRoot()) {
+                fbb.AddParameter(U("path_prefix"), path.path_name());
+            }
             request.set_body(fbb.Build());
             request.headers().set_content_type(fbb.ContentType());
             p_response = ri.Invoke(request);
         });
-        return true;
-    } catch (CHttpException& e) {
-        if (e.status() == 403) {
-            // object already exists, check if real folder or blob:
-            std::shared_ptr<CFile> p_file = GetFile(path);
+        web::json::value json = p_response->AsJson();
+        const web::json::array& entries = json.at(U("entries")).as_array();
+        for (auto it = entries.cbegin(); it != entries.cend(); ++it) {
+            // each entry is [lower_path, metadata]:
+            const web::json::value& metadata = it->at(1);
+            if (metadata.is_null()) {  // deleted file
+                continue;
+            }
+            std::shared_ptr<CFile> p_cfile = ParseCFile(metadata.as_object());
+            // path_prefix folder itself is listed (maybe with another
+            // case): files below it have longer paths
+            if (!path.IsRoot() && p_cfile->path().path_name().length()
+                                        <= path.path_name().length()) {
+                continue;
+            }
+            callback(p_cfile);
+        }
+        cursor = json.at(U("cursor")).as_string();
+        has_more = JsonForKey(json, U("has_more"), false);
+    } while (has_more);
+    return true;
+}
+
+bool Dropbox::CreateFolder(const CPath& path) {
+    return CreateFolderAsync(path).get();
+}
+
+std::shared_ptr<CFolder> Dropbox::CreateFolderAndGet(const CPath& path) {
+    std::shared_ptr<std::shared_ptr<CFolder>> p_folder =
+                                std::make_shared<std::shared_ptr<CFolder>>();
+    CreateFolderAsync(path, p_folder).get();
+    return *p_folder;
+}
+
+pplx::task<bool> Dropbox::CreateFolderAsync(const CPath& path) {
+    return CreateFolderAsync(path, nullptr);
+}
+
+pplx::task<bool> Dropbox::CreateFolderAsync(
+                        const CPath& path,
+                        std::shared_ptr<std::shared_ptr<CFolder>> p_folder) {
+    RequestInvoker ri = GetApiRequestInvoker(&path);
+    return p_retry_strategy_->InvokeRetryAsync([this, ri, path, p_folder] {
+        string_t url = BuildApiUrl(U("fileops/create_folder"));
+        web::http::http_request request(web::http::methods::POST);
+        request.set_request_uri(url);
+        FormBodyBuilder fbb;
+        fbb.AddParameter(U("root"), scope_);
+        fbb.AddParameter(U("path"), path.path_name());
+        request.set_body(fbb.Build());
+        request.headers().set_content_type(fbb.ContentType());
+        return ri.InvokeAsync(request).then([this, p_folder](
+                    std::shared_ptr<CResponse> p_response) -> pplx::task<void> {
+            if (!p_folder) {
+                // we are not interested in response body
+                return pplx::task_from_result();
+            }
+            return p_response->AsJsonAsync().then([this, p_folder](
+                                            const web::json::value& json) {
+                *p_folder = std::static_pointer_cast<CFolder>(
+                                                ParseCFile(json.as_object()));
+            });
+        });
+    }).then([this, path, p_folder](pplx::task<void> create_task)
+                                                        -> pplx::task<bool> {
+        try {
+            create_task.get();
+            return pplx::task_from_result(true);
+        } catch (CHttpException& e) {
+            if (e.status() != 403) {
+                // Other http exception:
+                throw;
+            }
+        }
+        // object already exists, check if real folder or blob:
+        return GetFileAsync(path).then([path, p_folder](
+                                        std::shared_ptr<CFile> p_file) -> bool {
             if (!p_file) {  // should not happen, as a file exists; but in case
                 LOG_ERROR << "Could not determine existing file type at path "
                           << path;
@@ -358,131 +536,388 @@ bool Dropbox::CreateFolder(const CPath& path) {
                 BOOST_THROW_EXCEPTION(CInvalidFileTypeException(path, false));
             }
             // Already existing folder
+            if (p_folder) {
+                *p_folder = std::static_pointer_cast<CFolder>(p_file);
+            }
             return false;
-        }
-        // Other http exception:
-        throw;
-    }
+        });
+    });
 }
 
 bool Dropbox::Delete(const CPath& path) {
-    RequestInvoker ri = GetApiRequestInvoker(&path);
-    std::shared_ptr<CResponse> p_response;
-    try {
-        p_retry_strategy_->InvokeRetry([&] {
-            string_t url = BuildApiUrl(U("fileops/delete"));
-            web::uri uri = web::uri_builder(url).to_uri();
-            web::http::http_request request(web::http::methods::POST);
-            request.set_request_uri(uri);
-            FormBodyBuilder fbb;
-            fbb.AddParameter(U("root"), scope_);
-            fbb.AddParameter(U("path"), path.path_name());
-            request.set_body(fbb.Build());
-            request.headers().set_content_type(fbb.ContentType());
+    return DeleteAsync(path).get();
+}
 
-            p_response = ri.Invoke(request);
+pplx::task<bool> Dropbox::DeleteAsync(const CPath& path) {
+    RequestInvoker ri = GetApiRequestInvoker(&path);
+    return p_retry_strategy_->InvokeRetryAsync([this, ri, path] {
+        string_t url = BuildApiUrl(U("fileops/delete"));
+        web::uri uri = web::uri_builder(url).to_uri();
+        web::http::http_request request(web::http::methods::POST);
+        request.set_request_uri(uri);
+        FormBodyBuilder fbb;
+        fbb.AddParameter(U("root"), scope_);
+        fbb.AddParameter(U("path"), path.path_name());
+        request.set_body(fbb.Build());
+        request.headers().set_content_type(fbb.ContentType());
+
+        return ri.InvokeAsync(request).then(
+                                    [](std::shared_ptr<CResponse> p_response) {
+            // we are not interested in response body
         });
-        return true;
-    } catch (CFileNotFoundException e) {
-        // Non existing file
-        return false;
-    }
+    }).then([](pplx::task<void> delete_task) -> bool {
+        try {
+            delete_task.get();
+            return true;
+        } catch (CFileNotFoundException&) {
+            // Non existing file
+            return false;
+        }
+    });
 }
 
 std::shared_ptr<CFile> Dropbox::GetFile(const CPath& path) {
-    std::shared_ptr<CFile> p_no_file;
+    return GetFileAsync(path).get();
+}
 
+pplx::task<std::shared_ptr<CFile>> Dropbox::GetFileAsync(const CPath& path) {
     RequestInvoker ri = GetApiRequestInvoker(&path);
-    std::shared_ptr<CResponse> p_response;
-    try {
-        p_retry_strategy_->InvokeRetry([&] {
-            string_t url = BuildFileUrl(kMetadata, path);
-            web::uri uri = web::uri_builder(url)
-                                .append_query(U("list"),
-                                              U("false")).to_uri();
-            web::http::http_request request(web::http::methods::GET);
-            request.set_request_uri(uri);
-            p_response = ri.Invoke(request);
+    return utilities::InvokeRetryAsync<std::shared_ptr<CResponse>>(
+                                            p_retry_strategy_.get(),
+                                            [this, ri, path] {
+        string_t url = BuildFileUrl(kMetadata, path);
+        web::uri uri = web::uri_builder(url)
+                            .append_query(U("list"),
+                                          U("false")).to_uri();
+        web::http::http_request request(web::http::methods::GET);
+        request.set_request_uri(uri);
+        return ri.InvokeAsync(request);
+    }).then([this, path](pplx::task<std::shared_ptr<CResponse>> get_task)
+                                    -> pplx::task<std::shared_ptr<CFile>> {
+        std::shared_ptr<CFile> p_no_file;
+        std::shared_ptr<CResponse> p_response;
+        try {
+            p_response = get_task.get();
+        } catch (CFileNotFoundException&) {
+            return pplx::task_from_result(p_no_file);
+        }
+        return p_response->AsJsonAsync().then([this, path, p_no_file](
+                                                    web::json::value json)
+                                                -> std::shared_ptr<CFile> {
+            if (JsonForKey(json, U("is_deleted"), false)) {
+                // File is logically deleted
+                LOG_DEBUG << "CFile " << path <<" is deleted";
+                return p_no_file;
+            }
+            return ParseCFile(json.as_object());
         });
-    } catch (CFileNotFoundException&) {
-        return p_no_file;
-    }
-    web::json::value json = p_response->AsJson();
-    if (JsonForKey(json, U("is_deleted"), false)) {
-        // File is logically deleted
-        LOG_DEBUG << "CFile " << path <<" is deleted";
-        return p_no_file;
-    }
-
-    return ParseCFile(json.as_object());
+    });
 }
 
 void Dropbox::Download(const CDownloadRequest& download_request) {
+    DownloadAsync(download_request).get();
+}
+
+pplx::task<void> Dropbox::DownloadAsync(
+                                    const CDownloadRequest& download_request) {
     CPath path = download_request.path();
     RequestInvoker ri = GetRequestInvoker(&path);
-    std::shared_ptr<CResponse> p_response;
-    try {
-        p_retry_strategy_->InvokeRetry([&] {
-            string_t url = BuildContentUrl(U("files"), download_request.path());
-            web::uri uri = web::uri_builder(url).to_uri();
-            web::http::http_request request(web::http::methods::GET);
-            request.set_request_uri(uri);
-            for (std::pair<string_t, string_t> header :
-                                            download_request.GetHttpHeaders()) {
-                request.headers().add(header.first, header.second);
-            }
-            p_response = ri.Invoke(request);
-            std::shared_ptr<ByteSink> p_byte_sink =
-                                                download_request.GetByteSink();
-            p_response->DownloadDataToSink(p_byte_sink.get());
+    return p_retry_strategy_->InvokeRetryAsync([this, ri, download_request] {
+        string_t url = BuildContentUrl(U("files"), download_request.path());
+        web::uri uri = web::uri_builder(url).to_uri();
+        // Sink may hold bytes of a previous attempt: then we only request
+        // the remaining ones
+        std::shared_ptr<ByteSink> p_byte_sink = download_request.GetByteSink();
+        int64_t resume_offset;
+        web::http::http_request request(web::http::methods::GET);
+        request.set_request_uri(uri);
+        for (std::pair<string_t, string_t> header :
+                download_request.GetHttpHeaders(*p_byte_sink, &resume_offset)) {
+            request.headers().add(header.first, header.second);
+        }
+        return ri.InvokeAsync(request).then([download_request, p_byte_sink,
+                                             resume_offset](
+                                    std::shared_ptr<CResponse> p_response) {
+            return p_response->DownloadDataToSinkAsync(
+                                            p_byte_sink,
+                                            download_request.chunk_size(),
+                                            resume_offset,
+                                            download_request.IsPartial());
         });
-    } catch (CFileNotFoundException e) {
+    }).then([this, path](pplx::task<void> download_task) -> pplx::task<void> {
+        std::exception_ptr p_not_found;
+        try {
+            download_task.get();
+            return pplx::task_from_result();
+        } catch (CFileNotFoundException&) {
+            p_not_found = std::current_exception();
+        }
         // We have to distinguish here between "nothing exists at that path",
         // and "a folder exists at that path" :
-        std::shared_ptr<CFile> p_file = GetFile(path);
-        if (!p_file) {
-            throw;
-        }
+        return GetFileAsync(path).then([p_not_found](
+                                            std::shared_ptr<CFile> p_file) {
+            if (!p_file) {
+                std::rethrow_exception(p_not_found);
+            }
 
-        if (p_file->IsFolder()) {
-            BOOST_THROW_EXCEPTION(
+            if (p_file->IsFolder()) {
+                BOOST_THROW_EXCEPTION(
                             CInvalidFileTypeException(p_file->path(), true));
-        }
-        // Should not happen : a file exists but can not be downloaded ?!
-        BOOST_THROW_EXCEPTION(
-            CStorageException(std::string("Not downloadable blob: ")
-                                + p_file->ToString()));
-    }
+            }
+            // Should not happen : a file exists but can not be downloaded ?!
+            BOOST_THROW_EXCEPTION(
+                CStorageException(std::string("Not downloadable blob: ")
+                                    + p_file->ToString()));
+        });
+    });
 }
 
 void Dropbox::Upload(const CUploadRequest& upload_request) {
+    UploadAsync(upload_request).get();
+}
+
+std::shared_ptr<CBlob> Dropbox::UploadAndGetBlob(
+                                        const CUploadRequest& upload_request) {
+    std::shared_ptr<std::shared_ptr<CBlob>> p_blob =
+                                std::make_shared<std::shared_ptr<CBlob>>();
+    UploadBlobAsync(upload_request, p_blob).get();
+    return *p_blob;
+}
+
+pplx::task<void> Dropbox::UploadAsync(const CUploadRequest& upload_request) {
+    return UploadBlobAsync(upload_request, nullptr);
+}
+
+pplx::task<void> Dropbox::UploadBlobAsync(
+                            const CUploadRequest& upload_request,
+                            std::shared_ptr<std::shared_ptr<CBlob>> p_blob) {
     CPath path = upload_request.path();
+    if (upload_request.optimistic() || optimistic_uploads_) {
+        // No check before upload: in case of conflict, server refuses
+        // to rename uploaded file
+        return RawUploadAsync(upload_request, false, p_blob).then([this, path](
+                                                pplx::task<void> upload_task) {
+            return CheckUploadConflictAsync(path, upload_task);
+        });
+    }
     // Check before upload : is it a folder ? (uploading a blob to a folder
     // would work, but would rename uploaded file).
-    std::shared_ptr<CFile> p_file = GetFile(path);
-    if (p_file && p_file->IsFolder()) {
-        BOOST_THROW_EXCEPTION(CInvalidFileTypeException(path, true));
+    return GetFileAsync(path).then([this, path, upload_request, p_blob](
+                                            std::shared_ptr<CFile> p_file)
+                                                        -> pplx::task<void> {
+        if (p_file && p_file->IsFolder()) {
+            BOOST_THROW_EXCEPTION(CInvalidFileTypeException(path, true));
+        }
+        return RawUploadAsync(upload_request, true, p_blob);
+    });
+}
+
+pplx::task<void> Dropbox::RawUploadAsync(
+                            const CUploadRequest& upload_request,
+                            bool autorename,
+                            std::shared_ptr<std::shared_ptr<CBlob>> p_blob) {
+    if (upload_request.byte_source()->Length() > chunked_upload_threshold_) {
+        return ChunkedUploadAsync(upload_request, autorename, p_blob);
     }
 
-    RequestInvoker ri = GetRequestInvoker(&path);
-    std::shared_ptr<CResponse> p_response;
-    p_retry_strategy_->InvokeRetry([&] {
-        string_t url = BuildContentUrl(U("files_put"), upload_request.path());
-        web::uri uri = web::uri_builder(url).to_uri();
+    RequestInvoker ri = GetRequestInvoker(&upload_request.path());
+    return p_retry_strategy_->InvokeRetryAsync(
+                            [this, ri, upload_request, autorename, p_blob] {
+        string_t url = BuildContentUrl(U("files_put"),
+                                       upload_request.path());
+        web::uri_builder builder(url);
+        if (!autorename) {
+            builder.append_query(U("autorename=false"));
+        }
+        web::uri uri = builder.to_uri();
         web::http::http_request request(web::http::methods::PUT);
         request.set_request_uri(uri);
         // Dropbox does not support content-type nor file meta information,
         // so nothing else to configure here
         std::shared_ptr<ByteSource> p_bs = upload_request.GetByteSource();
-        std::unique_ptr<std::istream> p_is = p_bs->OpenStream();
+        std::shared_ptr<std::istream> p_is = p_bs->OpenStream();
         // Adapt std::istream to asynchronous concurrency istream:
         concurrency::streams::stdio_istream<uint8_t> is_wrapper(*p_is);
 
         request.set_body(is_wrapper,
                          p_bs->Length(),  // content_length
                          U(""));  // content_type
-        p_response = ri.Invoke(request);
+        // source stream is kept open until request completes:
+        return ri.InvokeAsync(request).then([this, p_bs, p_is, p_blob](
+                                std::shared_ptr<CResponse> p_response) {
+            return ParseUploadResponseAsync(p_response, p_blob);
+        });
+    });
+}
+
+pplx::task<void> Dropbox::ParseUploadResponseAsync(
+                            std::shared_ptr<CResponse> p_response,
+                            std::shared_ptr<std::shared_ptr<CBlob>> p_blob) {
+    if (!p_blob) {
         // we are not interested in response body
+        return pplx::task_from_result();
+    }
+    // Response body is the metadata of uploaded blob:
+    return p_response->AsJsonAsync().then([this, p_blob](
+                                            const web::json::value& json) {
+        *p_blob = std::static_pointer_cast<CBlob>(
+                                                ParseCFile(json.as_object()));
+    });
+}
+
+pplx::task<void> Dropbox::CheckUploadConflictAsync(
+                                            const CPath& path,
+                                            pplx::task<void> upload_task) {
+    try {
+        upload_task.get();
+        return pplx::task_from_result();
+    }
+    catch (const CHttpException& ex) {
+        if (ex.status() != 409) {
+            throw;
+        }
+        // Conflict: most likely a folder exists at path, check it:
+        std::exception_ptr p_error = std::current_exception();
+        return GetFileAsync(path).then([path, p_error](
+                                            std::shared_ptr<CFile> p_file) {
+            if (p_file && p_file->IsFolder()) {
+                BOOST_THROW_EXCEPTION(CInvalidFileTypeException(path, true));
+            }
+            std::rethrow_exception(p_error);
+        });
+    }
+}
+
+pplx::task<void> Dropbox::ChunkedUploadAsync(
+                            const CUploadRequest& upload_request,
+                            bool autorename,
+                            std::shared_ptr<std::shared_ptr<CBlob>> p_blob) {
+    std::shared_ptr<ChunkedUpload> p_upload =
+                    std::make_shared<ChunkedUpload>(upload_request.path());
+    p_upload->autorename = autorename;
+    p_upload->p_blob = p_blob;
+    p_upload->p_source = upload_request.byte_source();
+    p_upload->p_listener = upload_request.progress_listener();
+    p_upload->length = p_upload->p_source->Length();
+    p_upload->chunk_size = upload_request.chunk_size() > 0 ?
+                            upload_request.chunk_size() : upload_chunk_size_;
+    LOG_DEBUG << "Uploading " << upload_request.path() << " in chunks ("
+              << p_upload->length << " bytes)";
+    if (p_upload->p_listener) {
+        p_upload->p_listener->SetProgressTotal(p_upload->length);
+        p_upload->p_listener->Progress(0);
+    }
+    return UploadChunksAsync(p_upload).then([this, p_upload] {
+        return CommitChunkedUploadAsync(p_upload);
+    });
+}
+
+pplx::task<void> Dropbox::UploadChunksAsync(
+                                    std::shared_ptr<ChunkedUpload> p_upload) {
+    if (p_upload->offset >= p_upload->length) {
+        return pplx::task_from_result();
+    }
+    p_upload->tries = 0;
+    RequestInvoker ri = GetChunkedUploadRequestInvoker(&p_upload->path);
+    return p_retry_strategy_->InvokeRetryAsync([this, ri, p_upload] {
+        return UploadChunkAsync(ri, p_upload);
+    }).then([this, p_upload] {
+        // Adapt size of next chunk: smaller after failures (but not below
+        // minimum, unless configured so), larger if network is fast.
+        if (p_upload->tries > 1) {
+            p_upload->chunk_size = std::min(p_upload->chunk_size,
+                                            std::max(kMinUploadChunkSize,
+                                                     p_upload->chunk_size / 2));
+        } else if (std::chrono::steady_clock::now() - p_upload->chunk_start
+                   < kChunkTargetDuration) {
+            p_upload->chunk_size = std::min(kMaxUploadChunkSize,
+                                            p_upload->chunk_size * 2);
+        }
+        if (p_upload->p_listener) {
+            p_upload->p_listener->Progress(p_upload->offset);
+        }
+        return UploadChunksAsync(p_upload);
+    });
+}
+
+pplx::task<void> Dropbox::UploadChunkAsync(
+                                    RequestInvoker ri,
+                                    std::shared_ptr<ChunkedUpload> p_upload) {
+    ++p_upload->tries;
+    p_upload->chunk_start = std::chrono::steady_clock::now();
+    // Chunk starts at last offset acknowledged by server:
+    int64_t offset = p_upload->offset;
+    int64_t size = std::min(p_upload->chunk_size, p_upload->length - offset);
+    web::uri_builder builder(BuildUrl(content_end_point_,
+                                      U("chunked_upload")));
+    if (!p_upload->upload_id.empty()) {
+        builder.append_query(U("upload_id"), p_upload->upload_id);
+        builder.append_query(U("offset"), offset);
+    }
+    LOG_DEBUG << "Uploading chunk: " << offset << "-" << (offset + size - 1)
+              << "/" << p_upload->length;
+
+    std::shared_ptr<ByteSource> p_chunk_source =
+            std::make_shared<detail::RangeByteSource>(p_upload->p_source,
+                                                      offset, size);
+    std::shared_ptr<std::istream> p_is = p_chunk_source->OpenStream();
+    concurrency::streams::stdio_istream<uint8_t> is_wrapper(*p_is);
+    web::http::http_request request(web::http::methods::PUT);
+    request.set_request_uri(builder.to_uri());
+    request.set_body(is_wrapper, size, U(""));
+    // source stream is kept open until request completes:
+    return ri.InvokeAsync(request).then([p_upload, p_chunk_source, p_is](
+                                    std::shared_ptr<CResponse> p_response) {
+        return p_response->AsJsonAsync().then([p_upload, p_response](
+                                            const web::json::value& json) {
+            int64_t server_offset = JsonForKey(json, U("offset"),
+                                               static_cast<int64_t>(-1));
+            string_t upload_id = JsonForKey(json, U("upload_id"),
+                                            string_t(U("")));
+            if (server_offset < 0 || upload_id.empty()) {
+                string_t msg = JsonForKey(json, U("error"), string_t(U("")));
+                p_response->ThrowCStorageException(
+                                    utility::conversions::to_utf8string(msg),
+                                    &p_upload->path);
+            }
+            p_upload->upload_id = upload_id;
+            p_upload->offset = server_offset;
+            if (p_response->status() == 400) {
+                // Offset mismatch (a previous try has been partially
+                // received): retry at once from the offset expected by server
+                LOG_DEBUG << "Chunked upload continues at offset "
+                          << server_offset;
+                try {
+                    BOOST_THROW_EXCEPTION(
+                                CStorageException("Chunk offset mismatch"));
+                }
+                catch (...) {
+                    BOOST_THROW_EXCEPTION(CRetriableException(
+                                            std::current_exception(),
+                                            std::chrono::milliseconds(0)));
+                }
+            }
+        });
+    });
+}
+
+pplx::task<void> Dropbox::CommitChunkedUploadAsync(
+                                    std::shared_ptr<ChunkedUpload> p_upload) {
+    web::uri_builder builder(BuildContentUrl(U("commit_chunked_upload"),
+                                             p_upload->path));
+    builder.append_query(U("upload_id"), p_upload->upload_id);
+    if (!p_upload->autorename) {
+        builder.append_query(U("autorename=false"));
+    }
+    web::uri uri = builder.to_uri();
+    RequestInvoker ri = GetApiRequestInvoker(&p_upload->path);
+    return p_retry_strategy_->InvokeRetryAsync([this, ri, uri, p_upload] {
+        web::http::http_request request(web::http::methods::POST);
+        request.set_request_uri(uri);
+        return ri.InvokeAsync(request).then([this, p_upload](
+                                    std::shared_ptr<CResponse> p_response) {
+            return ParseUploadResponseAsync(p_response, p_upload->p_blob);
+        });
     });
 }
 
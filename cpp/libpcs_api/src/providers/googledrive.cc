@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include <algorithm>
 #include <vector>
 #include <string>
 #include <memory>
@@ -21,6 +22,7 @@
 #include "boost/algorithm/string.hpp"
 #include "boost/algorithm/string/replace.hpp"
 #include "boost/format.hpp"
+#include "boost/lexical_cast.hpp"
 #include "boost/date_time/posix_time/posix_time.hpp"
 
 #include "cpprest/json.h"
@@ -40,6 +42,7 @@
 #include "pcs_api/internal/utilities.h"
 #include "pcs_api/internal/form_body_builder.h"
 #include "pcs_api/internal/multipart_streambuf.h"
+#include "pcs_api/internal/range_byte_source.h"
 #include "pcs_api/internal/logger.h"
 
 namespace pcs_api {
@@ -55,8 +58,47 @@ static const char_t *kUserInfoEndPoint =
                             U("https://www.googleapis.com/oauth2/v1/userinfo");
 static const char_t *kOAuthRoot =
                                     U("https://accounts.google.com/o/oauth2");
+/**
+ * Blobs larger than this are uploaded within a resumable upload session,
+ * unless set by StorageBuilder::google_drive_resumable_upload().
+ */
+static const int64_t kResumableUploadThreshold = 5 * 1024 * 1024;
+/**
+ * Default size of resumable upload chunks.
+ */
+static const int64_t kDefaultUploadChunkSize = 8 * 1024 * 1024;
+/**
+ * Resumable upload chunks must be a multiple of this size.
+ */
+static const int64_t kUploadChunkGranularity = 256 * 1024;
+/**
+ * Maximum number of sessions started for a resumable upload
+ * (a new session is started when previous one has expired).
+ */
+static const int kMaxUploadSessions = 3;
 static const char_t *kMimeTypeDirectory =
                                     U("application/vnd.google-apps.folder");
+/**
+ * Paths with fewer segments are resolved level by level.
+ */
+static const size_t kTitleQueryMinDepth = 2;
+/**
+ * Paths are resolved level by level if title query is expected to return
+ * more files (or really returns more than a page).
+ */
+static const int kTitleQueryMaxExpectedFiles = 200;
+static const int kTitleQueryMaxResults = 1000;
+/**
+ * Maximum number of files per page when listing a folder.
+ */
+static const int kListFolderMaxResults = 1000;
+/**
+ * Fields of files used for resolving paths
+ */
+static const char_t *kPathFileFields =
+                            U("id,title,mimeType,parents/id,parents/isRoot");
+static const char_t *kFileDetailsFields =
+                            U(",downloadUrl,modifiedDate,fileSize");
 
 StorageBuilder::create_provider_func GoogleDrive::GetCreateInstanceFunction() {
     return GoogleDrive::CreateInstance;
@@ -80,7 +122,38 @@ GoogleDrive::GoogleDrive(const StorageBuilder& builder)
                 true,  // scope_in_authorization,
                 ' ',  // scope_perms_separator
                 builder),
-        builder.retry_strategy()) {
+        builder.retry_strategy()),
+      path_ids_cache_file_(builder.path_ids_cache_file()),
+      title_query_files_per_segment_(0),
+      resumable_upload_threshold_(
+                    builder.google_drive_upload_chunk_size() > 0 ?
+                        builder.google_drive_resumable_upload_threshold() :
+                        kResumableUploadThreshold),
+      upload_chunk_size_(builder.google_drive_upload_chunk_size() > 0 ?
+                        builder.google_drive_upload_chunk_size() :
+                        kDefaultUploadChunkSize),
+      files_upload_end_point_(kFilesUploadEndPoint) {
+    if (!path_ids_cache_file_.empty()) {
+        try {
+            path_ids_cache_.Load(path_ids_cache_file_);
+        }
+        catch (...) {
+            LOG_WARN << "Could not load path ids cache: "
+                     << CurrentExceptionToString();
+        }
+    }
+}
+
+GoogleDrive::~GoogleDrive() {
+    if (!path_ids_cache_file_.empty()) {
+        try {
+            path_ids_cache_.Save(path_ids_cache_file_);
+        }
+        catch (...) {
+            LOG_WARN << "Could not save path ids cache: "
+                     << CurrentExceptionToString();
+        }
+    }
 }
 
 void GoogleDrive::ThrowCStorageException(CResponse *p_response,
@@ -188,7 +261,7 @@ RequestInvoker GoogleDrive::GetApiRequestInvoker(const CPath* p_opt_path) {
                       std::placeholders::_1,
                       std::placeholders::_2));  // validate_func
     return RequestInvoker(
-        std::bind(&OAuth2SessionManager::Execute,
+        std::bind(&OAuth2SessionManager::ExecuteAsync,
                 p_session_manager_.get(),
                 std::placeholders::_1),  // do_request_func
         std::bind(&Retry401OnceResponseValidator::ValidateResponse,
@@ -198,6 +271,41 @@ RequestInvoker GoogleDrive::GetApiRequestInvoker(const CPath* p_opt_path) {
         p_opt_path);
 }
 
+void GoogleDrive::ValidateResumableUploadResponse(CResponse *p_response,
+                                                  const CPath* p_opt_path) {
+    if (p_response->status() == 308) {
+        // Resume Incomplete: more bytes are expected
+        return;
+    }
+    ValidateGoogleDriveResponse(p_response, p_opt_path);
+}
+
+/**
+* \brief An invoker for the requests of an upload session.
+*
+* @param p_path context for the request: path of remote file
+* @return a request invoker that accepts incomplete upload responses
+*/
+RequestInvoker GoogleDrive::GetResumableUploadRequestInvoker(
+                                                        const CPath* p_path) {
+    std::shared_ptr<Retry401OnceResponseValidator> p_validator_object =
+        std::make_shared<Retry401OnceResponseValidator>(
+            p_session_manager_.get(),
+            std::bind(&GoogleDrive::ValidateResumableUploadResponse,
+                      this,
+                      std::placeholders::_1,
+                      std::placeholders::_2));  // validate_func
+    return RequestInvoker(
+        std::bind(&OAuth2SessionManager::ExecuteAsync,
+                p_session_manager_.get(),
+                std::placeholders::_1),  // do_request_func
+        std::bind(&Retry401OnceResponseValidator::ValidateResponse,
+                p_validator_object,
+                std::placeholders::_1,
+                std::placeholders::_2),  // validate_func
+        p_path);
+}
+
 /**
 * \brief An invoker that does not check response content type:
 *        to be used for files downloads.
@@ -209,7 +317,7 @@ RequestInvoker GoogleDrive::GetRequestInvoker(const CPath* p_path) {
     // Request execution is delegated to our session manager,
     // response validation is done here:
     return RequestInvoker(
-        std::bind(&OAuth2SessionManager::Execute,
+        std::bind(&OAuth2SessionManager::ExecuteAsync,
                   p_session_manager_.get(),
                   std::placeholders::_1),  // do_request_func
         // validate_func:
@@ -225,10 +333,12 @@ static string_t GetFileUrl(string_t file_id) {
 
 
 GoogleDrive::RemotePath::RemotePath(const CPath& path,
-                                    std::vector<web::json::value> files_chain)
+                                    std::vector<web::json::value> files_chain,
+                                    bool from_cache)
     : path_(path),
       segments_(std::move(path.Split())),
-      files_chain_(files_chain) {
+      files_chain_(files_chain),
+      from_cache_(from_cache) {
 }
 
 bool GoogleDrive::RemotePath::Exists() const {
@@ -282,26 +392,239 @@ CPath GoogleDrive::RemotePath::LastCPath() {
 }
 
 
+static bool IsFolder(const web::json::value& file) {
+    return string_t(kMimeTypeDirectory)
+            == JsonForKey(file, U("mimeType"), string_t());
+}
+
+/**
+ * \brief Build a (partial) file json object from cached id.
+ */
+static web::json::value CachedFileToJson(const string_t& title,
+                                         const PathIdsCache::Entry& entry) {
+    web::json::value file = web::json::value::object();
+    file[U("id")] = web::json::value::string(entry.id);
+    file[U("title")] = web::json::value::string(title);
+    file[U("mimeType")] = web::json::value::string(
+                    entry.is_folder ? kMimeTypeDirectory : U(""));
+    return file;
+}
+
 /**
  * \brief Resolve the given CPath to gather informations (mainly id and
  *        mimeType) ; returns a RemotePath object.
  *
- * Drive API does not allow this natively ; we perform a single request that
- * returns all files (but may return too much): find files with title='a' or
- * title='b' or title='c', then we connect children and parents to get the
- * chain of ids. TODO This fails if there are several folders with same name,
- * and we follow the wrong "branch".
+ * Ids of files are cached: if all segments of path are cached, no
+ * request is needed (detailed information of last file is still requested
+ * by id if needed, or if last id must be checked). If only leading segments
+ * are cached, the other ones are resolved level by level from the deepest
+ * cached folder. Cached ids may be outdated: they are revalidated when a
+ * request fails because of an unknown id (see WithRemotePath()). Trashed
+ * files are still known to server, so they can only be detected by checking
+ * ids.
  */
 const GoogleDrive::RemotePath GoogleDrive::FindRemotePath(const CPath& path,
-                                                          bool detailed) {
+                                                          bool detailed,
+                                                          bool check_cached) {
+    if (path.IsRoot()) {
+        return RemotePath(path, std::vector<web::json::value>());
+    }
+    std::vector<string_t> segments = path.Split();
+    std::vector<PathIdsCache::Entry> entries = path_ids_cache_.Lookup(path);
+    if (entries.size() == segments.size()) {
+        std::vector<web::json::value> files_chain;
+        for (size_t i = 0; i < entries.size(); ++i) {
+            files_chain.push_back(CachedFileToJson(segments[i], entries[i]));
+        }
+        if (!detailed && !check_cached) {
+            return RemotePath(path, files_chain, true);
+        }
+        // Details are not cached: ask for them (this also checks that
+        // last cached id is still valid: not trashed, nor moved)
+        string_t parent_id = entries.size() > 1 ?
+                                entries[entries.size() - 2].id : U("root");
+        web::json::value file = GetCachedFile(path, entries.back().id,
+                                              parent_id);
+        if (!file.is_null()) {
+            files_chain.back() = file;
+            return RemotePath(path, files_chain, true);
+        }
+        LOG_DEBUG << "Outdated path ids cache entry: " << path;
+        path_ids_cache_.Remove(path);
+    } else if (!entries.empty()) {
+        std::vector<web::json::value> files_chain;
+        if (ResolveFromCachedFolder(path, segments, entries, detailed,
+                                    &files_chain)) {
+            return RemotePath(path, files_chain, true);
+        }
+    }
+    return ResolveRemotePath(path, detailed);
+}
+
+bool GoogleDrive::ResolveFromCachedFolder(
+                            const CPath& path,
+                            const std::vector<string_t>& segments,
+                            const std::vector<PathIdsCache::Entry>& entries,
+                            bool detailed,
+                            std::vector<web::json::value> *p_files_chain) {
+    std::vector<web::json::value> cached_chain;
+    std::basic_ostringstream<char_t> cached_path_name;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        cached_chain.push_back(CachedFileToJson(segments[i], entries[i]));
+        cached_path_name << U("/") << segments[i];
+    }
+    string_t fields_filter = kPathFileFields;
+    if (detailed) {
+        fields_filter += kFileDetailsFields;
+    }
+    std::vector<web::json::value> files_chain = ResolveLevelByLevel(
+                                    path, segments, fields_filter,
+                                    cached_chain);
+    if (files_chain.size() == cached_chain.size()) {
+        // Nothing found in deepest cached folder: path does not exist,
+        // unless that folder is outdated (trashed files have no children)
+        CPath cached_path(cached_path_name.str());
+        string_t parent_id = entries.size() > 1 ?
+                                entries[entries.size() - 2].id : U("root");
+        if (GetCachedFile(cached_path, entries.back().id,
+                          parent_id).is_null()) {
+            LOG_DEBUG << "Outdated path ids cache entry: " << cached_path;
+            path_ids_cache_.Remove(cached_path);
+            return false;
+        }
+    }
+    std::vector<PathIdsCache::Entry> resolved_entries(entries);
+    for (size_t i = entries.size(); i < files_chain.size(); ++i) {
+        resolved_entries.push_back(PathIdsCache::Entry(
+                                    files_chain[i].at(U("id")).as_string(),
+                                    IsFolder(files_chain[i])));
+    }
+    path_ids_cache_.Put(path, resolved_entries);
+    *p_files_chain = std::move(files_chain);
+    return true;
+}
+
+web::json::value GoogleDrive::GetCachedFile(const CPath& path,
+                                            const string_t& file_id,
+                                            const string_t& parent_id) {
+    web::uri_builder builder(GetFileUrl(file_id));
+    builder.append_query(U("fields"), string_t(kPathFileFields)
+                                      + kFileDetailsFields
+                                      + U(",labels/trashed"));
+    RequestInvoker ri = GetApiRequestInvoker(&path);
+    std::shared_ptr<CResponse> p_response;
+    try {
+        p_retry_strategy_->InvokeRetry([&] {
+            web::http::http_request request(web::http::methods::GET);
+            request.set_request_uri(builder.to_uri());
+            p_response = ri.Invoke(request);
+        });
+    }
+    catch (const CFileNotFoundException&) {
+        return web::json::value::null();
+    }
+    web::json::value file = p_response->AsJson();
+    // File may have been trashed, renamed or moved since it was cached:
+    if (file.has_field(U("labels"))
+            && JsonForKey(file.at(U("labels")), U("trashed"), false)) {
+        return web::json::value::null();
+    }
+    if (JsonForKey(file, U("title"), string_t()) != path.GetBaseName()) {
+        return web::json::value::null();
+    }
+    const web::json::value& parents = file.has_field(U("parents")) ?
+                                            file.at(U("parents")) :
+                                            web::json::value::array();
+    if (parent_id == U("root") && parents.size() == 0) {
+        return file;  // shared file
+    }
+    for (size_t k = 0; k < parents.size(); k++) {
+        const web::json::value& p = parents.at(k);
+        if (parent_id == U("root") ? JsonForKey(p, U("isRoot"), false)
+                : JsonForKey(p, U("id"), string_t()) == parent_id) {
+            return file;
+        }
+    }
+    return web::json::value::null();
+}
+
+template<class T>
+T GoogleDrive::WithRemotePath(const CPath& path,
+                              bool detailed,
+                              std::function<T(const RemotePath&)> func) {
+    // Files may have been trashed by another client: last id is checked
+    // (a trashed file can still be updated or trashed again)
+    RemotePath remote_path = FindRemotePath(path, detailed, true);
+    if (!remote_path.from_cache()) {
+        return func(remote_path);
+    }
+    try {
+        return func(remote_path);
+    }
+    catch (const CFileNotFoundException&) {
+        LOG_DEBUG << "Outdated path ids cache entries for " << path
+                  << ": " << CurrentExceptionToString();
+    }
+    return func(ResolveRemotePath(path, detailed));
+}
+
+/**
+ * \brief Resolve the given CPath from server.
+ *
+ * Drive API does not allow this natively ; two strategies are used:
+ * - a single request that returns all files whose title is one of the path
+ *   segments: find files with title='a' or title='b' or title='c', then we
+ *   connect children and parents to get the chain of ids. This is cheap for
+ *   rare titles, but common titles ('data', '2024'...) may match thousands
+ *   of files all over the drive. TODO This fails if there are several
+ *   folders with same name, and we follow the wrong "branch".
+ * - one request per segment, looking for a given title among children of
+ *   last resolved folder ; cost is bounded by path depth.
+ * Title query is used for deep paths, as long as observed title queries
+ * returned few files ; it is abandoned as soon as it returns too many files.
+ */
+const GoogleDrive::RemotePath GoogleDrive::ResolveRemotePath(
+                                                        const CPath& path,
+                                                        bool detailed) {
     // easy special case:
     if (path.IsRoot()) {
         return RemotePath(path, std::vector<web::json::value>());
     }
     // Here we know that we have at least one path segment
+    std::vector<string_t> segments = path.Split();
+
+    // We ask for specific fields only
+    string_t fields_filter = kPathFileFields;
+    if (detailed) {
+        fields_filter += kFileDetailsFields;
+    }
 
+    std::vector<web::json::value> files_chain;
+    int expected_files = title_query_files_per_segment_
+                            * static_cast<int>(segments.size());
+    if (segments.size() < kTitleQueryMinDepth
+            || expected_files > kTitleQueryMaxExpectedFiles
+            || !ResolveWithTitleQuery(segments, fields_filter, &files_chain)) {
+        files_chain = ResolveLevelByLevel(path, segments, fields_filter);
+        // slowly forget title queries results:
+        title_query_files_per_segment_ =
+                                title_query_files_per_segment_ * 7 / 8;
+    }
+
+    std::vector<PathIdsCache::Entry> entries;
+    for (const web::json::value& file : files_chain) {
+        entries.push_back(PathIdsCache::Entry(file.at(U("id")).as_string(),
+                                              IsFolder(file)));
+    }
+    path_ids_cache_.Put(path, entries);
+    return GoogleDrive::RemotePath(path, files_chain);
+}
+
+bool GoogleDrive::ResolveWithTitleQuery(
+                                const std::vector<string_t>& segments,
+                                const string_t& fields_filter,
+                                std::vector<web::json::value> *p_files_chain) {
     // Build query (https://developers.google.com/drive/web/search-parameters)
-    std::vector<string_t> segments = path.Split();
     std::basic_ostringstream<char_t> query;
     query << U("(");
     int i = 0;
@@ -318,58 +641,41 @@ const GoogleDrive::RemotePath GoogleDrive::FindRemotePath(const CPath& path,
     }
     query << U(") and trashed=false");
 
-    // drive may not return all results in a single query:
-    // ouch there seems to be some issues with pagination on the google side ?
+    // We only read a single page: if drive has more results, too many files
+    // match (and there seems to be some issues with pagination on the google
+    // side anyway:
     // http://stackoverflow.com/questions/18646004/drive-api-files-list-query-with-not-parameter-returns-empty-pages?rq=1
     // http://stackoverflow.com/questions/18355113/paging-in-files-list-returns-endless-number-of-empty-pages?rq=1
     // http://stackoverflow.com/questions/19679190/is-paging-broken-in-drive?rq=1
     // http://stackoverflow.com/questions/16186264/files-list-reproducibly-returns-incomplete-list-in-drive-files-scope
-    std::vector<web::json::value> items;
-    string_t next_page_token;
-    while (true) {
-        // Execute request ; we ask for specific fields only
-        string_t fields_filter =
-                            U("id,title,mimeType,parents/id,parents/isRoot");
-        if (detailed) {
-            fields_filter += U(",downloadUrl,modifiedDate,fileSize");
-        }
-        fields_filter = string_t(U("nextPageToken,items("))
-                        + fields_filter + U(")");
-        web::uri uri(kFilesEndPoint);
-        web::uri_builder builder(uri);
-        builder.append_query(U("q="
-                                + web::uri::encode_data_string(query.str())));
-        builder.append_query(U("fields"), fields_filter);
-        if (!next_page_token.empty()) {
-            builder.append_query(U("pageToken"), next_page_token);
-        }
-        builder.append_query(U("maxResults"), 1000);
+    // )
+    web::uri uri(kFilesEndPoint);
+    web::uri_builder builder(uri);
+    builder.append_query(U("q=" + web::uri::encode_data_string(query.str())));
+    builder.append_query(U("fields"), string_t(U("nextPageToken,items("))
+                                      + fields_filter + U(")"));
+    builder.append_query(U("maxResults"), kTitleQueryMaxResults);
 
-        RequestInvoker ri = GetApiRequestInvoker();
-        std::shared_ptr<CResponse> p_response;
-        p_retry_strategy_->InvokeRetry([&] {
-            web::http::http_request request(web::http::methods::GET);
-            request.set_request_uri(builder.to_uri());
-            p_response = ri.Invoke(request);
-        });
-        web::json::value jresp = std::move(p_response->AsJson());
-        web::json::array& items_in_page = jresp.at(U("items")).as_array();
-        for (web::json::value item : items_in_page) {
-            items.push_back(item);
-        }
-        // Is it the last page ?
-        next_page_token = JsonForKey(jresp, U("nextPageToken"), string_t());
-        if (!next_page_token.empty()) {
-            LOG_TRACE << "FindRemotePath() will loop: ("
-                      << items_in_page.size() << " items in this page)";
-        } else {
-            // LOG_TRACE << "FindRemotePath(): no more data for this query";
-            break;
-        }
+    RequestInvoker ri = GetApiRequestInvoker();
+    std::shared_ptr<CResponse> p_response;
+    p_retry_strategy_->InvokeRetry([&] {
+        web::http::http_request request(web::http::methods::GET);
+        request.set_request_uri(builder.to_uri());
+        p_response = ri.Invoke(request);
+    });
+    web::json::value jresp = std::move(p_response->AsJson());
+    const web::json::array& items = jresp.at(U("items")).as_array();
+    int files_per_segment = static_cast<int>(items.size() / segments.size());
+    title_query_files_per_segment_ =
+            (title_query_files_per_segment_ * 3 + files_per_segment) / 4;
+    if (!JsonForKey(jresp, U("nextPageToken"), string_t()).empty()) {
+        LOG_DEBUG << "Title query matches too many files ("
+                  << items.size() << " in first page)";
+        return false;
     }
 
     // Now connect parent/children to build the path:
-    std::vector<web::json::value> files_chain;
+    std::vector<web::json::value>& files_chain = *p_files_chain;
     // this changes parent condition (isRoot, or no parent for shares):
     bool first_segment = true;
     for (const string_t& searched_segment : segments) {
@@ -423,7 +729,54 @@ const GoogleDrive::RemotePath GoogleDrive::FindRemotePath(const CPath& path,
         files_chain.push_back(next_item);
         first_segment = false;
     }
-    return GoogleDrive::RemotePath(path, files_chain);
+    return true;
+}
+
+std::vector<web::json::value> GoogleDrive::ResolveLevelByLevel(
+                            const CPath& path,
+                            const std::vector<string_t>& segments,
+                            const string_t& fields_filter,
+                            std::vector<web::json::value> files_chain) {
+    RequestInvoker ri = GetApiRequestInvoker();
+    for (size_t i = files_chain.size(); i < segments.size(); ++i) {
+        const string_t& segment = segments[i];
+        std::basic_ostringstream<char_t> query;
+        if (files_chain.empty()) {
+            // shared files have no parents, but appear at root level:
+            query << U("('root' in parents or sharedWithMe)");
+        } else {
+            if (!IsFolder(files_chain.back())) {
+                break;  // a blob has no children
+            }
+            query << U("'") << files_chain.back().at(U("id")).as_string()
+                  << U("' in parents");
+        }
+        query << U(" and title='")
+              << boost::algorithm::replace_all_copy(segment, U("'"), U("\\'"))
+              << U("' and trashed=false");
+
+        web::uri_builder builder = web::uri_builder(web::uri(kFilesEndPoint));
+        builder.append_query(U("q"), query.str());
+        builder.append_query(U("fields"), string_t(U("items("))
+                                          + fields_filter + U(")"));
+        // If several files have the same title, any of them will do:
+        builder.append_query(U("maxResults"), 1);
+        std::shared_ptr<CResponse> p_response;
+        p_retry_strategy_->InvokeRetry([&] {
+            web::http::http_request request(web::http::methods::GET);
+            request.set_request_uri(builder.to_uri());
+            p_response = ri.Invoke(request);
+        });
+        web::json::value jresp = p_response->AsJson();
+        const web::json::array& items = jresp.at(U("items")).as_array();
+        if (items.size() == 0) {
+            break;  // this segment does not exist: no need to go further
+        }
+        files_chain.push_back(*items.begin());
+    }
+    LOG_TRACE << "Resolved " << files_chain.size() << "/" << segments.size()
+              << " segments of " << path << " level by level";
+    return files_chain;
 }
 
 
@@ -463,12 +816,22 @@ std::shared_ptr<CFolderContent> GoogleDrive::ListRootFolder() {
 }
 
 std::shared_ptr<CFolderContent> GoogleDrive::ListFolder(const CPath& path) {
-    std::shared_ptr<CFolderContent> p_ret;
-    RemotePath remote_path = FindRemotePath(path, true);
-    if (!remote_path.Exists()) {
+    CFolderContentBuilder cfcb;
+    if (!ListFolderStream(path, [&cfcb](std::shared_ptr<CFile> p_file) {
+                cfcb.Add(p_file->path(), p_file);
+            })) {
         // per contract, listing a non existing folder
         // must return an empty pointer
-        return p_ret;  // empty
+        return std::shared_ptr<CFolderContent>();  // empty
+    }
+    return cfcb.BuildFolderContent();
+}
+
+bool GoogleDrive::ListFolderStream(const CPath& path,
+                                   file_callback callback) {
+    RemotePath remote_path = FindRemotePath(path, true);
+    if (!remote_path.Exists()) {
+        return false;
     }
     if (remote_path.LastIsBlob()) {
         BOOST_THROW_EXCEPTION(CInvalidFileTypeException(path, false));
@@ -484,26 +847,33 @@ std::shared_ptr<CFolderContent> GoogleDrive::ListFolder(const CPath& path) {
     query << U(") and trashed=false");
     string_t fields_filter =
         U("nextPageToken,items(id,title,mimeType,fileSize,modifiedDate)");
-    web::uri_builder builder = web::uri_builder(web::uri(kFilesEndPoint));
-    builder.append_query(U("q"), query.str());
-    builder.append_query(U("fields"), fields_filter);
     RequestInvoker ri = GetApiRequestInvoker();
-    std::shared_ptr<CResponse> p_response;
-    p_retry_strategy_->InvokeRetry([&] {
-        web::http::http_request request(web::http::methods::GET);
-        request.set_request_uri(builder.to_uri());
-        p_response = ri.Invoke(request);
-    });
-    web::json::value json = std::move(p_response->AsJson());
+    // Files are given to callback page by page:
+    string_t page_token;
+    do {
+        web::uri_builder builder = web::uri_builder(web::uri(kFilesEndPoint));
+        builder.append_query(U("q"), query.str());
+        builder.append_query(U("fields"), fields_filter);
+        builder.append_query(U("maxResults"), kListFolderMaxResults);
+        if (!page_token.empty()) {
+            builder.append_query(U("pageToken"), page_token);
+        }
+        std::shared_ptr<CResponse> p_response;
+        p_retry_strategy_->InvokeRetry([&] {
+            web::http::http_request request(web::http::methods::GET);
+            request.set_request_uri(builder.to_uri());
+            p_response = ri.Invoke(request);
+        });
+        web::json::value json = std::move(p_response->AsJson());
 
-    CFolderContentBuilder cfcb;
-    const web::json::value& array = json.at(U("items"));
-    for (unsigned int i = 0; i < array.size(); i++) {
-        const web::json::value &item_obj = array.at(i);
-        std::shared_ptr<CFile> p_file = ParseCFile(path, item_obj);
-        cfcb.Add(p_file->path(), p_file);
-    }
-    return cfcb.BuildFolderContent();
+        const web::json::value& array = json.at(U("items"));
+        for (unsigned int i = 0; i < array.size(); i++) {
+            const web::json::value &item_obj = array.at(i);
+            callback(ParseCFile(path, item_obj));
+        }
+        page_token = JsonForKey(json, U("nextPageToken"), string_t());
+    } while (!page_token.empty());
+    return true;
 }
 
 std::shared_ptr<CFolderContent> GoogleDrive::ListFolder(const CFolder& folder) {
@@ -538,33 +908,37 @@ string_t GoogleDrive::RawCreateFolder(const CPath& path, string_t parent_id) {
         p_response = ri.Invoke(request);
     });
     web::json::value jresp = p_response->AsJson();
-    return jresp.at(U("id")).as_string();
+    string_t folder_id = jresp.at(U("id")).as_string();
+    path_ids_cache_.PutFile(path, PathIdsCache::Entry(folder_id, true));
+    return folder_id;
 }
 
 
 bool GoogleDrive::CreateFolder(const CPath& path) {
     // we have to check before if folder already exists:
     // (and also to determine what folders must be created)
-    RemotePath remote_path = FindRemotePath(path, false);
-    if (remote_path.LastIsBlob()) {
-        // A blob exists along that path: wrong !
-        BOOST_THROW_EXCEPTION(
-                CInvalidFileTypeException(remote_path.LastCPath(), false));
-    }
-    if (remote_path.Exists()) {
-        // folder already exists:
-        return false;
-    }
+    return WithRemotePath<bool>(path, false, [this](RemotePath remote_path)
+                                                                    -> bool {
+        if (remote_path.LastIsBlob()) {
+            // A blob exists along that path: wrong !
+            BOOST_THROW_EXCEPTION(
+                    CInvalidFileTypeException(remote_path.LastCPath(), false));
+        }
+        if (remote_path.Exists()) {
+            // folder already exists:
+            return false;
+        }
 
-    // we may have to create any intermediate folders:
-    string_t parent_id = remote_path.GetDeepestFolderId();
-    size_t i = remote_path.files_chain().size();
-    while (i < remote_path.segments().size()) {
-        CPath current_path = remote_path.GetFirstSegmentsPath(i + 1);
-        parent_id = RawCreateFolder(current_path, parent_id);
-        i++;
-    }
-    return true;
+        // we may have to create any intermediate folders:
+        string_t parent_id = remote_path.GetDeepestFolderId();
+        size_t i = remote_path.files_chain().size();
+        while (i < remote_path.segments().size()) {
+            CPath current_path = remote_path.GetFirstSegmentsPath(i + 1);
+            parent_id = RawCreateFolder(current_path, parent_id);
+            i++;
+        }
+        return true;
+    });
 }
 
 void GoogleDrive::DeleteById(const CPath& path, string_t file_id) {
@@ -586,14 +960,19 @@ bool GoogleDrive::Delete(const CPath& path) {
         BOOST_THROW_EXCEPTION(CStorageException("Can not delete root folder"));
     }
 
-    RemotePath remote_path = FindRemotePath(path, false);
-    if (!remote_path.Exists()) {
-        return false;
-    }
-    // We have at least one segment ; this is either a folder or a blob
-    // (so we cannot rely on DeepestFolderId() as it works only for folders)
-    DeleteById(path, remote_path.files_chain().back().at(U("id")).as_string());
-    return true;
+    return WithRemotePath<bool>(path, false, [this, &path](
+                                const RemotePath& remote_path) -> bool {
+        if (!remote_path.Exists()) {
+            return false;
+        }
+        // We have at least one segment ; this is either a folder or a blob
+        // (so we cannot rely on DeepestFolderId() as it works only for
+        // folders)
+        DeleteById(path,
+                   remote_path.files_chain().back().at(U("id")).as_string());
+        path_ids_cache_.Remove(path);
+        return true;
+    });
 }
 
 std::shared_ptr<CFile> GoogleDrive::GetFile(const CPath& path) {
@@ -643,75 +1022,145 @@ void GoogleDrive::Download(const CDownloadRequest& download_request) {
                                     + path.path_name_utf8()));
         }
         string_t url = blob.at(U("downloadUrl")).as_string();
+        // Sink may hold bytes of a previous attempt: then we only request
+        // the remaining ones
+        std::shared_ptr<ByteSink> p_byte_sink = download_request.GetByteSink();
+        int64_t resume_offset;
         web::http::http_request request(web::http::methods::GET);
         request.set_request_uri(web::uri(url));
         for (std::pair<string_t, string_t> header :
-                                        download_request.GetHttpHeaders()) {
+                download_request.GetHttpHeaders(*p_byte_sink, &resume_offset)) {
             request.headers().add(header.first, header.second);
         }
         std::shared_ptr<CResponse> p_response = ri.Invoke(request);
-        std::shared_ptr<ByteSink> p_byte_sink = download_request.GetByteSink();
-        p_response->DownloadDataToSink(p_byte_sink.get());
+        p_response->DownloadDataToSink(p_byte_sink.get(),
+                                       download_request.chunk_size(),
+                                       resume_offset,
+                                       download_request.IsPartial());
     });
 }
 
 void GoogleDrive::Upload(const CUploadRequest& upload_request) {
-    p_retry_strategy_->InvokeRetry([&]{
-        // Check before upload: is it a folder ?
-        // (uploading a blob would create another file with the same name: bad)
-        const CPath& path = upload_request.path();
-        RemotePath remote_path = FindRemotePath(path, false);
-        if (remote_path.Exists() && !remote_path.LastIsBlob()) {
-            // path refer to an existing folder: wrong !
-            BOOST_THROW_EXCEPTION(CInvalidFileTypeException(path, true));
-        }
-        if (!remote_path.Exists() && remote_path.LastIsBlob()) {
-            // some blob exists in path: wrong !
-            BOOST_THROW_EXCEPTION(
-                CInvalidFileTypeException(remote_path.LastCPath(), false));
-        }
+    UploadFile(upload_request);
+}
 
-        // only one of these 2 will be set:
+std::shared_ptr<CBlob> GoogleDrive::UploadAndGetBlob(
+                                        const CUploadRequest& upload_request) {
+    const CPath& path = upload_request.path();
+    web::json::value json = UploadFile(upload_request);
+    std::shared_ptr<CFile> p_file;
+    if (!json.is_null()) {
+        p_file = ParseCFile(path.GetParent(), json);
+    } else {
+        // upload completed without a final response: ask for blob
+        p_file = GetFile(path);
+    }
+    if (!p_file || !p_file->IsBlob()) {
+        BOOST_THROW_EXCEPTION(CStorageException(
+                    "Blob not found after upload: " + path.path_name_utf8()));
+    }
+    return std::static_pointer_cast<CBlob>(p_file);
+}
+
+web::json::value GoogleDrive::UploadFile(
+                                        const CUploadRequest& upload_request) {
+    // Check before upload: is it a folder ?
+    // (uploading a blob would create another file with the same name: bad)
+    const CPath& path = upload_request.path();
+    return WithRemotePath<web::json::value>(path, false,
+                                    [this, &upload_request, &path](
+                        const RemotePath& remote_path) -> web::json::value {
         string_t file_id;
-        string_t parent_id;
-        if (remote_path.Exists()) {
-            // Blob already exists: we'll update it
-            file_id = remote_path.GetBlob().at(U("id")).as_string();
-        } else {
-            parent_id = remote_path.GetDeepestFolderId();
-            // We may need to create intermediate folders first:
-            size_t i = remote_path.files_chain().size();
-            while (i < remote_path.segments().size() - 1) {
-                const CPath current_path =
-                                    remote_path.GetFirstSegmentsPath(i + 1);
-                parent_id = RawCreateFolder(current_path, parent_id);
-                i++;
-            }
+        web::json::value json_meta = PrepareUpload(upload_request,
+                                                   remote_path,
+                                                   &file_id);
+        web::json::value json = SendBlob(upload_request, file_id, json_meta);
+        // Only id of file is of interest here (for caching):
+        if (!json.is_null()) {
+            file_id = JsonForKey(json, U("id"), file_id);
         }
-
-        // By now we can upload a new blob to folder with id=parent_id,
-        // or update existing blob with id=file_id:
-        web::json::value json_meta = web::json::value::object();
         if (!file_id.empty()) {
-            // Blob update
-        } else {
-            // Blob creation
-            json_meta[U("title")] =
-                                web::json::value::string(path.GetBaseName());
-            web::json::value ids_array = web::json::value::array();
-            web::json::value id_obj = web::json::value::object();
-            id_obj[U("id")] = web::json::value::string(parent_id);
-            ids_array[0] = id_obj;
-            json_meta[U("parents")] = ids_array;
+            path_ids_cache_.PutFile(path, PathIdsCache::Entry(file_id, false));
         }
-        if (!upload_request.content_type().empty()) {
-            // It seems that drive distinguishes between mimeType defined here,
-            // and Content-Type defined in part header.
-            // Drive also tries to guess mimeType...
-            json_meta[U("mimeType")] =
-                web::json::value::string(upload_request.content_type());
+        return json;
+    });
+}
+
+web::json::value GoogleDrive::PrepareUpload(
+                                        const CUploadRequest& upload_request,
+                                        const RemotePath& remote_path,
+                                        string_t *p_file_id) {
+    const CPath& path = upload_request.path();
+    if (remote_path.Exists() && !remote_path.LastIsBlob()) {
+        // path refer to an existing folder: wrong !
+        BOOST_THROW_EXCEPTION(CInvalidFileTypeException(path, true));
+    }
+    if (!remote_path.Exists() && remote_path.LastIsBlob()) {
+        // some blob exists in path: wrong !
+        BOOST_THROW_EXCEPTION(
+            CInvalidFileTypeException(remote_path.LastCPath(), false));
+    }
+
+    // only one of these 2 will be set:
+    string_t file_id;
+    string_t parent_id;
+    if (remote_path.Exists()) {
+        // Blob already exists: we'll update it
+        file_id = remote_path.GetBlob().at(U("id")).as_string();
+    } else {
+        parent_id = remote_path.GetDeepestFolderId();
+        // We may need to create intermediate folders first:
+        size_t i = remote_path.files_chain().size();
+        while (i < remote_path.segments().size() - 1) {
+            const CPath current_path = remote_path.GetFirstSegmentsPath(i + 1);
+            parent_id = RawCreateFolder(current_path, parent_id);
+            i++;
         }
+    }
 
+    // By now we can upload a new blob to folder with id=parent_id,
+    // or update existing blob with id=file_id:
+    web::json::value json_meta = web::json::value::object();
+    if (!file_id.empty()) {
+        // Blob update
+    } else {
+        // Blob creation
+        json_meta[U("title")] = web::json::value::string(path.GetBaseName());
+        web::json::value ids_array = web::json::value::array();
+        web::json::value id_obj = web::json::value::object();
+        id_obj[U("id")] = web::json::value::string(parent_id);
+        ids_array[0] = id_obj;
+        json_meta[U("parents")] = ids_array;
+    }
+    if (!upload_request.content_type().empty()) {
+        // It seems that drive distinguishes between mimeType defined here,
+        // and Content-Type defined in part header.
+        // Drive also tries to guess mimeType...
+        json_meta[U("mimeType")] =
+            web::json::value::string(upload_request.content_type());
+    }
+    *p_file_id = file_id;
+    return json_meta;
+}
+
+web::json::value GoogleDrive::SendBlob(const CUploadRequest& upload_request,
+                                       const string_t& file_id,
+                                       const web::json::value& json_meta) {
+    // Small blobs are sent at once, larger ones within an upload session:
+    if (upload_request.byte_source()->Length()
+                                        <= resumable_upload_threshold_) {
+        return MultipartUpload(upload_request, file_id, json_meta);
+    }
+    return ResumableUpload(upload_request, file_id, json_meta);
+}
+
+web::json::value GoogleDrive::MultipartUpload(
+                                        const CUploadRequest& upload_request,
+                                        const string_t& file_id,
+                                        const web::json::value& json_meta) {
+    const CPath& path = upload_request.path();
+    web::json::value uploaded;
+    p_retry_strategy_->InvokeRetry([&]{
         MultipartStreamer mp_streamer("related");
         // metadata part:
         MemoryByteSource metadata(
@@ -739,13 +1188,13 @@ void GoogleDrive::Upload(const CUploadRequest& upload_request) {
         if (!file_id.empty()) {
             // Updating existing file:
             request.set_method(web::http::methods::PUT);
-            request.set_request_uri(string_t(kFilesUploadEndPoint)
+            request.set_request_uri(files_upload_end_point_
                                     + U("/")
                                     + file_id + U("?uploadType=multipart"));
         } else {
             // uploading a new file:
             request.set_method(web::http::methods::POST);
-            request.set_request_uri(string_t(kFilesUploadEndPoint)
+            request.set_request_uri(files_upload_end_point_
                                     + U("?uploadType=multipart"));
         }
         request.set_body(is_wrapper,
@@ -754,8 +1203,207 @@ void GoogleDrive::Upload(const CUploadRequest& upload_request) {
 
         RequestInvoker ri = GetApiRequestInvoker(&path);
         std::shared_ptr<CResponse> p_response = ri.Invoke(request);
-        // We are not interested in response
+        uploaded = p_response->AsJson();
     });
+    return uploaded;
+}
+
+/**
+ * Get the number of bytes committed by server, from the Range header of
+ * a "308 Resume Incomplete" response (looks like "bytes=0-524287").
+ */
+static int64_t ParseCommittedBytes(CResponse *p_response) {
+    auto it = p_response->headers().find(web::http::header_names::range);
+    if (it == p_response->headers().end()) {
+        return 0;  // nothing received yet
+    }
+    size_t dash = it->second.find(U('-'));
+    if (dash == string_t::npos) {
+        BOOST_THROW_EXCEPTION(CStorageException(
+                "Unexpected Range header in upload response: "
+                + utility::conversions::to_utf8string(it->second)));
+    }
+    return boost::lexical_cast<int64_t>(it->second.substr(dash + 1)) + 1;
+}
+
+/**
+ * \brief Invoke a request within an upload session.
+ *
+ * @return the response, or null if session has expired or is unknown
+ *         to server (404 or 410): a new session must be started
+ */
+static std::shared_ptr<CResponse> InvokeInUploadSession(
+                                    RequestInvoker *p_ri,
+                                    web::http::http_request request) {
+    try {
+        return p_ri->Invoke(request);
+    }
+    catch (CFileNotFoundException&) {
+        return std::shared_ptr<CResponse>();
+    }
+    catch (CHttpException& e) {
+        if (e.status() != 410) {
+            throw;
+        }
+        return std::shared_ptr<CResponse>();
+    }
+}
+
+web::json::value GoogleDrive::ResumableUpload(
+                                        const CUploadRequest& upload_request,
+                                        const string_t& file_id,
+                                        const web::json::value& json_meta) {
+    const CPath& path = upload_request.path();
+    std::shared_ptr<ByteSource> p_source = upload_request.byte_source();
+    const int64_t length = p_source->Length();
+    // Chunks must be a multiple of 256 KiB (except the last one):
+    int64_t chunk_size = upload_request.chunk_size() > 0 ?
+                    upload_request.chunk_size() : upload_chunk_size_;
+    chunk_size = std::max(kUploadChunkGranularity,
+                          chunk_size - chunk_size % kUploadChunkGranularity);
+    std::shared_ptr<ProgressListener> p_listener =
+                                        upload_request.progress_listener();
+    if (p_listener) {
+        p_listener->SetProgressTotal(length);
+        p_listener->Progress(0);
+    }
+
+    string_t session_uri;  // empty until session is started
+    int nb_sessions = 0;
+    int64_t offset = 0;
+    bool offset_is_known = true;
+    // last response holds the uploaded file (unless a query found upload
+    // was already complete):
+    web::json::value uploaded;
+    RequestInvoker ri = GetResumableUploadRequestInvoker(&path);
+    while (offset < length) {
+        if (session_uri.empty()) {
+            // first session, or previous one has been lost:
+            if (++nb_sessions > kMaxUploadSessions) {
+                BOOST_THROW_EXCEPTION(CStorageException(
+                            "Upload sessions keep expiring for blob: "
+                            + path.path_name_utf8()));
+            }
+            session_uri = CreateUploadSession(upload_request, file_id,
+                                              json_meta);
+            offset = 0;
+            offset_is_known = true;
+        }
+        p_retry_strategy_->InvokeRetry([&] {
+            if (!offset_is_known) {
+                // previous chunk failed: some bytes may have been committed
+                offset = QueryUploadOffset(session_uri, path, length);
+                offset_is_known = true;
+                if (offset < 0) {
+                    LOG_WARN << "Upload session lost, upload restarts: "
+                             << path.path_name_utf8();
+                    session_uri.clear();
+                    offset = 0;
+                    return;
+                }
+                if (offset >= length) {
+                    return;  // upload is complete
+                }
+            }
+            int64_t size = std::min(chunk_size, length - offset);
+            LOG_DEBUG << "Uploading chunk: " << offset << "-"
+                      << (offset + size - 1) << "/" << length;
+            detail::RangeByteSource chunk_source(p_source, offset, size);
+            std::unique_ptr<std::istream> p_is = chunk_source.OpenStream();
+            concurrency::streams::stdio_istream<uint8_t> is_wrapper(*p_is);
+            web::http::http_request request(web::http::methods::PUT);
+            request.set_request_uri(web::uri(session_uri));
+            request.set_body(is_wrapper, size, U("application/octet-stream"));
+            request.headers().add(U("Content-Range"),
+                    U("bytes ") + utility::conversions::print_string(offset)
+                    + U("-") + utility::conversions::print_string(
+                                                        offset + size - 1)
+                    + U("/") + utility::conversions::print_string(length));
+            offset_is_known = false;
+            std::shared_ptr<CResponse> p_response =
+                                        InvokeInUploadSession(&ri, request);
+            if (!p_response) {
+                LOG_WARN << "Upload session lost, upload restarts: "
+                         << path.path_name_utf8();
+                session_uri.clear();
+                offset = 0;
+            } else if (p_response->status() == 308) {
+                offset = ParseCommittedBytes(p_response.get());
+            } else {
+                offset = length;  // 200 or 201: upload is complete
+                if (p_response->IsJsonContentType()) {
+                    uploaded = p_response->AsJson();
+                }
+            }
+            offset_is_known = true;
+        });
+        if (p_listener) {
+            p_listener->Progress(offset);
+        }
+    }
+    return uploaded;
+}
+
+string_t GoogleDrive::CreateUploadSession(const CUploadRequest& upload_request,
+                                          const string_t& file_id,
+                                          const web::json::value& json_meta) {
+    const CPath& path = upload_request.path();
+    string_t session_uri;
+    RequestInvoker ri = GetResumableUploadRequestInvoker(&path);
+    p_retry_strategy_->InvokeRetry([&] {
+        web::http::http_request request;
+        if (!file_id.empty()) {
+            // Updating existing file:
+            request.set_method(web::http::methods::PUT);
+            request.set_request_uri(files_upload_end_point_
+                                    + U("/")
+                                    + file_id + U("?uploadType=resumable"));
+        } else {
+            // uploading a new file:
+            request.set_method(web::http::methods::POST);
+            request.set_request_uri(files_upload_end_point_
+                                    + U("?uploadType=resumable"));
+        }
+        request.set_body(json_meta);
+        request.headers().add(U("X-Upload-Content-Length"),
+                              upload_request.byte_source()->Length());
+        if (!upload_request.content_type().empty()) {
+            request.headers().add(U("X-Upload-Content-Type"),
+                                  upload_request.content_type());
+        }
+        std::shared_ptr<CResponse> p_response = ri.Invoke(request);
+        auto it = p_response->headers().find(
+                                        web::http::header_names::location);
+        if (it == p_response->headers().end()) {
+            BOOST_THROW_EXCEPTION(CStorageException(
+                        "No upload session URI returned for blob: "
+                        + path.path_name_utf8()));
+        }
+        session_uri = it->second;
+    });
+    return session_uri;
+}
+
+int64_t GoogleDrive::QueryUploadOffset(const string_t& session_uri,
+                                       const CPath& path,
+                                       int64_t length) {
+    web::http::http_request request(web::http::methods::PUT);
+    request.set_request_uri(web::uri(session_uri));
+    request.headers().set_content_length(0);
+    request.headers().add(U("Content-Range"),
+            U("bytes */") + utility::conversions::print_string(length));
+    RequestInvoker ri = GetResumableUploadRequestInvoker(&path);
+    std::shared_ptr<CResponse> p_response = InvokeInUploadSession(&ri,
+                                                                  request);
+    if (!p_response) {
+        return -1;  // session has been lost
+    }
+    if (p_response->status() != 308) {
+        return length;  // upload is complete
+    }
+    int64_t offset = ParseCommittedBytes(p_response.get());
+    LOG_DEBUG << "Upload will continue after " << offset << " bytes";
+    return offset;
 }
 
 std::shared_ptr<CFile> GoogleDrive::ParseCFile(const CPath& parent_path,
@@ -14,6 +14,11 @@
  * limitations under the License.
  */
 
+#include <cstdlib>
+#include <locale>
+#include <sstream>
+#include <string>
+
 #include "boost/date_time/posix_time/posix_time_io.hpp"
 
 #include "cpprest/json.h"
@@ -41,6 +46,17 @@ const char* Hubic::kProviderName = "hubic";
 static const char_t *kRoot = U("https://api.hubic.com");
 static const char_t *kEndPoint = U("https://api.hubic.com/1.0");
 
+// Swift credentials persisted with user credentials (as provider data):
+static const char_t *kSwiftEndpoint = U("swift_endpoint");
+static const char_t *kSwiftToken = U("swift_token");
+static const char_t *kSwiftExpiresAt = U("swift_expires_at");
+static const char_t *kSwiftContainer = U("swift_container");
+/**
+ * Persisted swift credentials are not used if they expire sooner
+ * than this delay.
+ */
+static const int kSwiftExpirationMargin_s = 5 * 60;
+
 StorageBuilder::create_provider_func Hubic::GetCreateInstanceFunction() {
     return Hubic::CreateInstance;
 }
@@ -64,7 +80,15 @@ Hubic::Hubic(const StorageBuilder& builder) :
                             true,  // scope_in_authorization,
                             ',',  // scope_perms_separator
                             builder),
-                    builder.retry_strategy()) {
+                    builder.retry_strategy()),
+    swift_fetch_in_progress_(false),
+    pinned_container_(utility::conversions::to_string_t(
+                                                builder.swift_container())),
+    optimistic_uploads_(builder.optimistic_uploads()),
+    large_object_threshold_(builder.swift_large_object_threshold()),
+    segment_size_(builder.swift_segment_size()),
+    max_segments_concurrency_(builder.swift_max_segments_concurrency()),
+    listing_page_size_(builder.swift_listing_page_size()) {
 }
 
 void Hubic::ThrowCStorageException(CResponse *p_response,
@@ -159,7 +183,7 @@ RequestInvoker Hubic::GetApiRequestInvoker(const CPath* p_opt_path) {
                       std::placeholders::_1,
                       std::placeholders::_2));  // validate_func
     return RequestInvoker(
-        std::bind(&OAuth2SessionManager::Execute,
+        std::bind(&OAuth2SessionManager::ExecuteAsync,
                   p_session_manager_.get(),
                   std::placeholders::_1),  // do_request_func
         std::bind(&Retry401OnceResponseValidator::ValidateResponse,
@@ -215,19 +239,148 @@ class NoRetryStrategy : public RetryStrategy {
     void InvokeRetry(std::function<void()> request_func) override {
         request_func();
     }
+    pplx::task<void> InvokeRetryAsync(
+            std::function<pplx::task<void>()> request_func) override {
+        return request_func();
+    }
 };
 
 std::shared_ptr<SwiftClient> Hubic::GetSwiftClient() {
-    // Only one thread can instantiate client:
-    std::lock_guard<std::mutex> lock(swift_client_mutex_);
+    return GetSwiftClientAsync().get();
+}
 
-    // take snapshot of member variable in a local variable
-    // as member variable can be reset at anytime:
-    std::shared_ptr<SwiftClient> p_swift = p_swift_client_;
+pplx::task<std::shared_ptr<SwiftClient>> Hubic::GetSwiftClientAsync() {
+    std::shared_ptr<SwiftClient> p_swift = std::atomic_load(&p_swift_client_);
     if (p_swift) {
-        return p_swift;  // usual path
+        return pplx::task_from_result(p_swift);  // usual path
+    }
+    std::lock_guard<std::mutex> lock(swift_fetch_mutex_);
+    p_swift = std::atomic_load(&p_swift_client_);
+    if (p_swift) {
+        return pplx::task_from_result(p_swift);  // fetched meanwhile
+    }
+    if (!swift_fetch_in_progress_) {
+        // No client yet (or has been invalidated).
+        // Client instantiation is not frequent, it is performed
+        // synchronously in a background task:
+        swift_fetch_in_progress_ = true;
+        swift_fetch_task_ = pplx::create_task([this] {
+            return FetchSwiftClient();
+        }).then([this](pplx::task<std::shared_ptr<SwiftClient>> fetch_task) {
+            std::shared_ptr<SwiftClient> p_fetched;
+            try {
+                p_fetched = fetch_task.get();
+                // published before fetch ends, so that no other fetch starts:
+                std::atomic_store(&p_swift_client_, p_fetched);
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lock(swift_fetch_mutex_);
+                swift_fetch_in_progress_ = false;  // next call tries again
+                throw;
+            }
+            std::lock_guard<std::mutex> lock(swift_fetch_mutex_);
+            swift_fetch_in_progress_ = false;
+            return p_fetched;
+        });
+    }
+    return swift_fetch_task_;
+}
+
+/**
+ * \brief Parse swift credentials expiration date, as given by hubiC API.
+ *
+ * @param expires looks like "2014-10-08T13:03:25+02:00"
+ * @return expiration date, as a time_t (or -1 if unparsable)
+ */
+static int64_t ParseSwiftExpires(const string_t& expires) {
+    std::string expires_str = utility::conversions::to_utf8string(expires);
+    if (expires_str.length() < 19) {
+        return -1;
+    }
+    std::locale loc(std::locale::classic(),
+            new boost::posix_time::time_input_facet("%Y-%m-%dT%H:%M:%S"));
+    std::istringstream is(expires_str.substr(0, 19));
+    is.imbue(loc);
+    boost::posix_time::ptime expires_at;
+    is >> expires_at;
+    if (expires_at.is_special()) {
+        return -1;
+    }
+    // Convert to UTC, according to offset:
+    std::string offset = expires_str.substr(19);
+    if (offset.length() == 6 && (offset[0] == '+' || offset[0] == '-')) {
+        boost::posix_time::time_duration delta =
+                boost::posix_time::hours(std::atoi(offset.substr(1, 2).c_str()))
+                + boost::posix_time::minutes(
+                                    std::atoi(offset.substr(4, 2).c_str()));
+        expires_at = offset[0] == '+' ? expires_at - delta : expires_at + delta;
     }
-    // No client yet (or has been invalidated):
+    return utilities::DateTimeToTime_t(expires_at);
+}
+
+std::shared_ptr<SwiftClient> Hubic::NewSwiftClient(const string_t& endpoint,
+                                                   const string_t& token) {
+    std::shared_ptr<SwiftClient> p_swift = std::make_shared<SwiftClient>(
+                    endpoint,
+                    token,
+                    std::unique_ptr<RetryStrategy>(new NoRetryStrategy()),
+                    true,  // use_directory_markers
+                    // we delegate requests execution to our session manager:
+                    std::bind(&OAuth2SessionManager::RawExecuteAsync,
+                              p_session_manager_.get(),
+                              std::placeholders::_1));
+    // Whole operations are retried here, but large objects segments are
+    // retried one by one (a new client is needed only for auth errors):
+    p_swift->SetSegmentsRetryStrategy(p_retry_strategy_);
+    if (segment_size_ > 0) {
+        p_swift->SetLargeObjectSegmentation(large_object_threshold_,
+                                            segment_size_,
+                                            max_segments_concurrency_);
+    }
+    if (listing_page_size_ > 0) {
+        p_swift->SetListingPageSize(listing_page_size_);
+    }
+    return p_swift;
+}
+
+std::shared_ptr<SwiftClient> Hubic::FetchSwiftClient() {
+    web::json::value persisted = web::json::value::object();
+    string_t provider_data = p_session_manager_->GetProviderData();
+    if (!provider_data.empty()) {
+        try {
+            persisted = web::json::value::parse(provider_data);
+            if (!persisted.is_object()) {
+                persisted = web::json::value::object();
+            }
+        }
+        catch (web::json::json_exception&) {
+            LOG_WARN << "Ignored unparsable persisted swift credentials";
+        }
+    }
+    string_t persisted_endpoint = JsonForKey(persisted,
+                                             kSwiftEndpoint,
+                                             string_t());
+    string_t persisted_token = JsonForKey(persisted, kSwiftToken, string_t());
+    int64_t persisted_expires_at = JsonForKey(persisted,
+                                              kSwiftExpiresAt,
+                                              (int64_t)-1);
+    string_t container = pinned_container_;
+    if (container.empty()) {
+        container = JsonForKey(persisted, kSwiftContainer, string_t());
+    }
+    int64_t now = utilities::DateTimeToTime_t(
+                        boost::posix_time::second_clock::universal_time());
+    if (!persisted_token.empty() && !container.empty()
+            && persisted_expires_at > now + kSwiftExpirationMargin_s) {
+        // Persisted credentials are still valid: no request at all
+        LOG_DEBUG << "Using persisted swift credentials";
+        std::shared_ptr<SwiftClient> p_swift = NewSwiftClient(
+                                                        persisted_endpoint,
+                                                        persisted_token);
+        p_swift->UseContainer(container);
+        return p_swift;
+    }
+
     // hubiC API gives us informations for instantiation
     string_t url = string_t(kEndPoint) + U("/account/credentials");
     RequestInvoker ri = GetApiRequestInvoker();
@@ -241,35 +394,89 @@ std::shared_ptr<SwiftClient> Hubic::GetSwiftClient() {
     const web::json::object& json_obj = json.as_object();
     const string_t& swift_endpoint = json_obj.at(U("endpoint")).as_string();
     const string_t& swift_token = json_obj.at(U("token")).as_string();
-    p_swift = std::make_shared<SwiftClient>(
-                    swift_endpoint,
-                    swift_token,
-                    std::unique_ptr<RetryStrategy>(new NoRetryStrategy()),
-                    true,  // use_directory_markers
-                    // we delegate requests execution to our session manager:
-                    std::bind(&OAuth2SessionManager::RawExecute,
-                              p_session_manager_.get(),
-                              std::placeholders::_1));
-    p_swift->UseFirstContainer();
-    p_swift_client_ = p_swift;
-    return p_swift;  // return snapshot
-}
+    int64_t swift_expires_at = ParseSwiftExpires(
+                                JsonForKey(json, U("expires"), string_t()));
+    std::shared_ptr<SwiftClient> p_swift = NewSwiftClient(swift_endpoint,
+                                                          swift_token);
+    if (!container.empty() && (!pinned_container_.empty()
+                               || swift_endpoint == persisted_endpoint)) {
+        p_swift->UseContainer(container);
+    } else {
+        p_swift->UseFirstContainer();
+    }
 
-void Hubic::SwiftCall(std::function<void(SwiftClient *p_swift)> user_func) {
+    // Persist for next instances:
+    web::json::value to_persist = web::json::value::object();
+    to_persist[kSwiftEndpoint] = web::json::value::string(swift_endpoint);
+    to_persist[kSwiftContainer] =
+                    web::json::value::string(p_swift->current_container());
+    if (swift_expires_at > 0) {  // else token is not reused
+        to_persist[kSwiftToken] = web::json::value::string(swift_token);
+        to_persist[kSwiftExpiresAt] = web::json::value::number(
+                                        static_cast<double>(swift_expires_at));
+    }
     try {
-        std::shared_ptr<SwiftClient> p_swift = GetSwiftClient();
-        user_func(p_swift.get());
+        p_session_manager_->SaveProviderData(to_persist.serialize());
+    }
+    catch (std::exception& ex) {
+        // not fatal: next instance will request credentials again
+        LOG_WARN << "Could not persist swift credentials: " << ex.what();
     }
-    catch (const CAuthenticationException&) {
+    return p_swift;
+}
+
+void Hubic::InvalidateSwiftClient(std::shared_ptr<SwiftClient> p_stale) {
+    // p_stale is kept alive by caller, so that a new client can not have
+    // the same address: client pointer acts as a version.
+    if (std::atomic_compare_exchange_strong(&p_swift_client_,
+                                            &p_stale,
+                                            std::shared_ptr<SwiftClient>())) {
         LOG_WARN << "Swift authentication error: swift client invalidated";
-        p_swift_client_.reset();
-        // Wrap as a retriable error without wait,
-        // so that retrier will not abort :
-        BOOST_THROW_EXCEPTION(CRetriableException(std::current_exception(),
-                                                std::chrono::milliseconds(0)));
+        // Persisted token is not valid anymore (container is kept):
+        string_t provider_data = p_session_manager_->GetProviderData();
+        try {
+            if (!provider_data.empty()) {
+                web::json::value persisted =
+                                    web::json::value::parse(provider_data);
+                web::json::value to_persist = web::json::value::object();
+                to_persist[kSwiftEndpoint] = web::json::value::string(
+                        JsonForKey(persisted, kSwiftEndpoint, string_t()));
+                to_persist[kSwiftContainer] = web::json::value::string(
+                        JsonForKey(persisted, kSwiftContainer, string_t()));
+                p_session_manager_->SaveProviderData(to_persist.serialize());
+            }
+        }
+        catch (std::exception& ex) {
+            LOG_WARN << "Could not forget persisted swift credentials: "
+                     << ex.what();
+        }
+    } else {
+        LOG_DEBUG << "Swift authentication error with an outdated client";
     }
 }
 
+pplx::task<void> Hubic::SwiftCallAsync(
+        std::function<pplx::task<void>(SwiftClient *p_swift)> user_func) {
+    return GetSwiftClientAsync().then([this, user_func](
+                                        std::shared_ptr<SwiftClient> p_swift) {
+        // swift client is kept alive until its operation completes:
+        return user_func(p_swift.get()).then([this, p_swift](
+                                                pplx::task<void> swift_task) {
+            try {
+                swift_task.get();
+            }
+            catch (const CAuthenticationException&) {
+                InvalidateSwiftClient(p_swift);
+                // Wrap as a retriable error without wait,
+                // so that retrier will not abort :
+                BOOST_THROW_EXCEPTION(CRetriableException(
+                                                std::current_exception(),
+                                                std::chrono::milliseconds(0)));
+            }
+        });
+    });
+}
+
 std::shared_ptr<CFolderContent> Hubic::ListRootFolder() {
     return ListFolder(CPath(U("/")));
 }
@@ -279,57 +486,168 @@ std::shared_ptr<CFolderContent> Hubic::ListFolder(const CFolder& folder) {
 }
 
 std::shared_ptr<CFolderContent> Hubic::ListFolder(const CPath& path) {
-    std::shared_ptr<CFolderContent> p_ret;
-    p_retry_strategy_->InvokeRetry([&] {
-        SwiftCall([&](SwiftClient *p_swift) {
-            p_ret = p_swift->ListFolder(path);
+    return ListFolderAsync(path).get();
+}
+
+bool Hubic::ListFolderStream(const CPath& path, file_callback callback) {
+    // Listing progress is kept between retries, so that files are not
+    // given twice to callback:
+    std::shared_ptr<SwiftClient::ListingProgress> p_progress =
+                            std::make_shared<SwiftClient::ListingProgress>();
+    std::shared_ptr<bool> p_ret = std::make_shared<bool>(false);
+    p_retry_strategy_->InvokeRetryAsync([this, path, callback, p_progress,
+                                         p_ret] {
+        return SwiftCallAsync([path, callback, p_progress, p_ret](
+                                                    SwiftClient *p_swift) {
+            return p_swift->ListFolderStreamAsync(path, callback,
+                                                  p_progress).then(
+                                                        [p_ret](bool ret) {
+                *p_ret = ret;
+            });
         });
-    });
-    return p_ret;
+    }).get();
+    return *p_ret;
+}
+
+bool Hubic::ListRecursive(const CPath& path, file_callback callback) {
+    // A single listing of all objects below path (without delimiter),
+    // resumed after errors like ListFolderStream():
+    std::shared_ptr<SwiftClient::ListingProgress> p_progress =
+                            std::make_shared<SwiftClient::ListingProgress>();
+    std::shared_ptr<bool> p_ret = std::make_shared<bool>(false);
+    p_retry_strategy_->InvokeRetryAsync([this, path, callback, p_progress,
+                                         p_ret] {
+        return SwiftCallAsync([path, callback, p_progress, p_ret](
+                                                    SwiftClient *p_swift) {
+            return p_swift->ListRecursiveStreamAsync(path, callback,
+                                                     p_progress).then(
+                                                        [p_ret](bool ret) {
+                *p_ret = ret;
+            });
+        });
+    }).get();
+    return *p_ret;
 }
 
 bool Hubic::CreateFolder(const CPath& path) {
-    bool ret;
-    p_retry_strategy_->InvokeRetry([&] {
-        SwiftCall([&](SwiftClient *p_swift) {
-            ret = p_swift->CreateFolder(path);
+    return CreateFolderAsync(path).get();
+}
+
+bool Hubic::Delete(const CPath& path) {
+    return DeleteAsync(path).get();
+}
+
+std::shared_ptr<CFile> Hubic::GetFile(const CPath& path) {
+    return GetFileAsync(path).get();
+}
+
+void Hubic::Download(const CDownloadRequest& download_request) {
+    DownloadAsync(download_request).get();
+}
+
+void Hubic::Upload(const CUploadRequest& upload_request) {
+    UploadAsync(upload_request).get();
+}
+
+std::shared_ptr<CFolder> Hubic::CreateFolderAndGet(const CPath& path) {
+    std::shared_ptr<std::shared_ptr<CFolder>> p_ret =
+                                std::make_shared<std::shared_ptr<CFolder>>();
+    p_retry_strategy_->InvokeRetryAsync([this, path, p_ret] {
+        return SwiftCallAsync([path, p_ret](SwiftClient *p_swift) {
+            return p_swift->CreateFolderAsync(path, p_ret).then([](bool) {});
         });
+    }).get();
+    return *p_ret;
+}
+
+std::shared_ptr<CBlob> Hubic::UploadAndGetBlob(
+                                        const CUploadRequest& upload_request) {
+    std::shared_ptr<std::shared_ptr<CBlob>> p_ret =
+                                std::make_shared<std::shared_ptr<CBlob>>();
+    UploadBlobAsync(upload_request, p_ret).get();
+    return *p_ret;
+}
+
+pplx::task<std::shared_ptr<CFolderContent>> Hubic::ListFolderAsync(
+                                                        const CPath& path) {
+    std::shared_ptr<std::shared_ptr<CFolderContent>> p_ret =
+                        std::make_shared<std::shared_ptr<CFolderContent>>();
+    return p_retry_strategy_->InvokeRetryAsync([this, path, p_ret] {
+        return SwiftCallAsync([path, p_ret](SwiftClient *p_swift) {
+            return p_swift->ListFolderAsync(path).then(
+                                [p_ret](std::shared_ptr<CFolderContent> p) {
+                *p_ret = p;
+            });
+        });
+    }).then([p_ret] {
+        return *p_ret;
     });
-    return ret;
 }
 
-bool Hubic::Delete(const CPath& path) {
-    bool ret;
-    p_retry_strategy_->InvokeRetry([&] {
-        SwiftCall([&](SwiftClient *p_swift) {
-            ret = p_swift->Delete(path);
+pplx::task<bool> Hubic::CreateFolderAsync(const CPath& path) {
+    std::shared_ptr<bool> p_ret = std::make_shared<bool>(false);
+    return p_retry_strategy_->InvokeRetryAsync([this, path, p_ret] {
+        return SwiftCallAsync([path, p_ret](SwiftClient *p_swift) {
+            return p_swift->CreateFolderAsync(path).then([p_ret](bool ret) {
+                *p_ret = ret;
+            });
         });
+    }).then([p_ret] {
+        return *p_ret;
     });
-    return ret;
 }
 
-std::shared_ptr<CFile> Hubic::GetFile(const CPath& path) {
-    std::shared_ptr<CFile> p_ret;
-    p_retry_strategy_->InvokeRetry([&] {
-        SwiftCall([&](SwiftClient *p_swift) {
-            p_ret = p_swift->GetFile(path);
+pplx::task<bool> Hubic::DeleteAsync(const CPath& path) {
+    std::shared_ptr<bool> p_ret = std::make_shared<bool>(false);
+    return p_retry_strategy_->InvokeRetryAsync([this, path, p_ret] {
+        return SwiftCallAsync([path, p_ret](SwiftClient *p_swift) {
+            return p_swift->DeleteAsync(path).then([p_ret](bool ret) {
+                *p_ret = ret;
+            });
         });
+    }).then([p_ret] {
+        return *p_ret;
     });
-    return p_ret;
 }
 
-void Hubic::Download(const CDownloadRequest& download_request) {
-    p_retry_strategy_->InvokeRetry([&] {
-        SwiftCall([&](SwiftClient *p_swift) {
-            p_swift->Download(download_request);
+pplx::task<std::shared_ptr<CFile>> Hubic::GetFileAsync(const CPath& path) {
+    std::shared_ptr<std::shared_ptr<CFile>> p_ret =
+                                    std::make_shared<std::shared_ptr<CFile>>();
+    return p_retry_strategy_->InvokeRetryAsync([this, path, p_ret] {
+        return SwiftCallAsync([path, p_ret](SwiftClient *p_swift) {
+            return p_swift->GetFileAsync(path).then(
+                                        [p_ret](std::shared_ptr<CFile> p) {
+                *p_ret = p;
+            });
         });
+    }).then([p_ret] {
+        return *p_ret;
     });
 }
 
-void Hubic::Upload(const CUploadRequest& upload_request) {
-    p_retry_strategy_->InvokeRetry([&] {
-        SwiftCall([&](SwiftClient *p_swift) {
-            p_swift->Upload(upload_request);
+pplx::task<void> Hubic::DownloadAsync(
+                                    const CDownloadRequest& download_request) {
+    return p_retry_strategy_->InvokeRetryAsync([this, download_request] {
+        return SwiftCallAsync([download_request](SwiftClient *p_swift) {
+            return p_swift->DownloadAsync(download_request);
+        });
+    });
+}
+
+pplx::task<void> Hubic::UploadAsync(const CUploadRequest& request) {
+    return UploadBlobAsync(request, nullptr);
+}
+
+pplx::task<void> Hubic::UploadBlobAsync(
+                            const CUploadRequest& request,
+                            std::shared_ptr<std::shared_ptr<CBlob>> p_blob) {
+    CUploadRequest upload_request(request);
+    if (optimistic_uploads_) {
+        upload_request.set_optimistic(true);
+    }
+    return p_retry_strategy_->InvokeRetryAsync([this, upload_request, p_blob] {
+        return SwiftCallAsync([upload_request, p_blob](SwiftClient *p_swift) {
+            return p_swift->UploadAsync(upload_request, p_blob);
         });
     });
 }
@@ -14,8 +14,17 @@
  * limitations under the License.
  */
 
+#include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <functional>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
 
+#include "boost/algorithm/string.hpp"
 #include "boost/date_time/posix_time/posix_time_io.hpp"
 
 #include "cpprest/uri_builder.h"
@@ -24,6 +33,8 @@
 #include "pcs_api/internal/providers/swift_client.h"
 #include "pcs_api/internal/c_folder_content_builder.h"
 #include "pcs_api/internal/json_utils.h"
+#include "pcs_api/internal/range_byte_source.h"
+#include "pcs_api/internal/utilities.h"
 #include "pcs_api/internal/logger.h"
 
 namespace pcs_api {
@@ -33,18 +44,123 @@ namespace pcs_api {
  */
 static const char_t *kContentTypeDirectory = U("application/directory");
 
+const int64_t SwiftClient::kDefaultLargeObjectThreshold = 256 * 1024 * 1024;
+const int64_t SwiftClient::kDefaultSegmentSize = 64 * 1024 * 1024;
+const int SwiftClient::kDefaultMaxSegmentsConcurrency = 4;
+const int64_t SwiftClient::kDefaultMaxManifestSegments = 1000;
+const int SwiftClient::kDefaultListingPageSize = 10000;
+/**
+ * Maximum number of objects deleted by a bulk delete request
+ * (default limit of Swift bulk middleware).
+ */
+static const size_t kMaxBulkDeletes = 10000;
+/**
+ * Maximum number of concurrent DELETE requests (if bulk delete is not
+ * supported by server).
+ */
+static const int kMaxDeletesConcurrency = 8;
+/**
+ * Maximum number of folders remembered as existing, and how long
+ * (changes made by other clients are seen once entries have expired).
+ */
+static const size_t kKnownFoldersMaxEntries = 10000;
+static const std::chrono::minutes kKnownFoldersTtl(5);
+
+/**
+ * \brief State of a Static Large Object upload, shared by concurrent
+ *        segments uploads.
+ */
+struct SwiftClient::LargeObjectUpload {
+    CPath path;
+    string_t content_type;
+    std::shared_ptr<ByteSource> p_source;
+    std::shared_ptr<ProgressListener> p_listener;
+    int64_t length;
+    int64_t segment_size;
+    string_t segments_prefix;  // name of segments, without index
+    std::mutex mutex;  // protects members below
+    size_t next_segment;
+    std::vector<string_t> etags;  // empty until segment is uploaded
+    int64_t uploaded;
+    std::exception_ptr p_error;  // first failure
+
+    LargeObjectUpload(const CPath& upload_path,
+                      size_t nb_segments)
+        : path(upload_path),
+          next_segment(0),
+          etags(nb_segments),
+          uploaded(0) {
+    }
+
+    int64_t SegmentLength(size_t index) const {
+        return std::min(segment_size, length - index * segment_size);
+    }
+
+    string_t SegmentName(size_t index) const {
+        std::basic_ostringstream<char_t> name;
+        name << segments_prefix << std::setw(8) << std::setfill(U('0'))
+             << index;
+        return name.str();
+    }
+};
+
 SwiftClient::SwiftClient(
     const string_t& account_endpoint,
     const string_t& auth_token,
     std::unique_ptr<RetryStrategy> p_retry_strategy,
     bool use_directory_markers,
-    std::function<std::shared_ptr<CResponse>(web::http::http_request request)>
-                                                    execute_request_function)
+    execute_function execute_request_function)
     : account_endpoint_(account_endpoint),
       auth_token_(auth_token),
       p_retry_strategy_(std::move(p_retry_strategy)),
       use_directory_markers_(use_directory_markers),
-      execute_request_function_(execute_request_function) {
+      execute_request_function_(execute_request_function),
+      large_object_threshold_(kDefaultLargeObjectThreshold),
+      segment_size_(kDefaultSegmentSize),
+      max_segments_concurrency_(kDefaultMaxSegmentsConcurrency),
+      listing_page_size_(kDefaultListingPageSize),
+      slo_limits_requested_(false),
+      max_manifest_segments_(kDefaultMaxManifestSegments),
+      min_segment_size_(1),
+      segments_container_exists_(false),
+      bulk_delete_unsupported_(false),
+      known_folders_(kKnownFoldersMaxEntries, kKnownFoldersTtl) {
+}
+
+void SwiftClient::SetLargeObjectSegmentation(int64_t threshold,
+                                             int64_t segment_size,
+                                             int max_concurrency) {
+    if (segment_size <= 0) {
+        BOOST_THROW_EXCEPTION(
+                        std::invalid_argument("Segment size must be > 0"));
+    }
+    if (max_concurrency <= 0) {
+        BOOST_THROW_EXCEPTION(
+                        std::invalid_argument("Concurrency must be > 0"));
+    }
+    large_object_threshold_ = threshold;
+    segment_size_ = segment_size;
+    max_segments_concurrency_ = max_concurrency;
+}
+
+void SwiftClient::SetSegmentsRetryStrategy(
+                            std::shared_ptr<RetryStrategy> p_retry_strategy) {
+    p_segments_retry_strategy_ = p_retry_strategy;
+}
+
+void SwiftClient::SetListingPageSize(int page_size) {
+    if (page_size <= 0) {
+        BOOST_THROW_EXCEPTION(
+                        std::invalid_argument("Page size must be > 0"));
+    }
+    // Server would return less objects than requested, which would be
+    // taken as the last page:
+    if (page_size > kDefaultListingPageSize) {
+        LOG_WARN << "Listing page size " << page_size
+                 << " exceeds server limit: using " << kDefaultListingPageSize;
+        page_size = kDefaultListingPageSize;
+    }
+    listing_page_size_ = page_size;
 }
 
 void SwiftClient::ConfigureRequest(web::http::http_request *p_request,
@@ -60,7 +176,7 @@ void SwiftClient::ConfigureRequest(web::http::http_request *p_request,
     }
 }
 
-std::shared_ptr<CResponse> SwiftClient::ConfigureAndExecuteRequest(
+pplx::task<std::shared_ptr<CResponse>> SwiftClient::ConfigureAndExecuteRequest(
         web::http::http_request request, string_t format) {
     ConfigureRequest(&request, format);
     return execute_request_function_(request);
@@ -157,228 +273,1274 @@ void SwiftClient::UseFirstContainer() {
 }
 
 std::shared_ptr<CFolderContent> SwiftClient::ListFolder(const CPath& path) {
-    web::json::value json = ListObjectsWithinFolder(path, U("/"));
-    const web::json::array& json_array = json.as_array();
-    std::shared_ptr<CFile> p_file;
-    if (json_array.size() == 0) {
-        // List is empty ; can be caused by a really empty folder,
-        // a non existing folder, or a blob
-        // Distinguish the different cases :
-        p_file = GetFile(path);
+    return ListFolderAsync(path).get();
+}
+
+bool SwiftClient::CreateFolder(const CPath& path) {
+    return CreateFolderAsync(path).get();
+}
+
+bool SwiftClient::Delete(const CPath& path) {
+    return DeleteAsync(path).get();
+}
+
+std::shared_ptr<CFile> SwiftClient::GetFile(const CPath& path) {
+    return GetFileAsync(path).get();
+}
+
+void SwiftClient::Download(const CDownloadRequest& download_request) {
+    DownloadAsync(download_request).get();
+}
+
+void SwiftClient::Upload(const CUploadRequest& upload_request) {
+    UploadAsync(upload_request).get();
+}
+
+pplx::task<std::shared_ptr<CFolderContent>> SwiftClient::ListFolderAsync(
+                                                        const CPath& path) {
+    std::shared_ptr<CFolderContentBuilder> p_cfcb =
+                                    std::make_shared<CFolderContentBuilder>();
+    LruCacheGeneration generation = known_folders_.generation();
+    return ListObjectsWithinFolderAsync(path, U("/"),
+            [this, p_cfcb, generation](const web::json::array& json_array) {
+        AddToFolderContent(json_array, p_cfcb.get(), generation);
+        return pplx::task_from_result();
+    }).then([this, path, p_cfcb](size_t count)
+                            -> pplx::task<std::shared_ptr<CFolderContent>> {
+        if (count > 0) {
+            return pplx::task_from_result(p_cfcb->BuildFolderContent());
+        }
+        return CheckEmptyListingAsync(path).then([](bool exists)
+                                        -> std::shared_ptr<CFolderContent> {
+            if (!exists) {
+                return std::shared_ptr<CFolderContent>();  // empty pointer
+            }
+            // empty existing folder:
+            return CFolderContentBuilder().BuildFolderContent();
+        });
+    });
+}
+
+pplx::task<bool> SwiftClient::CheckEmptyListingAsync(const CPath& path) {
+    // List is empty ; can be caused by a really empty folder,
+    // a non existing folder, or a blob
+    // Distinguish the different cases :
+    return GetFileAsync(path).then([path](std::shared_ptr<CFile> p_file)
+                                                                    -> bool {
         if (!p_file) {  // Nothing at that path
-            return std::shared_ptr<CFolderContent>();  // empty pointer
+            return false;
         }
         if (p_file->IsBlob()) {  // It is a blob : error !
             BOOST_THROW_EXCEPTION(CInvalidFileTypeException(path, false));
         }
-        // empty existing folder: we continue (empty loop below)
+        return true;  // empty existing folder
+    });
+}
+
+/**
+ * \brief Build file from an object of a container listing.
+ *
+ * @param p_detailed (out) false if object only indicates a sub directory
+ */
+static std::shared_ptr<CFile> ParseListedObject(const web::json::value& val,
+                                                bool *p_detailed) {
+    const web::json::object& obj = val.as_object();
+    if (val.has_field(U("subdir"))) {
+        // indicates a non empty sub directory
+        // There are two cases here : provider uses directory-markers,
+        // or not.
+        // - if yes, another entry should exist in json with more detailed
+        //   informations (possibly in a previous page).
+        // - if not, this will be the only entry that indicates a sub
+        //   folder exists.
+        *p_detailed = false;
+        return std::make_shared<CFolder>(
+                        CPath(obj.at(U("subdir")).as_string()),
+                        boost::posix_time::not_a_date_time);
+    }
+    *p_detailed = true;
+    if (obj.at(U("content_type")).as_string() != kContentTypeDirectory) {
+        return std::make_shared<CBlob>(
+                        CPath(obj.at(U("name")).as_string()),
+                        JsonForKey(val, U("bytes"), (int64_t)-1),
+                        obj.at(U("content_type")).as_string(),
+                        swift_details::ParseLastModified(val));
     }
+    return std::make_shared<CFolder>(
+                        CPath(obj.at(U("name")).as_string()),
+                        swift_details::ParseLastModified(val));
+}
 
-    CFolderContentBuilder cfcb;
+void SwiftClient::AddToFolderContent(const web::json::array& json_array,
+                                     CFolderContentBuilder *p_cfcb,
+                                     const LruCacheGeneration& generation) {
     for (web::json::array::size_type i = 0; i < json_array.size(); ++i) {
-        const web::json::value& val = json_array.at(i);
-        const web::json::object& obj = val.as_object();
         bool detailed;
-        if (val.has_field(U("subdir"))) {
-            // indicates a non empty sub directory
-            // There are two cases here : provider uses directory-markers,
-            // or not.
-            // - if yes, another entry should exist in json with more detailed
-            //   informations.
-            // - if not, this will be the only entry that indicates a sub
-            //   folder exists, so we keep this file, but we'll memorize it
-            //   only if it is not already present in our current map.
-            detailed = false;
-            p_file = std::make_shared<CFolder>(
-                            CPath(obj.at(U("subdir")).as_string()),
-                            boost::posix_time::not_a_date_time);
+        std::shared_ptr<CFile> p_file = ParseListedObject(json_array.at(i),
+                                                          &detailed);
+        if (detailed && p_file->IsFolder()) {
+            known_folders_.Put(p_file->path(), true, generation);
+        }
+        if (detailed || !p_cfcb->HasPath(p_file->path())) {
+            // If we got a detailed file, we always store it
+            // If we got only rough description,
+            // we keep it only if no info already exists
+            p_cfcb->Add(p_file->path(), p_file);
+        }
+    }
+}
 
-        } else {
-            detailed = true;
-            if (obj.at(U("content_type")).as_string() !=
-                                                    kContentTypeDirectory) {
-                p_file = std::make_shared<CBlob>(
-                            CPath(obj.at(U("name")).as_string()),
-                            JsonForKey(val, U("bytes"), (int64_t)-1),
-                            obj.at(U("content_type")).as_string(),
-                            swift_details::ParseLastModified(val));
+pplx::task<bool> SwiftClient::ListFolderStreamAsync(
+                                    const CPath& path,
+                                    IStorageProvider::file_callback callback,
+                            std::shared_ptr<ListingProgress> p_progress) {
+    LruCacheGeneration generation = known_folders_.generation();
+    return ListObjectsWithinFolderAsync(path, U("/"),
+            [this, callback, p_progress, generation](
+                                        const web::json::array& json_array) {
+        for (web::json::array::size_type i = 0; i < json_array.size(); ++i) {
+            bool detailed;
+            std::shared_ptr<CFile> p_file = ParseListedObject(
+                                                    json_array.at(i),
+                                                    &detailed);
+            if (detailed && p_file->IsFolder()) {
+                known_folders_.Put(p_file->path(), true, generation);
+            }
+            // directory marker is listed before its sub directory entry:
+            if (p_file->IsFolder()
+                    && !p_progress->folders.insert(p_file->path()).second) {
+                continue;
+            }
+            callback(p_file);
+        }
+        if (json_array.size() > 0) {
+            const web::json::value& last = json_array.at(json_array.size() - 1);
+            p_progress->marker = last.has_field(U("subdir")) ?
+                                        last.at(U("subdir")).as_string() :
+                                        last.at(U("name")).as_string();
+        }
+        return pplx::task_from_result();
+    }, p_progress->marker).then([this, path, p_progress](size_t)
+                                                        -> pplx::task<bool> {
+        if (!p_progress->marker.empty()) {
+            return pplx::task_from_result(true);
+        }
+        return CheckEmptyListingAsync(path);
+    });
+}
+
+pplx::task<bool> SwiftClient::ListRecursiveStreamAsync(
+                                    const CPath& path,
+                                    IStorageProvider::file_callback callback,
+                            std::shared_ptr<ListingProgress> p_progress) {
+    // Without delimiter, all objects below path are listed (in names order):
+    LruCacheGeneration generation = known_folders_.generation();
+    return ListObjectsWithinFolderAsync(path, U(""),
+            [this, path, callback, p_progress, generation](
+                                        const web::json::array& json_array) {
+        for (web::json::array::size_type i = 0; i < json_array.size(); ++i) {
+            bool detailed;
+            std::shared_ptr<CFile> p_file = ParseListedObject(
+                                                    json_array.at(i),
+                                                    &detailed);
+            if (detailed && p_file->IsFolder()) {
+                known_folders_.Put(p_file->path(), true, generation);
+            }
+            // Folders without directory marker only appear in objects
+            // names: they are given before the first object they contain
+            // (a directory marker is always listed before its content).
+            std::vector<CPath> implicit_folders;
+            for (CPath parent = p_file->path().GetParent();
+                        parent != path && !parent.IsRoot();
+                        parent = parent.GetParent()) {
+                if (p_progress->folders.count(parent) > 0) {
+                    break;
+                }
+                implicit_folders.push_back(parent);
+            }
+            for (auto it = implicit_folders.rbegin();
+                        it != implicit_folders.rend(); ++it) {
+                p_progress->folders.insert(*it);
+                callback(std::make_shared<CFolder>(
+                                    *it, boost::posix_time::not_a_date_time));
+            }
+            if (p_file->IsFolder()
+                    && !p_progress->folders.insert(p_file->path()).second) {
+                continue;
+            }
+            callback(p_file);
+        }
+        if (json_array.size() > 0) {
+            p_progress->marker = json_array.at(json_array.size() - 1)
+                                                .at(U("name")).as_string();
+        }
+        return pplx::task_from_result();
+    }, p_progress->marker).then([this, path, p_progress](size_t)
+                                                        -> pplx::task<bool> {
+        if (!p_progress->marker.empty()) {
+            return pplx::task_from_result(true);
+        }
+        return CheckEmptyListingAsync(path);
+    });
+}
+
+pplx::task<bool> SwiftClient::CreateFolderAsync(
+                        const CPath& path,
+                        std::shared_ptr<std::shared_ptr<CFolder>> p_folder) {
+    // Known folders are checked anyway, as they may have been deleted
+    // by another client:
+    return GetFileAsync(path).then([this, path, p_folder](
+                    std::shared_ptr<CFile> p_file) -> pplx::task<bool> {
+        if (p_file) {
+            if (p_file->IsFolder()) {
+                // folder already exists
+                if (p_folder) {
+                    *p_folder = std::static_pointer_cast<CFolder>(p_file);
+                }
+                return pplx::task_from_result(false);
+            }
+            // It is a blob: error !
+            BOOST_THROW_EXCEPTION(CInvalidFileTypeException(path, false));
+        }
+        pplx::task<void> parents_task = pplx::task_from_result();
+        if (use_directory_markers_) {
+            parents_task = CreateIntermediateFoldersObjectsAsync(
+                                                            path.GetParent());
+        }
+        std::shared_ptr<web::http::http_headers> p_headers;
+        if (p_folder) {
+            p_headers = std::make_shared<web::http::http_headers>();
+        }
+        return parents_task.then([this, path, p_headers] {
+            return RawCreateFolderAsync(path, p_headers);
+        }).then([path, p_folder, p_headers] {
+            if (p_folder) {
+                *p_folder = std::make_shared<CFolder>(
+                        path,
+                        swift_details::ParseLastModifiedHeader(*p_headers));
+            }
+            return true;
+        });
+    });
+}
+
+/**
+ * \brief Is this listed object possibly the manifest of a large object ?
+ *
+ * Container listings report the total size of large objects (and a slo_etag
+ * field with recent servers).
+ */
+static bool MayBeLargeObject(const web::json::value& obj,
+                             int64_t large_object_threshold) {
+    return obj.has_field(U("slo_etag"))
+            || (large_object_threshold >= 0
+                && JsonForKey(obj, U("bytes"), (int64_t)0)
+                                                    > large_object_threshold);
+}
+
+/**
+ * \brief Are these object headers the ones of a large object manifest ?
+ */
+static bool IsLargeObject(const web::http::http_headers& headers) {
+    auto it = headers.find(U("X-Static-Large-Object"));
+    return it != headers.end() && boost::iequals(it->second, U("True"));
+}
+
+pplx::task<bool> SwiftClient::DeleteAsync(const CPath& path) {
+    // Request sub-objects w/o delimiter: all sub-objects are returned
+    // In case path is a blob, we'll get an empty list.
+    // Objects are deleted page after page ; directory markers are deleted
+    // last (the deepest ones first), so that in case we are interrupted,
+    // remaining objects are still visible.
+    std::shared_ptr<std::vector<CPath>> p_markers =
+                                        std::make_shared<std::vector<CPath>>();
+    std::shared_ptr<std::atomic<bool>> p_deleted =
+                                std::make_shared<std::atomic<bool>>(false);
+    ForgetKnownFolders(path);
+    return ListObjectsWithinFolderAsync(path, U(""),
+                [this, p_markers, p_deleted](const web::json::array& array) {
+        std::shared_ptr<std::vector<CPath>> p_paths =
+                                        std::make_shared<std::vector<CPath>>();
+        std::shared_ptr<std::vector<CPath>> p_large_objects =
+                                        std::make_shared<std::vector<CPath>>();
+        for (web::json::array::size_type i = 0; i < array.size(); ++i) {
+            const web::json::value& obj = array.at(i);
+            CPath obj_path(U("/") + obj.at(U("name")).as_string());
+            if (JsonForKey(obj, U("content_type"), string_t())
+                                                    == kContentTypeDirectory) {
+                p_markers->push_back(obj_path);
+            } else if (MayBeLargeObject(obj, large_object_threshold_)) {
+                p_large_objects->push_back(obj_path);
             } else {
-                p_file = std::make_shared<CFolder>(
-                            CPath(obj.at(U("name")).as_string()),
-                            swift_details::ParseLastModified(val));
+                p_paths->push_back(obj_path);
             }
         }
+        return DeleteObjectsAsync(p_paths, true).then(
+                            [this, p_large_objects, p_deleted](bool deleted) {
+            if (deleted) {
+                *p_deleted = true;
+            }
+            return DeleteObjectsAsync(p_large_objects, false);
+        }).then([p_deleted](bool deleted) {
+            if (deleted) {
+                *p_deleted = true;
+            }
+        });
+    }).then([this, path, p_markers, p_deleted](size_t count) {
+        // Directory markers are deleted level by level, deepest first:
+        std::map<size_t, std::shared_ptr<std::vector<CPath>>,
+                 std::greater<size_t>> levels;
+        for (const CPath& marker : *p_markers) {
+            std::shared_ptr<std::vector<CPath>>& p_level =
+                                                levels[marker.Split().size()];
+            if (!p_level) {
+                p_level = std::make_shared<std::vector<CPath>>();
+            }
+            p_level->push_back(marker);
+        }
+        pplx::task<void> markers_task = pplx::task_from_result();
+        for (const auto& level : levels) {
+            std::shared_ptr<std::vector<CPath>> p_level = level.second;
+            markers_task = markers_task.then([this, p_level] {
+                return DeleteObjectsAsync(p_level, true);
+            }).then([p_deleted](bool deleted) {
+                if (deleted) {
+                    *p_deleted = true;
+                }
+            });
+        }
+        // Now we also delete that top-level folder (or blob):
+        // (only a blob may be a large object)
+        bool may_be_manifest = count == 0;
+        return markers_task.then([this, path, may_be_manifest] {
+            return DeleteObjectAsync(path, may_be_manifest);
+        }).then([this, path, p_deleted](bool deleted) {
+            // folders may have been seen again while being deleted:
+            ForgetKnownFolders(path);
+            return deleted || *p_deleted;
+        });
+    });
+}
 
-        if (detailed || !cfcb.HasPath(path)) {
-            // If we got a detailed file, we always store it
-            // If we got only rough description,
-            // we keep it only if no info already exists
-            cfcb.Add(p_file->path(), p_file);
+pplx::task<bool> SwiftClient::DeleteObjectsAsync(
+                            std::shared_ptr<const std::vector<CPath>> p_paths,
+                            bool bulk_allowed) {
+    if (p_paths->empty()) {
+        return pplx::task_from_result(false);
+    }
+    if (bulk_allowed && !bulk_delete_unsupported_) {
+        return BulkDeleteAsync(p_paths, 0, false);
+    }
+    return ParallelDeleteAsync(p_paths, 0, !bulk_allowed);
+}
+
+/**
+ * \brief Check the result of a bulk delete (or of a large object deletion):
+ *        objects not found are ignored, other errors are reported.
+ *
+ * @param json the response body, as json
+ * @throws CStorageException if some object could not be deleted
+ */
+static void CheckBulkDeleteResult(const web::json::value& json) {
+    // Errors are reported per object, as [ name, status ] pairs:
+    if (json.has_field(U("Errors"))) {
+        const web::json::array& errors = json.at(U("Errors")).as_array();
+        for (web::json::array::size_type i = 0; i < errors.size(); ++i) {
+            const web::json::value& error = errors.at(i);
+            string_t status = error.at(1).as_string();
+            if (!boost::starts_with(status, U("404"))) {
+                BOOST_THROW_EXCEPTION(CStorageException(
+                    "Bulk delete failed for object "
+                    + utility::conversions::to_utf8string(
+                                                    error.at(0).as_string())
+                    + ": " + utility::conversions::to_utf8string(status)));
+            }
         }
     }
-    return cfcb.BuildFolderContent();
+    // Other errors (if any) are only in global status:
+    string_t status = JsonForKey(json, U("Response Status"), string_t());
+    if (!status.empty() && !boost::starts_with(status, U("2"))
+            && !boost::starts_with(status, U("404"))) {
+        BOOST_THROW_EXCEPTION(CStorageException(
+                    "Bulk delete failed: "
+                    + utility::conversions::to_utf8string(status) + " "
+                    + utility::conversions::to_utf8string(JsonForKey(
+                            json, U("Response Body"), string_t()))));
+    }
 }
 
-bool SwiftClient::CreateFolder(const CPath& path) {
-    std::shared_ptr<CFile> p_file = GetFile(path);
-    if (p_file) {
-        if (p_file->IsFolder()) {
-            return false;  // folder already exists
+pplx::task<bool> SwiftClient::BulkDeleteAsync(
+                            std::shared_ptr<const std::vector<CPath>> p_paths,
+                            size_t index,
+                            bool at_least_one_deleted) {
+    if (index >= p_paths->size()) {
+        return pplx::task_from_result(at_least_one_deleted);
+    }
+    if (bulk_delete_unsupported_) {
+        return ParallelDeleteAsync(p_paths, index, false).then(
+                                    [at_least_one_deleted](bool deleted) {
+            return at_least_one_deleted || deleted;
+        });
+    }
+    // Body lists url encoded names of objects, one per line:
+    size_t end = std::min(p_paths->size(), index + kMaxBulkDeletes);
+    string_t container_prefix = U("/")
+                        + web::uri::encode_data_string(current_container_);
+    std::basic_ostringstream<char_t> body;
+    for (size_t i = index; i < end; ++i) {
+        body << container_prefix << (*p_paths)[i].GetUrlEncoded() << U("\n");
+    }
+    string_t body_str = body.str();
+    LOG_DEBUG << "Bulk deleting " << (end - index) << " objects";
+
+    web::uri_builder builder(account_endpoint_);
+    builder.append_query(U("bulk-delete"));
+    web::uri uri = builder.to_uri();
+    RequestInvoker ri = GetApiRequestInvoker();
+    return utilities::InvokeRetryAsync<std::shared_ptr<CResponse>>(
+                                            p_retry_strategy_.get(),
+                                            [ri, uri, body_str] {
+        web::http::http_request request(web::http::methods::POST);
+        request.set_request_uri(uri);
+        request.headers().add(web::http::header_names::accept,
+                              U("application/json"));
+        request.set_body(body_str, U("text/plain"));
+        return ri.InvokeAsync(request);
+    }).then([](std::shared_ptr<CResponse> p_response)
+                                        -> pplx::task<web::json::value> {
+        if (!p_response->IsJsonContentType()) {
+            return pplx::task_from_result(web::json::value::null());
+        }
+        return p_response->AsJsonAsync();
+    }).then([this, p_paths, index, end, at_least_one_deleted](
+                                web::json::value json) -> pplx::task<bool> {
+        if (!json.is_object() || !json.has_field(U("Number Deleted"))) {
+            // Request was understood as an account update:
+            LOG_INFO << "Bulk delete is not supported by server:"
+                        " objects will be deleted one by one";
+            bulk_delete_unsupported_ = true;
+            return BulkDeleteAsync(p_paths, index, at_least_one_deleted);
         }
-        // It is a blob: error !
-        BOOST_THROW_EXCEPTION(CInvalidFileTypeException(path, false));
+        CheckBulkDeleteResult(json);
+        bool deleted = JsonForKey(json, U("Number Deleted"), (int64_t)0) > 0;
+        return BulkDeleteAsync(p_paths, end, at_least_one_deleted || deleted);
+    });
+}
+
+pplx::task<bool> SwiftClient::ParallelDeleteAsync(
+                            std::shared_ptr<const std::vector<CPath>> p_paths,
+                            size_t index,
+                            bool may_be_manifests) {
+    std::shared_ptr<std::atomic<size_t>> p_next =
+                                std::make_shared<std::atomic<size_t>>(index);
+    std::shared_ptr<std::atomic<bool>> p_deleted =
+                                std::make_shared<std::atomic<bool>>(false);
+    std::vector<pplx::task<void>> lanes;
+    for (size_t i = index;
+         i < p_paths->size()
+            && lanes.size() < static_cast<size_t>(kMaxDeletesConcurrency);
+         ++i) {
+        lanes.push_back(DeleteNextObjectsAsync(p_paths, p_next, p_deleted,
+                                               may_be_manifests));
     }
-    if (use_directory_markers_) {
-        CreateIntermediateFoldersObjects(path.GetParent());
+    return pplx::when_all(lanes.begin(), lanes.end()).then([p_deleted] {
+        return p_deleted->load();
+    });
+}
+
+pplx::task<void> SwiftClient::DeleteNextObjectsAsync(
+                            std::shared_ptr<const std::vector<CPath>> p_paths,
+                            std::shared_ptr<std::atomic<size_t>> p_next,
+                            std::shared_ptr<std::atomic<bool>> p_deleted,
+                            bool may_be_manifests) {
+    size_t index = (*p_next)++;
+    if (index >= p_paths->size()) {
+        return pplx::task_from_result();
     }
-    RawCreateFolder(path);
-    return true;
+    return DeleteObjectAsync((*p_paths)[index], may_be_manifests).then(
+        [this, p_paths, p_next, p_deleted, may_be_manifests](bool deleted) {
+        if (deleted) {
+            *p_deleted = true;
+        }
+        return DeleteNextObjectsAsync(p_paths, p_next, p_deleted,
+                                      may_be_manifests);
+    });
 }
 
-bool SwiftClient::Delete(const CPath& path) {
-    // Request sub-objects w/o delimiter: all sub-objects are returned
-    // In case path is a blob, we'll get an empty list
-    web::json::value json = ListObjectsWithinFolder(path, U(""));
-    // Now delete all objects ; we start with the deepest ones so that
-    // in case we are interrupted, directory markers are still present
-    // Note: swift may guarantee that list is ordered,
-    // but could not confirm information...
-    std::list<string_t> pathnames;
-    const web::json::array& array = json.as_array();
-    for (web::json::array::size_type i = 0; i < array.size(); ++i) {
-        const web::json::value& obj = array.at(i);
-        pathnames.push_back(U("/") + obj.at(U("name")).as_string());
-    }
-    pathnames.sort();
-    pathnames.reverse();
-    // Now we also add that top-level folder (or blob) to delete :
-    pathnames.push_back(path.path_name());
-
-    bool at_least_one_deleted = false;
-    for (string_t pathname : pathnames) {
-        LOG_DEBUG << "deleting object at path: "
-                  << utility::conversions::to_utf8string(pathname);
-        CPath path(pathname);
-        string_t url = GetObjectUrl(path);
-        RequestInvoker ri = GetApiRequestInvoker(&path);
-        std::shared_ptr<CResponse> p_response;
-        try {
-            p_retry_strategy_->InvokeRetry([&] {
-                web::http::http_request request(web::http::methods::DEL);
-                request.set_request_uri(web::uri(url));
-                p_response = ri.Invoke(request);
-                at_least_one_deleted = true;
+pplx::task<bool> SwiftClient::DeleteObjectAsync(const CPath& path,
+                                                bool may_be_manifest) {
+    LOG_DEBUG << "deleting object at path: " << path.path_name_utf8();
+    pplx::task<bool> is_manifest_task = pplx::task_from_result(false);
+    if (may_be_manifest) {
+        // Only manifests must be deleted with their segments:
+        is_manifest_task = HeadOrNullAsync(path).then([](
+                std::shared_ptr<web::http::http_headers> p_headers) -> bool {
+            // if no object, DELETE will report object does not exist
+            return p_headers && IsLargeObject(*p_headers);
+        });
+    }
+    string_t url = GetObjectUrl(path);
+    RequestInvoker ri = GetApiRequestInvoker(&path);
+    return is_manifest_task.then([this, path, ri, url](bool is_manifest)
+                                                    -> pplx::task<void> {
+        if (is_manifest) {
+            return DeleteManifestAsync(path);
+        }
+        return p_retry_strategy_->InvokeRetryAsync([ri, url] {
+            web::http::http_request request(web::http::methods::DEL);
+            request.set_request_uri(web::uri(url));
+            return ri.InvokeAsync(request).then(
+                                    [](std::shared_ptr<CResponse> p_response) {
+                // not interested in response body
             });
+        });
+    }).then([](pplx::task<void> delete_task) -> bool {
+        try {
+            delete_task.get();
+            return true;
         }
         catch (CFileNotFoundException&) {
             // object already deleted ? continue
+            return false;
         }
-    }
-    return at_least_one_deleted;
+    });
 }
 
-std::shared_ptr<CFile> SwiftClient::GetFile(const CPath& path) {
-    std::shared_ptr<CFile> p_ret;  // empty pointer for now
-    std::unique_ptr<web::http::http_headers> p_headers = HeadOrNull(path);
-    if (!p_headers) {
-        return p_ret;
-    }
-    string_t content_type = p_headers->content_type();  // empty if not present
-    if (content_type.empty()) {
-        LOG_WARN << path.path_name_utf8() << " object has no content type ?!";
+pplx::task<void> SwiftClient::DeleteManifestAsync(const CPath& path) {
+    LOG_DEBUG << "deleting large object at path: " << path.path_name_utf8();
+    // Segments are deleted with their manifest ; server reports the result
+    // as a bulk delete response:
+    web::uri_builder builder(GetObjectUrl(path));
+    builder.append_query(U("multipart-manifest=delete"));
+    web::uri uri = builder.to_uri();
+    RequestInvoker ri = GetBasicRequestInvoker(path);
+    return utilities::InvokeRetryAsync<std::shared_ptr<CResponse>>(
+                                            p_retry_strategy_.get(),
+                                            [ri, uri] {
+        web::http::http_request request(web::http::methods::DEL);
+        request.set_request_uri(uri);
+        request.headers().add(web::http::header_names::accept,
+                              U("application/json"));
+        return ri.InvokeAsync(request);
+    }).then([](std::shared_ptr<CResponse> p_response)
+                                        -> pplx::task<web::json::value> {
+        if (!p_response->IsJsonContentType()) {
+            return pplx::task_from_result(web::json::value::null());
+        }
+        return p_response->AsJsonAsync();
+    }).then([path](web::json::value json) {
+        if (!json.is_object()) {
+            LOG_WARN << "Unexpected response when deleting large object "
+                     << path.path_name_utf8() << ": segments may remain";
+            return;
+        }
+        CheckBulkDeleteResult(json);
+    });
+}
+
+pplx::task<std::shared_ptr<CFile>> SwiftClient::GetFileAsync(
+            const CPath& path,
+            std::shared_ptr<web::http::http_headers> p_response_headers) {
+    LruCacheGeneration generation = known_folders_.generation();
+    return HeadOrNullAsync(path).then([this, path, generation,
+                                       p_response_headers](
+                        std::shared_ptr<web::http::http_headers> p_headers)
+                                                    -> std::shared_ptr<CFile> {
+        std::shared_ptr<CFile> p_ret;  // empty pointer for now
+        bool known;
+        if (!p_headers) {
+            if (known_folders_.Get(path, &known)) {  // no longer exists
+                known_folders_.Erase(path);
+            }
+            return p_ret;
+        }
+        if (p_response_headers) {
+            *p_response_headers = *p_headers;
+        }
+        // empty if not present:
+        string_t content_type = p_headers->content_type();
+        if (content_type.empty()) {
+            LOG_WARN << path.path_name_utf8()
+                     << " object has no content type ?!";
+            return p_ret;
+        }
+        if (content_type != kContentTypeDirectory) {
+            if (known_folders_.Get(path, &known)) {  // replaced by a blob
+                known_folders_.Erase(path);
+            }
+            p_ret.reset(new CBlob(
+                    path,
+                    boost::lexical_cast<int64_t>(p_headers->content_length()),
+                    content_type,
+                    swift_details::ParseTimestamp(*p_headers)));
+        } else {
+            known_folders_.Put(path, true, generation);
+            p_ret.reset(new CFolder(path,
+                                    swift_details::ParseTimestamp(*p_headers)));
+        }
         return p_ret;
-    }
-    if (content_type != kContentTypeDirectory) {
-        p_ret.reset( new CBlob(
-                path,
-                boost::lexical_cast<int64_t>(p_headers->content_length()),
-                content_type,
-                swift_details::ParseTimestamp(*p_headers)));
-    } else {
-        p_ret.reset(new CFolder(path,
-                                swift_details::ParseTimestamp(*p_headers)));
-    }
-    return p_ret;
+    });
 }
 
-void SwiftClient::Download(const CDownloadRequest& download_request) {
+pplx::task<void> SwiftClient::DownloadAsync(
+                                    const CDownloadRequest& download_request) {
     const CPath& path = download_request.path();
     string_t url = GetObjectUrl(path);
 
     RequestInvoker ri = GetBasicRequestInvoker(path);
-    std::shared_ptr<CResponse> p_response;
-    p_retry_strategy_->InvokeRetry([&] {
+    return p_retry_strategy_->InvokeRetryAsync([ri, url, download_request] {
+        // Sink may hold bytes of a previous attempt: then we only request
+        // the remaining ones
+        std::shared_ptr<ByteSink> p_byte_sink = download_request.GetByteSink();
+        int64_t resume_offset;
         web::http::http_request request(web::http::methods::GET);
         request.set_request_uri(web::uri(url));
-        for (auto kv : download_request.GetHttpHeaders()) {
+        for (auto kv : download_request.GetHttpHeaders(*p_byte_sink,
+                                                        &resume_offset)) {
             request.headers().add(kv.first, kv.second);
         }
-        p_response = ri.Invoke(request);
-        if (p_response->headers().content_type() == kContentTypeDirectory) {
-            BOOST_THROW_EXCEPTION(CInvalidFileTypeException(path, true));
-        }
-        std::shared_ptr<ByteSink> p_sink = download_request.GetByteSink();
-        p_response->DownloadDataToSink(p_sink.get());
+        return ri.InvokeAsync(request).then([download_request, p_byte_sink,
+                                             resume_offset](
+                                    std::shared_ptr<CResponse> p_response) {
+            if (p_response->headers().content_type() == kContentTypeDirectory) {
+                BOOST_THROW_EXCEPTION(CInvalidFileTypeException(
+                                            download_request.path(), true));
+            }
+            return p_response->DownloadDataToSinkAsync(
+                                            p_byte_sink,
+                                            download_request.chunk_size(),
+                                            resume_offset,
+                                            download_request.IsPartial());
+        });
     });
 }
 
-void SwiftClient::Upload(const CUploadRequest& upload_request) {
-    const CPath& path = upload_request.path();
+pplx::task<void> SwiftClient::UploadAsync(
+                            const CUploadRequest& upload_request,
+                            std::shared_ptr<std::shared_ptr<CBlob>> p_blob) {
+    const CPath path = upload_request.path();
+    bool large_object = large_object_threshold_ >= 0
+                        && upload_request.byte_source()->Length()
+                                                    > large_object_threshold_;
+    // Segments of a replaced large object are not deleted with it:
+    // they are collected before upload, and deleted afterwards
+    std::shared_ptr<std::vector<string_t>> p_replaced_segments =
+                                    std::make_shared<std::vector<string_t>>();
 
-    // Check before upload : is it a folder ?
-    // (uploading a blob to a folder would work,
-    //  but would hide all folder sub-files)
-    std::shared_ptr<CFile> p_file = GetFile(path);
-    if (p_file && p_file->IsFolder()) {
-        BOOST_THROW_EXCEPTION(CInvalidFileTypeException(path, true));
+    pplx::task<void> check_task;
+    pplx::task<void> replaced_task = pplx::task_from_result();
+    if (upload_request.optimistic()) {
+        // No check before upload (server would not report a folder
+        // replaced by blob, this is checked afterwards), except for folders
+        // known to exist:
+        bool exists;
+        if (known_folders_.Get(path, &exists)) {
+            try {
+                BOOST_THROW_EXCEPTION(CInvalidFileTypeException(path, true));
+            }
+            catch (...) {
+                return pplx::task_from_exception<void>(
+                                                    std::current_exception());
+            }
+        }
+        check_task = use_directory_markers_ ?
+                    CreateIntermediateFoldersObjectsAsync(path.GetParent()) :
+                    pplx::task_from_result();
+        if (large_object) {
+            // replaced object is checked while segments are uploaded
+            // (small blobs are uploaded without any check):
+            replaced_task = GetReplacedSegmentsAsync(path,
+                                                     p_replaced_segments);
+        }
+    } else {
+        // Check before upload : is it a folder ?
+        // (uploading a blob to a folder would work,
+        //  but would hide all folder sub-files)
+        std::shared_ptr<web::http::http_headers> p_headers =
+                                std::make_shared<web::http::http_headers>();
+        check_task = GetFileAsync(path, p_headers).then([this, path,
+                                            p_headers, p_replaced_segments](
+                std::shared_ptr<CFile> p_file) -> pplx::task<void> {
+            if (p_file && p_file->IsFolder()) {
+                BOOST_THROW_EXCEPTION(CInvalidFileTypeException(path, true));
+            }
+            pplx::task<void> segments_task = pplx::task_from_result();
+            if (p_file) {
+                segments_task = GetReplacedSegmentsAsync(path,
+                                                         p_replaced_segments,
+                                                         p_headers);
+            }
+            if (use_directory_markers_) {
+                return segments_task.then([this, path] {
+                    return CreateIntermediateFoldersObjectsAsync(
+                                                            path.GetParent());
+                });
+            }
+            return segments_task;
+        });
     }
-    if (use_directory_markers_) {
-        CreateIntermediateFoldersObjects(path.GetParent());
+    pplx::task<void> upload_task = check_task.then([this, upload_request,
+                                                    large_object,
+                                                    replaced_task, p_blob]()
+                                                        -> pplx::task<void> {
+        const CPath& path = upload_request.path();
+        if (large_object) {
+            return UploadLargeObjectAsync(upload_request, replaced_task).then(
+                                    [this, path, p_blob]() -> pplx::task<void> {
+                if (!p_blob) {
+                    return pplx::task_from_result();
+                }
+                // manifest response does not describe large object:
+                return GetUploadedBlobAsync(path, p_blob);
+            });
+        }
+        std::shared_ptr<web::http::http_headers> p_headers;
+        if (p_blob) {
+            p_headers = std::make_shared<web::http::http_headers>();
+        }
+        return RawUploadAsync(upload_request, p_headers).then(
+                    [this, upload_request, p_blob, p_headers]()
+                                                        -> pplx::task<void> {
+            if (!p_blob) {
+                return pplx::task_from_result();
+            }
+            if (upload_request.content_type().empty()) {
+                // content type has been chosen by server:
+                return GetUploadedBlobAsync(upload_request.path(), p_blob);
+            }
+            *p_blob = std::make_shared<CBlob>(
+                        upload_request.path(),
+                        upload_request.byte_source()->Length(),
+                        upload_request.content_type(),
+                        swift_details::ParseLastModifiedHeader(*p_headers));
+            return pplx::task_from_result();
+        });
+    });
+    if (upload_request.optimistic()) {
+        upload_task = upload_task.then([this, path, large_object] {
+            return CheckNoFolderReplacedAsync(path, large_object);
+        });
     }
+    // Replaced object is no longer referenced: delete its segments
+    return upload_task.then([this, path, p_replaced_segments] {
+        if (p_replaced_segments->empty()) {
+            return pplx::task_from_result();
+        }
+        LOG_DEBUG << "Deleting " << p_replaced_segments->size()
+                  << " segments of replaced large object "
+                  << path.path_name_utf8();
+        return DeleteSegmentsAsync(path, p_replaced_segments);
+    });
+}
+
+pplx::task<void> SwiftClient::CheckNoFolderReplacedAsync(const CPath& path,
+                                                         bool large_object) {
+    // A single listed object below path is enough:
+    web::uri_builder builder(GetCurrentContainerUrl());
+    builder.append_query(U("prefix=") + web::uri::encode_data_string(
+                                        path.path_name().substr(1) + U("/")));
+    builder.append_query(U("limit"), 1);
+    web::uri uri = builder.to_uri();
+    RequestInvoker ri = GetApiRequestInvoker(&path);
+    return utilities::InvokeRetryAsync<std::shared_ptr<CResponse>>(
+                                            p_retry_strategy_.get(),
+                                            [ri, uri] {
+        web::http::http_request request(web::http::methods::GET);
+        request.set_request_uri(uri);
+        return ri.InvokeAsync(request);
+    }).then([](std::shared_ptr<CResponse> p_response) {
+        return p_response->AsJsonAsync();
+    }).then([this, path, large_object](web::json::value json)
+                                                        -> pplx::task<void> {
+        if (json.size() == 0) {
+            return pplx::task_from_result();
+        }
+        LOG_WARN << "Blob uploaded over folder " << path.path_name_utf8()
+                 << ": blob is removed";
+        pplx::task<void> restore_task = pplx::task_from_result();
+        if (large_object || !use_directory_markers_) {
+            // (segments of a large object are deleted with it)
+            restore_task = DeleteObjectAsync(path, large_object).then(
+                                                            [](bool deleted) {
+            });
+        }
+        if (use_directory_markers_) {
+            restore_task = restore_task.then([this, path] {
+                return RawCreateFolderAsync(path);
+            });
+        }
+        return restore_task.then([path] {
+            BOOST_THROW_EXCEPTION(CInvalidFileTypeException(path, true));
+        });
+    });
+}
+
+pplx::task<void> SwiftClient::GetReplacedSegmentsAsync(
+                    const CPath& path,
+                    std::shared_ptr<std::vector<string_t>> p_segments_urls,
+                    std::shared_ptr<web::http::http_headers> p_headers) {
+    pplx::task<std::shared_ptr<web::http::http_headers>> head_task =
+            p_headers ? pplx::task_from_result(p_headers)
+                      : HeadOrNullAsync(path);
+    return head_task.then([this, path, p_segments_urls](
+            std::shared_ptr<web::http::http_headers> p_headers)
+                                                        -> pplx::task<void> {
+        if (!p_headers || !IsLargeObject(*p_headers)) {
+            return pplx::task_from_result();
+        }
+        return GetManifestSegmentsAsync(path, p_segments_urls);
+    }).then([path, p_segments_urls](pplx::task<void> segments_task) {
+        try {
+            segments_task.get();
+        }
+        catch (...) {
+            // upload can go on: only cleanup is compromised
+            LOG_WARN << "Could not get segments of replaced large object "
+                     << path.path_name_utf8() << ": "
+                     << CurrentExceptionToString();
+            p_segments_urls->clear();
+        }
+    });
+}
+
+pplx::task<void> SwiftClient::GetManifestSegmentsAsync(
+                    const CPath& path,
+                    std::shared_ptr<std::vector<string_t>> p_segments_urls) {
+    web::uri_builder builder(GetObjectUrl(path));
+    builder.append_query(U("multipart-manifest=get"));
+    web::uri uri = builder.to_uri();
+    RequestInvoker ri = GetBasicRequestInvoker(path);
+    return utilities::InvokeRetryAsync<std::shared_ptr<CResponse>>(
+                                            p_retry_strategy_.get(),
+                                            [ri, uri] {
+        web::http::http_request request(web::http::methods::GET);
+        request.set_request_uri(uri);
+        return ri.InvokeAsync(request);
+    }).then([](std::shared_ptr<CResponse> p_response) {
+        return p_response->AsJsonAsync();
+    }).then([this, path, p_segments_urls](
+                                pplx::task<web::json::value> json_task) {
+        web::json::value json;
+        try {
+            json = json_task.get();
+        }
+        catch (CFileNotFoundException&) {
+            return;  // deleted in the meantime: nothing to clean up
+        }
+        // Segments are listed as /container/name:
+        const web::json::array& segments = json.as_array();
+        for (web::json::array::size_type i = 0; i < segments.size(); ++i) {
+            p_segments_urls->push_back(account_endpoint_ + CPath(
+                    segments.at(i).at(U("name")).as_string()).GetUrlEncoded());
+        }
+    });
+}
+
+pplx::task<void> SwiftClient::GetUploadedBlobAsync(
+                            const CPath& path,
+                            std::shared_ptr<std::shared_ptr<CBlob>> p_blob) {
+    return GetFileAsync(path).then([path, p_blob](
+                                            std::shared_ptr<CFile> p_file) {
+        if (!p_file || !p_file->IsBlob()) {
+            BOOST_THROW_EXCEPTION(CStorageException(
+                    "Blob not found after upload: " + path.path_name_utf8()));
+        }
+        *p_blob = std::static_pointer_cast<CBlob>(p_file);
+    });
+}
+
+pplx::task<void> SwiftClient::RawUploadAsync(
+            const CUploadRequest& upload_request,
+            std::shared_ptr<web::http::http_headers> p_response_headers) {
+    const CPath& path = upload_request.path();
     string_t url = GetObjectUrl(path);
     RequestInvoker ri = GetBasicRequestInvoker(path);
-    std::shared_ptr<CResponse> p_response;
-    p_retry_strategy_->InvokeRetry([&] {
+    return p_retry_strategy_->InvokeRetryAsync([ri, url, upload_request,
+                                                p_response_headers] {
         web::http::http_request request(web::http::methods::PUT);
         request.set_request_uri(web::uri(url));
 
         std::shared_ptr<ByteSource> p_bs = upload_request.GetByteSource();
-        std::unique_ptr<std::istream> p_bsis = p_bs->OpenStream();
+        std::shared_ptr<std::istream> p_bsis = p_bs->OpenStream();
         // wrap istream as asynchronous:
         concurrency::streams::stdio_istream<uint8_t> is_wrapper(*p_bsis);
         request.set_body(is_wrapper,
                          p_bs->Length(),  // content_length
                          upload_request.content_type());  // content_type
 
-        p_response = ri.Invoke(request);
-        // not interested in response body
+        // source stream is kept open until request completes:
+        return ri.InvokeAsync(request).then([p_bs, p_bsis, p_response_headers](
+                                std::shared_ptr<CResponse> p_response) {
+            // not interested in response body
+            if (p_response_headers) {
+                *p_response_headers = p_response->headers();
+            }
+        });
+    }).then([this, path](pplx::task<void> upload_task) {
+        try {
+            upload_task.get();
+        }
+        catch (CFileNotFoundException&) {
+            ForgetParentFolders(path);
+            throw;
+        }
     });
 }
 
+pplx::task<void> SwiftClient::GetLargeObjectLimitsAsync() {
+    pplx::task_completion_event<void> tce;
+    {
+        std::lock_guard<std::mutex> lock(slo_limits_mutex_);
+        if (slo_limits_requested_) {
+            return slo_limits_task_;
+        }
+        slo_limits_requested_ = true;
+        slo_limits_task_ = pplx::create_task(tce);
+    }
+    // Limits are published at the root of storage server:
+    web::uri_builder builder(web::uri(account_endpoint_).authority());
+    builder.set_path(U("/info"));
+    web::http::http_request request(web::http::methods::GET);
+    request.set_request_uri(builder.to_uri());
+    RequestInvoker ri = GetBasicRequestInvoker(CPath(U("/")));
+    ri.InvokeAsync(request).then([](std::shared_ptr<CResponse> p_response) {
+        return p_response->AsJsonAsync();
+    }).then([this, tce](pplx::task<web::json::value> json_task) {
+        web::json::value info;
+        try {
+            info = json_task.get();
+        }
+        catch (...) {
+            LOG_DEBUG << "Could not get large objects limits: "
+                      << ExceptionPtrToString(std::current_exception());
+        }
+        if (info.is_object() && info.has_field(U("slo"))
+                && info.at(U("slo")).is_object()) {
+            const web::json::value& slo = info.at(U("slo"));
+            std::lock_guard<std::mutex> lock(slo_limits_mutex_);
+            max_manifest_segments_ = std::max(static_cast<int64_t>(1),
+                    JsonForKey<int64_t>(slo, U("max_manifest_segments"),
+                                        max_manifest_segments_));
+            min_segment_size_ = JsonForKey<int64_t>(
+                        slo, U("min_segment_size"), min_segment_size_);
+            LOG_DEBUG << "Large objects limits: at most "
+                      << max_manifest_segments_ << " segments of at least "
+                      << min_segment_size_ << " bytes";
+        }
+        tce.set();
+    });
+    return slo_limits_task_;
+}
 
-std::unique_ptr<web::http::http_headers> SwiftClient::HeadOrNull(
-                                                        const CPath& path) {
-    std::unique_ptr<web::http::http_headers> p_ret;  // empty pointer for now
-    try {
-        string_t url = GetObjectUrl(path);
+int64_t SwiftClient::GetSegmentSize(int64_t length) {
+    std::lock_guard<std::mutex> lock(slo_limits_mutex_);
+    if (segment_size_ < min_segment_size_) {
+        std::ostringstream msg;
+        msg << "Segment size " << segment_size_
+            << " is below server minimum segment size " << min_segment_size_;
+        BOOST_THROW_EXCEPTION(CStorageException(msg.str()));
+    }
+    // Server would reject manifest once all segments are uploaded:
+    int64_t min_size = (length + max_manifest_segments_ - 1)
+                                                    / max_manifest_segments_;
+    if (segment_size_ < min_size) {
+        LOG_DEBUG << "Segments enlarged to " << min_size << " bytes (at most "
+                  << max_manifest_segments_ << " segments)";
+        return min_size;
+    }
+    return segment_size_;
+}
+
+pplx::task<void> SwiftClient::UploadLargeObjectAsync(
+                                        const CUploadRequest& upload_request,
+                                        pplx::task<void> replaced_task) {
+    return GetLargeObjectLimitsAsync().then([this, upload_request,
+                                             replaced_task] {
+        int64_t segment_size = GetSegmentSize(
+                                    upload_request.byte_source()->Length());
+        return UploadSegmentedObjectAsync(upload_request, replaced_task,
+                                          segment_size);
+    });
+}
+
+pplx::task<void> SwiftClient::UploadSegmentedObjectAsync(
+                                        const CUploadRequest& upload_request,
+                                        pplx::task<void> replaced_task,
+                                        int64_t segment_size) {
+    std::shared_ptr<ByteSource> p_source = upload_request.byte_source();
+    int64_t length = p_source->Length();
+    size_t nb_segments = static_cast<size_t>(
+                                (length + segment_size - 1) / segment_size);
+    std::shared_ptr<LargeObjectUpload> p_upload =
+            std::make_shared<LargeObjectUpload>(upload_request.path(),
+                                                nb_segments);
+    p_upload->content_type = upload_request.content_type();
+    p_upload->p_source = p_source;
+    p_upload->p_listener = upload_request.progress_listener();
+    p_upload->length = length;
+    p_upload->segment_size = segment_size;
+    // Segments of each upload are distinct, so that a failed upload
+    // does not alter a previous version of object:
+    int64_t now_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+    std::basic_ostringstream<char_t> prefix;
+    prefix << upload_request.path().path_name().substr(1) << U("/slo/")
+           << now_us << U("/") << length << U("/") << segment_size << U("/");
+    p_upload->segments_prefix = prefix.str();
+    LOG_DEBUG << "Uploading " << upload_request.path() << " as "
+              << nb_segments << " segments";
+    if (p_upload->p_listener) {
+        p_upload->p_listener->SetProgressTotal(length);
+        p_upload->p_listener->Progress(0);
+    }
+
+    return CreateSegmentsContainerAsync().then([this, p_upload, nb_segments] {
+        std::vector<pplx::task<void>> lanes;
+        size_t nb_lanes = std::min(nb_segments,
+                            static_cast<size_t>(max_segments_concurrency_));
+        for (size_t i = 0; i < nb_lanes; ++i) {
+            lanes.push_back(UploadSegmentsAsync(p_upload));
+        }
+        return pplx::when_all(lanes.begin(), lanes.end());
+    }).then([this, p_upload, replaced_task]() -> pplx::task<void> {
+        if (!p_upload->p_error) {
+            return replaced_task.then([this, p_upload] {
+                return PutManifestAsync(p_upload);
+            });
+        }
+        return pplx::task_from_result();
+    }).then([this, p_upload](pplx::task<void> upload_task)
+                                                        -> pplx::task<void> {
+        try {
+            upload_task.get();
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(p_upload->mutex);
+            if (!p_upload->p_error) {
+                p_upload->p_error = std::current_exception();
+            }
+        }
+        if (!p_upload->p_error) {
+            return pplx::task_from_result();
+        }
+        LOG_WARN << "Large object upload failed: "
+                 << ExceptionPtrToString(p_upload->p_error);
+        std::shared_ptr<std::vector<string_t>> p_segments_urls =
+                                    std::make_shared<std::vector<string_t>>();
+        for (size_t i = 0; i < p_upload->etags.size(); ++i) {
+            if (!p_upload->etags[i].empty()) {  // uploaded
+                p_segments_urls->push_back(
+                                GetSegmentUrl(p_upload->SegmentName(i)));
+            }
+        }
+        return DeleteSegmentsAsync(p_upload->path, p_segments_urls).then(
+                                                                [p_upload] {
+            std::rethrow_exception(p_upload->p_error);
+        });
+    });
+}
+
+pplx::task<void> SwiftClient::UploadSegmentsAsync(
+                                std::shared_ptr<LargeObjectUpload> p_upload) {
+    size_t index;
+    {
+        std::lock_guard<std::mutex> lock(p_upload->mutex);
+        if (p_upload->p_error
+            || p_upload->next_segment >= p_upload->etags.size()) {
+            // Nothing more to upload: lane is over
+            return pplx::task_from_result();
+        }
+        index = p_upload->next_segment++;
+    }
+    std::shared_ptr<ByteSource> p_segment_source =
+            std::make_shared<detail::RangeByteSource>(
+                                    p_upload->p_source,
+                                    index * p_upload->segment_size,
+                                    p_upload->SegmentLength(index));
+    return UploadSegmentAsync(p_upload->path,
+                              p_upload->SegmentName(index),
+                              p_segment_source).then([this, p_upload, index](
+                    pplx::task<string_t> segment_task) -> pplx::task<void> {
+        try {
+            string_t etag = segment_task.get();
+            std::lock_guard<std::mutex> lock(p_upload->mutex);
+            p_upload->etags[index] = etag;
+            p_upload->uploaded += p_upload->SegmentLength(index);
+            if (p_upload->p_listener) {
+                p_upload->p_listener->Progress(p_upload->uploaded);
+            }
+        }
+        catch (...) {
+            LOG_DEBUG << "Segment #" << index << " upload failed: "
+                      << CurrentExceptionToString();
+            std::lock_guard<std::mutex> lock(p_upload->mutex);
+            if (!p_upload->p_error) {
+                p_upload->p_error = std::current_exception();
+            }
+            return pplx::task_from_result();
+        }
+        return UploadSegmentsAsync(p_upload);
+    });
+}
 
-        RequestInvoker ri = GetBasicRequestInvoker(path);
-        std::shared_ptr<CResponse> p_response;
-        p_retry_strategy_->InvokeRetry([&] {
-            web::http::http_request request(web::http::methods::HEAD);
+pplx::task<string_t> SwiftClient::UploadSegmentAsync(
+                                        const CPath& path,
+                                        const string_t& segment_name,
+                                        std::shared_ptr<ByteSource> p_source) {
+    string_t url = GetSegmentUrl(segment_name);
+    RequestInvoker ri = GetBasicRequestInvoker(path);
+    RetryStrategy *p_retry_strategy = p_segments_retry_strategy_ ?
+                p_segments_retry_strategy_.get() : p_retry_strategy_.get();
+    return utilities::InvokeRetryAsync<string_t>(p_retry_strategy,
+                                                 [ri, url, p_source] {
+        web::http::http_request request(web::http::methods::PUT);
+        request.set_request_uri(web::uri(url));
+        std::shared_ptr<std::istream> p_is = p_source->OpenStream();
+        concurrency::streams::stdio_istream<uint8_t> is_wrapper(*p_is);
+        request.set_body(is_wrapper,
+                         p_source->Length(),  // content_length
+                         U("application/octet-stream"));  // content_type
+
+        // source stream is kept open until request completes:
+        return ri.InvokeAsync(request).then([p_source, p_is](
+                        std::shared_ptr<CResponse> p_response) -> string_t {
+            string_t etag;
+            auto it = p_response->headers().find(
+                                            web::http::header_names::etag);
+            if (it != p_response->headers().end()) {
+                etag = it->second;
+                boost::algorithm::trim_if(etag,
+                                          boost::algorithm::is_any_of(U("\"")));
+            }
+            return etag;
+        });
+    });
+}
+
+pplx::task<void> SwiftClient::PutManifestAsync(
+                                std::shared_ptr<LargeObjectUpload> p_upload) {
+    web::json::value manifest = web::json::value::array();
+    string_t container_path = U("/") + GetSegmentsContainer() + U("/");
+    for (size_t i = 0; i < p_upload->etags.size(); ++i) {
+        web::json::value segment;
+        segment[U("path")] = web::json::value::string(
+                                    container_path + p_upload->SegmentName(i));
+        segment[U("etag")] = web::json::value::string(p_upload->etags[i]);
+        segment[U("size_bytes")] = web::json::value::number(
+                                                p_upload->SegmentLength(i));
+        manifest[i] = segment;
+    }
+    web::uri_builder builder(GetObjectUrl(p_upload->path));
+    builder.append_query(U("multipart-manifest=put"));
+    web::uri uri = builder.to_uri();
+    string_t body = manifest.serialize();
+    // Manifest content type is object content type:
+    string_t content_type = p_upload->content_type;
+
+    RequestInvoker ri = GetBasicRequestInvoker(p_upload->path);
+    return p_retry_strategy_->InvokeRetryAsync([ri, uri, body, content_type] {
+        web::http::http_request request(web::http::methods::PUT);
+        request.set_request_uri(uri);
+        request.set_body(body, content_type);
+        return ri.InvokeAsync(request).then(
+                                    [](std::shared_ptr<CResponse> p_response) {
+            // not interested in response body
+        });
+    });
+}
+
+pplx::task<void> SwiftClient::DeleteSegmentsAsync(
+            const CPath& path,
+            std::shared_ptr<const std::vector<string_t>> p_segments_urls) {
+    pplx::task<void> delete_task = pplx::task_from_result();
+    RequestInvoker ri = GetBasicRequestInvoker(path);
+    for (const string_t& url : *p_segments_urls) {
+        delete_task = delete_task.then([ri, url] {
+            web::http::http_request request(web::http::methods::DEL);
             request.set_request_uri(web::uri(url));
-            p_response = ri.Invoke(request);
+            return ri.InvokeAsync(request);
+        }).then([](pplx::task<std::shared_ptr<CResponse>> task) {
+            try {
+                task.get();
+            }
+            catch (CFileNotFoundException&) {
+                // already deleted
+            }
+            catch (...) {
+                // segments cleanup is not critical
+                LOG_WARN << "Could not delete segment: "
+                         << CurrentExceptionToString();
+            }
         });
-        p_ret.reset(new web::http::http_headers(p_response->headers()));
     }
-    catch (CFileNotFoundException ex) {
-        // can happen if file does not exist
+    return delete_task;
+}
+
+pplx::task<void> SwiftClient::CreateSegmentsContainerAsync() {
+    if (segments_container_exists_) {
+        return pplx::task_from_result();
+    }
+    // Creating an existing container is harmless:
+    string_t url = account_endpoint_ + U("/") + GetSegmentsContainer();
+    RequestInvoker ri = GetBasicRequestInvoker(CPath(U("/")));
+    return p_retry_strategy_->InvokeRetryAsync([ri, url] {
+        web::http::http_request request(web::http::methods::PUT);
+        request.set_request_uri(web::uri(url));
+        request.headers().set_content_length(0);
+        return ri.InvokeAsync(request).then(
+                                    [](std::shared_ptr<CResponse> p_response) {
+            // not interested in response body
+        });
+    }).then([this] {
+        segments_container_exists_ = true;
+    });
+}
+
+
+pplx::task<std::shared_ptr<web::http::http_headers>>
+                        SwiftClient::HeadOrNullAsync(const CPath& path) {
+    string_t url = GetObjectUrl(path);
+
+    RequestInvoker ri = GetBasicRequestInvoker(path);
+    return utilities::InvokeRetryAsync<std::shared_ptr<CResponse>>(
+                                            p_retry_strategy_.get(),
+                                            [ri, url] {
+        web::http::http_request request(web::http::methods::HEAD);
+        request.set_request_uri(web::uri(url));
+        return ri.InvokeAsync(request);
+    }).then([](pplx::task<std::shared_ptr<CResponse>> head_task) {
+        // empty pointer for now:
+        std::shared_ptr<web::http::http_headers> p_ret;
+        try {
+            p_ret = std::make_shared<web::http::http_headers>(
+                                                    head_task.get()->headers());
+        }
+        catch (CFileNotFoundException&) {
+            // can happen if file does not exist
+        }
+        return p_ret;
+    });
+}
+
+void SwiftClient::ForgetKnownFolders(const CPath& path) {
+    string_t folder_prefix = path.path_name() + U("/");
+    known_folders_.EraseIf([&path, &folder_prefix](const CPath& known) {
+        return path.IsRoot() || known == path
+               || boost::starts_with(known.path_name(), folder_prefix);
+    });
+}
+
+void SwiftClient::ForgetParentFolders(const CPath& path) {
+    for (CPath parent = path.GetParent(); !parent.IsRoot();
+                                            parent = parent.GetParent()) {
+        known_folders_.Erase(parent);
     }
-    return p_ret;
 }
 
 void SwiftClient::UseContainer(string_t container_name) {
     current_container_ = container_name;
+    segments_container_exists_ = false;
+    known_folders_.Clear();
     LOG_DEBUG << "Using container: "
               << utility::conversions::to_utf8string(current_container_);
 }
@@ -402,59 +1564,94 @@ std::vector<string_t> SwiftClient::GetContainers() {
     return containers;
 }
 
-void SwiftClient::RawCreateFolder(const CPath& path) {
+pplx::task<void> SwiftClient::RawCreateFolderAsync(
+            const CPath& path,
+            std::shared_ptr<web::http::http_headers> p_response_headers) {
     string_t url = GetObjectUrl(path);
     RequestInvoker ri = GetApiRequestInvoker();
-    std::shared_ptr<CResponse> p_response;
-    p_retry_strategy_->InvokeRetry([&] {
+    LruCacheGeneration generation = known_folders_.generation();
+    return p_retry_strategy_->InvokeRetryAsync([ri, url, p_response_headers] {
         web::http::http_request request(web::http::methods::PUT);
         request.set_request_uri(web::uri(url));
         request.headers().set_content_type(kContentTypeDirectory);
         request.headers().set_content_length(0);
-        p_response = ri.Invoke(request);
+        return ri.InvokeAsync(request).then([p_response_headers](
+                                    std::shared_ptr<CResponse> p_response) {
+            // We are not interested in response body
+            if (p_response_headers) {
+                *p_response_headers = p_response->headers();
+            }
+        });
+    }).then([this, path, generation](pplx::task<void> create_task) {
+        try {
+            create_task.get();
+        }
+        catch (CFileNotFoundException&) {
+            ForgetParentFolders(path);
+            throw;
+        }
+        known_folders_.Put(path, true, generation);
     });
-    // We are not interested in response body
 }
 
-void SwiftClient::CreateIntermediateFoldersObjects(
+pplx::task<void> SwiftClient::CreateIntermediateFoldersObjectsAsync(
                                             const CPath& leaf_folder_path) {
     // We check for folder existence before creation,
     // as in general leaf folder is likely to already exist.
     // So we walk from leaf to root:
-    CPath path = leaf_folder_path;
+    std::shared_ptr<std::vector<CPath>> p_parent_folders =
+                                        std::make_shared<std::vector<CPath>>();
+    return FindMissingFoldersAsync(leaf_folder_path, p_parent_folders).then(
+                                                    [this, p_parent_folders] {
+        // By now we know which folders to create:
+        pplx::task<void> create_task = pplx::task_from_result();
+        if (!p_parent_folders->empty()) {
+            LOG_DEBUG << p_parent_folders->size()
+                      << " inexisting parent_folders will be created";
+            for (CPath parent : *p_parent_folders) {
+                create_task = create_task.then([this, parent] {
+                    LOG_TRACE << "Creating intermediate folder: "
+                              << parent.path_name_utf8();
+                    return RawCreateFolderAsync(parent);
+                });
+            }
+        }
+        return create_task;
+    });
+}
 
-    std::vector<CPath> parent_folders;
-    std::shared_ptr<CFile> p_file;
-    while (!path.IsRoot()) {  // loop, climbing in hierarchy
-        p_file = GetFile(path);
+pplx::task<void> SwiftClient::FindMissingFoldersAsync(
+                    const CPath& path,
+                    std::shared_ptr<std::vector<CPath>> p_missing_folders) {
+    // Deepest folder is always checked: the ones above are not checked
+    // if known to exist
+    bool exists;
+    if (path.IsRoot() || (!p_missing_folders->empty()
+                          && known_folders_.Get(path, &exists))) {
+        return pplx::task_from_result();
+    }
+    return GetFileAsync(path).then([this, path, p_missing_folders](
+                    std::shared_ptr<CFile> p_file) -> pplx::task<void> {
         if (p_file) {
             if (p_file->IsBlob()) {
                 // Problem here: clash between folder and blob
                 BOOST_THROW_EXCEPTION(CInvalidFileTypeException(path, false));
             }
-            break;
-        } else {
-            LOG_TRACE << "Nothing exists at path: "
-                      << path.path_name_utf8() << ", will go up";
-            parent_folders.insert(parent_folders.begin(), path);
-            path = path.GetParent();
-        }
-    }
-
-    // By now we know which folders to create:
-    if (!parent_folders.empty()) {
-        LOG_DEBUG << parent_folders.size()
-                  << " inexisting parent_folders will be created";
-        for (CPath parent : parent_folders) {
-            LOG_TRACE << "Creating intermediate folder: "
-                      << parent.path_name_utf8();
-            RawCreateFolder(parent);
+            return pplx::task_from_result();
         }
-    }
+        LOG_TRACE << "Nothing exists at path: "
+                  << path.path_name_utf8() << ", will go up";
+        p_missing_folders->insert(p_missing_folders->begin(), path);
+        // continue, climbing in hierarchy:
+        return FindMissingFoldersAsync(path.GetParent(), p_missing_folders);
+    });
 }
 
-web::json::value SwiftClient::ListObjectsWithinFolder(const CPath& path,
-                                                      string_t opt_delimiter) {
+pplx::task<size_t> SwiftClient::ListObjectsWithinFolderAsync(
+                                            const CPath& path,
+                                            string_t opt_delimiter,
+                                            objects_page_callback callback,
+                                            string_t marker) {
     // prefix should not start with a slash, but end with a slash:
     // '/path/to/folder' --> 'path/to/folder/'
     string_t prefix = path.path_name().substr(1) + U("/");
@@ -470,16 +1667,45 @@ web::json::value SwiftClient::ListObjectsWithinFolder(const CPath& path,
         builder.append_query(U("delimiter=")
                              + web::uri::encode_data_string(opt_delimiter));
     }
+    builder.append_query(U("limit"), listing_page_size_);
+    if (!marker.empty()) {
+        builder.append_query(U("marker=")
+                             + web::uri::encode_data_string(marker));
+    }
     uri = builder.to_uri();
 
     RequestInvoker ri = GetApiRequestInvoker(&path);
-    std::shared_ptr<CResponse> p_response;
-    p_retry_strategy_->InvokeRetry([&] {
+    return utilities::InvokeRetryAsync<std::shared_ptr<CResponse>>(
+                                            p_retry_strategy_.get(),
+                                            [ri, uri] {
         web::http::http_request request(web::http::methods::GET);
         request.set_request_uri(uri);
-        p_response = ri.Invoke(request);
+        return ri.InvokeAsync(request);
+    }).then([](std::shared_ptr<CResponse> p_response) {
+        return p_response->AsJsonAsync();
+    }).then([this, path, opt_delimiter, callback](web::json::value json) {
+        std::shared_ptr<web::json::value> p_json =
+                            std::make_shared<web::json::value>(std::move(json));
+        return callback(p_json->as_array()).then([this, path, opt_delimiter,
+                                                  callback, p_json]()
+                                                        -> pplx::task<size_t> {
+            const web::json::array& page = p_json->as_array();
+            if (page.size() < static_cast<size_t>(listing_page_size_)) {
+                return pplx::task_from_result(page.size());  // last page
+            }
+            // Next page starts after last listed name (or sub directory):
+            const web::json::value& last = page.at(page.size() - 1);
+            string_t next_marker = last.has_field(U("subdir")) ?
+                                        last.at(U("subdir")).as_string() :
+                                        last.at(U("name")).as_string();
+            size_t count = page.size();
+            return ListObjectsWithinFolderAsync(path, opt_delimiter,
+                                                callback, next_marker).then(
+                                                [count](size_t next_count) {
+                return count + next_count;
+            });
+        });
     });
-    return p_response->AsJson();
 }
 
 string_t SwiftClient::GetObjectUrl(const CPath& path) {
@@ -487,6 +1713,16 @@ string_t SwiftClient::GetObjectUrl(const CPath& path) {
     return container_url + path.GetUrlEncoded();
 }
 
+string_t SwiftClient::GetSegmentsContainer() {
+    GetCurrentContainerUrl();  // checks current container is defined
+    return current_container_ + U("_segments");
+}
+
+string_t SwiftClient::GetSegmentUrl(const string_t& segment_name) {
+    return account_endpoint_ + U("/") + GetSegmentsContainer()
+           + CPath(U("/") + segment_name).GetUrlEncoded();
+}
+
 string_t SwiftClient::GetCurrentContainerUrl() {
     if (current_container_.empty()) {
         BOOST_THROW_EXCEPTION(std::logic_error(
@@ -568,6 +1804,26 @@ boost::posix_time::ptime ParseTimestamp(
     return ret;
 }
 
+boost::posix_time::ptime ParseLastModifiedHeader(
+                                    const web::http::http_headers& headers) {
+    boost::posix_time::ptime ret = ParseTimestamp(headers);
+    if (!ret.is_not_a_date_time()) {
+        return ret;
+    }
+    // PUT responses only have Last-Modified (rounded to seconds),
+    // looks like "Thu, 16 Jan 2014 21:12:31 GMT"
+    auto it = headers.find(web::http::header_names::last_modified);
+    if (it == headers.end()) {
+        return ret;
+    }
+    std::locale loc(std::locale::classic(),
+            new boost::posix_time::time_input_facet("%a, %d %b %Y %H:%M:%S"));
+    std::istringstream is(utility::conversions::to_utf8string(it->second));
+    is.imbue(loc);
+    is >> ret;
+    return ret;
+}
+
 }  // namespace swift_details
 
 }  // namespace pcs_api
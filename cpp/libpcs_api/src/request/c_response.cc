@@ -14,6 +14,9 @@
  * limitations under the License.
  */
 
+#include <algorithm>
+#include <vector>
+
 #include "boost/lexical_cast.hpp"
 #include "boost/property_tree/xml_parser.hpp"
 #include "boost/algorithm/string.hpp"
@@ -46,6 +49,27 @@ static int64_t ExtractContentLength(const web::http::http_headers& headers) {
     return -1;
 }
 
+/**
+ * Get the validator of response entity, for later conditional range
+ * requests: strong ETag if present, Last-Modified otherwise.
+ *
+ * @param headers
+ * @return validator, or an empty string if none is available
+ */
+static string_t ExtractValidator(const web::http::http_headers& headers) {
+    auto it = headers.find(web::http::header_names::etag);
+    if (it != headers.end()
+            && !boost::algorithm::starts_with(it->second, U("W/"))) {
+        // weak ETags can not be used with If-Range
+        return it->second;
+    }
+    it = headers.find(web::http::header_names::last_modified);
+    if (it != headers.end()) {
+        return it->second;
+    }
+    return string_t();
+}
+
 CResponse::CResponse(
         web::http::client::http_client *p_client,
         std::function<void(web::http::client::http_client *)> release_client_f,
@@ -106,9 +130,15 @@ void CResponse::ThrowCStorageException(std::string message,
 }
 
 const std::string CResponse::AsString() {
-    auto task = response_.extract_vector();
-    std::vector<unsigned char> content = task.get();
-    return std::string(content.begin(), content.end());
+    return AsStringAsync().get();
+}
+
+pplx::task<std::string> CResponse::AsStringAsync() {
+    std::shared_ptr<CResponse> p_self = shared_from_this();
+    return response_.extract_vector().then([p_self](
+                                    const std::vector<unsigned char>& content) {
+        return std::string(content.begin(), content.end());
+    });
 }
 
 bool CResponse::IsJsonContentType() const {
@@ -142,8 +172,15 @@ void CResponse::EnsureContentTypeIsJson(bool throwRetriable) const {
 }
 
 web::json::value CResponse::AsJson() {
-    pplx::task<web::json::value> json_value = response_.extract_json();
-    return json_value.get();
+    return AsJsonAsync().get();
+}
+
+pplx::task<web::json::value> CResponse::AsJsonAsync() {
+    std::shared_ptr<CResponse> p_self = shared_from_this();
+    return response_.extract_json().then([p_self](
+                                            const web::json::value& json) {
+        return json;
+    });
 }
 
 bool CResponse::IsXmlContentType() const {
@@ -192,59 +229,177 @@ const boost::property_tree::ptree CResponse::AsDom() {
     return ret;
 }
 
-void CResponse::DownloadDataToSink(ByteSink *p_bs) {
-    try {
-        if (content_length_ >= 0) {
-            // content length is known: inform any listener
-            p_bs->SetExpectedLength(content_length_);
-        }
+void CResponse::DownloadDataToSink(ByteSink *p_bs,
+                                   size_t chunk_size,
+                                   int64_t resume_offset,
+                                   bool partial) {
+    // sink is owned by caller, who waits for completion:
+    std::shared_ptr<ByteSink> p_not_owned(p_bs, [](ByteSink*) {});
+    DownloadDataToSinkAsync(p_not_owned, chunk_size, resume_offset,
+                            partial).get();
+}
 
-        int64_t current = 0;
-        concurrency::streams::istream is = response_.body();
-        // The stream itself will not really be used, only its streambuf,
-        // so we can't check for errors in this stream:
-        std::ostream *p_os = p_bs->OpenStream();
-        // Wrap output stream as asynchronous for cpprest API:
-        concurrency::streams::stdio_ostream<char> os_wrapper(*p_os);
-        concurrency::streams::streambuf<char> os_streambuf =
-                                                        os_wrapper.streambuf();
-        while (true) {
-            // Read bytes directly into our output streambuf:
-            size_t nb_read = is.read(os_streambuf, 2048).get();
-            if (nb_read == 0) {
-                break;  // end of body stream, or error
+namespace {
+
+/**
+ * \brief Copies a response body into a ByteSink, until end of body stream.
+ *
+ * Buffers already received are handed to the sink without intermediate copy
+ * (thanks to streambuf acquire()/release()) ; when no data is available yet,
+ * bytes are read asynchronously into a local buffer of chunk size.
+ * Each read is started from the continuation of the previous one ; tasks
+ * are not chained so that memory does not grow with body size.
+ */
+class BodyToSinkCopier : public std::enable_shared_from_this<BodyToSinkCopier> {
+ public:
+    BodyToSinkCopier(concurrency::streams::istream body,
+                     ByteSink *p_bs,
+                     std::ostream *p_os,
+                     size_t chunk_size) :
+        body_(body),
+        body_buf_(body.streambuf()),
+        p_bs_(p_bs),
+        p_os_(p_os),
+        buffer_writable_(p_bs->IsBufferWritable()),
+        chunk_size_(chunk_size),
+        written_(0) {
+    }
+
+    /**
+     * @return a task holding the total number of bytes written
+     */
+    pplx::task<int64_t> Run() {
+        ReadNext();
+        return pplx::create_task(tce_);
+    }
+
+ private:
+    concurrency::streams::istream body_;
+    concurrency::streams::streambuf<uint8_t> body_buf_;
+    ByteSink *p_bs_;
+    std::ostream *p_os_;
+    const bool buffer_writable_;
+    const size_t chunk_size_;
+    std::vector<uint8_t> buffer_;  // only allocated if needed
+    int64_t written_;
+    pplx::task_completion_event<int64_t> tce_;
+
+    void WriteToSink(const uint8_t *p_data, size_t size) {
+        const char *p_chars = reinterpret_cast<const char*>(p_data);
+        if (buffer_writable_) {
+            p_bs_->Write(p_chars, size);
+        } else {
+            p_os_->write(p_chars, size);
+            if (p_os_->bad()) {
+                BOOST_THROW_EXCEPTION(
+                        CStorageException("Could not write to output stream"));
             }
-            current += nb_read;
         }
-        // FIXME error detection does not seem to be possible:
-        // see https://casablanca.codeplex.com/discussions/561562
-        // and https://casablanca.codeplex.com/workitem/244
-        // For now, as all downloads should have a known content length,
-        // we just compare this content length with the number of bytes
-        // actually downloaded:
-        if (content_length_ >= 0
-            && current != content_length_) {
-            // We have no details on error :(
-            std::string msg =
-                std::string("Did not write all bytes to sink (Content-Length=")
-                + std::to_string(content_length_)
-                + ", written=" + std::to_string(current) + ")";
-            BOOST_THROW_EXCEPTION(CStorageException(msg));
+        written_ += size;
+    }
+
+    void ReadNext() {
+        try {
+            // Consume already received data, without copy:
+            uint8_t *p_data;
+            size_t count;
+            while (body_buf_.acquire(p_data, count) && count > 0) {
+                count = std::min(count, chunk_size_);
+                WriteToSink(p_data, count);
+                body_buf_.release(p_data, count);
+            }
+            // Wait for more data (or end of stream):
+            if (buffer_.empty()) {
+                buffer_.resize(chunk_size_);
+            }
+            std::shared_ptr<BodyToSinkCopier> p_self = shared_from_this();
+            body_buf_.getn(buffer_.data(), chunk_size_).then(
+                                    [p_self](pplx::task<size_t> read_task) {
+                try {
+                    size_t nb_read;
+                    try {
+                        nb_read = read_task.get();
+                    }
+                    catch (...) {
+                        // Connection failure: download may be retried
+                        BOOST_THROW_EXCEPTION(CRetriableException(
+                                                std::current_exception()));
+                    }
+                    if (nb_read == 0) {
+                        // end of body stream, or error
+                        p_self->tce_.set(p_self->written_);
+                        return;
+                    }
+                    p_self->WriteToSink(p_self->buffer_.data(), nb_read);
+                    p_self->ReadNext();
+                }
+                catch (...) {
+                    p_self->tce_.set_exception(std::current_exception());
+                }
+            });
         }
-        os_wrapper.flush().get();  // void ?!
-        p_os->flush();
-        if (p_os->bad()) {
-            BOOST_THROW_EXCEPTION(
-                        CStorageException("Could not flush output stream"));
+        catch (...) {
+            tce_.set_exception(std::current_exception());
         }
+    }
+};
+
+}  // namespace
 
-        if (content_length_ < 0) {
-            // content length was unknown;
-            // inform listener operation is terminated
-            // We should never pass here
-            p_bs->SetExpectedLength(current);
+pplx::task<void> CResponse::DownloadDataToSinkAsync(
+                                            std::shared_ptr<ByteSink> p_bs,
+                                            size_t chunk_size,
+                                            int64_t resume_offset,
+                                            bool partial) {
+    std::shared_ptr<CResponse> p_self = shared_from_this();
+    const int64_t content_length = content_length_;
+    std::ostream *p_os;
+    pplx::task<int64_t> read_task;
+    try {
+        int64_t kept = 0;
+        if (resume_offset > 0) {
+            // If content has changed (or range is not supported),
+            // server sends whole content:
+            if (status_ == web::http::status_codes::PartialContent) {
+                LOG_DEBUG << "Resuming download after " << resume_offset
+                          << " bytes";
+                kept = resume_offset;
+            } else if (partial) {
+                // Whole content is not the requested range: held bytes are
+                // dropped (with their validator), so that range is requested
+                // again without If-Range
+                LOG_DEBUG << "Could not resume range download ("
+                          << status_ << ")";
+                p_bs->SetResume(false);
+                p_bs->SetResumeValidator(string_t());
+                p_bs->OpenStream();
+                try {
+                    BOOST_THROW_EXCEPTION(CStorageException(
+                        "Content has changed during range download: "
+                        + UriUtils::ShortenUri(uri_)));
+                }
+                catch (...) {
+                    BOOST_THROW_EXCEPTION(
+                            CRetriableException(std::current_exception()));
+                }
+            } else {
+                LOG_DEBUG << "Could not resume download: restarting ("
+                          << status_ << ")";
+            }
+            p_bs->SetResume(kept > 0);
         }
-        p_bs->CloseStream();
+        p_bs->SetResumeValidator(ExtractValidator(response_.headers()));
+        if (content_length >= 0) {
+            // content length is known: inform any listener
+            p_bs->SetExpectedLength(kept + content_length);
+        }
+
+        concurrency::streams::istream is = response_.body();
+        p_os = p_bs->OpenStream();
+        std::shared_ptr<BodyToSinkCopier> p_copier =
+                std::make_shared<BodyToSinkCopier>(is, p_bs.get(), p_os,
+                                                   chunk_size);
+        read_task = p_copier->Run();
     }
     catch (...) {
         LOG_ERROR << "Exception during download: "
@@ -253,6 +408,55 @@ void CResponse::DownloadDataToSink(ByteSink *p_bs) {
         p_bs->CloseStream();
         throw;
     }
+    return read_task.then([p_self, p_bs, p_os, content_length](
+                                            pplx::task<int64_t> read_task) {
+        try {
+            int64_t current = read_task.get();
+            // FIXME error detection does not seem to be possible:
+            // see https://casablanca.codeplex.com/discussions/561562
+            // and https://casablanca.codeplex.com/workitem/244
+            // For now, as all downloads should have a known content length,
+            // we just compare this content length with the number of bytes
+            // actually downloaded:
+            if (content_length >= 0
+                && current != content_length) {
+                // We have no details on error :(
+                // (probably connection was closed, so we may retry)
+                std::string msg =
+                    std::string("Did not write all bytes to sink "
+                                "(Content-Length=")
+                    + std::to_string(content_length)
+                    + ", written=" + std::to_string(current) + ")";
+                try {
+                    BOOST_THROW_EXCEPTION(CStorageException(msg));
+                }
+                catch (...) {
+                    BOOST_THROW_EXCEPTION(
+                                CRetriableException(std::current_exception()));
+                }
+            }
+            p_os->flush();
+            if (p_os->bad()) {
+                BOOST_THROW_EXCEPTION(
+                            CStorageException("Could not flush output stream"));
+            }
+
+            if (content_length < 0) {
+                // content length was unknown;
+                // inform listener operation is terminated
+                // We should never pass here
+                p_bs->SetExpectedLength(current);
+            }
+            p_bs->CloseStream();
+        }
+        catch (...) {
+            LOG_ERROR << "Exception during download: "
+                      << CurrentExceptionToString() << std::endl;
+            p_bs->Abort();
+            p_bs->CloseStream();
+            throw;
+        }
+    });
 }
 
 std::string CResponse::ToString() const {
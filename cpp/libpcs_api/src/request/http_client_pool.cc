@@ -22,23 +22,52 @@
 namespace pcs_api {
 
 HttpClientPool::HttpClientPool(const web::uri& base_uri,
-        std::shared_ptr<web::http::client::http_client_config> client_config)
+        std::shared_ptr<const web::http::client::http_client_config>
+                                                                client_config,
+        size_t max_clients,
+        std::chrono::milliseconds idle_timeout,
+        std::chrono::milliseconds max_wait)
     : ObjectPool(std::bind(&HttpClientPool::CreateClient,
                            this),
                  std::bind(&HttpClientPool::DeleteClient,
+                           this,
+                           std::placeholders::_1),
+                 max_clients,
+                 idle_timeout,
+                 max_wait,
+                 std::bind(&HttpClientPool::CheckClient,
                            this,
                            std::placeholders::_1)),
       base_uri_(base_uri),
       p_http_client_config_(client_config) {
 }
 
+HttpClientPool::~HttpClientPool() {
+    // idle clients are deleted while failed_clients_ still exists:
+    Clear();
+}
+
 web::http::client::http_client* HttpClientPool::CreateClient() {
     return new web::http::client::http_client(base_uri_,
                                               *p_http_client_config_);
 }
 
 void HttpClientPool::DeleteClient(web::http::client::http_client *p_client) {
+    {
+        std::lock_guard<std::mutex> lock(failed_clients_mutex_);
+        failed_clients_.erase(p_client);
+    }
     delete p_client;
 }
 
+void HttpClientPool::ReportFailure(web::http::client::http_client *p_client) {
+    std::lock_guard<std::mutex> lock(failed_clients_mutex_);
+    failed_clients_.insert(p_client);
+}
+
+bool HttpClientPool::CheckClient(web::http::client::http_client *p_client) {
+    std::lock_guard<std::mutex> lock(failed_clients_mutex_);
+    return failed_clients_.find(p_client) == failed_clients_.end();
+}
+
 }  // namespace pcs_api
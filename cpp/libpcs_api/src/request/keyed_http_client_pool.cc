@@ -0,0 +1,110 @@
+/**
+ * Copyright (c) 2014 Netheos (http://www.netheos.net)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <memory>
+
+#include "cpprest/http_client.h"
+#include "cpprest/asyncrt_utils.h"
+
+#include "pcs_api/internal/keyed_http_client_pool.h"
+#include "pcs_api/internal/logger.h"
+
+namespace pcs_api {
+
+KeyedHttpClientPool::KeyedHttpClientPool(
+        std::shared_ptr<const web::http::client::http_client_config>
+                                                                client_config,
+        size_t max_clients_per_host,
+        std::chrono::milliseconds idle_timeout,
+        std::chrono::milliseconds max_wait)
+    : p_http_client_config_(client_config),
+      max_clients_per_host_(max_clients_per_host),
+      idle_timeout_(idle_timeout),
+      max_wait_(max_wait),
+      p_pools_(std::make_shared<PoolsMap>()) {
+}
+
+web::http::client::http_client* KeyedHttpClientPool::Get(
+                                                    const web::uri& uri) {
+    return GetPool(uri.authority()).Get();
+}
+
+pplx::task<web::http::client::http_client*> KeyedHttpClientPool::GetAsync(
+                                                    const web::uri& uri) {
+    return GetPool(uri.authority()).GetAsync();
+}
+
+void KeyedHttpClientPool::Put(web::http::client::http_client *p_client) {
+    // clients base uri is the authority they have been created for:
+    GetPool(p_client->base_uri()).Put(p_client);
+}
+
+void KeyedHttpClientPool::Discard(web::http::client::http_client *p_client) {
+    GetPool(p_client->base_uri()).Discard(p_client);
+}
+
+void KeyedHttpClientPool::ReportFailure(
+                                web::http::client::http_client *p_client) {
+    GetPool(p_client->base_uri()).ReportFailure(p_client);
+}
+
+ObjectPoolStats KeyedHttpClientPool::GetStats() {
+    ObjectPoolStats total = ObjectPoolStats();
+    std::shared_ptr<const PoolsMap> p_pools = std::atomic_load(&p_pools_);
+    for (const auto& entry : *p_pools) {
+        ObjectPoolStats stats = entry.second->GetStats();
+        total.hits += stats.hits;
+        total.misses += stats.misses;
+        total.waits += stats.waits;
+        total.evictions += stats.evictions;
+        total.overflows += stats.overflows;
+    }
+    return total;
+}
+
+HttpClientPool& KeyedHttpClientPool::GetPool(const web::uri& authority) {
+    string_t key = authority.to_string();
+    // pools are never removed, so references remain valid:
+    std::shared_ptr<const PoolsMap> p_pools = std::atomic_load(&p_pools_);
+    auto it = p_pools->find(key);
+    if (it != p_pools->end()) {
+        return *it->second;
+    }
+
+    std::lock_guard<std::mutex> lock(pools_mutex_);
+    // another thread may have created pool meanwhile:
+    p_pools = std::atomic_load(&p_pools_);
+    it = p_pools->find(key);
+    if (it != p_pools->end()) {
+        return *it->second;
+    }
+    LOG_DEBUG << "Creating clients pool for: "
+              << utility::conversions::to_utf8string(key);
+    std::shared_ptr<HttpClientPool> p_pool =
+                        std::make_shared<HttpClientPool>(authority,
+                                                         p_http_client_config_,
+                                                         max_clients_per_host_,
+                                                         idle_timeout_,
+                                                         max_wait_);
+    std::shared_ptr<PoolsMap> p_new_pools =
+                                        std::make_shared<PoolsMap>(*p_pools);
+    (*p_new_pools)[key] = p_pool;
+    std::atomic_store(&p_pools_,
+                      std::shared_ptr<const PoolsMap>(p_new_pools));
+    return *p_pool;
+}
+
+}  // namespace pcs_api
@@ -29,7 +29,8 @@ RequestInvoker::RequestInvoker(const request_function request_func,
                                const CPath* p_opt_path) :
     request_func_(request_func),
     validate_func_(validate_func),
-    p_path_(p_opt_path) {
+    p_path_(p_opt_path != nullptr ? std::make_shared<CPath>(*p_opt_path)
+                                  : std::shared_ptr<CPath>()) {
 }
 
 std::shared_ptr<CResponse> RequestInvoker::Invoke(
@@ -37,26 +38,61 @@ std::shared_ptr<CResponse> RequestInvoker::Invoke(
     std::shared_ptr<CResponse> p_response;
     bool request_done = false;
     try {
-        p_response = request_func_(request);  // may throw
+        p_response = request_func_(request).get();  // may throw
         request_done = true;
-        validate_func_(p_response.get(), p_path_);
+        validate_func_(p_response.get(), p_path_.get());
         return p_response;
     }
     catch(std::exception&) {
         std::exception_ptr p_current = std::current_exception();
         LOG_DEBUG << "catched exception in request_invoker: "
                   << ExceptionPtrToString(p_current);
-        if (request_done || !IsRetriable(p_current)) {
-            // request has been done and validation failed
-            // with not retriable error:
+        if (request_done) {
+            // request has been done and validation failed:
             // LOG_DEBUG << "RequestInvoker: exception rethrown !";
             throw;
         }
-        // Exception is retriable:
-        BOOST_THROW_EXCEPTION(CRetriableException(p_current));
+        RethrowRequestException(p_current);
+        throw;  // not reached
     }
 }
 
+pplx::task<std::shared_ptr<CResponse>> RequestInvoker::InvokeAsync(
+                                    web::http::http_request request) const {
+    // copies, as this object may be destroyed before task completes:
+    const request_function request_func = request_func_;
+    const validate_function validate_func = validate_func_;
+    std::shared_ptr<const CPath> p_path = p_path_;
+    // request_func() is called in a continuation, so that exceptions it may
+    // throw synchronously are handled as task failures:
+    return pplx::task_from_result().then([request_func, request] {
+        return request_func(request);
+    }).then([validate_func, p_path](
+                    pplx::task<std::shared_ptr<CResponse>> request_task)
+                                                -> std::shared_ptr<CResponse> {
+        std::shared_ptr<CResponse> p_response;
+        try {
+            p_response = request_task.get();
+        }
+        catch (std::exception&) {
+            LOG_DEBUG << "catched exception in request_invoker: "
+                      << CurrentExceptionToString();
+            RethrowRequestException(std::current_exception());
+        }
+        validate_func(p_response.get(), p_path.get());
+        return p_response;
+    });
+}
+
+void RequestInvoker::RethrowRequestException(std::exception_ptr p_ex) {
+    if (!IsRetriable(p_ex)) {
+        // not retriable error:
+        std::rethrow_exception(p_ex);
+    }
+    // Exception is retriable:
+    BOOST_THROW_EXCEPTION(CRetriableException(p_ex));
+}
+
 bool RequestInvoker::IsRetriable(std::exception_ptr p_ex) {
     bool ret = false;
     try {
@@ -0,0 +1,87 @@
+/**
+ * Copyright (c) 2014 Netheos (http://www.netheos.net)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdexcept>
+
+#include "boost/throw_exception.hpp"
+
+#include "pcs_api/internal/bounded_scheduler.h"
+
+namespace pcs_api {
+
+BoundedScheduler::BoundedScheduler(size_t max_threads)
+    : max_threads_(max_threads),
+      p_state_(std::make_shared<State>()) {
+    if (max_threads == 0) {
+        BOOST_THROW_EXCEPTION(std::invalid_argument(
+                                    "max_threads must be strictly positive"));
+    }
+    p_state_->nb_idle_threads = 0;
+    p_state_->stopping = false;
+}
+
+BoundedScheduler::~BoundedScheduler() {
+    std::vector<std::thread> threads;
+    {
+        std::lock_guard<std::mutex> lock(p_state_->mutex);
+        p_state_->stopping = true;
+        threads.swap(threads_);
+    }
+    p_state_->cond.notify_all();
+    for (std::thread& thread : threads) {
+        if (thread.get_id() == std::this_thread::get_id()) {
+            // destroyed by one of our tasks: thread stops by itself
+            thread.detach();
+        } else {
+            thread.join();
+        }
+    }
+}
+
+void BoundedScheduler::schedule(pplx::TaskProc_t proc, void* param) {
+    std::lock_guard<std::mutex> lock(p_state_->mutex);
+    p_state_->tasks.push_back(std::make_pair(proc, param));
+    if (p_state_->tasks.size() > p_state_->nb_idle_threads
+            && threads_.size() < max_threads_) {
+        threads_.push_back(std::thread(&BoundedScheduler::Run, p_state_));
+    } else {
+        p_state_->cond.notify_one();
+    }
+}
+
+void BoundedScheduler::Run(std::shared_ptr<State> p_state) {
+    std::unique_lock<std::mutex> lock(p_state->mutex);
+    for (;;) {
+        if (!p_state->tasks.empty()) {
+            std::pair<pplx::TaskProc_t, void*> task = p_state->tasks.front();
+            p_state->tasks.pop_front();
+            lock.unlock();
+            task.first(task.second);
+            lock.lock();
+            continue;
+        }
+        if (p_state->stopping) {
+            return;
+        }
+        ++p_state->nb_idle_threads;
+        p_state->cond.wait(lock, [&p_state] {
+            return !p_state->tasks.empty() || p_state->stopping;
+        });
+        --p_state->nb_idle_threads;
+    }
+}
+
+}  // namespace pcs_api
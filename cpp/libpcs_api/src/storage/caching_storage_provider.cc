@@ -0,0 +1,342 @@
+/**
+ * Copyright (c) 2014 Netheos (http://www.netheos.net)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <functional>
+#include <stdexcept>
+
+#include "boost/throw_exception.hpp"
+
+#include "pcs_api/caching_storage_provider.h"
+#include "pcs_api/internal/logger.h"
+#include "pcs_api/internal/lru_cache.h"
+
+namespace pcs_api {
+
+const std::chrono::milliseconds CachingStorageProvider::kDefaultTtl =
+                                                    std::chrono::seconds(10);
+const size_t CachingStorageProvider::kDefaultMaxEntries = 10000;
+
+namespace {
+
+/**
+ * @return true if path is equal to folder_path, or a descendant of it.
+ */
+bool IsSameOrDescendant(const CPath& path, const CPath& folder_path) {
+    if (folder_path.IsRoot()) {
+        return true;
+    }
+    string_t folder_name = folder_path.path_name();
+    string_t name = path.path_name();
+    return name == folder_name || name.compare(0, folder_name.length() + 1,
+                                               folder_name + U("/")) == 0;
+}
+
+}  // namespace
+
+struct CachingStorageProvider::Caches {
+    Caches(size_t max_entries, std::chrono::milliseconds ttl) :
+        files(max_entries, ttl), folders_contents(max_entries, ttl) {
+    }
+    /**
+     * GetFile() results (empty pointer if no file exists)
+     */
+    LruCache<CPath, std::shared_ptr<CFile>, CPathHash> files;
+    /**
+     * ListFolder() results (empty pointer if no folder exists)
+     */
+    LruCache<CPath, std::shared_ptr<CFolderContent>, CPathHash>
+                                                            folders_contents;
+};
+
+CachingStorageProvider::CachingStorageProvider(
+                                std::shared_ptr<IStorageProvider> p_storage,
+                                std::chrono::milliseconds ttl,
+                                size_t max_entries) :
+    p_storage_(p_storage),
+    p_caches_(new Caches(max_entries, ttl)),
+    hits_(0),
+    misses_(0),
+    invalidations_(0) {
+    if (!p_storage_) {
+        BOOST_THROW_EXCEPTION(
+                    std::invalid_argument("Decorated storage is undefined"));
+    }
+}
+
+CachingStorageProvider::~CachingStorageProvider() {
+    LOG_TRACE << "Metadata cache destructor"
+              << " (hits=" << hits_
+              << " misses=" << misses_
+              << " invalidations=" << invalidations_ << ")";
+}
+
+std::string CachingStorageProvider::GetProviderName() const {
+    return p_storage_->GetProviderName();
+}
+
+std::string CachingStorageProvider::GetUserId() {
+    return p_storage_->GetUserId();
+}
+
+CQuota CachingStorageProvider::GetQuota() {
+    return p_storage_->GetQuota();
+}
+
+std::shared_ptr<CFolderContent> CachingStorageProvider::ListRootFolder() {
+    return ListFolder(CPath(U("/")));
+}
+
+std::shared_ptr<CFolderContent> CachingStorageProvider::ListFolder(
+                                                        const CFolder& folder) {
+    return ListFolder(folder.path());
+}
+
+std::shared_ptr<CFolderContent> CachingStorageProvider::ListFolder(
+                                                        const CPath& path) {
+    std::shared_ptr<CFolderContent> p_content;
+    if (LookupFolderContent(path, &p_content)) {
+        return p_content;
+    }
+    LruCacheGeneration generation = p_caches_->folders_contents.generation();
+    p_content = p_storage_->ListFolder(path);
+    p_caches_->folders_contents.Put(path, p_content, generation);
+    return p_content;
+}
+
+bool CachingStorageProvider::ListFolderStream(const CPath& path,
+                                              file_callback callback) {
+    std::shared_ptr<CFolderContent> p_content;
+    if (!LookupFolderContent(path, &p_content)) {
+        return p_storage_->ListFolderStream(path, callback);
+    }
+    if (!p_content) {
+        return false;
+    }
+    for (auto it = p_content->cbegin(); it != p_content->cend(); ++it) {
+        callback(it->second);
+    }
+    return true;
+}
+
+bool CachingStorageProvider::ListRecursive(const CPath& path,
+                                           file_callback callback) {
+    return p_storage_->ListRecursive(path, callback);
+}
+
+pplx::task<std::shared_ptr<CFolderContent>>
+                CachingStorageProvider::ListFolderAsync(const CPath& path) {
+    std::shared_ptr<CFolderContent> p_content;
+    if (LookupFolderContent(path, &p_content)) {
+        return pplx::task_from_result(p_content);
+    }
+    LruCacheGeneration generation = p_caches_->folders_contents.generation();
+    return p_storage_->ListFolderAsync(path).then([this, path, generation](
+                                std::shared_ptr<CFolderContent> p_content) {
+        p_caches_->folders_contents.Put(path, p_content, generation);
+        return p_content;
+    });
+}
+
+std::shared_ptr<CFile> CachingStorageProvider::GetFile(const CPath& path) {
+    std::shared_ptr<CFile> p_file;
+    if (LookupFile(path, &p_file)) {
+        return p_file;
+    }
+    LruCacheGeneration generation = p_caches_->files.generation();
+    p_file = p_storage_->GetFile(path);
+    p_caches_->files.Put(path, p_file, generation);
+    return p_file;
+}
+
+pplx::task<std::shared_ptr<CFile>> CachingStorageProvider::GetFileAsync(
+                                                        const CPath& path) {
+    std::shared_ptr<CFile> p_file;
+    if (LookupFile(path, &p_file)) {
+        return pplx::task_from_result(p_file);
+    }
+    LruCacheGeneration generation = p_caches_->files.generation();
+    return p_storage_->GetFileAsync(path).then([this, path, generation](
+                                            std::shared_ptr<CFile> p_file) {
+        p_caches_->files.Put(path, p_file, generation);
+        return p_file;
+    });
+}
+
+bool CachingStorageProvider::CreateFolder(const CPath& path) {
+    try {
+        bool created = p_storage_->CreateFolder(path);
+        InvalidateAfterWrite(path, false);
+        return created;
+    }
+    catch (...) {
+        InvalidateAfterWrite(path, false);
+        throw;
+    }
+}
+
+pplx::task<bool> CachingStorageProvider::CreateFolderAsync(const CPath& path) {
+    return p_storage_->CreateFolderAsync(path).then([this, path](
+                                                pplx::task<bool> create_task) {
+        InvalidateAfterWrite(path, false);
+        return create_task.get();
+    });
+}
+
+bool CachingStorageProvider::Delete(const CPath& path) {
+    try {
+        bool deleted = p_storage_->Delete(path);
+        InvalidateAfterWrite(path, true);
+        return deleted;
+    }
+    catch (...) {
+        InvalidateAfterWrite(path, true);
+        throw;
+    }
+}
+
+pplx::task<bool> CachingStorageProvider::DeleteAsync(const CPath& path) {
+    return p_storage_->DeleteAsync(path).then([this, path](
+                                                pplx::task<bool> delete_task) {
+        InvalidateAfterWrite(path, true);
+        return delete_task.get();
+    });
+}
+
+void CachingStorageProvider::Download(
+                                    const CDownloadRequest& download_request) {
+    p_storage_->Download(download_request);
+}
+
+pplx::task<void> CachingStorageProvider::DownloadAsync(
+                                    const CDownloadRequest& download_request) {
+    return p_storage_->DownloadAsync(download_request);
+}
+
+void CachingStorageProvider::Upload(const CUploadRequest& upload_request) {
+    try {
+        p_storage_->Upload(upload_request);
+        InvalidateAfterWrite(upload_request.path(), false);
+    }
+    catch (...) {
+        InvalidateAfterWrite(upload_request.path(), false);
+        throw;
+    }
+}
+
+pplx::task<void> CachingStorageProvider::UploadAsync(
+                                        const CUploadRequest& upload_request) {
+    CPath path = upload_request.path();
+    return p_storage_->UploadAsync(upload_request).then([this, path](
+                                                pplx::task<void> upload_task) {
+        InvalidateAfterWrite(path, false);
+        upload_task.get();
+    });
+}
+
+std::shared_ptr<CFolder> CachingStorageProvider::CreateFolderAndGet(
+                                                        const CPath& path) {
+    std::shared_ptr<CFolder> p_folder;
+    try {
+        p_folder = p_storage_->CreateFolderAndGet(path);
+    }
+    catch (...) {
+        InvalidateAfterWrite(path, false);
+        throw;
+    }
+    InvalidateAfterWrite(path, false);
+    p_caches_->files.Put(path, p_folder, p_caches_->files.generation());
+    return p_folder;
+}
+
+std::shared_ptr<CBlob> CachingStorageProvider::UploadAndGetBlob(
+                                        const CUploadRequest& upload_request) {
+    const CPath& path = upload_request.path();
+    std::shared_ptr<CBlob> p_blob;
+    try {
+        p_blob = p_storage_->UploadAndGetBlob(upload_request);
+    }
+    catch (...) {
+        InvalidateAfterWrite(path, false);
+        throw;
+    }
+    InvalidateAfterWrite(path, false);
+    p_caches_->files.Put(path, p_blob, p_caches_->files.generation());
+    return p_blob;
+}
+
+void CachingStorageProvider::Invalidate(const CPath& path) {
+    InvalidateAfterWrite(path, true);
+}
+
+void CachingStorageProvider::Clear() {
+    p_caches_->files.Clear();
+    p_caches_->folders_contents.Clear();
+}
+
+MetadataCacheStats CachingStorageProvider::GetStats() const {
+    MetadataCacheStats stats;
+    stats.hits = hits_;
+    stats.misses = misses_;
+    stats.invalidations = invalidations_;
+    return stats;
+}
+
+bool CachingStorageProvider::LookupFile(const CPath& path,
+                                        std::shared_ptr<CFile>* p_file) {
+    if (p_caches_->files.Get(path, p_file)) {
+        ++hits_;
+        return true;
+    }
+    ++misses_;
+    return false;
+}
+
+bool CachingStorageProvider::LookupFolderContent(
+                                const CPath& path,
+                                std::shared_ptr<CFolderContent>* p_content) {
+    if (p_caches_->folders_contents.Get(path, p_content)) {
+        ++hits_;
+        return true;
+    }
+    ++misses_;
+    return false;
+}
+
+void CachingStorageProvider::InvalidateAfterWrite(const CPath& path,
+                                                  bool recursive) {
+    ++invalidations_;
+    if (recursive) {
+        std::function<bool(const CPath&)> is_below = [path](const CPath& key) {
+            return IsSameOrDescendant(key, path);
+        };
+        p_caches_->files.EraseIf(is_below);
+        p_caches_->folders_contents.EraseIf(is_below);
+    } else {
+        p_caches_->files.Erase(path);
+        p_caches_->folders_contents.Erase(path);
+    }
+    // Parent folders may have been created (or removed), and their content
+    // has changed:
+    CPath parent = path;
+    while (!parent.IsRoot()) {
+        parent = parent.GetParent();
+        p_caches_->files.Erase(parent);
+        p_caches_->folders_contents.Erase(parent);
+    }
+}
+
+}  // namespace pcs_api
@@ -0,0 +1,135 @@
+/**
+ * Copyright (c) 2014 Netheos (http://www.netheos.net)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <functional>
+#include <memory>
+
+#include "boost/throw_exception.hpp"
+#include "pplx/pplxtasks.h"
+
+#include "pcs_api/i_storage_provider.h"
+#include "pcs_api/c_exceptions.h"
+#include "pcs_api/tree_walker.h"
+#include "pcs_api/internal/bounded_scheduler.h"
+
+namespace pcs_api {
+
+const size_t IStorageProvider::kMaxBlockingThreads = 8;
+
+IStorageProvider::IStorageProvider()
+    : p_blocking_scheduler_(
+            std::make_shared<BoundedScheduler>(kMaxBlockingThreads)) {
+}
+
+/**
+ * \brief Run the given synchronous function in a thread of this provider.
+ *
+ * Returned task completes on the ambient scheduler: continuations attached by
+ * caller inherit it, and do not occupy (nor wait for) the bounded threads.
+ */
+template<class T>
+pplx::task<T> IStorageProvider::RunBlocking(std::function<T()> func) {
+    return pplx::create_task(func,
+                             pplx::task_options(p_blocking_scheduler_))
+        .then([](pplx::task<T> blocking_task) {
+            return blocking_task.get();
+        }, pplx::task_options(pplx::get_ambient_scheduler()));
+}
+
+bool IStorageProvider::ListFolderStream(const CPath& path,
+                                        file_callback callback) {
+    std::shared_ptr<CFolderContent> p_content = ListFolder(path);
+    if (!p_content) {
+        return false;
+    }
+    for (auto it = p_content->cbegin(); it != p_content->cend(); ++it) {
+        callback(it->second);
+    }
+    return true;
+}
+
+bool IStorageProvider::ListRecursive(const CPath& path,
+                                     file_callback callback) {
+    return TreeWalker(this).Walk(path, callback);
+}
+
+std::shared_ptr<CFolder> IStorageProvider::CreateFolderAndGet(
+                                                        const CPath& path) {
+    CreateFolder(path);
+    std::shared_ptr<CFolder> p_folder =
+                            std::dynamic_pointer_cast<CFolder>(GetFile(path));
+    if (!p_folder) {
+        BOOST_THROW_EXCEPTION(CStorageException(
+                "Folder not found after creation: " + path.path_name_utf8()));
+    }
+    return p_folder;
+}
+
+std::shared_ptr<CBlob> IStorageProvider::UploadAndGetBlob(
+                                        const CUploadRequest& upload_request) {
+    Upload(upload_request);
+    const CPath& path = upload_request.path();
+    std::shared_ptr<CBlob> p_blob =
+                            std::dynamic_pointer_cast<CBlob>(GetFile(path));
+    if (!p_blob) {
+        BOOST_THROW_EXCEPTION(CStorageException(
+                "Blob not found after upload: " + path.path_name_utf8()));
+    }
+    return p_blob;
+}
+
+pplx::task<std::shared_ptr<CFolderContent>> IStorageProvider::ListFolderAsync(
+                                                        const CPath& path) {
+    return RunBlocking<std::shared_ptr<CFolderContent>>(
+        [this, path] {
+            return ListFolder(path);
+        });
+}
+
+pplx::task<bool> IStorageProvider::CreateFolderAsync(const CPath& path) {
+    return RunBlocking<bool>([this, path] {
+        return CreateFolder(path);
+    });
+}
+
+pplx::task<bool> IStorageProvider::DeleteAsync(const CPath& path) {
+    return RunBlocking<bool>([this, path] {
+        return Delete(path);
+    });
+}
+
+pplx::task<std::shared_ptr<CFile>> IStorageProvider::GetFileAsync(
+                                                        const CPath& path) {
+    return RunBlocking<std::shared_ptr<CFile>>([this, path] {
+        return GetFile(path);
+    });
+}
+
+pplx::task<void> IStorageProvider::DownloadAsync(
+                                    const CDownloadRequest& download_request) {
+    return RunBlocking<void>([this, download_request] {
+        Download(download_request);
+    });
+}
+
+pplx::task<void> IStorageProvider::UploadAsync(
+                                    const CUploadRequest& upload_request) {
+    return RunBlocking<void>([this, upload_request] {
+        Upload(upload_request);
+    });
+}
+
+}  // namespace pcs_api
@@ -0,0 +1,345 @@
+/**
+ * Copyright (c) 2014 Netheos (http://www.netheos.net)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include "boost/filesystem/fstream.hpp"
+
+#include "cpprest/http_msg.h"
+
+#include "pcs_api/parallel_downloader.h"
+#include "pcs_api/c_exceptions.h"
+#include "pcs_api/file_byte_sink.h"
+#include "pcs_api/internal/file_range_byte_sink.h"
+#include "pcs_api/internal/logger.h"
+
+namespace pcs_api {
+
+const int64_t ParallelDownloader::kDefaultSegmentSize = 8 * 1024 * 1024;
+const size_t ParallelDownloader::kDefaultMaxConcurrency = 4;
+const int ParallelDownloader::kDefaultNbTriesPerSegment = 3;
+
+namespace {
+
+/**
+ * \brief State of a parallel download, shared by all its lanes.
+ *
+ * A lane downloads segments one after the other ; lanes run concurrently.
+ */
+struct SegmentsDownload {
+    struct Segment {
+        int64_t offset;
+        int64_t length;
+    };
+    IStorageProvider *p_storage;
+    CPath path;
+    boost::filesystem::path part_path;
+    std::vector<Segment> segments;
+    int nb_tries;
+
+    std::mutex mutex;  // protects members below
+    size_t next_segment;
+    std::exception_ptr p_error;  // first error encountered
+    // validator of the first received segment (empty if unknown yet):
+    // all segments must come from the same content
+    string_t validator;
+
+    explicit SegmentsDownload(const CPath& blob_path) :
+        path(blob_path), next_segment(0) {
+    }
+
+    bool HasFailed() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return static_cast<bool>(p_error);
+    }
+
+    string_t GetValidator() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return validator;
+    }
+
+    /**
+     * \brief Check that a segment comes from the same content as the
+     *        previous ones ; otherwise the whole download fails.
+     *
+     * @param segment_validator validator of segment response (empty if
+     *        server sent none: then nothing can be checked)
+     */
+    void CheckValidator(const string_t& segment_validator) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (segment_validator.empty()) {
+            return;
+        }
+        if (validator.empty()) {
+            validator = segment_validator;
+            return;
+        }
+        if (segment_validator == validator) {
+            return;
+        }
+        try {
+            BOOST_THROW_EXCEPTION(CStorageException(
+                            "Blob has changed during download: "
+                            + path.path_name_utf8()));
+        }
+        catch (...) {
+            if (!p_error) {
+                p_error = std::current_exception();
+            }
+            throw;
+        }
+    }
+
+    /**
+     * \brief Server refused a segment because content has changed (412
+     *        response to a conditional request).
+     */
+    void SetContentChanged() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!p_error) {
+            p_error = std::current_exception();
+        }
+    }
+};
+
+/**
+ * \brief Sink of a segment: checks that segment comes from the same
+ *        content as the other ones.
+ */
+class SegmentByteSink : public detail::FileRangeByteSink {
+ public:
+    SegmentByteSink(std::shared_ptr<SegmentsDownload> p_dl,
+                    int64_t offset,
+                    int64_t length)
+        : FileRangeByteSink(p_dl->part_path, offset, length),
+          p_dl_(p_dl) {
+    }
+
+    void SetResumeValidator(const string_t& validator) override {
+        // called by downloads before writing anything:
+        p_dl_->CheckValidator(validator);
+    }
+
+ private:
+    std::shared_ptr<SegmentsDownload> p_dl_;
+};
+
+/**
+ * \brief Is this error a 412 response to a conditional request ?
+ */
+bool IsPreconditionFailed(std::exception_ptr p_error) {
+    try {
+        std::rethrow_exception(p_error);
+    }
+    catch (const CHttpException& e) {
+        return e.status() == web::http::status_codes::PreconditionFailed;
+    }
+    catch (...) {
+        return false;
+    }
+}
+
+pplx::task<void> DownloadSegment(std::shared_ptr<SegmentsDownload> p_dl,
+                                 size_t index,
+                                 int current_try) {
+    const SegmentsDownload::Segment& segment = p_dl->segments[index];
+    std::shared_ptr<ByteSink> p_sink = std::make_shared<SegmentByteSink>(
+                                                            p_dl,
+                                                            segment.offset,
+                                                            segment.length);
+    CDownloadRequest request(p_dl->path, p_sink);
+    request.SetRange(segment.offset, segment.length);
+    // Once a segment has been received, server is asked for the same content
+    // (segments already requested are checked by their sink):
+    request.set_expected_validator(p_dl->GetValidator());
+    return p_dl->p_storage->DownloadAsync(request).then(
+                [p_dl, index, current_try](pplx::task<void> download_task)
+                                                        -> pplx::task<void> {
+        try {
+            download_task.get();
+            return pplx::task_from_result();
+        }
+        catch (const CFileNotFoundException&) {
+            throw;  // blob has been deleted: no need to retry
+        }
+        catch (const CInvalidFileTypeException&) {
+            throw;
+        }
+        catch (...) {
+            if (IsPreconditionFailed(std::current_exception())) {
+                // content has changed: no need to retry
+                p_dl->SetContentChanged();
+                throw;
+            }
+            if (current_try >= p_dl->nb_tries || p_dl->HasFailed()) {
+                throw;
+            }
+            LOG_WARN << "Download of segment #" << index << " failed (try "
+                     << current_try << "/" << p_dl->nb_tries << "): "
+                     << CurrentExceptionToString() << " ; will retry";
+        }
+        return DownloadSegment(p_dl, index, current_try + 1);
+    });
+}
+
+/**
+ * \brief Downloads remaining segments, one after the other.
+ *
+ * Returned task never fails: errors are stored in download state, and stop
+ * all lanes.
+ */
+pplx::task<void> RunLane(std::shared_ptr<SegmentsDownload> p_dl) {
+    size_t index;
+    {
+        std::lock_guard<std::mutex> lock(p_dl->mutex);
+        if (p_dl->p_error || p_dl->next_segment >= p_dl->segments.size()) {
+            return pplx::task_from_result();
+        }
+        index = p_dl->next_segment++;
+    }
+    return DownloadSegment(p_dl, index, 1).then(
+                        [p_dl](pplx::task<void> segment_task)
+                                                        -> pplx::task<void> {
+        try {
+            segment_task.get();
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(p_dl->mutex);
+            if (!p_dl->p_error) {
+                p_dl->p_error = std::current_exception();
+            }
+            return pplx::task_from_result();
+        }
+        return RunLane(p_dl);
+    });
+}
+
+}  // namespace
+
+
+ParallelDownloader::ParallelDownloader(IStorageProvider *p_storage)
+    : p_storage_(p_storage),
+      segment_size_(kDefaultSegmentSize),
+      max_concurrency_(kDefaultMaxConcurrency),
+      nb_tries_per_segment_(kDefaultNbTriesPerSegment) {
+}
+
+ParallelDownloader& ParallelDownloader::set_segment_size(
+                                                    int64_t segment_size) {
+    if (segment_size <= 0) {
+        BOOST_THROW_EXCEPTION(
+                    std::invalid_argument("Segment size must be > 0"));
+    }
+    segment_size_ = segment_size;
+    return *this;
+}
+
+ParallelDownloader& ParallelDownloader::set_max_concurrency(
+                                                    size_t max_concurrency) {
+    if (max_concurrency == 0) {
+        BOOST_THROW_EXCEPTION(
+                    std::invalid_argument("Max concurrency must be > 0"));
+    }
+    max_concurrency_ = max_concurrency;
+    return *this;
+}
+
+ParallelDownloader& ParallelDownloader::set_nb_tries_per_segment(
+                                                            int nb_tries) {
+    if (nb_tries <= 0) {
+        BOOST_THROW_EXCEPTION(
+                    std::invalid_argument("Number of tries must be > 0"));
+    }
+    nb_tries_per_segment_ = nb_tries;
+    return *this;
+}
+
+void ParallelDownloader::Download(const CPath& path,
+                                  const boost::filesystem::path& local_path) {
+    std::shared_ptr<CFile> p_file = p_storage_->GetFile(path);
+    if (!p_file) {
+        BOOST_THROW_EXCEPTION(CFileNotFoundException("Blob not found", path));
+    }
+    if (p_file->IsFolder()) {
+        BOOST_THROW_EXCEPTION(CInvalidFileTypeException(path, true));
+    }
+    int64_t length = std::static_pointer_cast<CBlob>(p_file)->length();
+
+    if (length < 0 || length <= segment_size_) {
+        // Unknown length or small blob: a single request is enough
+        LOG_DEBUG << "Downloading " << path << " with a single request";
+        std::shared_ptr<ByteSink> p_sink = std::make_shared<FileByteSink>(
+                                        local_path,
+                                        true,  // temp_name_during_write
+                                        false);  // delete_on_abort
+        p_storage_->Download(CDownloadRequest(path, p_sink));
+        return;
+    }
+
+    std::shared_ptr<SegmentsDownload> p_dl =
+                                    std::make_shared<SegmentsDownload>(path);
+    p_dl->p_storage = p_storage_;
+    p_dl->nb_tries = nb_tries_per_segment_;
+    p_dl->part_path = local_path;
+    p_dl->part_path += ".part";
+    for (int64_t offset = 0; offset < length; offset += segment_size_) {
+        SegmentsDownload::Segment segment;
+        segment.offset = offset;
+        segment.length = std::min(segment_size_, length - offset);
+        p_dl->segments.push_back(segment);
+    }
+
+    // Pre-size file, so that segments can be written at their offset:
+    {
+        boost::filesystem::ofstream os(p_dl->part_path,
+                                       std::ios_base::out
+                                       | std::ios_base::trunc
+                                       | std::ios_base::binary);
+        if (os.fail()) {
+            BOOST_THROW_EXCEPTION(std::ios_base::failure(
+                    "Could not create file: " + p_dl->part_path.string()));
+        }
+    }
+    boost::filesystem::resize_file(p_dl->part_path, length);
+
+    size_t nb_lanes = std::min(max_concurrency_, p_dl->segments.size());
+    LOG_DEBUG << "Downloading " << path << " (" << length << " bytes) in "
+              << p_dl->segments.size() << " segments, "
+              << nb_lanes << " at a time";
+    std::vector<pplx::task<void>> lanes;
+    for (size_t i = 0; i < nb_lanes; ++i) {
+        lanes.push_back(RunLane(p_dl));
+    }
+    // lanes tasks never fail:
+    pplx::when_all(lanes.begin(), lanes.end()).wait();
+    if (p_dl->p_error) {
+        LOG_ERROR << "Parallel download of " << path << " failed: "
+                  << ExceptionPtrToString(p_dl->p_error);
+        // Partial file is useless (segments are not resumed):
+        boost::system::error_code ec;
+        boost::filesystem::remove(p_dl->part_path, ec);
+        std::rethrow_exception(p_dl->p_error);
+    }
+
+    // Everything went fine: we rename temp file to its final name
+    boost::filesystem::remove(local_path);
+    boost::filesystem::rename(p_dl->part_path, local_path);
+}
+
+}  // namespace pcs_api
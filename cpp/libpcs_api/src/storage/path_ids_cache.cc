@@ -0,0 +1,238 @@
+/**
+ * Copyright (c) 2014 Netheos (http://www.netheos.net)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <map>
+#include <string>
+#include <system_error>
+
+#include "boost/filesystem/fstream.hpp"
+#include "boost/throw_exception.hpp"
+
+#include "cpprest/asyncrt_utils.h"
+
+#include "pcs_api/internal/path_ids_cache.h"
+#include "pcs_api/internal/logger.h"
+
+namespace pcs_api {
+
+static const char *kFileHeader = "# pcs_api path ids cache";
+
+struct PathIdsCache::Node {
+    Entry entry;
+    std::map<string_t, std::unique_ptr<Node>> children;
+};
+
+size_t PathIdsCache::CountNodes(const Node& node) {
+    size_t count = 1;
+    for (auto& kv : node.children) {
+        count += CountNodes(*kv.second);
+    }
+    return count;
+}
+
+void PathIdsCache::WriteNodes(const Node& node,
+                              const string_t& path_name,
+                              std::ostream* p_os) {
+    for (auto& kv : node.children) {
+        string_t child_path_name = path_name + U("/") + kv.first;
+        const Entry& entry = kv.second->entry;
+        *p_os << (entry.is_folder ? 'F' : 'B') << ' '
+              << utility::conversions::to_utf8string(entry.id) << ' '
+              << utility::conversions::to_utf8string(child_path_name) << '\n';
+        WriteNodes(*kv.second, child_path_name, p_os);
+    }
+}
+
+PathIdsCache::PathIdsCache() : p_root_(new Node()), size_(0) {
+    p_root_->entry = Entry(U("root"), true);
+}
+
+PathIdsCache::~PathIdsCache() {
+}
+
+std::vector<PathIdsCache::Entry> PathIdsCache::Lookup(
+                                                const CPath& path) const {
+    std::vector<Entry> chain;
+    std::vector<string_t> segments = path.Split();
+    std::lock_guard<std::mutex> lock(mutex_);
+    const Node* p_node = p_root_.get();
+    for (const string_t& segment : segments) {
+        auto it = p_node->children.find(segment);
+        if (it == p_node->children.end()) {
+            break;
+        }
+        p_node = it->second.get();
+        chain.push_back(p_node->entry);
+    }
+    return chain;
+}
+
+void PathIdsCache::Put(const CPath& path, const std::vector<Entry>& chain) {
+    std::vector<string_t> segments = path.Split();
+    std::lock_guard<std::mutex> lock(mutex_);
+    Node* p_node = p_root_.get();
+    size_t i = 0;
+    for (; i < chain.size() && i < segments.size(); ++i) {
+        std::unique_ptr<Node>& p_child = p_node->children[segments[i]];
+        if (!p_child) {
+            p_child.reset(new Node());
+            ++size_;
+        } else if (p_child->entry.id != chain[i].id) {
+            // Another file now has this path: cached files below are
+            // outdated
+            size_ -= CountNodes(*p_child) - 1;
+            p_child->children.clear();
+        }
+        p_child->entry = chain[i];
+        p_node = p_child.get();
+    }
+    if (i < segments.size()) {
+        // First missing segment: forget it, if cached
+        auto it = p_node->children.find(segments[i]);
+        if (it != p_node->children.end()) {
+            size_ -= CountNodes(*it->second);
+            p_node->children.erase(it);
+        }
+    }
+}
+
+void PathIdsCache::PutFile(const CPath& path, const Entry& entry) {
+    if (path.IsRoot()) {
+        return;
+    }
+    std::vector<string_t> segments = path.Split();
+    std::lock_guard<std::mutex> lock(mutex_);
+    Node* p_node = p_root_.get();
+    for (size_t i = 0; i + 1 < segments.size(); ++i) {
+        auto it = p_node->children.find(segments[i]);
+        if (it == p_node->children.end()) {
+            return;  // parent folder is unknown
+        }
+        p_node = it->second.get();
+    }
+    std::unique_ptr<Node>& p_child = p_node->children[segments.back()];
+    if (!p_child) {
+        p_child.reset(new Node());
+        ++size_;
+    } else if (p_child->entry.id != entry.id) {
+        size_ -= CountNodes(*p_child) - 1;
+        p_child->children.clear();
+    }
+    p_child->entry = entry;
+}
+
+void PathIdsCache::Remove(const CPath& path) {
+    if (path.IsRoot()) {
+        Clear();
+        return;
+    }
+    std::vector<string_t> segments = path.Split();
+    std::lock_guard<std::mutex> lock(mutex_);
+    Node* p_node = p_root_.get();
+    for (size_t i = 0; i + 1 < segments.size(); ++i) {
+        auto it = p_node->children.find(segments[i]);
+        if (it == p_node->children.end()) {
+            return;  // not cached
+        }
+        p_node = it->second.get();
+    }
+    auto it = p_node->children.find(segments.back());
+    if (it != p_node->children.end()) {
+        size_ -= CountNodes(*it->second);
+        p_node->children.erase(it);
+    }
+}
+
+void PathIdsCache::Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    p_root_->children.clear();
+    size_ = 0;
+}
+
+size_t PathIdsCache::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return size_;
+}
+
+void PathIdsCache::Load(const boost::filesystem::path& file_path) {
+    Clear();
+    if (!boost::filesystem::exists(file_path)) {
+        LOG_DEBUG << "No path ids cache file: " << file_path;
+        return;
+    }
+    LOG_DEBUG << "Will read path ids cache file: " << file_path;
+    boost::filesystem::ifstream is(file_path);
+    if (is.fail()) {
+        std::system_error se(errno, std::system_category());
+        BOOST_THROW_EXCEPTION(std::ios_base::failure(
+                std::string("Could not open file: ") + file_path.string()
+                + ": " + se.what()));
+    }
+    // expected line format is "<F|B> <id> <path>"
+    // (parent folders come before their children):
+    for (std::string line; std::getline(is, line) ;) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::string::size_type id_end = line.find(' ', 2);
+        if (line.length() < 4 || line[1] != ' '
+                || (line[0] != 'F' && line[0] != 'B')
+                || id_end == std::string::npos) {
+            LOG_WARN << "Ignored malformed path ids cache line";
+            continue;
+        }
+        try {
+            CPath path(utility::conversions::to_string_t(
+                                                    line.substr(id_end + 1)));
+            PutFile(path, Entry(utility::conversions::to_string_t(
+                                            line.substr(2, id_end - 2)),
+                                line[0] == 'F'));
+        }
+        catch (const std::invalid_argument&) {
+            LOG_WARN << "Ignored invalid path in path ids cache file";
+        }
+    }
+}
+
+void PathIdsCache::Save(const boost::filesystem::path& file_path) const {
+    LOG_DEBUG << "Writing path ids cache file to " << file_path;
+    boost::filesystem::path temp_path = file_path;
+    temp_path += ".tmp";
+    boost::filesystem::ofstream os(temp_path);
+    if (os.fail()) {
+        std::system_error se(errno, std::system_category());
+        BOOST_THROW_EXCEPTION(std::ios_base::failure(
+                std::string("Could not open file: ") + temp_path.string()
+                + ": " + se.what()));
+    }
+    os << kFileHeader << '\n';
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        WriteNodes(*p_root_, U(""), &os);
+    }
+    os.flush();
+    os.close();
+    if (!os.good()) {
+        BOOST_THROW_EXCEPTION(std::ios_base::failure(
+                            "Could not write file: " + temp_path.string()));
+    }
+    // Rename to final name (need to delete first on windows):
+    boost::filesystem::remove(file_path);
+    boost::filesystem::rename(temp_path, file_path);
+}
+
+}  // namespace pcs_api
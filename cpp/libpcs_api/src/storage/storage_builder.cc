@@ -15,6 +15,7 @@
  */
 
 #include <mutex>
+#include <stdexcept>
 
 #include "cpprest/http_client.h"
 
@@ -28,13 +29,39 @@ namespace pcs_api {
  */
 static const int kDefaultTimeout_s = 3 * 60;
 
+/**
+ * Default connections pooling parameters.
+ */
+static const size_t kDefaultMaxClientsPerHost = 16;
+static const int kDefaultClientsIdleTimeout_s = 60;
+static const int kDefaultClientsMaxWait_s = 30;
+
+/**
+ * Default delay before expiration for renewing OAuth2 tokens.
+ */
+static const int kDefaultTokenRefreshMargin_s = 2 * 60;
+
 
 StorageBuilder::StorageBuilder(const std::string& provider_name,
                                create_provider_func create_instance)
     : provider_name_(provider_name),
       create_instance_func_(create_instance),
       p_retry_strategy_(std::make_shared<RetryStrategy>(5, 1000)),
-      for_bootstrapping_(false) {
+      for_bootstrapping_(false),
+      max_clients_per_host_(kDefaultMaxClientsPerHost),
+      clients_idle_timeout_(std::chrono::seconds(
+                                        kDefaultClientsIdleTimeout_s)),
+      clients_max_wait_(std::chrono::seconds(kDefaultClientsMaxWait_s)),
+      token_refresh_margin_(kDefaultTokenRefreshMargin_s),
+      optimistic_uploads_(false),
+      swift_large_object_threshold_(0),
+      swift_segment_size_(0),
+      swift_max_segments_concurrency_(0),
+      swift_listing_page_size_(0),
+      dropbox_chunked_upload_threshold_(0),
+      dropbox_upload_chunk_size_(0),
+      google_drive_resumable_upload_threshold_(0),
+      google_drive_upload_chunk_size_(0) {
     // Create now a default http_client_config:
     p_http_client_config_.reset(new web::http::client::http_client_config());
     p_http_client_config_->set_timeout(utility::seconds(kDefaultTimeout_s));
@@ -68,6 +95,84 @@ StorageBuilder& StorageBuilder::retry_strategy(
     return *this;
 }
 
+StorageBuilder& StorageBuilder::connection_pool(
+                                    size_t max_clients_per_host,
+                                    std::chrono::milliseconds idle_timeout,
+                                    std::chrono::milliseconds max_wait) {
+    max_clients_per_host_ = max_clients_per_host;
+    clients_idle_timeout_ = idle_timeout;
+    clients_max_wait_ = max_wait;
+    return *this;
+}
+
+StorageBuilder& StorageBuilder::path_ids_cache_file(
+                            const boost::filesystem::path& cache_file_path) {
+    path_ids_cache_file_ = cache_file_path;
+    return *this;
+}
+
+StorageBuilder& StorageBuilder::token_refresh_margin(
+                                            std::chrono::seconds margin) {
+    token_refresh_margin_ = margin;
+    return *this;
+}
+
+StorageBuilder& StorageBuilder::swift_container(
+                                        const std::string& container_name) {
+    swift_container_ = container_name;
+    return *this;
+}
+
+StorageBuilder& StorageBuilder::optimistic_uploads(bool optimistic) {
+    optimistic_uploads_ = optimistic;
+    return *this;
+}
+
+StorageBuilder& StorageBuilder::swift_segmentation(int64_t threshold,
+                                                   int64_t segment_size,
+                                                   int max_concurrency) {
+    if (segment_size <= 0 || max_concurrency <= 0) {
+        BOOST_THROW_EXCEPTION(std::invalid_argument(
+                    "Segment size and concurrency must be strictly positive"));
+    }
+    swift_large_object_threshold_ = threshold;
+    swift_segment_size_ = segment_size;
+    swift_max_segments_concurrency_ = max_concurrency;
+    return *this;
+}
+
+StorageBuilder& StorageBuilder::swift_listing_page_size(int page_size) {
+    if (page_size <= 0) {
+        BOOST_THROW_EXCEPTION(std::invalid_argument(
+                                    "Page size must be strictly positive"));
+    }
+    swift_listing_page_size_ = page_size;
+    return *this;
+}
+
+StorageBuilder& StorageBuilder::dropbox_chunked_upload(int64_t threshold,
+                                                       int64_t chunk_size) {
+    if (chunk_size <= 0) {
+        BOOST_THROW_EXCEPTION(std::invalid_argument(
+                                    "Chunk size must be strictly positive"));
+    }
+    dropbox_chunked_upload_threshold_ = threshold;
+    dropbox_upload_chunk_size_ = chunk_size;
+    return *this;
+}
+
+StorageBuilder& StorageBuilder::google_drive_resumable_upload(
+                                                        int64_t threshold,
+                                                        int64_t chunk_size) {
+    if (chunk_size <= 0) {
+        BOOST_THROW_EXCEPTION(std::invalid_argument(
+                                    "Chunk size must be strictly positive"));
+    }
+    google_drive_resumable_upload_threshold_ = threshold;
+    google_drive_upload_chunk_size_ = chunk_size;
+    return *this;
+}
+
 std::shared_ptr<IStorageProvider> StorageBuilder::Build() {
     if (!p_app_info_repo_) {
         BOOST_THROW_EXCEPTION(
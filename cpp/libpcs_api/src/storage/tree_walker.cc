@@ -0,0 +1,229 @@
+/**
+ * Copyright (c) 2014 Netheos (http://www.netheos.net)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include "pcs_api/tree_walker.h"
+#include "pcs_api/c_exceptions.h"
+#include "pcs_api/internal/logger.h"
+
+namespace pcs_api {
+
+const size_t TreeWalker::kDefaultMaxConcurrency = 8;
+
+namespace {
+
+/**
+ * \brief State of a tree walk, shared by all folders listings.
+ *
+ * Folders waiting to be listed are kept in a LIFO queue: walking depth first
+ * keeps the queue small, even for wide trees.
+ */
+struct TreeWalk {
+    IStorageProvider *p_storage;
+    CPath root_path;
+    size_t max_concurrency;
+    TreeWalker::visitor visitor;
+    TreeWalker::prune_predicate prune_predicate;
+    pplx::task_completion_event<void> completed;
+
+    std::mutex visitor_mutex;  // visitor calls are never concurrent
+
+    std::mutex mutex;  // protects members below
+    std::deque<CPath> pending_folders;
+    size_t nb_in_flight;
+    bool root_found;
+    bool finished;
+    std::exception_ptr p_error;  // first error encountered
+
+    explicit TreeWalk(const CPath& path) :
+        root_path(path), nb_in_flight(0), root_found(true), finished(false) {
+    }
+
+    void SetError(std::exception_ptr p_exception) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!p_error) {
+            p_error = p_exception;
+        }
+    }
+
+    bool HasFailed() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return static_cast<bool>(p_error);
+    }
+};
+
+void ListPendingFolders(std::shared_ptr<TreeWalk> p_walk);
+
+/**
+ * \brief Gives listed files to visitor, and returns the sub folders to be
+ *        listed.
+ */
+std::vector<CPath> VisitFolderContent(
+                            std::shared_ptr<TreeWalk> p_walk,
+                            const CPath& path,
+                            std::shared_ptr<CFolderContent> p_content) {
+    std::vector<CPath> sub_folders;
+    if (!p_content) {
+        // Folder has disappeared since its parent has been listed:
+        LOG_DEBUG << "Folder " << path << " not found while walking";
+        if (path == p_walk->root_path) {
+            std::lock_guard<std::mutex> lock(p_walk->mutex);
+            p_walk->root_found = false;
+        }
+        return sub_folders;
+    }
+    std::lock_guard<std::mutex> lock(p_walk->visitor_mutex);
+    for (auto it = p_content->cbegin(); it != p_content->cend(); ++it) {
+        std::shared_ptr<CFile> p_file = it->second;
+        if (p_walk->HasFailed()) {
+            break;
+        }
+        try {
+            p_walk->visitor(p_file);
+        }
+        catch (...) {
+            // Stored while visitor mutex is held, so that visitor is not
+            // called anymore:
+            p_walk->SetError(std::current_exception());
+            sub_folders.clear();
+            break;
+        }
+        if (p_file->IsFolder()
+                && !(p_walk->prune_predicate
+                     && p_walk->prune_predicate(
+                                *std::static_pointer_cast<CFolder>(p_file)))) {
+            sub_folders.push_back(p_file->path());
+        }
+    }
+    return sub_folders;
+}
+
+/**
+ * \brief Lists a folder, then queues its sub folders and starts next
+ *        listings.
+ *
+ * Returned task never fails: errors are stored in walk state, and stop
+ * the walk.
+ */
+pplx::task<void> ListFolder(std::shared_ptr<TreeWalk> p_walk,
+                            const CPath& path) {
+    pplx::task<std::shared_ptr<CFolderContent>> list_task;
+    try {
+        list_task = p_walk->p_storage->ListFolderAsync(path);
+    }
+    catch (...) {
+        list_task = pplx::task_from_exception<
+                std::shared_ptr<CFolderContent>>(std::current_exception());
+    }
+    return list_task.then([p_walk, path](
+                    pplx::task<std::shared_ptr<CFolderContent>> content_task) {
+        std::vector<CPath> sub_folders;
+        try {
+            sub_folders = VisitFolderContent(p_walk, path, content_task.get());
+        }
+        catch (...) {
+            LOG_WARN << "Walk failed while listing " << path << ": "
+                     << CurrentExceptionToString();
+            p_walk->SetError(std::current_exception());
+        }
+        {
+            std::lock_guard<std::mutex> lock(p_walk->mutex);
+            --p_walk->nb_in_flight;
+            // pushed in reverse order, so that they are listed in order:
+            p_walk->pending_folders.insert(p_walk->pending_folders.end(),
+                                           sub_folders.rbegin(),
+                                           sub_folders.rend());
+        }
+        ListPendingFolders(p_walk);
+    });
+}
+
+/**
+ * \brief Starts as many listings as allowed ; completes walk when there is
+ *        nothing left to list.
+ */
+void ListPendingFolders(std::shared_ptr<TreeWalk> p_walk) {
+    std::vector<CPath> to_list;
+    {
+        std::lock_guard<std::mutex> lock(p_walk->mutex);
+        if (p_walk->p_error) {
+            p_walk->pending_folders.clear();
+        }
+        while (!p_walk->pending_folders.empty()
+                && p_walk->nb_in_flight < p_walk->max_concurrency) {
+            to_list.push_back(p_walk->pending_folders.back());
+            p_walk->pending_folders.pop_back();
+            ++p_walk->nb_in_flight;
+        }
+        if (p_walk->nb_in_flight == 0 && !p_walk->finished) {
+            p_walk->finished = true;
+            p_walk->completed.set();
+            return;
+        }
+    }
+    for (const CPath& path : to_list) {
+        ListFolder(p_walk, path);
+    }
+}
+
+}  // namespace
+
+
+TreeWalker::TreeWalker(IStorageProvider *p_storage)
+    : p_storage_(p_storage),
+      max_concurrency_(kDefaultMaxConcurrency) {
+}
+
+TreeWalker& TreeWalker::set_max_concurrency(size_t max_concurrency) {
+    if (max_concurrency == 0) {
+        BOOST_THROW_EXCEPTION(
+                    std::invalid_argument("Max concurrency must be > 0"));
+    }
+    max_concurrency_ = max_concurrency;
+    return *this;
+}
+
+TreeWalker& TreeWalker::set_prune_predicate(prune_predicate predicate) {
+    prune_predicate_ = predicate;
+    return *this;
+}
+
+bool TreeWalker::Walk(const CPath& path, visitor visitor) {
+    std::shared_ptr<TreeWalk> p_walk = std::make_shared<TreeWalk>(path);
+    p_walk->p_storage = p_storage_;
+    p_walk->max_concurrency = max_concurrency_;
+    p_walk->visitor = visitor;
+    p_walk->prune_predicate = prune_predicate_;
+    p_walk->pending_folders.push_back(path);
+
+    LOG_DEBUG << "Walking " << path << " (" << max_concurrency_
+              << " listings at a time)";
+    ListPendingFolders(p_walk);
+    pplx::create_task(p_walk->completed).wait();
+    if (p_walk->p_error) {
+        LOG_ERROR << "Walk of " << path << " failed: "
+                  << ExceptionPtrToString(p_walk->p_error);
+        std::rethrow_exception(p_walk->p_error);
+    }
+    return p_walk->root_found;
+}
+
+}  // namespace pcs_api
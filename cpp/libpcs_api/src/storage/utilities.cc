@@ -16,6 +16,11 @@
 
 #include <ostream>  // NOLINT(readability/streams)
 #include <random>
+#include <memory>
+#include <thread>
+
+#include "boost/asio/io_service.hpp"
+#include "boost/asio/deadline_timer.hpp"
 
 #include "pcs_api/internal/utilities.h"
 #include "pcs_api/internal/logger.h"
@@ -115,6 +120,62 @@ int64_t DateTimeToTime_t_ms(const boost::posix_time::ptime& pt) {
     return diff.total_milliseconds();
 }
 
+/**
+ * \brief Timer thread, shared by all delayed tasks.
+ *
+ * Created on first use, and stopped at program exit (pending delays then
+ * never complete).
+ */
+class TimerService {
+ public:
+    TimerService()
+        : p_work_(new boost::asio::io_service::work(io_service_)),
+          thread_([this] {
+              io_service_.run();
+          }) {
+    }
+
+    ~TimerService() {
+        p_work_.reset();
+        io_service_.stop();
+        thread_.join();
+    }
+
+    boost::asio::io_service& io_service() {
+        return io_service_;
+    }
+
+ private:
+    boost::asio::io_service io_service_;
+    // keeps run() from returning when no timer is pending:
+    std::unique_ptr<boost::asio::io_service::work> p_work_;
+    std::thread thread_;  // last member: started once others are built
+
+    TimerService(const TimerService&) = delete;
+    TimerService& operator=(const TimerService&) = delete;
+};
+
+static boost::asio::io_service& GetTimerService() {
+    static TimerService timer_service;
+    return timer_service.io_service();
+}
+
+pplx::task<void> CompleteAfter(std::chrono::milliseconds delay) {
+    if (delay.count() <= 0) {
+        return pplx::task_from_result();
+    }
+    pplx::task_completion_event<void> tce;
+    std::shared_ptr<boost::asio::deadline_timer> p_timer =
+        std::make_shared<boost::asio::deadline_timer>(
+                                GetTimerService(),
+                                boost::posix_time::milliseconds(delay.count()));
+    // timer is kept alive by the handler until it fires:
+    p_timer->async_wait([p_timer, tce](const boost::system::error_code&) {
+        tce.set();
+    });
+    return pplx::create_task(tce);
+}
+
 }  // namespace utilities
 
 }  // namespace pcs_api
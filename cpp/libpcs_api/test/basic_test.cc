@@ -16,6 +16,7 @@
 
 #include <algorithm>
 #include <functional>
+#include <set>
 
 #include "gtest/gtest.h"
 
@@ -267,19 +268,36 @@ TEST_P(BasicTest, TestFileOperations) {
         p_storage_->Download(download_request);
         EXPECT_EQ(content_file2, p_mbsi->GetData());
 
+        // Same without any check before upload:
+        LOG_INFO << "Checking optimistic file overwrite: " << fpath2;
+        content_file2 = MiscUtils::GenerateRandomData(1000);
+        p_mbs2 = std::make_shared<MemoryByteSource>(content_file2);
+        upload_request = CUploadRequest(fpath2, p_mbs2);
+        upload_request.set_optimistic(true);
+        p_storage_->Upload(upload_request);
+        p_storage_->Download(download_request);
+        EXPECT_EQ(content_file2, p_mbsi->GetData());
+
         // Check that we can replace replace existing blob with empty content:
         LOG_INFO << "Checking file overwrite with empty file: " << fpath2;
         content_file2 = std::string();  // empty
         p_mbs2 = std::make_shared<MemoryByteSource>(content_file2);
         upload_request = CUploadRequest(fpath2, p_mbs2);
-        p_storage_->Upload(upload_request);
+        std::shared_ptr<CBlob> p_blob =
+                                p_storage_->UploadAndGetBlob(upload_request);
+        ASSERT_TRUE(nullptr != p_blob.get());
+        EXPECT_EQ(fpath2, p_blob->path());
+        EXPECT_EQ(0, p_blob->length());
         p_storage_->Download(download_request);
         EXPECT_EQ(content_file2, p_mbsi->GetData());
 
         // Create a sub_sub_folder:
         CPath sub_sub_path = sub_path.Add(PCS_API_STRING_T("a_sub_sub_folder"));
         LOG_INFO << "Creating sub_sub folder: " << sub_sub_path;
-        p_storage_->CreateFolder(sub_sub_path);
+        std::shared_ptr<CFolder> p_sub_sub_folder =
+                                p_storage_->CreateFolderAndGet(sub_sub_path);
+        ASSERT_TRUE(nullptr != p_sub_sub_folder.get());
+        EXPECT_EQ(sub_sub_path, p_sub_sub_folder->path());
 
         LOG_INFO << "Check uploaded blobs and sub_sub_folder"
                     " all appear in folder list";
@@ -308,6 +326,38 @@ TEST_P(BasicTest, TestFileOperations) {
         EXPECT_FALSE(p_file->IsBlob());
         EXPECT_TRUE(p_file->IsFolder());
 
+        LOG_INFO << "Check that streamed list gives the same files";
+        std::set<CPath> streamed_paths;
+        EXPECT_TRUE(p_storage_->ListFolderStream(sub_path,
+                        [&streamed_paths](std::shared_ptr<CFile> p_file) {
+            EXPECT_TRUE(streamed_paths.insert(p_file->path()).second);
+        }));
+        EXPECT_EQ(3, streamed_paths.size());
+        EXPECT_EQ(1, streamed_paths.count(fpath1));
+        EXPECT_EQ(1, streamed_paths.count(fpath2));
+        EXPECT_EQ(1, streamed_paths.count(sub_sub_path));
+        EXPECT_FALSE(p_storage_->ListFolderStream(
+                                sub_path.Add(PCS_API_STRING_T("nothing")),
+                                [](std::shared_ptr<CFile> p_file) {
+            ADD_FAILURE() << "Unexpected file: " << p_file->path();
+        }));
+
+        LOG_INFO << "Check that recursive list gives the whole tree";
+        std::set<CPath> recursive_paths;
+        EXPECT_TRUE(p_storage_->ListRecursive(temp_root_path,
+                        [&recursive_paths](std::shared_ptr<CFile> p_file) {
+            EXPECT_TRUE(recursive_paths.insert(p_file->path()).second);
+        }));
+        EXPECT_EQ(4, recursive_paths.size());
+        EXPECT_EQ(1, recursive_paths.count(sub_path));
+        EXPECT_EQ(1, recursive_paths.count(fpath1));
+        EXPECT_EQ(1, recursive_paths.count(sub_sub_path));
+        EXPECT_THROW(p_storage_->ListRecursive(fpath1,
+                                        [](std::shared_ptr<CFile> p_file) {
+                        ADD_FAILURE() << "Unexpected file: " << p_file->path();
+                    }),
+                     CInvalidFileTypeException);
+
         LOG_INFO << "Check that list of sub_sub folder is empty: "
                  << sub_sub_path;
         p_folder_content = p_storage_->ListFolder(sub_sub_path);
@@ -349,6 +399,41 @@ TEST_P(BasicTest, TestFileOperations) {
     });
 }
 
+TEST_P(BasicTest, TestUploadInChunks) {
+    // Small thresholds, so that blobs are uploaded in several requests:
+    p_storage_ = GetStorageBuilder(GetParam())
+                    .dropbox_chunked_upload(100000, 100000)
+                    .google_drive_resumable_upload(100000, 256 * 1024)
+                    .Build();
+    WithRandomTestPath([&](CPath temp_root_path) {
+        CPath fpath = temp_root_path.Add(PCS_API_STRING_T("a_chunked_file"));
+        std::string content = MiscUtils::GenerateRandomData(450000);
+        LOG_INFO << "Uploading blob in chunks to: " << fpath;
+        CUploadRequest upload_request(
+                            fpath, std::make_shared<MemoryByteSource>(content));
+        std::shared_ptr<CBlob> p_blob =
+                                p_storage_->UploadAndGetBlob(upload_request);
+        ASSERT_TRUE(nullptr != p_blob.get());
+        EXPECT_EQ(fpath, p_blob->path());
+        EXPECT_EQ(content.length(), p_blob->length());
+
+        std::shared_ptr<MemoryByteSink> p_mbsi =
+                                            std::make_shared<MemoryByteSink>();
+        p_storage_->Download(CDownloadRequest(fpath, p_mbsi));
+        EXPECT_EQ(content, p_mbsi->GetData());
+
+        // Same without any check before upload:
+        LOG_INFO << "Checking optimistic upload in chunks: " << fpath;
+        content = MiscUtils::GenerateRandomData(250000);
+        upload_request = CUploadRequest(
+                            fpath, std::make_shared<MemoryByteSource>(content));
+        upload_request.set_optimistic(true);
+        p_storage_->Upload(upload_request);
+        p_storage_->Download(CDownloadRequest(fpath, p_mbsi));
+        EXPECT_EQ(content, p_mbsi->GetData());
+    });
+}
+
 TEST_P(BasicTest, TestCreateIntermediateFolders) {
     WithRandomTestPath([&](CPath temp_root_path) {
         // We create a deep sub-folder, and check each parent has been created:
@@ -364,6 +449,39 @@ TEST_P(BasicTest, TestCreateIntermediateFolders) {
     });
 }
 
+TEST_P(BasicTest, TestFilesDeletedByAnotherClient) {
+    WithRandomTestPath([&](CPath temp_root_path) {
+        CPath folder_path = temp_root_path.Add(PCS_API_STRING_T("folder"));
+        CPath blob_path = temp_root_path.Add(PCS_API_STRING_T("blob"));
+        CPath child_path = folder_path.Add(PCS_API_STRING_T("child"));
+        std::shared_ptr<MemoryByteSource> p_mbs =
+                            std::make_shared<MemoryByteSource>("content");
+        EXPECT_TRUE(p_storage_->CreateFolder(folder_path));
+        p_storage_->Upload(CUploadRequest(blob_path, p_mbs));
+        p_storage_->Upload(CUploadRequest(child_path, p_mbs));
+
+        // Files are deleted (trashed for Google Drive) by another client,
+        // whereas our storage may still know their ids:
+        std::shared_ptr<IStorageProvider> p_other =
+                                                    CreateProvider(GetParam());
+        EXPECT_TRUE(p_other->Delete(blob_path));
+        EXPECT_TRUE(p_other->Delete(folder_path));
+
+        EXPECT_FALSE(p_storage_->Delete(blob_path));
+        // Uploaded again into a new folder, not into the deleted one:
+        p_storage_->Upload(CUploadRequest(child_path, p_mbs));
+        std::shared_ptr<CFile> p_file = p_storage_->GetFile(child_path);
+        ASSERT_TRUE(nullptr != p_file.get());
+        EXPECT_TRUE(p_file->IsBlob());
+        EXPECT_TRUE(p_other->GetFile(folder_path) != nullptr);
+        // Folder already exists again:
+        EXPECT_FALSE(p_storage_->CreateFolder(folder_path));
+
+        EXPECT_TRUE(p_other->Delete(folder_path));
+        EXPECT_TRUE(p_storage_->CreateFolder(folder_path));
+    });
+}
+
 TEST_P(BasicTest, TestBlobContentType) {
     // Only hubiC supports content-type for now:
     NOT_SUPPORTED_BY_PROVIDER(p_storage_,
@@ -0,0 +1,75 @@
+/**
+ * Copyright (c) 2014 Netheos (http://www.netheos.net)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "pcs_api/internal/bounded_scheduler.h"
+
+namespace pcs_api {
+
+TEST(BoundedSchedulerTest, TestMaxThreads) {
+    pplx::scheduler_ptr p_scheduler = std::make_shared<BoundedScheduler>(3);
+    std::mutex mutex;
+    std::condition_variable cond;
+    int nb_running = 0;
+    int max_running = 0;
+    bool gate_opened = false;
+
+    std::vector<pplx::task<void>> tasks;
+    for (int i = 0; i < 10; ++i) {
+        tasks.push_back(pplx::create_task([&] {
+            std::unique_lock<std::mutex> lock(mutex);
+            ++nb_running;
+            max_running = std::max(max_running, nb_running);
+            cond.notify_all();
+            cond.wait(lock, [&gate_opened] { return gate_opened; });
+            --nb_running;
+        }, pplx::task_options(p_scheduler)));
+    }
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        ASSERT_TRUE(cond.wait_for(lock, std::chrono::seconds(10),
+                                  [&nb_running] { return nb_running == 3; }));
+        gate_opened = true;
+    }
+    cond.notify_all();
+    pplx::when_all(tasks.begin(), tasks.end()).wait();
+    EXPECT_EQ(3, max_running);
+    EXPECT_EQ(0, nb_running);
+}
+
+TEST(BoundedSchedulerTest, TestDestructorRunsQueuedTasks) {
+    std::atomic<int> nb_run(0);
+    {
+        BoundedScheduler scheduler(1);
+        for (int i = 0; i < 5; ++i) {
+            scheduler.schedule([](void* param) {
+                ++*static_cast<std::atomic<int>*>(param);
+            }, &nb_run);
+        }
+    }
+    EXPECT_EQ(5, nb_run);
+}
+
+}  // namespace pcs_api
@@ -19,14 +19,20 @@
 
 #include "gtest/gtest.h"
 
+#include "cpprest/http_client.h"
+
 #include "pcs_api/model.h"
+#include "pcs_api/c_exceptions.h"
 #include "pcs_api/stdout_progress_listener.h"
 #include "pcs_api/file_byte_sink.h"
 #include "pcs_api/file_byte_source.h"
 #include "pcs_api/memory_byte_sink.h"
 #include "pcs_api/memory_byte_source.h"
+#include "pcs_api/internal/c_response.h"
+#include "pcs_api/internal/file_range_byte_sink.h"
 #include "pcs_api/internal/progress_byte_sink.h"
 #include "pcs_api/internal/progress_byte_source.h"
+#include "pcs_api/internal/range_byte_source.h"
 #include "pcs_api/internal/logger.h"
 #include "pcs_api/internal/utilities.h"
 #include "misc_test_utils.h"
@@ -145,6 +151,35 @@ TEST_F(BytesIOTest, TestLongByteSource) {
     CheckByteSources(tmp_path, data);
 }
 
+TEST_F(BytesIOTest, TestRangeByteSource) {
+    auto tmp_path = tmp_dir_ / "range_byte_source.txt";
+    std::string data = MiscUtils::GenerateRandomData(300000);
+    WriteStringToFile(data, tmp_path);
+    std::shared_ptr<ByteSource> p_file_bs =
+                                std::make_shared<FileByteSource>(tmp_path);
+
+    // Ranges of a same source can be read concurrently:
+    std::shared_ptr<ByteSource> p_first =
+            std::make_shared<detail::RangeByteSource>(p_file_bs, 0, 100000);
+    std::shared_ptr<ByteSource> p_last =
+            std::make_shared<detail::RangeByteSource>(p_file_bs, 100000,
+                                                      200000);
+    std::unique_ptr<std::istream> p_first_is = p_first->OpenStream();
+    std::unique_ptr<std::istream> p_last_is = p_last->OpenStream();
+    EXPECT_EQ(data.substr(100000), ConsumeStreamToString(p_last_is.get()));
+    EXPECT_EQ(data.substr(0, 100000), ConsumeStreamToString(p_first_is.get()));
+
+    // Also works with progress decoration:
+    CheckByteSource(std::make_shared<detail::RangeByteSource>(
+                                                p_file_bs, 1234, 5678),
+                    data.substr(1234, 5678));
+    std::shared_ptr<ByteSource> p_memory_bs =
+                                    std::make_shared<MemoryByteSource>(data);
+    CheckByteSource(std::make_shared<detail::RangeByteSource>(
+                                                p_memory_bs, 299999, 1),
+                    data.substr(299999));
+}
+
 static void CheckFileByteSink(const std::string& data_to_write,
                               bool abort,
                               boost::filesystem::path pathname,
@@ -203,6 +238,103 @@ TEST_F(BytesIOTest, TestFileByteSink) {
     }
 }
 
+TEST_F(BytesIOTest, TestFileByteSinkResume) {
+    auto tmp_path = tmp_dir_ / "file_byte_sink_resume.txt";
+    auto part_path = tmp_dir_ / "file_byte_sink_resume.txt.part";
+    auto validator_path =
+                    tmp_dir_ / "file_byte_sink_resume.txt.part.validator";
+    const string_t validator = PCS_API_STRING_T("\"some-etag\"");
+
+    // An interrupted download leaves partial file and its validator:
+    FileByteSink interrupted(tmp_path, true, false);
+    EXPECT_EQ(0, interrupted.GetResumeOffset());  // no validator yet
+    interrupted.SetResumeValidator(validator);
+    interrupted.SetExpectedLength(kByteContent.length());
+    interrupted.OpenStream();
+    interrupted.Write(kByteContent.data(), 10);
+    interrupted.Abort();
+    interrupted.CloseStream();
+    EXPECT_FALSE(boost::filesystem::exists(tmp_path));
+    EXPECT_EQ(10, interrupted.GetResumeOffset());
+    EXPECT_TRUE(boost::filesystem::exists(validator_path));
+
+    // Without resume flag, partial file is ignored:
+    EXPECT_EQ(0, FileByteSink(tmp_path, true, false).GetResumeOffset());
+
+    // A resuming sink completes the partial file:
+    FileByteSink resuming(tmp_path, true, false, true);
+    EXPECT_EQ(10, resuming.GetResumeOffset());
+    EXPECT_EQ(validator, resuming.GetResumeValidator());
+    resuming.SetResume(true);
+    resuming.SetExpectedLength(kByteContent.length());
+    resuming.OpenStream();
+    resuming.Write(kByteContent.data() + 10, kByteContent.length() - 10);
+    resuming.CloseStream();
+    EXPECT_FALSE(boost::filesystem::exists(part_path));
+    EXPECT_FALSE(boost::filesystem::exists(validator_path));
+    boost::filesystem::ifstream read_back(tmp_path, std::ios::binary);
+    EXPECT_EQ(kByteContent, ConsumeStreamToString(&read_back));
+    read_back.close();
+
+    // If server does not resume, partial file is overwritten:
+    WriteStringToFile("garbage", part_path);
+    FileByteSink restarting(tmp_path, true, false);
+    restarting.SetResumeValidator(validator);
+    EXPECT_EQ(7, restarting.GetResumeOffset());
+    restarting.SetResume(false);
+    restarting.OpenStream();
+    restarting.Write(kByteContent.data(), kByteContent.length());
+    restarting.CloseStream();
+    EXPECT_EQ(kByteContent.length(), boost::filesystem::file_size(tmp_path));
+}
+
+TEST_F(BytesIOTest, TestResumedRangeDownloadGetsWholeContent) {
+    auto tmp_path = tmp_dir_ / "file_byte_sink_range.txt";
+    auto validator_path = tmp_dir_ / "file_byte_sink_range.txt.part.validator";
+    const string_t validator = PCS_API_STRING_T("\"some-etag\"");
+
+    // An interrupted range download leaves partial file and its validator:
+    FileByteSink interrupted(tmp_path, true, false);
+    interrupted.SetResumeValidator(validator);
+    interrupted.OpenStream();
+    interrupted.Write(kByteContent.data() + 5, 10);
+    interrupted.Abort();
+    interrupted.CloseStream();
+
+    FileByteSink resuming(tmp_path, true, false, true);
+    CDownloadRequest dr(CPath(PCS_API_STRING_T("/foo")),
+                        std::make_shared<MemoryByteSink>());
+    dr.SetRange(5, 20);
+    int64_t resume_offset;
+    std::map<string_t, string_t> headers = dr.GetHttpHeaders(resuming,
+                                                             &resume_offset);
+    EXPECT_EQ(10, resume_offset);
+    EXPECT_EQ(validator, headers[PCS_API_STRING_T("If-Range")]);
+
+    // Content has changed: server ignores range and sends whole content
+    web::http::http_request request(web::http::methods::GET);
+    request.set_request_uri(web::uri(PCS_API_STRING_T("http://localhost/foo")));
+    web::http::http_response response(web::http::status_codes::OK);
+    response.set_body(kByteContent);
+    std::shared_ptr<CResponse> p_response = std::make_shared<CResponse>(
+                    nullptr,
+                    [](web::http::client::http_client *p_client) {},
+                    request, &response, pplx::cancellation_token_source());
+    EXPECT_THROW(p_response->DownloadDataToSink(&resuming, dr.chunk_size(),
+                                                resume_offset,
+                                                dr.IsPartial()),
+                 CRetriableException);
+    // Partial file is dropped, and range is requested again from start:
+    EXPECT_FALSE(boost::filesystem::exists(tmp_path));
+    EXPECT_FALSE(boost::filesystem::exists(validator_path));
+    EXPECT_EQ(0, resuming.GetResumeOffset());
+    headers = dr.GetHttpHeaders(resuming, &resume_offset);
+    EXPECT_EQ(0, resume_offset);
+    EXPECT_EQ(PCS_API_STRING_T("bytes=5-24"),
+              headers[PCS_API_STRING_T("Range")]);
+    EXPECT_TRUE(headers.find(PCS_API_STRING_T("If-Range")) == headers.end());
+}
+
 TEST_F(BytesIOTest, TestMemoryByteSink) {
     MemoryByteSink mb_sink;
     std::ostream* p_os = mb_sink.OpenStream();
@@ -274,5 +406,42 @@ TEST_F(BytesIOTest, TestProgressByteSink) {
 }
 
 
+TEST_F(BytesIOTest, TestFileRangeByteSink) {
+    auto tmp_path = tmp_dir_ / "file_range_byte_sink.txt";
+    WriteStringToFile(std::string(kByteContent.length(), 'x'), tmp_path);
+    const int64_t half = kByteContent.length() / 2;
+
+    // Write second half first, then first half:
+    detail::FileRangeByteSink second_sink(tmp_path, half,
+                                          kByteContent.length() - half);
+    second_sink.SetExpectedLength(kByteContent.length() - half);
+    second_sink.OpenStream();
+    EXPECT_TRUE(second_sink.IsBufferWritable());
+    second_sink.Write(kByteContent.data() + half,
+                      kByteContent.length() - half);
+    second_sink.CloseStream();
+
+    detail::FileRangeByteSink first_sink(tmp_path, 0, half);
+    first_sink.SetExpectedLength(half);
+    // A first partial write, then range is written again (retry):
+    first_sink.OpenStream();
+    first_sink.Write("garbage", 7);
+    first_sink.CloseStream();
+    first_sink.OpenStream();
+    first_sink.Write(kByteContent.data(), half);
+    // Range can not overflow:
+    EXPECT_THROW(first_sink.Write(kByteContent.data(), 1), CStorageException);
+    first_sink.CloseStream();
+    // Server ignoring range is detected:
+    EXPECT_THROW(first_sink.SetExpectedLength(kByteContent.length()),
+                 CStorageException);
+
+    // File has not been truncated nor extended:
+    EXPECT_EQ(kByteContent.length(), boost::filesystem::file_size(tmp_path));
+    boost::filesystem::ifstream read_back(tmp_path, std::ios::binary);
+    EXPECT_EQ(kByteContent, ConsumeStreamToString(&read_back));
+}
+
+
 }  // namespace pcs_api
 
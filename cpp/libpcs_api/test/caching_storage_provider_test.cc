@@ -0,0 +1,178 @@
+/**
+ * Copyright (c) 2014 Netheos (http://www.netheos.net)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#include "cpprest/asyncrt_utils.h"
+
+#include "pcs_api/caching_storage_provider.h"
+#include "pcs_api/c_exceptions.h"
+#include "pcs_api/memory_byte_source.h"
+
+#include "memory_storage_provider.h"
+
+namespace pcs_api {
+
+class CachingStorageProviderTest : public ::testing::Test {
+ protected:
+    std::shared_ptr<MemoryStorageProvider> p_memory_ =
+                                    std::make_shared<MemoryStorageProvider>();
+    const CPath kFolderPath = CPath(U("/folder"));
+    const CPath kBlobPath = CPath(U("/folder/blob.txt"));
+
+    void Upload(IStorageProvider *p_storage, const CPath& path) {
+        CUploadRequest request(path,
+                               std::make_shared<MemoryByteSource>("content"));
+        p_storage->Upload(request);
+    }
+
+    static CPath BlobPath(int index) {
+        return CPath(U("/blob") + utility::conversions::print_string(index));
+    }
+};
+
+TEST_F(CachingStorageProviderTest, TestHitsAndMisses) {
+    p_memory_->PutBlob(kBlobPath, "content");
+    CachingStorageProvider cache(p_memory_);
+
+    std::shared_ptr<CFile> p_file = cache.GetFile(kBlobPath);
+    ASSERT_TRUE(p_file.get() != nullptr);
+    EXPECT_TRUE(p_file->IsBlob());
+    EXPECT_EQ(p_file, cache.GetFile(kBlobPath));
+    EXPECT_EQ(p_file, cache.GetFileAsync(kBlobPath).get());
+    EXPECT_EQ(1, p_memory_->nb_requests());
+
+    std::shared_ptr<CFolderContent> p_content = cache.ListFolder(kFolderPath);
+    ASSERT_TRUE(p_content.get() != nullptr);
+    EXPECT_EQ(1, p_content->size());
+    EXPECT_EQ(p_content, cache.ListFolderAsync(kFolderPath).get());
+    EXPECT_EQ(p_content, cache.ListFolder(
+            CFolder(kFolderPath, boost::posix_time::not_a_date_time)));
+    EXPECT_EQ(2, p_memory_->nb_requests());
+
+    MetadataCacheStats stats = cache.GetStats();
+    EXPECT_EQ(4, stats.hits);
+    EXPECT_EQ(2, stats.misses);
+    EXPECT_EQ(0, stats.invalidations);
+}
+
+TEST_F(CachingStorageProviderTest, TestNegativeCaching) {
+    CachingStorageProvider cache(p_memory_);
+    EXPECT_FALSE(cache.GetFile(kBlobPath));
+    EXPECT_FALSE(cache.GetFile(kBlobPath));
+    EXPECT_FALSE(cache.ListFolder(kFolderPath));
+    EXPECT_FALSE(cache.ListFolder(kFolderPath));
+    EXPECT_EQ(2, p_memory_->nb_requests());
+
+    // Errors are not cached:
+    p_memory_->PutBlob(kFolderPath, "blob, not folder");
+    cache.Invalidate(kFolderPath);
+    EXPECT_THROW(cache.ListFolder(kFolderPath), CInvalidFileTypeException);
+    EXPECT_THROW(cache.ListFolder(kFolderPath), CInvalidFileTypeException);
+    EXPECT_EQ(4, p_memory_->nb_requests());
+}
+
+TEST_F(CachingStorageProviderTest, TestWritesInvalidate) {
+    CachingStorageProvider cache(p_memory_);
+    EXPECT_FALSE(cache.GetFile(kBlobPath));
+    EXPECT_FALSE(cache.GetFile(kFolderPath));
+    EXPECT_TRUE(cache.ListRootFolder()->empty());
+
+    // Upload invalidates path and parent folders:
+    Upload(&cache, kBlobPath);
+    EXPECT_TRUE(cache.GetFile(kBlobPath)->IsBlob());
+    EXPECT_TRUE(cache.GetFile(kFolderPath)->IsFolder());
+    EXPECT_EQ(1, cache.ListRootFolder()->size());
+    EXPECT_EQ(1, cache.ListFolder(kFolderPath)->size());
+
+    // Delete invalidates all entries below path:
+    EXPECT_TRUE(cache.DeleteAsync(kFolderPath).get());
+    EXPECT_FALSE(cache.GetFile(kBlobPath));
+    EXPECT_FALSE(cache.ListFolder(kFolderPath));
+    EXPECT_TRUE(cache.ListRootFolder()->empty());
+
+    CPath sub_folder_path = kFolderPath.Add(U("sub"));
+    EXPECT_TRUE(cache.CreateFolder(sub_folder_path));
+    EXPECT_TRUE(cache.GetFile(kFolderPath)->IsFolder());
+    EXPECT_TRUE(cache.ListFolder(sub_folder_path)->empty());
+
+    // Failed writes also invalidate (server state is unknown):
+    EXPECT_TRUE(cache.GetFile(sub_folder_path)->IsFolder());
+    EXPECT_THROW(Upload(&cache, sub_folder_path), CInvalidFileTypeException);
+    EXPECT_EQ(4, cache.GetStats().invalidations);
+}
+
+TEST_F(CachingStorageProviderTest, TestReturnedFilesAreCached) {
+    CachingStorageProvider cache(p_memory_);
+    EXPECT_FALSE(cache.GetFile(kBlobPath));
+
+    // Default implementation gets blob after upload:
+    CUploadRequest request(kBlobPath,
+                           std::make_shared<MemoryByteSource>("content"));
+    std::shared_ptr<CBlob> p_blob = cache.UploadAndGetBlob(request);
+    ASSERT_TRUE(p_blob.get() != nullptr);
+    EXPECT_EQ(kBlobPath, p_blob->path());
+    EXPECT_EQ(7, p_blob->length());
+    EXPECT_EQ(3, p_memory_->nb_requests());
+    EXPECT_EQ(p_blob, cache.GetFile(kBlobPath));
+    EXPECT_EQ(3, p_memory_->nb_requests());
+
+    CPath sub_folder_path = kFolderPath.Add(U("sub"));
+    std::shared_ptr<CFolder> p_folder =
+                                    cache.CreateFolderAndGet(sub_folder_path);
+    ASSERT_TRUE(p_folder.get() != nullptr);
+    EXPECT_EQ(sub_folder_path, p_folder->path());
+    EXPECT_EQ(p_folder, cache.GetFile(sub_folder_path));
+    EXPECT_EQ(5, p_memory_->nb_requests());
+
+    // Conflicts are reported as usual:
+    EXPECT_THROW(cache.CreateFolderAndGet(kBlobPath),
+                 CInvalidFileTypeException);
+}
+
+TEST_F(CachingStorageProviderTest, TestChangesSeenAfterTtl) {
+    CachingStorageProvider cache(p_memory_, std::chrono::milliseconds(50));
+    EXPECT_FALSE(cache.GetFile(kBlobPath));
+    p_memory_->PutBlob(kBlobPath, "changed by another client");
+    EXPECT_FALSE(cache.GetFile(kBlobPath));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_TRUE(cache.GetFile(kBlobPath)->IsBlob());
+}
+
+TEST_F(CachingStorageProviderTest, TestSizeIsBounded) {
+    CachingStorageProvider cache(p_memory_, std::chrono::seconds(60), 16);
+    for (int i = 0; i < 100; ++i) {
+        cache.GetFile(BlobPath(i));
+    }
+    EXPECT_EQ(100, p_memory_->nb_requests());
+    // Most entries have been evicted:
+    for (int i = 0; i < 100; ++i) {
+        cache.GetFile(BlobPath(i));
+    }
+    EXPECT_LE(184, p_memory_->nb_requests());
+    // whereas most recently used ones have been kept:
+    int nb_requests = p_memory_->nb_requests();
+    cache.GetFile(BlobPath(99));
+    EXPECT_EQ(nb_requests, p_memory_->nb_requests());
+}
+
+}  // namespace pcs_api
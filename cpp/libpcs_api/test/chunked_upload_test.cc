@@ -0,0 +1,620 @@
+/**
+ * Copyright (c) 2014 Netheos (http://www.netheos.net)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "boost/algorithm/string.hpp"
+#include "boost/lexical_cast.hpp"
+
+#include "gtest/gtest.h"
+
+#include "cpprest/json.h"
+#include "cpprest/asyncrt_utils.h"
+#include "cpprest/http_listener.h"
+
+#include "pcs_api/storage_facade.h"
+#include "pcs_api/memory_byte_source.h"
+#include "pcs_api/oauth2_app_info.h"
+#include "pcs_api/oauth2_credentials.h"
+#include "pcs_api/internal/providers/dropbox.h"
+#include "pcs_api/internal/providers/googledrive.h"
+#include "pcs_api/internal/logger.h"
+
+#include "misc_test_utils.h"
+
+namespace pcs_api {
+
+/**
+ * \brief Repository of a single application.
+ */
+class SingleAppInfoRepository : public AppInfoRepository {
+ public:
+    explicit SingleAppInfoRepository(std::unique_ptr<AppInfo> p_app_info)
+        : p_app_info_(std::move(p_app_info)) {
+    }
+
+    const AppInfo& GetAppInfo(const std::string& provider_name,
+                              const std::string& app_name) const override {
+        return *p_app_info_;
+    }
+
+ private:
+    std::unique_ptr<AppInfo> p_app_info_;
+};
+
+/**
+ * \brief Credentials of a single user, with a non expiring access token
+ *        (nothing is persisted).
+ */
+class SingleUserCredentialsRepository : public UserCredentialsRepository {
+ public:
+    void Save(const UserCredentials& user_credentials) override {
+    }
+
+    std::unique_ptr<UserCredentials> Get(
+                        const AppInfo& app_info,
+                        const std::string& user_id) const override {
+        web::json::value json;
+        json[OAuth2Credentials::kAccessToken] =
+                                        web::json::value::string(U("token"));
+        return std::unique_ptr<UserCredentials>(new UserCredentials(
+                    app_info, "test_user",
+                    *OAuth2Credentials::CreateFromJson(json)));
+    }
+};
+
+/**
+ * \brief Serves Dropbox content API from a local http listener, for testing
+ *        chunked uploads: chunks can be partially received.
+ */
+class DropboxChunkedUploadTest : public ::testing::Test {
+ public:
+    void SetUp() override {
+        server_url_ = U("http://127.0.0.1:")
+                + utility::conversions::print_string(
+                                            MiscUtils::GetFreeLocalPort());
+        p_listener_.reset(
+            new web::http::experimental::listener::http_listener(
+                                                            server_url_));
+        p_listener_->support([this](web::http::http_request request) {
+            Handle(request);
+        });
+        p_listener_->open().wait();
+
+        p_app_repo_ = std::make_shared<SingleAppInfoRepository>(
+            std::unique_ptr<AppInfo>(new OAuth2AppInfo(
+                    Dropbox::kProviderName, "test_app", "app_id", "secret",
+                    std::vector<std::string>(1, "sandbox"),
+                    "http://localhost/")));
+        p_user_repo_ = std::make_shared<SingleUserCredentialsRepository>();
+    }
+
+    void TearDown() override {
+        p_listener_->close().wait();
+    }
+
+ protected:
+    string_t server_url_;
+    std::unique_ptr<web::http::experimental::listener::http_listener>
+                                                                p_listener_;
+    std::shared_ptr<AppInfoRepository> p_app_repo_;
+    std::shared_ptr<UserCredentialsRepository> p_user_repo_;
+
+    std::mutex mutex_;  // protects members below
+    std::string received_;  // bytes of current chunked upload
+    // chunk at this offset is partially received, then fails with 503:
+    int64_t fail_chunk_offset_ = -1;
+    int64_t fail_chunk_received_ = 0;  // bytes kept of failed chunk
+    std::vector<int64_t> chunks_offsets_;  // of chunk requests
+    int nb_mismatches_ = 0;
+    int nb_files_puts_ = 0;
+    std::map<string_t, std::string> files_;  // committed, by path
+
+    /**
+     * \brief Create a Dropbox storage, that sends content requests to
+     *        local server.
+     */
+    std::shared_ptr<IStorageProvider> CreateStorage(int64_t threshold,
+                                                    int64_t chunk_size) {
+        std::shared_ptr<IStorageProvider> p_storage =
+                StorageFacade::ForProvider(Dropbox::kProviderName)
+                    .app_info_repository(p_app_repo_, "")
+                    .user_credentials_repository(p_user_repo_, "")
+                    .retry_strategy(std::make_shared<RetryStrategy>(5, 0))
+                    .optimistic_uploads(true)  // no metadata requests
+                    .dropbox_chunked_upload(threshold, chunk_size)
+                    .Build();
+        std::static_pointer_cast<Dropbox>(p_storage)->content_end_point_ =
+                                                                server_url_;
+        return p_storage;
+    }
+
+    void FailChunk(int64_t offset, int64_t nb_received_bytes) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        fail_chunk_offset_ = offset;
+        fail_chunk_received_ = nb_received_bytes;
+    }
+
+    std::vector<int64_t> ChunksOffsets() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return chunks_offsets_;
+    }
+
+    int NbMismatches() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return nb_mismatches_;
+    }
+
+    int NbFilesPuts() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return nb_files_puts_;
+    }
+
+    std::string File(const string_t& path) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return files_[path];
+    }
+
+ private:
+    static const string_t kScopePrefix;
+
+    void Handle(web::http::http_request request) {
+        string_t path = web::uri::decode(request.relative_uri().path());
+        std::map<string_t, string_t> query = web::uri::split_query(
+                            web::uri::decode(request.relative_uri().query()));
+        request.extract_vector().then([this, request, path, query](
+                                    const std::vector<unsigned char>& body) {
+            request.reply(Respond(path, query,
+                                  std::string(body.begin(), body.end())));
+        });
+    }
+
+    web::http::http_response Respond(
+                                const string_t& path,
+                                const std::map<string_t, string_t>& query,
+                                const std::string& body) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (path == U("/chunked_upload")) {
+            return UploadChunk(query, body);
+        }
+        if (boost::starts_with(path, U("/commit_chunked_upload")
+                                     + kScopePrefix)) {
+            string_t file_path = path.substr(
+                    string_t(U("/commit_chunked_upload")).size()
+                    + kScopePrefix.size() - 1);
+            files_[file_path] = received_;
+            return Metadata(file_path);
+        }
+        if (boost::starts_with(path, U("/files_put") + kScopePrefix)) {
+            ++nb_files_puts_;
+            string_t file_path = path.substr(
+                    string_t(U("/files_put")).size()
+                    + kScopePrefix.size() - 1);
+            files_[file_path] = body;
+            return Metadata(file_path);
+        }
+        return web::http::http_response(web::http::status_codes::NotFound);
+    }
+
+    web::http::http_response UploadChunk(
+                                const std::map<string_t, string_t>& query,
+                                const std::string& body) {
+        int64_t offset = 0;
+        if (query.count(U("upload_id")) == 0) {
+            received_.clear();  // new upload
+        } else {
+            offset = boost::lexical_cast<int64_t>(query.at(U("offset")));
+        }
+        chunks_offsets_.push_back(offset);
+        web::json::value json;
+        json[U("upload_id")] = web::json::value::string(U("upload_1"));
+        if (offset != static_cast<int64_t>(received_.size())) {
+            ++nb_mismatches_;
+            json[U("offset")] = web::json::value::number(
+                                    static_cast<int64_t>(received_.size()));
+            web::http::http_response response(
+                                        web::http::status_codes::BadRequest);
+            response.set_body(json);
+            return response;
+        }
+        if (offset == fail_chunk_offset_) {
+            fail_chunk_offset_ = -1;
+            received_.append(body, 0, fail_chunk_received_);
+            return web::http::http_response(
+                                web::http::status_codes::ServiceUnavailable);
+        }
+        received_.append(body);
+        json[U("offset")] = web::json::value::number(
+                                    static_cast<int64_t>(received_.size()));
+        web::http::http_response response(web::http::status_codes::OK);
+        response.set_body(json);
+        return response;
+    }
+
+    web::http::http_response Metadata(const string_t& file_path) {
+        web::json::value json;
+        json[U("path")] = web::json::value::string(file_path);
+        json[U("is_dir")] = web::json::value::boolean(false);
+        json[U("bytes")] = web::json::value::number(
+                            static_cast<int64_t>(files_[file_path].size()));
+        json[U("mime_type")] = web::json::value::string(
+                                            U("application/octet-stream"));
+        json[U("modified")] = web::json::value::string(
+                                        U("Sat, 21 Aug 2010 22:31:20 +0000"));
+        web::http::http_response response(web::http::status_codes::OK);
+        response.set_body(json);
+        return response;
+    }
+};
+
+const string_t DropboxChunkedUploadTest::kScopePrefix = U("/sandbox/");
+
+TEST_F(DropboxChunkedUploadTest, TestSmallBlobIsSentAtOnce) {
+    std::shared_ptr<IStorageProvider> p_storage = CreateStorage(1000, 400);
+    std::string content = MiscUtils::GenerateRandomData(1000);
+    CPath path(U("/small"));
+    p_storage->Upload(CUploadRequest(
+                            path, std::make_shared<MemoryByteSource>(content)));
+
+    EXPECT_EQ(1, NbFilesPuts());
+    EXPECT_TRUE(ChunksOffsets().empty());
+    EXPECT_EQ(content, File(U("/small")));
+}
+
+TEST_F(DropboxChunkedUploadTest, TestLargeBlobIsSentInChunks) {
+    std::shared_ptr<IStorageProvider> p_storage = CreateStorage(1000, 400);
+    std::string content = MiscUtils::GenerateRandomData(3000);
+    CPath path(U("/large"));
+    std::shared_ptr<CBlob> p_blob = p_storage->UploadAndGetBlob(CUploadRequest(
+                            path, std::make_shared<MemoryByteSource>(content)));
+
+    ASSERT_TRUE(nullptr != p_blob.get());
+    EXPECT_EQ(path, p_blob->path());
+    EXPECT_EQ(3000, p_blob->length());
+    EXPECT_EQ(content, File(U("/large")));
+    EXPECT_EQ(0, NbFilesPuts());
+    // Chunks are enlarged, as they are sent quickly:
+    std::vector<int64_t> expected_offsets = { 0, 400, 1200, 2800 };
+    EXPECT_EQ(expected_offsets, ChunksOffsets());
+    EXPECT_EQ(0, NbMismatches());
+}
+
+TEST_F(DropboxChunkedUploadTest, TestUploadResumesAtServerOffset) {
+    std::shared_ptr<IStorageProvider> p_storage = CreateStorage(1000, 400);
+    std::string content = MiscUtils::GenerateRandomData(3000);
+    // Second chunk is received partially, then fails:
+    FailChunk(400, 300);
+    CPath path(U("/resumed"));
+    p_storage->Upload(CUploadRequest(
+                            path, std::make_shared<MemoryByteSource>(content)));
+
+    EXPECT_EQ(content, File(U("/resumed")));
+    EXPECT_EQ(1, NbMismatches());
+    // Failed chunk is sent again, refused (offset mismatch), then sent
+    // from the offset expected by server, without any delay ;
+    // chunk size is not enlarged after failures:
+    std::vector<int64_t> offsets = ChunksOffsets();
+    ASSERT_LE(5u, offsets.size());
+    std::vector<int64_t> expected_offsets = { 0, 400, 400, 700, 1500 };
+    EXPECT_EQ(expected_offsets,
+              std::vector<int64_t>(offsets.begin(), offsets.begin() + 5));
+}
+
+/**
+ * \brief Serves Google Drive uploads from a local http listener, for testing
+ *        resumable uploads: chunks can be partially committed, and upload
+ *        sessions can be lost.
+ */
+class GoogleDriveResumableUploadTest : public ::testing::Test {
+ public:
+    void SetUp() override {
+        server_url_ = U("http://127.0.0.1:")
+                + utility::conversions::print_string(
+                                            MiscUtils::GetFreeLocalPort());
+        p_listener_.reset(
+            new web::http::experimental::listener::http_listener(
+                                                            server_url_));
+        p_listener_->support([this](web::http::http_request request) {
+            Handle(request);
+        });
+        p_listener_->open().wait();
+
+        p_app_repo_ = std::make_shared<SingleAppInfoRepository>(
+            std::unique_ptr<AppInfo>(new OAuth2AppInfo(
+                    GoogleDrive::kProviderName, "test_app", "app_id", "secret",
+                    std::vector<std::string>(
+                            1, "https://www.googleapis.com/auth/drive"),
+                    "http://localhost/")));
+        p_user_repo_ = std::make_shared<SingleUserCredentialsRepository>();
+        // Small threshold (chunks are at least 256 KiB):
+        p_storage_ = StorageFacade::ForProvider(GoogleDrive::kProviderName)
+                    .app_info_repository(p_app_repo_, "")
+                    .user_credentials_repository(p_user_repo_, "")
+                    .retry_strategy(std::make_shared<RetryStrategy>(5, 0))
+                    .google_drive_resumable_upload(300000, 256 * 1024)
+                    .Build();
+        std::static_pointer_cast<GoogleDrive>(p_storage_)
+                        ->files_upload_end_point_ = server_url_ + U("/files");
+    }
+
+    void TearDown() override {
+        p_listener_->close().wait();
+    }
+
+ protected:
+    string_t server_url_;
+    std::unique_ptr<web::http::experimental::listener::http_listener>
+                                                                p_listener_;
+    std::shared_ptr<AppInfoRepository> p_app_repo_;
+    std::shared_ptr<UserCredentialsRepository> p_user_repo_;
+    std::shared_ptr<IStorageProvider> p_storage_;
+
+    std::mutex mutex_;  // protects members below
+    // received requests, as "multipart", "session <n>" (session creation),
+    // or "<n>: bytes <range>" (request within session n):
+    std::vector<std::string> requests_;
+    int nb_sessions_ = 0;
+    int64_t length_ = 0;  // of blob uploaded in current session
+    std::string received_;  // bytes committed in current session
+    // chunk at this offset is partially committed, then fails with 503:
+    int64_t fail_chunk_offset_ = -1;
+    int64_t fail_chunk_received_ = 0;  // bytes kept of failed chunk
+    int fail_chunk_session_status_ = 0;  // session is lost if not 0
+    // chunk at this offset fails with this status, and loses session:
+    int64_t lose_session_offset_ = -1;
+    int lose_session_status_ = 404;
+    std::map<int, int> lost_sessions_;  // status, by session
+
+    /**
+     * \brief Upload a new blob (without checking destination).
+     *
+     * @return json file resource of uploaded blob (null if unknown)
+     */
+    web::json::value SendBlob(const std::string& content) {
+        CUploadRequest upload_request(
+                        CPath(U("/blob")),
+                        std::make_shared<MemoryByteSource>(content));
+        web::json::value json_meta = web::json::value::object();
+        json_meta[U("title")] = web::json::value::string(U("blob"));
+        return std::static_pointer_cast<GoogleDrive>(p_storage_)->SendBlob(
+                                        upload_request, string_t(), json_meta);
+    }
+
+    /**
+     * @param session_status if not 0, session is lost after failure, and
+     *        answers this status
+     */
+    void FailChunk(int64_t offset, int64_t nb_committed_bytes,
+                   int session_status = 0) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        fail_chunk_offset_ = offset;
+        fail_chunk_received_ = nb_committed_bytes;
+        fail_chunk_session_status_ = session_status;
+    }
+
+    /**
+     * \brief Check upload of a blob whose second chunk fails: session is
+     *        lost, so upload restarts in a new session.
+     */
+    void CheckUploadRestartsWhenSessionIsLost(int status) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            lose_session_offset_ = 262144;
+            lose_session_status_ = status;
+        }
+        std::string content = MiscUtils::GenerateRandomData(600000);
+        web::json::value json = SendBlob(content);
+
+        EXPECT_EQ(U("file_id"), json.at(U("id")).as_string());
+        EXPECT_EQ(content, Received());
+        std::vector<std::string> expected_requests = {
+            "session 1",
+            "1: bytes 0-262143/600000",
+            "1: bytes 262144-524287/600000",
+            "session 2",
+            "2: bytes 0-262143/600000",
+            "2: bytes 262144-524287/600000",
+            "2: bytes 524288-599999/600000" };
+        EXPECT_EQ(expected_requests, Requests());
+    }
+
+    std::vector<std::string> Requests() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return requests_;
+    }
+
+    std::string Received() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return received_;
+    }
+
+ private:
+    void Handle(web::http::http_request request) {
+        string_t path = web::uri::decode(request.relative_uri().path());
+        std::map<string_t, string_t> query = web::uri::split_query(
+                            web::uri::decode(request.relative_uri().query()));
+        web::http::http_headers headers = request.headers();
+        request.extract_vector().then([this, request, path, query, headers](
+                                    const std::vector<unsigned char>& body) {
+            request.reply(Respond(path, query, headers,
+                                  std::string(body.begin(), body.end())));
+        });
+    }
+
+    static string_t Header(const web::http::http_headers& headers,
+                           const string_t& name) {
+        auto it = headers.find(name);
+        return it == headers.end() ? string_t() : it->second;
+    }
+
+    web::http::http_response Respond(
+                                const string_t& path,
+                                const std::map<string_t, string_t>& query,
+                                const web::http::http_headers& headers,
+                                const std::string& body) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (boost::starts_with(path, U("/files"))) {
+            auto it = query.find(U("uploadType"));
+            if (it != query.end() && it->second == U("multipart")) {
+                requests_.push_back("multipart");
+                return Uploaded();
+            }
+            // New upload session:
+            ++nb_sessions_;
+            requests_.push_back("session "
+                                + std::to_string(nb_sessions_));
+            length_ = boost::lexical_cast<int64_t>(
+                            Header(headers, U("X-Upload-Content-Length")));
+            received_.clear();
+            web::http::http_response response(web::http::status_codes::OK);
+            response.headers().add(web::http::header_names::location,
+                    server_url_ + U("/session/")
+                    + utility::conversions::print_string(nb_sessions_));
+            return response;
+        }
+        if (boost::starts_with(path, U("/session/"))) {
+            int session = boost::lexical_cast<int>(path.substr(9));
+            string_t content_range = Header(headers, U("Content-Range"));
+            requests_.push_back(std::to_string(session) + ": "
+                    + utility::conversions::to_utf8string(content_range));
+            auto lost_it = lost_sessions_.find(session);
+            if (lost_it != lost_sessions_.end()) {
+                return web::http::http_response(lost_it->second);
+            }
+            // "bytes */<length>" (query) or "bytes <first>-<last>/<length>"
+            string_t range = content_range.substr(6);
+            if (range[0] != U('*')) {
+                int64_t offset = boost::lexical_cast<int64_t>(
+                                        range.substr(0, range.find(U('-'))));
+                if (offset != static_cast<int64_t>(received_.size())) {
+                    return web::http::http_response(
+                                        web::http::status_codes::BadRequest);
+                }
+                if (offset == lose_session_offset_) {
+                    lose_session_offset_ = -1;
+                    lost_sessions_[session] = lose_session_status_;
+                    return web::http::http_response(lose_session_status_);
+                }
+                if (offset == fail_chunk_offset_) {
+                    fail_chunk_offset_ = -1;
+                    received_.append(body, 0, fail_chunk_received_);
+                    if (fail_chunk_session_status_ != 0) {
+                        lost_sessions_[session] = fail_chunk_session_status_;
+                    }
+                    return web::http::http_response(
+                                web::http::status_codes::ServiceUnavailable);
+                }
+                received_.append(body);
+            }
+            if (static_cast<int64_t>(received_.size()) == length_) {
+                return Uploaded();
+            }
+            // Resume Incomplete:
+            web::http::http_response response(308);
+            if (!received_.empty()) {
+                response.headers().add(web::http::header_names::range,
+                        U("bytes=0-") + utility::conversions::print_string(
+                                                        received_.size() - 1));
+            }
+            return response;
+        }
+        return web::http::http_response(web::http::status_codes::NotFound);
+    }
+
+    web::http::http_response Uploaded() {
+        web::json::value json;
+        json[U("id")] = web::json::value::string(U("file_id"));
+        json[U("title")] = web::json::value::string(U("blob"));
+        web::http::http_response response(web::http::status_codes::OK);
+        response.set_body(json);
+        return response;
+    }
+};
+
+TEST_F(GoogleDriveResumableUploadTest, TestSmallBlobIsSentAtOnce) {
+    web::json::value json = SendBlob(MiscUtils::GenerateRandomData(300000));
+
+    EXPECT_EQ(U("file_id"), json.at(U("id")).as_string());
+    std::vector<std::string> expected_requests = { "multipart" };
+    EXPECT_EQ(expected_requests, Requests());
+}
+
+TEST_F(GoogleDriveResumableUploadTest, TestLargeBlobIsSentInChunks) {
+    std::string content = MiscUtils::GenerateRandomData(600000);
+    web::json::value json = SendBlob(content);
+
+    EXPECT_EQ(U("file_id"), json.at(U("id")).as_string());
+    EXPECT_EQ(content, Received());
+    std::vector<std::string> expected_requests = {
+        "session 1",
+        "1: bytes 0-262143/600000",
+        "1: bytes 262144-524287/600000",
+        "1: bytes 524288-599999/600000" };
+    EXPECT_EQ(expected_requests, Requests());
+}
+
+TEST_F(GoogleDriveResumableUploadTest, TestUploadContinuesAfterFailedChunk) {
+    std::string content = MiscUtils::GenerateRandomData(600000);
+    // Second chunk is partially committed, then fails:
+    FailChunk(262144, 100000);
+    web::json::value json = SendBlob(content);
+
+    EXPECT_EQ(U("file_id"), json.at(U("id")).as_string());
+    EXPECT_EQ(content, Received());
+    // Server is asked for committed bytes, and upload continues from there:
+    std::vector<std::string> expected_requests = {
+        "session 1",
+        "1: bytes 0-262143/600000",
+        "1: bytes 262144-524287/600000",
+        "1: bytes */600000",
+        "1: bytes 362144-599999/600000" };
+    EXPECT_EQ(expected_requests, Requests());
+}
+
+TEST_F(GoogleDriveResumableUploadTest, TestUploadRestartsAfter404) {
+    CheckUploadRestartsWhenSessionIsLost(404);
+}
+
+TEST_F(GoogleDriveResumableUploadTest, TestUploadRestartsAfter410) {
+    CheckUploadRestartsWhenSessionIsLost(410);
+}
+
+TEST_F(GoogleDriveResumableUploadTest, TestUploadRestartsAfterLostQuery) {
+    std::string content = MiscUtils::GenerateRandomData(600000);
+    // Second chunk fails, then session is not known anymore:
+    FailChunk(262144, 100000, 410);
+    web::json::value json = SendBlob(content);
+
+    EXPECT_EQ(U("file_id"), json.at(U("id")).as_string());
+    EXPECT_EQ(content, Received());
+    std::vector<std::string> expected_requests = {
+        "session 1",
+        "1: bytes 0-262143/600000",
+        "1: bytes 262144-524287/600000",
+        "1: bytes */600000",
+        "session 2",
+        "2: bytes 0-262143/600000",
+        "2: bytes 262144-524287/600000",
+        "2: bytes 524288-599999/600000" };
+    EXPECT_EQ(expected_requests, Requests());
+}
+
+}  // namespace pcs_api
@@ -0,0 +1,176 @@
+/**
+ * Copyright (c) 2014 Netheos (http://www.netheos.net)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "boost/filesystem.hpp"
+
+#include "gtest/gtest.h"
+
+#include "cpprest/http_client.h"
+#include "cpprest/http_listener.h"
+
+#include "pcs_api/memory_byte_sink.h"
+#include "pcs_api/file_byte_sink.h"
+#include "pcs_api/internal/c_response.h"
+#include "pcs_api/internal/logger.h"
+
+#include "misc_test_utils.h"
+
+namespace pcs_api {
+
+/**
+ * A sink decorator that only supports writes through its stream
+ * (as user defined sinks usually do).
+ */
+class StreamOnlyByteSink : public ByteSink {
+ public:
+    explicit StreamOnlyByteSink(std::shared_ptr<ByteSink> p_delegate) :
+        p_delegate_(p_delegate) {
+    }
+    std::ostream* OpenStream() override {
+        return p_delegate_->OpenStream();
+    }
+    void CloseStream() override {
+        p_delegate_->CloseStream();
+    }
+    void SetExpectedLength(std::streamsize expected_length) override {
+        p_delegate_->SetExpectedLength(expected_length);
+    }
+    void Abort() override {
+        p_delegate_->Abort();
+    }
+
+ private:
+    std::shared_ptr<ByteSink> p_delegate_;
+};
+
+/**
+ * Downloads a blob served by a local http listener, and reports throughput
+ * as test properties (in MB/s).
+ *
+ * These benchmarks are disabled by default: run them with
+ * --gtest_also_run_disabled_tests --gtest_filter=*DownloadBenchmark*
+ */
+class DownloadBenchmarkTest : public ::testing::Test {
+ public:
+    void SetUp() override {
+        content_.resize(32 * 1024 * 1024);
+        for (size_t i = 0; i < content_.size(); ++i) {
+            content_[i] = static_cast<unsigned char>(i * 31 + (i >> 12));
+        }
+        url_ = U("http://127.0.0.1:")
+                + utility::conversions::print_string(
+                                            MiscUtils::GetFreeLocalPort())
+                + U("/blob");
+        p_listener_.reset(
+            new web::http::experimental::listener::http_listener(url_));
+        p_listener_->support(web::http::methods::GET,
+                             [this](web::http::http_request request) {
+            web::http::http_response response(web::http::status_codes::OK);
+            response.set_body(std::vector<unsigned char>(content_));
+            request.reply(response);
+        });
+        p_listener_->open().wait();
+    }
+
+    void TearDown() override {
+        p_listener_->close().wait();
+    }
+
+ protected:
+    string_t url_;
+    std::vector<unsigned char> content_;
+    std::unique_ptr<web::http::experimental::listener::http_listener>
+                                                                p_listener_;
+
+    std::string ContentAsString() const {
+        return std::string(content_.begin(), content_.end());
+    }
+
+    /**
+     * @return download throughput, in MB/s
+     */
+    double Download(ByteSink *p_sink, size_t chunk_size) {
+        web::http::client::http_client *p_client =
+                            new web::http::client::http_client(url_);
+        web::http::http_request request(web::http::methods::GET);
+        pplx::cancellation_token_source cancel_source;
+
+        std::chrono::steady_clock::time_point start =
+                                            std::chrono::steady_clock::now();
+        web::http::http_response response =
+                    p_client->request(request, cancel_source.get_token()).get();
+        std::shared_ptr<CResponse> p_response = std::make_shared<CResponse>(
+            p_client,
+            [](web::http::client::http_client *p_c) { delete p_c; },
+            request, &response, cancel_source);
+        p_response->DownloadDataToSink(p_sink, chunk_size);
+        std::chrono::duration<double> elapsed =
+                                    std::chrono::steady_clock::now() - start;
+
+        double rate = content_.size() / (1024.0 * 1024.0) / elapsed.count();
+        RecordProperty(std::string(p_sink->IsBufferWritable() ?
+                                            "buffers_" : "stream_")
+                       + std::to_string(chunk_size) + "_mb_per_s",
+                       std::to_string(rate));
+        return rate;
+    }
+
+    void RecordSpeedup(size_t chunk_size, double speedup) {
+        RecordProperty("speedup_" + std::to_string(chunk_size),
+                       std::to_string(speedup));
+    }
+};
+
+TEST_F(DownloadBenchmarkTest, DISABLED_TestMemorySink) {
+    // Reference: small writes through sink stream
+    std::shared_ptr<MemoryByteSink> p_mbs = std::make_shared<MemoryByteSink>();
+    StreamOnlyByteSink stream_sink(p_mbs);
+    double reference_rate = Download(&stream_sink, 2048);
+    EXPECT_EQ(ContentAsString(), p_mbs->GetData());
+
+    const size_t chunk_sizes[] = { 64 * 1024, 1024 * 1024, 4 * 1024 * 1024 };
+    for (size_t chunk_size : chunk_sizes) {
+        MemoryByteSink buffer_sink;
+        double rate = Download(&buffer_sink, chunk_size);
+        EXPECT_EQ(ContentAsString(), buffer_sink.GetData());
+        RecordSpeedup(chunk_size, rate / reference_rate);
+    }
+}
+
+TEST_F(DownloadBenchmarkTest, DISABLED_TestFileSink) {
+    boost::filesystem::path tmp_path =
+                boost::filesystem::unique_path("pcs_api_%%%%%%%%.bench");
+    {
+        FileByteSink file_sink(tmp_path);
+        StreamOnlyByteSink stream_sink(
+                std::shared_ptr<ByteSink>(&file_sink, [](ByteSink*) {}));
+        double reference_rate = Download(&stream_sink, 2048);
+        EXPECT_EQ(content_.size(), boost::filesystem::file_size(tmp_path));
+
+        const size_t chunk_size = 4 * 1024 * 1024;
+        double rate = Download(&file_sink, chunk_size);
+        EXPECT_EQ(content_.size(), boost::filesystem::file_size(tmp_path));
+        RecordSpeedup(chunk_size, rate / reference_rate);
+    }
+    boost::filesystem::remove(tmp_path);
+}
+
+}  // namespace pcs_api
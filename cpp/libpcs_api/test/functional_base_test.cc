@@ -66,6 +66,11 @@ void FunctionalTest::CreateRepositories() {
 
 std::shared_ptr<IStorageProvider> FunctionalTest::CreateProvider(
                                             const std::string& provider_name) {
+    return GetStorageBuilder(provider_name).Build();
+}
+
+StorageBuilder FunctionalTest::GetStorageBuilder(
+                                            const std::string& provider_name) {
     StorageBuilder builder = StorageFacade::ForProvider(provider_name)
             .app_info_repository(p_app_repo_, "")
             .user_credentials_repository(p_user_repo_, "");
@@ -74,8 +79,7 @@ std::shared_ptr<IStorageProvider> FunctionalTest::CreateProvider(
     // web::web_proxy proxy(web::uri(U("https://10.0.0.1:3128")));
     // proxy.set_credentials(web::credentials(U("user"), U("password")));
     // builder.http_client_config()->set_proxy(proxy);
-    std::shared_ptr<IStorageProvider> p_storage = builder.Build();
-    return p_storage;
+    return builder;
 }
 
 static void DeleteQuietly(CPath path,
@@ -22,6 +22,7 @@
 #include <vector>
 
 #include "pcs_api/i_storage_provider.h"
+#include "pcs_api/storage_builder.h"
 
 // defined in main:
 extern std::vector<std::string> g_providers_to_be_tested;
@@ -52,10 +53,21 @@ class FunctionalTest : public ::testing::TestWithParam<std::string> {
     std::shared_ptr<UserCredentialsRepository> p_user_repo_;
     std::shared_ptr<IStorageProvider> p_storage_;
 
- private:
-    void CreateRepositories();
+    /**
+     * \brief Create another instance of a provider (as another client
+     *        would do).
+     */
     std::shared_ptr<IStorageProvider> CreateProvider(
                                             const std::string& provider_name);
+
+    /**
+     * \brief Get a builder of provider instances, for tests that change
+     *        storage settings.
+     */
+    StorageBuilder GetStorageBuilder(const std::string& provider_name);
+
+ private:
+    void CreateRepositories();
 };
 
 }  // namespace pcs_api
@@ -0,0 +1,256 @@
+/**
+ * Copyright (c) 2014 Netheos (http://www.netheos.net)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <istream>  // NOLINT(readability/streams)
+#include <sstream>
+
+#include "cpprest/asyncrt_utils.h"
+
+#include "pcs_api/c_exceptions.h"
+#include "pcs_api/internal/c_folder_content_builder.h"
+
+#include "memory_storage_provider.h"
+
+namespace pcs_api {
+
+MemoryStorageProvider::MemoryStorageProvider() :
+    next_version_(1), ignore_if_match_(false),
+    nb_download_failures_(0), nb_downloads_(0), nb_requests_(0) {
+    folders_.insert(CPath(U("/")));
+}
+
+std::string MemoryStorageProvider::GetProviderName() const {
+    return "memory";
+}
+
+std::string MemoryStorageProvider::GetUserId() {
+    return "memory_user";
+}
+
+CQuota MemoryStorageProvider::GetQuota() {
+    ++nb_requests_;
+    std::lock_guard<std::mutex> lock(mutex_);
+    int64_t used = 0;
+    for (auto& kv : blobs_) {
+        used += kv.second.size();
+    }
+    return CQuota(used, -1);
+}
+
+std::shared_ptr<CFolderContent> MemoryStorageProvider::ListRootFolder() {
+    return ListFolder(CPath(U("/")));
+}
+
+std::shared_ptr<CFolderContent> MemoryStorageProvider::ListFolder(
+                                                        const CFolder& folder) {
+    return ListFolder(folder.path());
+}
+
+std::shared_ptr<CFolderContent> MemoryStorageProvider::ListFolder(
+                                                        const CPath& path) {
+    ++nb_requests_;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (blobs_.count(path) > 0) {
+        BOOST_THROW_EXCEPTION(CInvalidFileTypeException(path, false));
+    }
+    if (folders_.count(path) == 0) {
+        return std::shared_ptr<CFolderContent>();
+    }
+    CFolderContentBuilder cfcb;
+    for (const CPath& folder_path : folders_) {
+        if (!folder_path.IsRoot() && folder_path.GetParent() == path) {
+            cfcb.Add(folder_path, std::make_shared<CFolder>(
+                        folder_path, boost::posix_time::not_a_date_time));
+        }
+    }
+    for (auto& kv : blobs_) {
+        if (kv.first.GetParent() == path) {
+            cfcb.Add(kv.first, std::make_shared<CBlob>(
+                        kv.first, kv.second.size(), U("text/plain"),
+                        boost::posix_time::not_a_date_time));
+        }
+    }
+    return cfcb.BuildFolderContent();
+}
+
+void MemoryStorageProvider::AddParentFolders(const CPath& path) {
+    for (CPath parent = path.GetParent(); !parent.IsRoot();
+                                          parent = parent.GetParent()) {
+        folders_.insert(parent);
+    }
+}
+
+bool MemoryStorageProvider::CreateFolder(const CPath& path) {
+    ++nb_requests_;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (blobs_.count(path) > 0) {
+        BOOST_THROW_EXCEPTION(CInvalidFileTypeException(path, false));
+    }
+    for (CPath parent = path.GetParent(); !parent.IsRoot();
+                                          parent = parent.GetParent()) {
+        if (blobs_.count(parent) > 0) {
+            BOOST_THROW_EXCEPTION(CInvalidFileTypeException(parent, false));
+        }
+    }
+    if (folders_.count(path) > 0) {
+        return false;
+    }
+    AddParentFolders(path);
+    folders_.insert(path);
+    return true;
+}
+
+/**
+ * @return true if path is equal to folder_path, or a descendant of it.
+ */
+static bool IsSameOrDescendant(const CPath& path, const CPath& folder_path) {
+    if (folder_path.IsRoot()) {
+        return true;
+    }
+    string_t folder_name = folder_path.path_name();
+    string_t name = path.path_name();
+    return name == folder_name || name.compare(0, folder_name.length() + 1,
+                                               folder_name + U("/")) == 0;
+}
+
+bool MemoryStorageProvider::Delete(const CPath& path) {
+    ++nb_requests_;
+    std::lock_guard<std::mutex> lock(mutex_);
+    bool deleted = false;
+    for (auto it = blobs_.begin(); it != blobs_.end();) {
+        if (IsSameOrDescendant(it->first, path)) {
+            it = blobs_.erase(it);
+            deleted = true;
+        } else {
+            ++it;
+        }
+    }
+    for (auto it = folders_.begin(); it != folders_.end();) {
+        if (!it->IsRoot() && IsSameOrDescendant(*it, path)) {
+            it = folders_.erase(it);
+            deleted = true;
+        } else {
+            ++it;
+        }
+    }
+    return deleted;
+}
+
+std::shared_ptr<CFile> MemoryStorageProvider::GetFile(const CPath& path) {
+    ++nb_requests_;
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = blobs_.find(path);
+    if (it != blobs_.end()) {
+        return std::make_shared<CBlob>(path, it->second.size(), U("text/plain"),
+                                       boost::posix_time::not_a_date_time);
+    }
+    if (folders_.count(path) > 0) {
+        return std::make_shared<CFolder>(path,
+                                         boost::posix_time::not_a_date_time);
+    }
+    return std::shared_ptr<CFile>();
+}
+
+void MemoryStorageProvider::Download(
+                                    const CDownloadRequest& download_request) {
+    ++nb_requests_;
+    ++nb_downloads_;
+    if (download_hook_) {
+        download_hook_();
+    }
+    const CPath& path = download_request.path();
+    std::string content;
+    string_t etag;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = blobs_.find(path);
+        if (it == blobs_.end()) {
+            if (folders_.count(path) > 0) {
+                BOOST_THROW_EXCEPTION(CInvalidFileTypeException(path, true));
+            }
+            BOOST_THROW_EXCEPTION(CFileNotFoundException("Blob not found",
+                                                         path));
+        }
+        content = it->second;
+        etag = U("\"") + utility::conversions::print_string(versions_[path])
+               + U("\"");
+    }
+    if (nb_download_failures_.fetch_sub(1) > 0) {
+        BOOST_THROW_EXCEPTION(CStorageException("Injected download failure"));
+    }
+
+    std::map<string_t, string_t> headers = download_request.GetHttpHeaders();
+    auto if_match_it = headers.find(U("If-Match"));
+    if (!ignore_if_match_ && if_match_it != headers.end()
+            && if_match_it->second != etag) {
+        BOOST_THROW_EXCEPTION(CHttpException("Precondition Failed", 412,
+                                             "Precondition Failed", "GET",
+                                             path.path_name_utf8()));
+    }
+    // Apply range, if any ("bytes=first-last" or "bytes=first-"):
+    auto range_it = headers.find(U("Range"));
+    if (range_it != headers.end()) {
+        std::string range = utility::conversions::to_utf8string(
+                                        range_it->second.substr(6));
+        size_t dash = range.find('-');
+        size_t first = std::stoul(range.substr(0, dash));
+        size_t last = dash + 1 < range.length() ?
+                        std::stoul(range.substr(dash + 1)) : content.size() - 1;
+        content = content.substr(first, last - first + 1);
+    }
+
+    std::shared_ptr<ByteSink> p_sink = download_request.GetByteSink();
+    p_sink->SetResumeValidator(etag);
+    p_sink->SetExpectedLength(content.size());
+    std::ostream *p_os = p_sink->OpenStream();
+    if (p_sink->IsBufferWritable()) {
+        p_sink->Write(content.data(), content.size());
+    } else {
+        p_os->write(content.data(), content.size());
+    }
+    p_sink->CloseStream();
+}
+
+void MemoryStorageProvider::Upload(const CUploadRequest& upload_request) {
+    ++nb_requests_;
+    const CPath& path = upload_request.path();
+    std::shared_ptr<ByteSource> p_bs = upload_request.GetByteSource();
+    std::unique_ptr<std::istream> p_is = p_bs->OpenStream();
+    std::ostringstream content;
+    content << p_is->rdbuf();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (folders_.count(path) > 0) {
+        BOOST_THROW_EXCEPTION(CInvalidFileTypeException(path, true));
+    }
+    AddParentFolders(path);
+    blobs_[path] = content.str();
+    versions_[path] = next_version_++;
+}
+
+void MemoryStorageProvider::PutBlob(const CPath& path,
+                                    const std::string& content) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    AddParentFolders(path);
+    blobs_[path] = content;
+    versions_[path] = next_version_++;
+}
+
+void MemoryStorageProvider::InjectDownloadFailures(int nb_failures) {
+    nb_download_failures_ = nb_failures;
+}
+
+}  // namespace pcs_api
@@ -0,0 +1,105 @@
+/**
+ * Copyright (c) 2014 Netheos (http://www.netheos.net)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef INCLUDE_TEST_MEMORY_STORAGE_PROVIDER_H_
+#define INCLUDE_TEST_MEMORY_STORAGE_PROVIDER_H_
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+
+#include "pcs_api/i_storage_provider.h"
+
+namespace pcs_api {
+
+/**
+ * \brief A storage provider keeping blobs and folders in memory,
+ *        for unit testing storage decorators and utilities.
+ *
+ * Downloads honor Range and If-Match headers of requests (each blob version
+ * has its own ETag). Failures can be injected.
+ */
+class MemoryStorageProvider : public IStorageProvider {
+ public:
+    MemoryStorageProvider();
+    std::string GetProviderName() const override;
+    std::string GetUserId() override;
+    CQuota GetQuota() override;
+    std::shared_ptr<CFolderContent> ListRootFolder() override;
+    std::shared_ptr<CFolderContent> ListFolder(const CPath& path) override;
+    std::shared_ptr<CFolderContent> ListFolder(const CFolder& folder) override;
+    bool CreateFolder(const CPath& path) override;
+    bool Delete(const CPath& path) override;
+    std::shared_ptr<CFile> GetFile(const CPath& path) override;
+    void Download(const CDownloadRequest& download_request) override;
+    void Upload(const CUploadRequest& upload_request) override;
+
+    /**
+     * \brief Store a blob (and its parent folders) without any check.
+     */
+    void PutBlob(const CPath& path, const std::string& content);
+
+    /**
+     * \brief Make the next downloads fail.
+     *
+     * @param nb_failures number of downloads to fail
+     */
+    void InjectDownloadFailures(int nb_failures);
+
+    /**
+     * \brief Defines a function called at the beginning of each download
+     *        (for example to modify the downloaded blob).
+     */
+    void set_download_hook(std::function<void()> hook) {
+        download_hook_ = hook;
+    }
+
+    /**
+     * \brief Ignore If-Match headers (as some servers do).
+     */
+    void set_ignore_if_match(bool ignore) {
+        ignore_if_match_ = ignore;
+    }
+
+    int nb_downloads() const {
+        return nb_downloads_;
+    }
+
+    int nb_requests() const {
+        return nb_requests_;
+    }
+
+ private:
+    std::mutex mutex_;
+    std::map<CPath, std::string> blobs_;
+    std::map<CPath, int64_t> versions_;  // changed when blob is written
+    int64_t next_version_;
+    std::function<void()> download_hook_;  // may be empty
+    bool ignore_if_match_;
+    std::set<CPath> folders_;
+    std::atomic<int> nb_download_failures_;
+    std::atomic<int> nb_downloads_;
+    std::atomic<int> nb_requests_;  // all operations
+
+    void AddParentFolders(const CPath& path);
+};
+
+}  // namespace pcs_api
+
+#endif  // INCLUDE_TEST_MEMORY_STORAGE_PROVIDER_H_
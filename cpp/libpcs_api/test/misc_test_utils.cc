@@ -18,6 +18,7 @@
 #include <random>
 
 #include "boost/algorithm/string/predicate.hpp"
+#include "boost/asio.hpp"
 
 #include "pcs_api/i_storage_provider.h"
 #include "pcs_api/internal/logger.h"
@@ -112,6 +113,16 @@ int MiscUtils::Random(int start, int end) {
     return start + static_cast<int>((end-start)*utilities::Random());
 }
 
+uint16_t MiscUtils::GetFreeLocalPort() {
+    boost::asio::io_service io_service;
+    boost::asio::ip::tcp::acceptor acceptor(
+            io_service,
+            boost::asio::ip::tcp::endpoint(
+                    boost::asio::ip::address_v4::loopback(), 0));
+    // port is released when acceptor is closed:
+    return acceptor.local_endpoint().port();
+}
+
 
 }  // namespace pcs_api
 
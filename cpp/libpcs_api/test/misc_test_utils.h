@@ -125,6 +125,14 @@ class MiscUtils {
      * @return (pseudo) random value (if start==end, return always 'start')
      */
     static int Random(int start, int end);
+
+    /**
+     * \brief Get a local TCP port that is currently free, for test servers
+     *        (so that concurrent test runs do not conflict).
+     *
+     * @return a port number chosen by the system
+     */
+    static uint16_t GetFreeLocalPort();
 };
 
 }  // namespace pcs_api
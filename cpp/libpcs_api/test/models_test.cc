@@ -139,6 +139,72 @@ TEST(ModelsTest, TestDownloadRequestBytesRange) {
     ASSERT_FALSE(headers.find(PCS_API_STRING_T("Range")) != headers.end());
 }
 
+namespace {
+
+/**
+ * A memory sink pretending to hold the first bytes of a content
+ */
+class PartialByteSink : public MemoryByteSink {
+ public:
+    PartialByteSink(int64_t held, string_t validator)
+        : held_(held), validator_(validator) {
+    }
+    int64_t GetResumeOffset() const override {
+        return held_;
+    }
+    string_t GetResumeValidator() const override {
+        return validator_;
+    }
+
+ private:
+    const int64_t held_;
+    const string_t validator_;
+};
+
+}  // namespace
+
+TEST(ModelsTest, TestDownloadRequestResume) {
+    const string_t etag = PCS_API_STRING_T("\"etag\"");
+    std::shared_ptr<ByteSink> p_bs = std::make_shared<MemoryByteSink>();
+    CDownloadRequest dr(CPath(PCS_API_STRING_T("/foo")), p_bs);
+    int64_t resume_offset = -1;
+
+    // Nothing held: same headers as usual
+    std::map<string_t, string_t> headers = dr.GetHttpHeaders(*p_bs,
+                                                             &resume_offset);
+    EXPECT_EQ(0, resume_offset);
+    EXPECT_TRUE(headers.empty());
+
+    PartialByteSink partial(100, etag);
+    headers = dr.GetHttpHeaders(partial, &resume_offset);
+    EXPECT_EQ(100, resume_offset);
+    EXPECT_EQ(PCS_API_STRING_T("bytes=100-"),
+              headers[PCS_API_STRING_T("Range")]);
+    EXPECT_EQ(etag, headers[PCS_API_STRING_T("If-Range")]);
+
+    // Remaining bytes of a requested range:
+    dr.SetRange(10, 1000);
+    headers = dr.GetHttpHeaders(partial, &resume_offset);
+    EXPECT_EQ(100, resume_offset);
+    EXPECT_EQ(PCS_API_STRING_T("bytes=110-1009"),
+              headers[PCS_API_STRING_T("Range")]);
+
+    // Suffix ranges can not be resumed:
+    dr.SetRange(-1, 1000);
+    headers = dr.GetHttpHeaders(partial, &resume_offset);
+    EXPECT_EQ(0, resume_offset);
+    EXPECT_EQ(PCS_API_STRING_T("bytes=-1000"),
+              headers[PCS_API_STRING_T("Range")]);
+    EXPECT_TRUE(headers.find(PCS_API_STRING_T("If-Range")) == headers.end());
+
+    // Content without validator can not be resumed:
+    dr.SetRange(-1, -1);
+    PartialByteSink no_validator(100, string_t());
+    headers = dr.GetHttpHeaders(no_validator, &resume_offset);
+    EXPECT_EQ(0, resume_offset);
+    EXPECT_TRUE(headers.empty());
+}
+
 TEST(ModelsTest, TestDownloadRequestProgressListener) {
     std::shared_ptr<ByteSink> p_bs = std::make_shared<MemoryByteSink>();
     CDownloadRequest dr(CPath(PCS_API_STRING_T("/foo")), p_bs);
@@ -178,6 +244,19 @@ TEST(ModelsTest, TestUploadRequestProgressListener) {
     std::unique_ptr<std::istream> p_is = p_progress_bs->OpenStream();
     p_is->get();
     ASSERT_GT(p_pl->current(), 0);
+    // Undecorated source and listener remain available:
+    ASSERT_EQ(p_bs, ur.byte_source());
+    ASSERT_EQ(p_pl, ur.progress_listener());
+}
+
+TEST(ModelsTest, TestUploadRequestChunkSize) {
+    std::shared_ptr<ByteSource> p_bs = std::make_shared<MemoryByteSource>("");
+    CUploadRequest ur(CPath(PCS_API_STRING_T("/foo")), p_bs);
+    // By default, providers choose:
+    EXPECT_EQ(0, ur.chunk_size());
+    ur.set_chunk_size(1024 * 1024);
+    EXPECT_EQ(1024 * 1024, ur.chunk_size());
+    EXPECT_THROW(ur.set_chunk_size(0), std::invalid_argument);
 }
 
 
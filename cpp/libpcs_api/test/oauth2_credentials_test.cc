@@ -0,0 +1,123 @@
+/**
+ * Copyright (c) 2014 Netheos (http://www.netheos.net)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "cpprest/json.h"
+#include "cpprest/asyncrt_utils.h"
+
+#include "pcs_api/oauth2_credentials.h"
+
+namespace pcs_api {
+
+static web::json::value TokenJson(int index, int64_t expires_in) {
+    web::json::value json = web::json::value::object();
+    string_t suffix = utility::conversions::print_string(index);
+    json[U("access_token")] = web::json::value::string(U("access") + suffix);
+    json[U("refresh_token")] = web::json::value::string(U("refresh") + suffix);
+    json[U("expires_in")] = web::json::value::number(expires_in);
+    return json;
+}
+
+TEST(OAuth2CredentialsTest, TestSnapshots) {
+    web::json::value json = TokenJson(1, 3600);
+    json[U("token_type")] = web::json::value::string(U("Bearer"));
+    std::unique_ptr<OAuth2Credentials> p_creds =
+                                    OAuth2Credentials::CreateFromJson(json);
+    EXPECT_FALSE(p_creds->HasExpired());
+    std::shared_ptr<const OAuth2Credentials::Tokens> p_before =
+                                                        p_creds->tokens();
+    std::unique_ptr<OAuth2Credentials> p_clone(p_creds->Clone());
+
+    // refresh responses may not contain all fields:
+    json = web::json::value::object();
+    json[U("access_token")] = web::json::value::string(U("access2"));
+    json[U("expires_at")] = web::json::value::number(1000);  // in the past
+    p_creds->Update(json);
+    EXPECT_EQ(U("access2"), p_creds->access_token());
+    EXPECT_EQ(U("refresh1"), p_creds->refresh_token());
+    EXPECT_EQ(U("Bearer"), p_creds->token_type());
+    EXPECT_TRUE(p_creds->HasExpired());
+
+    // previous snapshot and clone are unchanged:
+    EXPECT_EQ(U("access1"), p_before->access_token);
+    EXPECT_FALSE(p_before->HasExpired());
+    EXPECT_EQ(U("access1"), p_clone->access_token());
+    EXPECT_FALSE(p_clone->HasExpired());
+}
+
+TEST(OAuth2CredentialsTest, TestProviderData) {
+    std::unique_ptr<OAuth2Credentials> p_creds =
+                        OAuth2Credentials::CreateFromJson(TokenJson(1, 3600));
+    EXPECT_TRUE(p_creds->provider_data().empty());
+    p_creds->SetProviderData(U("{\"swift_token\":\"abc\"}"));
+    EXPECT_EQ(U("access1"), p_creds->access_token());
+
+    // kept when tokens are refreshed:
+    p_creds->Update(TokenJson(2, 3600));
+    EXPECT_EQ(U("access2"), p_creds->access_token());
+    web::json::value data = web::json::value::parse(p_creds->provider_data());
+    EXPECT_EQ(U("abc"), data.at(U("swift_token")).as_string());
+
+    // persisted:
+    std::unique_ptr<OAuth2Credentials> p_read =
+            OAuth2Credentials::CreateFromJson(web::json::value::parse(
+                utility::conversions::to_string_t(p_creds->ToJsonString())));
+    EXPECT_EQ(U("refresh2"), p_read->refresh_token());
+    data = web::json::value::parse(p_read->provider_data());
+    EXPECT_EQ(U("abc"), data.at(U("swift_token")).as_string());
+
+    p_read->SetProviderData(string_t());
+    EXPECT_EQ(std::string::npos,
+              p_read->ToJsonString().find("provider_data"));
+}
+
+TEST(OAuth2CredentialsTest, TestConcurrentUpdates) {
+    std::unique_ptr<OAuth2Credentials> p_creds =
+                        OAuth2Credentials::CreateFromJson(TokenJson(0, 3600));
+    std::atomic<bool> stop(false);
+    std::atomic<int> nb_inconsistencies(0);
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 4; ++i) {
+        readers.push_back(std::thread([&] {
+            while (!stop) {
+                std::shared_ptr<const OAuth2Credentials::Tokens> p_tokens =
+                                                            p_creds->tokens();
+                // tokens of a snapshot always come from the same update:
+                if (p_tokens->access_token.substr(6)
+                        != p_tokens->refresh_token.substr(7)) {
+                    ++nb_inconsistencies;
+                }
+            }
+        }));
+    }
+    for (int i = 1; i <= 1000; ++i) {
+        p_creds->Update(TokenJson(i, 3600));
+    }
+    stop = true;
+    for (std::thread& reader : readers) {
+        reader.join();
+    }
+    EXPECT_EQ(0, nb_inconsistencies);
+    EXPECT_EQ(U("access1000"), p_creds->access_token());
+}
+
+}  // namespace pcs_api
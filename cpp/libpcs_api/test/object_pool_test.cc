@@ -0,0 +1,223 @@
+/**
+ * Copyright (c) 2014 Netheos (http://www.netheos.net)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#include "pcs_api/internal/http_client_pool.h"
+#include "pcs_api/internal/object_pool.h"
+
+namespace pcs_api {
+
+/**
+ * Pool of int objects, counting created and deleted objects.
+ */
+class IntPool : public ObjectPool<int> {
+ public:
+    explicit IntPool(size_t max_objects = 0,
+                     std::chrono::milliseconds idle_timeout =
+                                            std::chrono::milliseconds::zero(),
+                     std::chrono::milliseconds max_wait =
+                                            std::chrono::milliseconds::zero(),
+                     std::function<bool(int*)> check_function = nullptr)
+        : ObjectPool([this] { ++nb_created_; return new int(nb_created_); },
+                     [this](int *p) { ++nb_deleted_; delete p; },
+                     max_objects, idle_timeout, max_wait, check_function),
+          nb_created_(0),
+          nb_deleted_(0) {
+    }
+    std::atomic<int> nb_created_;
+    std::atomic<int> nb_deleted_;
+};
+
+TEST(ObjectPoolTest, TestReuse) {
+    IntPool pool;
+    int *p1 = pool.Get();
+    int *p2 = pool.Get();
+    ASSERT_NE(p1, p2);
+    pool.Put(p1);
+    // Same thread gets back its object:
+    ASSERT_EQ(p1, pool.Get());
+    pool.Put(p1);
+    pool.Put(p2);
+    ASSERT_EQ(2, pool.nb_created_);
+    ASSERT_EQ(0, pool.nb_deleted_);
+    ASSERT_EQ(2u, pool.CountObjects());
+    ASSERT_EQ(2u, pool.CountIdleObjects());
+
+    ObjectPoolStats stats = pool.GetStats();
+    ASSERT_EQ(1u, stats.hits);
+    ASSERT_EQ(2u, stats.misses);
+    ASSERT_EQ(0u, stats.waits);
+    ASSERT_EQ(0u, stats.evictions);
+}
+
+TEST(ObjectPoolTest, TestIdleObjectsTakenFromOtherThreads) {
+    IntPool pool;
+    int *p1 = nullptr;
+    std::thread t([&] {
+        p1 = pool.Get();
+        pool.Put(p1);
+    });
+    t.join();
+    // object given back by another thread is reused:
+    ASSERT_EQ(p1, pool.Get());
+    ASSERT_EQ(1, pool.nb_created_);
+    pool.Put(p1);
+}
+
+TEST(ObjectPoolTest, TestMaxObjectsWait) {
+    IntPool pool(1);
+    int *p1 = pool.Get();
+    int *p_other = nullptr;
+    std::thread t([&] {
+        p_other = pool.Get();  // blocks until p1 is given back
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_EQ(nullptr, p_other);
+    pool.Put(p1);
+    t.join();
+    ASSERT_EQ(p1, p_other);
+    ASSERT_EQ(1, pool.nb_created_);
+    ASSERT_EQ(1u, pool.GetStats().waits);
+    pool.Put(p_other);
+
+    // Discarding an object also frees room:
+    p1 = pool.Get();
+    std::thread t2([&] {
+        p_other = pool.Get();
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    pool.Discard(p1);
+    t2.join();
+    ASSERT_EQ(2, pool.nb_created_);
+    ASSERT_EQ(1, pool.nb_deleted_);
+    pool.Put(p_other);
+}
+
+TEST(ObjectPoolTest, TestMaxWaitExpired) {
+    IntPool pool(1, std::chrono::milliseconds::zero(),
+                 std::chrono::milliseconds(50));
+    int *p1 = pool.Get();
+    // Limit is exceeded after max wait:
+    int *p2 = pool.Get();
+    ASSERT_NE(p1, p2);
+    ASSERT_EQ(2u, pool.CountObjects());
+    ASSERT_EQ(1u, pool.GetStats().waits);
+    ASSERT_EQ(1u, pool.GetStats().overflows);
+    pool.Put(p1);
+    pool.Put(p2);
+}
+
+TEST(ObjectPoolTest, TestGetAsync) {
+    IntPool pool(1);
+    pplx::task<int*> first = pool.GetAsync();
+    ASSERT_TRUE(first.is_done());
+    int *p1 = first.get();
+
+    // Pool is exhausted: tasks are queued, and served in order
+    pplx::task<int*> second = pool.GetAsync();
+    pplx::task<int*> third = pool.GetAsync();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_FALSE(second.is_done());
+    ASSERT_FALSE(third.is_done());
+    pool.Put(p1);
+    ASSERT_EQ(p1, second.get());
+    ASSERT_FALSE(third.is_done());
+    ASSERT_EQ(2u, pool.GetStats().waits);
+
+    // Discarding an object frees room for a new one:
+    pool.Discard(p1);
+    int *p2 = third.get();
+    ASSERT_NE(nullptr, p2);
+    ASSERT_EQ(2, pool.nb_created_);
+    ASSERT_EQ(1, pool.nb_deleted_);
+    ASSERT_EQ(1u, pool.CountObjects());
+    pool.Put(p2);
+}
+
+TEST(ObjectPoolTest, TestGetAsyncMaxWaitExpired) {
+    IntPool pool(1, std::chrono::milliseconds::zero(),
+                 std::chrono::milliseconds(50));
+    int *p1 = pool.GetAsync().get();
+    // Limit is exceeded after max wait:
+    int *p2 = pool.GetAsync().get();
+    ASSERT_NE(p1, p2);
+    ASSERT_EQ(2u, pool.CountObjects());
+    ASSERT_EQ(1u, pool.GetStats().waits);
+    ASSERT_EQ(1u, pool.GetStats().overflows);
+    // timed out request is not served again:
+    pool.Put(p1);
+    ASSERT_EQ(1u, pool.CountIdleObjects());
+    ASSERT_EQ(p1, pool.GetAsync().get());
+    pool.Put(p1);
+    pool.Put(p2);
+}
+
+TEST(ObjectPoolTest, TestIdleTimeout) {
+    IntPool pool(0, std::chrono::milliseconds(50));
+    int *p1 = pool.Get();
+    pool.Put(p1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    int *p2 = pool.Get();
+    ASSERT_EQ(1, pool.nb_deleted_);
+    ASSERT_EQ(2, pool.nb_created_);
+    ASSERT_EQ(1u, pool.GetStats().evictions);
+    pool.Put(p2);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    pool.EvictIdleObjects();
+    ASSERT_EQ(2, pool.nb_deleted_);
+    ASSERT_EQ(0u, pool.CountObjects());
+}
+
+TEST(ObjectPoolTest, TestHealthCheck) {
+    IntPool pool(0, std::chrono::milliseconds::zero(),
+                 std::chrono::milliseconds::zero(),
+                 [](int *p) { return *p != 1; });  // first object is "broken"
+    int *p1 = pool.Get();
+    int *p2 = pool.Get();
+    pool.Put(p1);
+    pool.Put(p2);
+    ASSERT_EQ(p2, pool.Get());  // most recently used
+    int *p3 = pool.Get();
+    ASSERT_EQ(3, *p3);  // p1 failed check, hence is replaced
+    ASSERT_EQ(1, pool.nb_deleted_);
+    ASSERT_EQ(1u, pool.GetStats().evictions);
+    pool.Put(p2);
+    pool.Put(p3);
+}
+
+TEST(ObjectPoolTest, TestHttpClientFailure) {
+    HttpClientPool pool(web::uri(U("http://127.0.0.1:8080")),
+                        std::make_shared<
+                            web::http::client::http_client_config>());
+    web::http::client::http_client *p1 = pool.Get();
+    pool.Put(p1);
+    ASSERT_EQ(p1, pool.Get());  // healthy client is reused
+    pool.ReportFailure(p1);
+    pool.Put(p1);
+    web::http::client::http_client *p2 = pool.Get();
+    ASSERT_EQ(1u, pool.GetStats().evictions);  // failed client is replaced
+    ASSERT_EQ(1u, pool.CountObjects());
+    pool.Put(p2);
+}
+
+}  // namespace pcs_api
@@ -0,0 +1,145 @@
+/**
+ * Copyright (c) 2014 Netheos (http://www.netheos.net)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string>
+
+#include "boost/filesystem.hpp"
+#include "boost/filesystem/fstream.hpp"
+
+#include "gtest/gtest.h"
+
+#include "pcs_api/c_exceptions.h"
+#include "pcs_api/parallel_downloader.h"
+#include "pcs_api/internal/logger.h"
+
+#include "memory_storage_provider.h"
+#include "misc_test_utils.h"
+
+namespace pcs_api {
+
+class ParallelDownloaderTest : public ::testing::Test {
+ public:
+    void SetUp() override {
+        tmp_dir_ = boost::filesystem::unique_path("pcs_api_%%%%%%%%.dir");
+        boost::filesystem::create_directory(tmp_dir_);
+        local_path_ = tmp_dir_ / "downloaded.bin";
+    }
+
+    void TearDown() override {
+        boost::filesystem::remove_all(tmp_dir_);
+    }
+
+ protected:
+    MemoryStorageProvider storage_;
+    boost::filesystem::path tmp_dir_;
+    boost::filesystem::path local_path_;
+    const CPath kBlobPath = CPath(U("/folder/blob.bin"));
+
+    std::string PutRandomBlob(size_t length) {
+        std::string content = MiscUtils::GenerateRandomData(length);
+        storage_.PutBlob(kBlobPath, content);
+        return content;
+    }
+
+    std::string ReadLocalFile() {
+        boost::filesystem::ifstream is(local_path_, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(is),
+                           std::istreambuf_iterator<char>());
+    }
+};
+
+TEST_F(ParallelDownloaderTest, TestSmallBlob) {
+    std::string content = PutRandomBlob(1000);
+    ParallelDownloader(&storage_).set_segment_size(1000)
+                                 .Download(kBlobPath, local_path_);
+    EXPECT_EQ(1, storage_.nb_downloads());  // not segmented
+    EXPECT_EQ(content, ReadLocalFile());
+}
+
+TEST_F(ParallelDownloaderTest, TestSegments) {
+    std::string content = PutRandomBlob(1000003);
+    ParallelDownloader(&storage_).set_segment_size(64 * 1024)
+                                 .set_max_concurrency(4)
+                                 .Download(kBlobPath, local_path_);
+    // 15 full segments + 1 partial one:
+    EXPECT_EQ(16, storage_.nb_downloads());
+    EXPECT_EQ(content, ReadLocalFile());
+    boost::filesystem::path part_path = local_path_;
+    part_path += ".part";
+    EXPECT_FALSE(boost::filesystem::exists(part_path));
+}
+
+TEST_F(ParallelDownloaderTest, TestSegmentsAreRetried) {
+    std::string content = PutRandomBlob(100000);
+    storage_.InjectDownloadFailures(2);
+    ParallelDownloader(&storage_).set_segment_size(10000)
+                                 .set_max_concurrency(3)
+                                 .set_nb_tries_per_segment(3)
+                                 .Download(kBlobPath, local_path_);
+    EXPECT_EQ(10 + 2, storage_.nb_downloads());
+    EXPECT_EQ(content, ReadLocalFile());
+}
+
+TEST_F(ParallelDownloaderTest, TestTooManyFailures) {
+    PutRandomBlob(100000);
+    storage_.InjectDownloadFailures(1000);
+    ParallelDownloader downloader(&storage_);
+    downloader.set_segment_size(10000).set_nb_tries_per_segment(2);
+    EXPECT_THROW(downloader.Download(kBlobPath, local_path_),
+                 CStorageException);
+    EXPECT_FALSE(boost::filesystem::exists(local_path_));
+    // partial file has been removed:
+    boost::filesystem::path part_path = local_path_;
+    part_path += ".part";
+    EXPECT_FALSE(boost::filesystem::exists(part_path));
+}
+
+TEST_F(ParallelDownloaderTest, TestBlobReplacedDuringDownload) {
+    std::string content = PutRandomBlob(100000);
+    std::string new_content = MiscUtils::GenerateRandomData(content.size());
+    int nb_downloads = 0;
+    storage_.set_download_hook([&] {
+        if (++nb_downloads == 3) {  // same length, other content
+            storage_.PutBlob(kBlobPath, new_content);
+        }
+    });
+    ParallelDownloader downloader(&storage_);
+    downloader.set_segment_size(10000).set_max_concurrency(1);
+    EXPECT_THROW(downloader.Download(kBlobPath, local_path_),
+                 CStorageException);
+    // segment is not retried (If-Match condition failed):
+    EXPECT_EQ(3, storage_.nb_downloads());
+    EXPECT_FALSE(boost::filesystem::exists(local_path_));
+
+    // Also detected if server ignores conditions:
+    nb_downloads = 0;
+    storage_.set_ignore_if_match(true);
+    EXPECT_THROW(downloader.Download(kBlobPath, local_path_),
+                 CStorageException);
+    EXPECT_FALSE(boost::filesystem::exists(local_path_));
+}
+
+TEST_F(ParallelDownloaderTest, TestNotABlob) {
+    ParallelDownloader downloader(&storage_);
+    EXPECT_THROW(downloader.Download(kBlobPath, local_path_),
+                 CFileNotFoundException);
+    PutRandomBlob(10);
+    EXPECT_THROW(downloader.Download(kBlobPath.GetParent(), local_path_),
+                 CInvalidFileTypeException);
+    EXPECT_FALSE(boost::filesystem::exists(local_path_));
+}
+
+}  // namespace pcs_api
@@ -0,0 +1,116 @@
+/**
+ * Copyright (c) 2014 Netheos (http://www.netheos.net)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <vector>
+
+#include "boost/filesystem.hpp"
+
+#include "gtest/gtest.h"
+
+#include "cpprest/asyncrt_utils.h"
+
+#include "pcs_api/internal/path_ids_cache.h"
+
+namespace pcs_api {
+
+typedef PathIdsCache::Entry Entry;
+typedef std::vector<Entry> Chain;
+
+static std::vector<string_t> Ids(const std::vector<Entry>& chain) {
+    std::vector<string_t> ids;
+    for (const Entry& entry : chain) {
+        ids.push_back(entry.id);
+    }
+    return ids;
+}
+
+TEST(PathIdsCacheTest, TestLookupLongestPrefix) {
+    PathIdsCache cache;
+    EXPECT_TRUE(cache.Lookup(CPath(U("/"))).empty());
+    EXPECT_TRUE(cache.Lookup(CPath(U("/a/b"))).empty());
+
+    cache.Put(CPath(U("/a/b/c")), Chain({ Entry(U("id_a"), true),
+                                          Entry(U("id_b"), true),
+                                          Entry(U("id_c"), false) }));
+    EXPECT_EQ(3, cache.size());
+    std::vector<Entry> chain = cache.Lookup(CPath(U("/a/b/c")));
+    EXPECT_EQ(std::vector<string_t>({ U("id_a"), U("id_b"), U("id_c") }),
+              Ids(chain));
+    EXPECT_TRUE(chain[1].is_folder);
+    EXPECT_FALSE(chain[2].is_folder);
+    EXPECT_EQ(std::vector<string_t>({ U("id_a"), U("id_b") }),
+              Ids(cache.Lookup(CPath(U("/a/b/other/d")))));
+    EXPECT_TRUE(cache.Lookup(CPath(U("/other/b"))).empty());
+
+    // Files are added only below cached folders:
+    cache.PutFile(CPath(U("/a/b/e")), Entry(U("id_e"), false));
+    cache.PutFile(CPath(U("/x/y")), Entry(U("id_y"), false));
+    EXPECT_EQ(4, cache.size());
+    EXPECT_EQ(3, cache.Lookup(CPath(U("/a/b/e"))).size());
+}
+
+TEST(PathIdsCacheTest, TestInvalidation) {
+    PathIdsCache cache;
+    cache.Put(CPath(U("/a/b/c")), Chain({ Entry(U("id_a"), true),
+                                          Entry(U("id_b"), true),
+                                          Entry(U("id_c"), false) }));
+    cache.PutFile(CPath(U("/a/b/d")), Entry(U("id_d"), false));
+
+    // b has been replaced by another folder: its children are outdated
+    cache.Put(CPath(U("/a/b")), Chain({ Entry(U("id_a"), true),
+                                        Entry(U("id_b2"), true) }));
+    EXPECT_EQ(2, cache.size());
+    EXPECT_EQ(std::vector<string_t>({ U("id_a"), U("id_b2") }),
+              Ids(cache.Lookup(CPath(U("/a/b/c")))));
+
+    // b does not exist anymore:
+    cache.PutFile(CPath(U("/a/b/d")), Entry(U("id_d"), false));
+    cache.Put(CPath(U("/a/b/d")), Chain({ Entry(U("id_a"), true) }));
+    EXPECT_EQ(1, cache.size());
+    EXPECT_EQ(1, cache.Lookup(CPath(U("/a/b/d"))).size());
+
+    cache.Remove(CPath(U("/a")));
+    EXPECT_EQ(0, cache.size());
+    EXPECT_TRUE(cache.Lookup(CPath(U("/a"))).empty());
+}
+
+TEST(PathIdsCacheTest, TestSaveLoad) {
+    boost::filesystem::path file_path =
+                    boost::filesystem::unique_path("pcs_api_%%%%%%%%.ids");
+    PathIdsCache cache;
+    cache.Put(CPath(U("/a/b c/d")), Chain({ Entry(U("id_a"), true),
+                                            Entry(U("id_bc"), true),
+                                            Entry(U("id_d"), false) }));
+    cache.PutFile(CPath(U("/e")), Entry(U("id_e"), true));
+    cache.Save(file_path);
+
+    PathIdsCache loaded;
+    loaded.Load(file_path);
+    boost::filesystem::remove(file_path);
+    EXPECT_EQ(4, loaded.size());
+    std::vector<Entry> chain = loaded.Lookup(CPath(U("/a/b c/d")));
+    EXPECT_EQ(std::vector<string_t>({ U("id_a"), U("id_bc"), U("id_d") }),
+              Ids(chain));
+    EXPECT_FALSE(chain[2].is_folder);
+    EXPECT_TRUE(loaded.Lookup(CPath(U("/e")))[0].is_folder);
+
+    // Missing file: empty cache
+    loaded.Load(file_path);
+    EXPECT_EQ(0, loaded.size());
+}
+
+}  // namespace pcs_api
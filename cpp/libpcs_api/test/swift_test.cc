@@ -16,12 +16,23 @@
 
 #include <algorithm>
 #include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "boost/algorithm/string.hpp"
 
 #include "gtest/gtest.h"
 
 #include "cpprest/json.h"
 #include "cpprest/asyncrt_utils.h"
+#include "cpprest/http_client.h"
+#include "cpprest/http_listener.h"
 
+#include "pcs_api/memory_byte_source.h"
+#include "pcs_api/internal/c_response.h"
 #include "pcs_api/internal/utilities.h"
 #include "pcs_api/internal/providers/swift_client.h"
 #include "pcs_api/internal/logger.h"
@@ -95,5 +106,489 @@ TEST(SwiftTest, TestParseMissingTimestamp) {
     EXPECT_EQ(nadt, pt);
 }
 
+TEST(SwiftTest, TestParseLastModifiedHeader) {
+    web::http::http_headers headers;
+    headers.add(U("Last-Modified"), U("Wed, 20 Aug 2014 15:58:44 GMT"));
+    boost::posix_time::ptime pt =
+                            swift_details::ParseLastModifiedHeader(headers);
+    EXPECT_EQ(1408550324000, utilities::DateTimeToTime_t_ms(pt));
+
+    // X-Timestamp is more precise, if present:
+    headers.add(U("X-Timestamp"), U("1408550324.34246"));
+    pt = swift_details::ParseLastModifiedHeader(headers);
+    EXPECT_EQ(1408550324342, utilities::DateTimeToTime_t_ms(pt));
+}
+
+/**
+ * \brief Serves a Swift account from a local http listener, for testing
+ *        SwiftClient requests: objects are kept in memory, and failures
+ *        can be injected.
+ */
+class SwiftClientTest : public ::testing::Test {
+ public:
+    void SetUp() override {
+        server_url_ = U("http://127.0.0.1:")
+                + utility::conversions::print_string(
+                                            MiscUtils::GetFreeLocalPort());
+        account_url_ = server_url_ + U("/v1/AUTH_test");
+        p_listener_.reset(
+            new web::http::experimental::listener::http_listener(
+                                                            account_url_));
+        p_listener_->support([this](web::http::http_request request) {
+            Handle(request);
+        });
+        p_listener_->open().wait();
+
+        // Operations are not retried as a whole (as hubiC does):
+        p_swift_ = std::make_shared<SwiftClient>(
+                account_url_,
+                U("token"),
+                std::unique_ptr<RetryStrategy>(new RetryStrategy(1, 0)),
+                false,  // use_directory_markers
+                &SwiftClientTest::Execute);
+        p_swift_->UseContainer(U("default"));
+    }
+
+    void TearDown() override {
+        if (p_info_listener_) {
+            p_info_listener_->close().wait();
+        }
+        p_listener_->close().wait();
+    }
+
+ protected:
+    string_t server_url_;
+    string_t account_url_;
+    std::unique_ptr<web::http::experimental::listener::http_listener>
+                                                                p_listener_;
+    // serves /info (if large objects limits are published):
+    std::unique_ptr<web::http::experimental::listener::http_listener>
+                                                            p_info_listener_;
+    std::shared_ptr<SwiftClient> p_swift_;
+
+    std::mutex mutex_;  // protects members below
+    std::map<string_t, std::string> objects_;  // by /container/name
+    std::map<string_t, int> nb_puts_;  // tries, by /container/name
+    // next request to a path ending with one of these fails with 503:
+    std::set<string_t> fail_once_suffixes_;
+    std::set<string_t> manifests_;  // large objects, by /container/name
+    std::map<string_t, string_t> delete_queries_;  // by /container/name
+    std::set<string_t> undeletable_;  // by /container/name
+
+    void PublishLargeObjectLimits(int64_t max_manifest_segments,
+                                  int64_t min_segment_size) {
+        web::json::value slo;
+        slo[U("max_manifest_segments")] =
+                            web::json::value::number(max_manifest_segments);
+        slo[U("min_segment_size")] =
+                            web::json::value::number(min_segment_size);
+        web::json::value info;
+        info[U("slo")] = slo;
+        p_info_listener_.reset(
+            new web::http::experimental::listener::http_listener(
+                                                server_url_ + U("/info")));
+        p_info_listener_->support([info](web::http::http_request request) {
+            request.reply(web::http::status_codes::OK, info);
+        });
+        p_info_listener_->open().wait();
+    }
+
+    void ForbidDelete(const string_t& path) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        undeletable_.insert(path);
+    }
+
+    bool Exists(const string_t& path) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return objects_.find(path) != objects_.end();
+    }
+
+    string_t DeleteQuery(const string_t& path) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return delete_queries_[path];
+    }
+
+    void FailOnce(const string_t& path_suffix) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        fail_once_suffixes_.insert(path_suffix);
+    }
+
+    int NbPuts(const string_t& path) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return nb_puts_[path];
+    }
+
+    std::vector<string_t> ObjectPaths(const string_t& prefix) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<string_t> paths;
+        for (const auto& entry : objects_) {
+            if (boost::starts_with(entry.first, prefix)) {
+                paths.push_back(entry.first);
+            }
+        }
+        return paths;
+    }
+
+    std::vector<string_t> PutPaths(const string_t& prefix) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<string_t> paths;
+        for (const auto& entry : nb_puts_) {
+            if (boost::starts_with(entry.first, prefix)) {
+                paths.push_back(entry.first);
+            }
+        }
+        return paths;
+    }
+
+    static pplx::task<std::shared_ptr<CResponse>> Execute(
+                                            web::http::http_request request) {
+        web::http::client::http_client *p_client =
+                new web::http::client::http_client(
+                                        request.request_uri().authority());
+        pplx::cancellation_token_source cancel_source;
+        return p_client->request(request, cancel_source.get_token()).then(
+                    [p_client, request, cancel_source](
+                        pplx::task<web::http::http_response> response_task)
+                                                -> std::shared_ptr<CResponse> {
+            web::http::http_response response;
+            try {
+                response = response_task.get();
+            }
+            catch (...) {
+                delete p_client;
+                throw;
+            }
+            return std::make_shared<CResponse>(
+                p_client,
+                [](web::http::client::http_client *p_c) { delete p_c; },
+                request, &response, cancel_source);
+        });
+    }
+
+ private:
+    void Handle(web::http::http_request request) {
+        string_t path = web::uri::decode(request.relative_uri().path());
+        std::map<string_t, string_t> query = web::uri::split_query(
+                            web::uri::decode(request.relative_uri().query()));
+        string_t method = request.method();
+        request.extract_vector().then([this, request, path, query, method](
+                                    const std::vector<unsigned char>& body) {
+            web::http::http_response response = Respond(
+                                method, path, query,
+                                std::string(body.begin(), body.end()));
+            request.reply(response);
+        });
+    }
+
+    web::http::http_response Respond(
+                                const string_t& method,
+                                const string_t& path,
+                                const std::map<string_t, string_t>& query,
+                                const std::string& body) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        bool is_container = path.find(U('/'), 1) == string_t::npos;
+        if (method == web::http::methods::PUT && !is_container) {
+            ++nb_puts_[path];
+        }
+        for (const string_t& suffix : fail_once_suffixes_) {
+            if (boost::ends_with(path, suffix)) {
+                fail_once_suffixes_.erase(suffix);
+                return web::http::http_response(
+                            web::http::status_codes::ServiceUnavailable);
+            }
+        }
+        if (method == web::http::methods::PUT) {
+            if (!is_container) {
+                objects_[path] = body;
+                if (query.count(U("multipart-manifest"))) {
+                    manifests_.insert(path);
+                } else {
+                    manifests_.erase(path);
+                }
+            }
+            web::http::http_response response(
+                                        web::http::status_codes::Created);
+            response.headers().add(web::http::header_names::etag,
+                    U("\"") + utility::conversions::print_string(body.size())
+                    + U("\""));
+            return response;
+        }
+        if (method == web::http::methods::GET && is_container) {
+            return List(path, query);
+        }
+        auto it = objects_.find(path);
+        if (it == objects_.end()) {
+            return web::http::http_response(web::http::status_codes::NotFound);
+        }
+        if (method == web::http::methods::HEAD) {
+            web::http::http_response response(web::http::status_codes::OK);
+            response.headers().set_content_type(
+                                            U("application/octet-stream"));
+            if (manifests_.count(path)) {
+                response.headers().add(U("X-Static-Large-Object"), U("True"));
+            }
+            return response;
+        }
+        if (method == web::http::methods::GET) {
+            web::http::http_response response(web::http::status_codes::OK);
+            if (manifests_.count(path)
+                    && query.count(U("multipart-manifest"))) {
+                response.set_body(GetManifest(path));
+            } else {
+                response.set_body(it->second);
+            }
+            return response;
+        }
+        if (method == web::http::methods::DEL) {
+            auto query_it = query.find(U("multipart-manifest"));
+            delete_queries_[path] = query_it == query.end()
+                        ? string_t() : U("multipart-manifest=")
+                                       + query_it->second;
+            if (query_it == query.end()) {
+                objects_.erase(it);
+                return web::http::http_response(
+                                        web::http::status_codes::NoContent);
+            }
+            return DeleteManifest(path);
+        }
+        return web::http::http_response(web::http::status_codes::BadRequest);
+    }
+
+    // Container listing (only prefix is supported)
+    web::http::http_response List(const string_t& container_path,
+                                  const std::map<string_t, string_t>& query) {
+        auto prefix_it = query.find(U("prefix"));
+        string_t prefix = container_path + U("/")
+                + (prefix_it == query.end() ? string_t() : prefix_it->second);
+        web::json::value array = web::json::value::array();
+        size_t i = 0;
+        for (const auto& entry : objects_) {
+            if (boost::starts_with(entry.first, prefix)) {
+                web::json::value obj;
+                obj[U("name")] = web::json::value::string(
+                            entry.first.substr(container_path.size() + 1));
+                obj[U("bytes")] = web::json::value::number(
+                            static_cast<int64_t>(entry.second.size()));
+                obj[U("content_type")] = web::json::value::string(
+                            U("application/octet-stream"));
+                array[i++] = obj;
+            }
+        }
+        web::http::http_response response(web::http::status_codes::OK);
+        response.set_body(array);
+        return response;
+    }
+
+    // Manifest as returned by server (segments are listed by name)
+    web::json::value GetManifest(const string_t& path) {
+        web::json::value manifest = web::json::value::parse(
+                utility::conversions::to_string_t(objects_[path]));
+        web::json::value segments = web::json::value::array();
+        for (size_t i = 0; i < manifest.size(); ++i) {
+            web::json::value segment;
+            segment[U("name")] = manifest.at(i).at(U("path"));
+            segment[U("hash")] = manifest.at(i).at(U("etag"));
+            segment[U("bytes")] = manifest.at(i).at(U("size_bytes"));
+            segments[i] = segment;
+        }
+        return segments;
+    }
+
+    // Deletion of a manifest and its segments, reported as a bulk delete
+    web::http::http_response DeleteManifest(const string_t& path) {
+        web::json::value errors = web::json::value::array();
+        size_t nb_errors = 0;
+        int64_t nb_deleted = 0;
+        if (manifests_.count(path) == 0) {
+            errors[nb_errors++] = ErrorEntry(path, U("Not an SLO manifest"));
+        } else {
+            web::json::value manifest = web::json::value::parse(
+                    utility::conversions::to_string_t(objects_[path]));
+            for (size_t i = 0; i < manifest.size(); ++i) {
+                string_t segment = manifest.at(i).at(U("path")).as_string();
+                if (undeletable_.count(segment)) {
+                    errors[nb_errors++] = ErrorEntry(segment,
+                                                     U("409 Conflict"));
+                } else {
+                    nb_deleted += objects_.erase(segment);
+                }
+            }
+            if (nb_errors == 0) {
+                nb_deleted += objects_.erase(path);
+                manifests_.erase(path);
+            }
+        }
+        web::json::value result;
+        result[U("Number Deleted")] = web::json::value::number(nb_deleted);
+        result[U("Number Not Found")] = web::json::value::number(0);
+        result[U("Response Status")] = web::json::value::string(
+                nb_errors == 0 ? U("200 OK") : U("400 Bad Request"));
+        result[U("Response Body")] = web::json::value::string(U(""));
+        result[U("Errors")] = errors;
+        web::http::http_response response(web::http::status_codes::OK);
+        response.set_body(result);
+        return response;
+    }
+
+    static web::json::value ErrorEntry(const string_t& path,
+                                       const string_t& status) {
+        web::json::value error = web::json::value::array();
+        error[0] = web::json::value::string(path.substr(1));
+        error[1] = web::json::value::string(status);
+        return error;
+    }
+};
+
+TEST_F(SwiftClientTest, TestFailedSegmentIsRetriedAlone) {
+    p_swift_->SetLargeObjectSegmentation(100, 64, 2);
+    p_swift_->SetSegmentsRetryStrategy(std::make_shared<RetryStrategy>(3, 1));
+    std::string content = MiscUtils::GenerateRandomData(300);
+    CUploadRequest request(CPath(U("/big.bin")),
+                           std::make_shared<MemoryByteSource>(content));
+    request.set_content_type(U("application/octet-stream"));
+    // Second segment fails once (segments names end with their index):
+    FailOnce(U("/00000001"));
+    p_swift_->Upload(request);
+
+    // Segments names are sorted by index:
+    std::vector<string_t> segments = PutPaths(U("/default_segments/"));
+    ASSERT_EQ(5, segments.size());
+    std::string uploaded;
+    for (size_t i = 0; i < segments.size(); ++i) {
+        // only failed segment has been sent again:
+        EXPECT_EQ(i == 1 ? 2 : 1, NbPuts(segments[i])) << segments[i];
+        std::lock_guard<std::mutex> lock(mutex_);
+        uploaded += objects_[segments[i]];
+    }
+    EXPECT_EQ(content, uploaded);
+    EXPECT_EQ(1, NbPuts(U("/default/big.bin")));  // manifest
+}
+
+TEST_F(SwiftClientTest, TestSegmentsEnlargedToServerLimit) {
+    PublishLargeObjectLimits(3, 1);
+    p_swift_->SetLargeObjectSegmentation(100, 64, 2);
+    std::string content = MiscUtils::GenerateRandomData(300);
+    CUploadRequest request(CPath(U("/big.bin")),
+                           std::make_shared<MemoryByteSource>(content));
+    p_swift_->Upload(request);
+
+    // 3 segments of 100 bytes instead of 5 segments of 64 bytes:
+    std::vector<string_t> segments = PutPaths(U("/default_segments/"));
+    ASSERT_EQ(3, segments.size());
+    std::string uploaded;
+    for (const string_t& segment : segments) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        EXPECT_EQ(100, objects_[segment].size());
+        uploaded += objects_[segment];
+    }
+    EXPECT_EQ(content, uploaded);
+    EXPECT_EQ(1, NbPuts(U("/default/big.bin")));  // manifest
+}
+
+TEST_F(SwiftClientTest, TestSegmentsBelowServerMinimumAreRejected) {
+    PublishLargeObjectLimits(1000, 100);
+    p_swift_->SetLargeObjectSegmentation(100, 64, 2);
+    CUploadRequest request(CPath(U("/big.bin")),
+                           std::make_shared<MemoryByteSource>(
+                                    MiscUtils::GenerateRandomData(300)));
+    EXPECT_THROW(p_swift_->Upload(request), CStorageException);
+    // nothing has been uploaded:
+    EXPECT_TRUE(PutPaths(U("/default_segments/")).empty());
+    EXPECT_FALSE(Exists(U("/default/big.bin")));
+}
+
+TEST_F(SwiftClientTest, TestDeleteLargeObjectDeletesSegments) {
+    p_swift_->SetLargeObjectSegmentation(100, 64, 2);
+    std::string content = MiscUtils::GenerateRandomData(300);
+    CUploadRequest request(CPath(U("/big.bin")),
+                           std::make_shared<MemoryByteSource>(content));
+    p_swift_->Upload(request);
+    std::vector<string_t> segments = PutPaths(U("/default_segments/"));
+    ASSERT_EQ(5, segments.size());
+
+    EXPECT_TRUE(p_swift_->Delete(CPath(U("/big.bin"))));
+    EXPECT_EQ(U("multipart-manifest=delete"),
+              DeleteQuery(U("/default/big.bin")));
+    EXPECT_FALSE(Exists(U("/default/big.bin")));
+    for (const string_t& segment : segments) {
+        EXPECT_FALSE(Exists(segment)) << segment;
+    }
+}
+
+TEST_F(SwiftClientTest, TestOverwriteLargeObjectDeletesReplacedSegments) {
+    p_swift_->SetLargeObjectSegmentation(100, 64, 2);
+    CPath path(U("/big.bin"));
+    CUploadRequest request(path, std::make_shared<MemoryByteSource>(
+                                    MiscUtils::GenerateRandomData(300)));
+    p_swift_->Upload(request);
+    std::vector<string_t> segments = ObjectPaths(U("/default_segments/"));
+    ASSERT_EQ(5, segments.size());
+
+    // Overwritten by another large object:
+    CUploadRequest request2(path, std::make_shared<MemoryByteSource>(
+                                    MiscUtils::GenerateRandomData(200)));
+    p_swift_->Upload(request2);
+    for (const string_t& segment : segments) {
+        EXPECT_FALSE(Exists(segment)) << segment;
+    }
+    segments = ObjectPaths(U("/default_segments/"));
+    EXPECT_EQ(4, segments.size());
+
+    // Overwritten by a small blob:
+    CUploadRequest request3(path,
+                            std::make_shared<MemoryByteSource>("small"));
+    p_swift_->Upload(request3);
+    EXPECT_TRUE(ObjectPaths(U("/default_segments/")).empty());
+    EXPECT_TRUE(Exists(U("/default/big.bin")));
+}
+
+TEST_F(SwiftClientTest, TestOptimisticUploadOverFolderIsRemoved) {
+    CUploadRequest child_request(CPath(U("/folder/child")),
+                                 std::make_shared<MemoryByteSource>("child"));
+    p_swift_->Upload(child_request);
+
+    CUploadRequest request(CPath(U("/folder")),
+                           std::make_shared<MemoryByteSource>("blob"));
+    request.set_optimistic(true);
+    EXPECT_THROW(p_swift_->Upload(request), CInvalidFileTypeException);
+    // blob has been sent, then removed:
+    EXPECT_EQ(1, NbPuts(U("/default/folder")));
+    EXPECT_FALSE(Exists(U("/default/folder")));
+    EXPECT_TRUE(Exists(U("/default/folder/child")));
+
+    // Blobs named like a folder prefix are not folders:
+    CUploadRequest request2(CPath(U("/fold")),
+                            std::make_shared<MemoryByteSource>("blob"));
+    request2.set_optimistic(true);
+    p_swift_->Upload(request2);
+    EXPECT_TRUE(Exists(U("/default/fold")));
+}
+
+TEST_F(SwiftClientTest, TestDeleteSmallObjectIsPlainDelete) {
+    CUploadRequest request(CPath(U("/small.bin")),
+                           std::make_shared<MemoryByteSource>("small"));
+    p_swift_->Upload(request);
+
+    EXPECT_TRUE(p_swift_->Delete(CPath(U("/small.bin"))));
+    // Server would report an error if object was deleted as a manifest:
+    EXPECT_EQ(U(""), DeleteQuery(U("/default/small.bin")));
+    EXPECT_FALSE(Exists(U("/default/small.bin")));
+}
+
+TEST_F(SwiftClientTest, TestDeleteLargeObjectReportsSegmentErrors) {
+    p_swift_->SetLargeObjectSegmentation(100, 64, 2);
+    std::string content = MiscUtils::GenerateRandomData(300);
+    CUploadRequest request(CPath(U("/big.bin")),
+                           std::make_shared<MemoryByteSource>(content));
+    p_swift_->Upload(request);
+    std::vector<string_t> segments = PutPaths(U("/default_segments/"));
+    ASSERT_EQ(5, segments.size());
+    ForbidDelete(segments[2]);
+
+    // Server answers 200 in any case, with errors in body:
+    EXPECT_THROW(p_swift_->Delete(CPath(U("/big.bin"))), CStorageException);
+    EXPECT_TRUE(Exists(U("/default/big.bin")));
+}
+
 }  // namespace pcs_api
 
@@ -0,0 +1,232 @@
+/**
+ * Copyright (c) 2014 Netheos (http://www.netheos.net)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <stdexcept>
+
+#include "gtest/gtest.h"
+
+#include "pcs_api/internal/token_refresher.h"
+
+namespace pcs_api {
+
+namespace {
+
+/**
+ * \brief A fake token, renewed for a given validity, and the fake clock
+ *        it is checked against.
+ *
+ * Time only advances when Advance() is called, and tests synchronize with
+ * refresher thread instead of sleeping: as long as time does not change,
+ * every check of token by refresher leads to the same decision.
+ */
+class FakeToken {
+ public:
+    explicit FakeToken(boost::posix_time::time_duration validity)
+        : validity_(validity),
+          now_(boost::gregorian::date(2014, 1, 1)),
+          expires_at_(now_ + validity),
+          time_version_(0),
+          seen_time_version_(-1),
+          nb_checks_(0),
+          nb_attempts_(0),
+          nb_refreshes_(0),
+          nb_failures_(0) {
+    }
+
+    boost::posix_time::ptime now() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        seen_time_version_ = time_version_;
+        return now_;
+    }
+
+    boost::posix_time::ptime expires_at() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (seen_time_version_ == time_version_) {
+            // refresher has read current time before checking token:
+            ++nb_checks_;
+            cond_.notify_all();
+        }
+        return expires_at_;
+    }
+
+    void Refresh() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++nb_attempts_;
+        cond_.notify_all();
+        if (nb_failures_ > 0) {
+            --nb_failures_;
+            throw std::runtime_error("refresh failure");
+        }
+        expires_at_ = now_ + validity_;
+        ++nb_refreshes_;
+    }
+
+    void Advance(boost::posix_time::time_duration duration) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        now_ += duration;
+        ++time_version_;
+    }
+
+    void InjectFailures(int nb_failures) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        nb_failures_ = nb_failures;
+    }
+
+    int nb_refreshes() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return nb_refreshes_;
+    }
+
+    /**
+     * \brief Notifies refresher, and waits until it has checked token
+     *        at current time.
+     */
+    void WaitForCheck(TokenRefresher *p_refresher) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        int nb_checks = nb_checks_;
+        lock.unlock();
+        p_refresher->Notify();
+        lock.lock();
+        ASSERT_TRUE(cond_.wait_for(lock, std::chrono::seconds(10),
+                                   [this, nb_checks] {
+                                       return nb_checks_ > nb_checks;
+                                   }));
+    }
+
+    /**
+     * \brief Notifies refresher, and waits until it has attempted the given
+     *        number of refreshes (failed or not).
+     */
+    void WaitForAttempts(TokenRefresher *p_refresher, int nb_attempts) {
+        p_refresher->Notify();
+        std::unique_lock<std::mutex> lock(mutex_);
+        ASSERT_TRUE(cond_.wait_for(lock, std::chrono::seconds(10),
+                                   [this, nb_attempts] {
+                                       return nb_attempts_ >= nb_attempts;
+                                   }));
+    }
+
+ private:
+    const boost::posix_time::time_duration validity_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    boost::posix_time::ptime now_;
+    boost::posix_time::ptime expires_at_;
+    int time_version_;  // incremented when time advances
+    int seen_time_version_;  // time version last read by refresher
+    int nb_checks_;  // checks of token at current time
+    int nb_attempts_;
+    int nb_refreshes_;
+    int nb_failures_;
+};
+
+}  // namespace
+
+TEST(TokenRefresherTest, TestRefreshBeforeExpiration) {
+    FakeToken token(boost::posix_time::minutes(60));
+    TokenRefresher refresher(std::bind(&FakeToken::expires_at, &token),
+                             std::bind(&FakeToken::Refresh, &token),
+                             boost::posix_time::minutes(5),
+                             std::bind(&FakeToken::now, &token));
+    token.Advance(boost::posix_time::minutes(54));
+    token.WaitForCheck(&refresher);
+    EXPECT_EQ(0, token.nb_refreshes());
+    // renewed 5 minutes before expiration:
+    token.Advance(boost::posix_time::minutes(1));
+    token.WaitForAttempts(&refresher, 1);
+    EXPECT_EQ(1, token.nb_refreshes());
+    // New token is renewed 55 minutes later:
+    token.Advance(boost::posix_time::minutes(54));
+    token.WaitForCheck(&refresher);
+    EXPECT_EQ(1, token.nb_refreshes());
+    token.Advance(boost::posix_time::minutes(1));
+    token.WaitForAttempts(&refresher, 2);
+    EXPECT_EQ(2, token.nb_refreshes());
+}
+
+TEST(TokenRefresherTest, TestShortLivedTokens) {
+    // Token validity is shorter than margin: renewed at half of validity
+    FakeToken token(boost::posix_time::minutes(4));
+    TokenRefresher refresher(std::bind(&FakeToken::expires_at, &token),
+                             std::bind(&FakeToken::Refresh, &token),
+                             boost::posix_time::minutes(60),
+                             std::bind(&FakeToken::now, &token));
+    for (int i = 1; i <= 3; ++i) {
+        token.Advance(boost::posix_time::seconds(90));
+        token.WaitForCheck(&refresher);
+        EXPECT_EQ(i - 1, token.nb_refreshes());
+        token.Advance(boost::posix_time::seconds(30));
+        token.WaitForAttempts(&refresher, i);
+        EXPECT_EQ(i, token.nb_refreshes());
+    }
+}
+
+TEST(TokenRefresherTest, TestNoToken) {
+    std::mutex mutex;
+    std::condition_variable cond;
+    int nb_checks = 0;
+    std::atomic<int> nb_refreshes(0);
+    TokenRefresher refresher(
+            [&]() {
+                std::lock_guard<std::mutex> lock(mutex);
+                ++nb_checks;
+                cond.notify_all();
+                return boost::posix_time::ptime();  // no token
+            },
+            [&nb_refreshes]() {
+                ++nb_refreshes;
+            },
+            boost::posix_time::seconds(60));
+    std::unique_lock<std::mutex> lock(mutex);
+    ASSERT_TRUE(cond.wait_for(lock, std::chrono::seconds(10),
+                              [&nb_checks] { return nb_checks >= 1; }));
+    // Notification makes refresher check again, without refreshing:
+    lock.unlock();
+    refresher.Notify();
+    lock.lock();
+    ASSERT_TRUE(cond.wait_for(lock, std::chrono::seconds(10),
+                              [&nb_checks] { return nb_checks >= 2; }));
+    EXPECT_EQ(0, nb_refreshes);
+}
+
+TEST(TokenRefresherTest, TestFailedRefresh) {
+    FakeToken token(boost::posix_time::minutes(60));
+    token.InjectFailures(1);
+    TokenRefresher refresher(std::bind(&FakeToken::expires_at, &token),
+                             std::bind(&FakeToken::Refresh, &token),
+                             boost::posix_time::minutes(5),
+                             std::bind(&FakeToken::now, &token));
+    token.Advance(boost::posix_time::minutes(55));
+    token.WaitForAttempts(&refresher, 1);
+    // First refresh failed, next one is delayed,
+    // and notification is not a retry either:
+    token.WaitForCheck(&refresher);
+    EXPECT_EQ(0, token.nb_refreshes());
+    token.Advance(TokenRefresher::kRetryDelay
+                  - boost::posix_time::seconds(1));
+    token.WaitForCheck(&refresher);
+    EXPECT_EQ(0, token.nb_refreshes());
+    token.Advance(boost::posix_time::seconds(1));
+    token.WaitForAttempts(&refresher, 2);
+    EXPECT_EQ(1, token.nb_refreshes());
+}
+
+}  // namespace pcs_api
@@ -0,0 +1,180 @@
+/**
+ * Copyright (c) 2014 Netheos (http://www.netheos.net)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <atomic>
+#include <chrono>
+#include <set>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#include "cpprest/asyncrt_utils.h"
+
+#include "pcs_api/c_exceptions.h"
+#include "pcs_api/tree_walker.h"
+
+#include "memory_storage_provider.h"
+
+namespace pcs_api {
+
+namespace {
+
+/**
+ * \brief Memory storage with slow listings, counting concurrent ones.
+ */
+class SlowListingStorageProvider : public MemoryStorageProvider {
+ public:
+    SlowListingStorageProvider() : nb_listings_(0), max_listings_(0) {
+    }
+
+    using MemoryStorageProvider::ListFolder;
+
+    std::shared_ptr<CFolderContent> ListFolder(const CPath& path) override {
+        int nb_listings = ++nb_listings_;
+        int max_listings = max_listings_;
+        while (nb_listings > max_listings
+               && !max_listings_.compare_exchange_weak(max_listings,
+                                                       nb_listings)) {
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        std::shared_ptr<CFolderContent> p_content =
+                                        MemoryStorageProvider::ListFolder(path);
+        --nb_listings_;
+        return p_content;
+    }
+
+    int max_listings() const {
+        return max_listings_;
+    }
+
+    void reset_max_listings() {
+        max_listings_ = 0;
+    }
+
+ private:
+    std::atomic<int> nb_listings_;
+    std::atomic<int> max_listings_;
+};
+
+}  // namespace
+
+class TreeWalkerTest : public ::testing::Test {
+ protected:
+    SlowListingStorageProvider storage_;
+
+    // Builds /a/{0..2}/{0..2}/blob and /b/blob
+    void BuildTree() {
+        for (int i = 0; i < 3; ++i) {
+            for (int j = 0; j < 3; ++j) {
+                storage_.PutBlob(
+                        CPath(U("/a/") + utility::conversions::print_string(i)
+                              + U("/") + utility::conversions::print_string(j)
+                              + U("/blob")),
+                        "data");
+            }
+        }
+        storage_.PutBlob(CPath(U("/b/blob")), "data");
+    }
+
+    std::set<CPath> Walk(TreeWalker *p_walker, const CPath& path) {
+        std::set<CPath> visited;
+        EXPECT_TRUE(p_walker->Walk(path, [&](std::shared_ptr<CFile> p_file) {
+            // parent folder is always visited before its children:
+            if (!p_file->path().GetParent().IsRoot()
+                    && p_file->path().GetParent() != path) {
+                EXPECT_EQ(1u, visited.count(p_file->path().GetParent()));
+            }
+            EXPECT_TRUE(visited.insert(p_file->path()).second);
+        }));
+        return visited;
+    }
+};
+
+TEST_F(TreeWalkerTest, TestWalkAllFiles) {
+    BuildTree();
+    TreeWalker walker(&storage_);
+    std::set<CPath> visited = Walk(&walker, CPath(U("/")));
+    // 2 + 3 + 3*3 folders, and 3*3 + 1 blobs:
+    EXPECT_EQ(24u, visited.size());
+    EXPECT_EQ(1u, visited.count(CPath(U("/a/2/1/blob"))));
+    EXPECT_EQ(1u, visited.count(CPath(U("/b"))));
+    EXPECT_EQ(0u, visited.count(CPath(U("/"))));
+
+    visited = Walk(&walker, CPath(U("/a/1")));
+    EXPECT_EQ(6u, visited.size());
+    EXPECT_EQ(1u, visited.count(CPath(U("/a/1/0/blob"))));
+}
+
+TEST_F(TreeWalkerTest, TestConcurrency) {
+    BuildTree();
+    TreeWalker walker(&storage_);
+    walker.set_max_concurrency(2);
+    EXPECT_EQ(24u, Walk(&walker, CPath(U("/"))).size());
+    EXPECT_LE(storage_.max_listings(), 2);
+
+    storage_.reset_max_listings();
+    walker.set_max_concurrency(1);
+    EXPECT_EQ(24u, Walk(&walker, CPath(U("/"))).size());
+    EXPECT_EQ(1, storage_.max_listings());
+
+    EXPECT_THROW(walker.set_max_concurrency(0), std::invalid_argument);
+}
+
+TEST_F(TreeWalkerTest, TestPrune) {
+    BuildTree();
+    TreeWalker walker(&storage_);
+    walker.set_prune_predicate([](const CFolder& folder) {
+        return folder.path().GetBaseName() == U("a")
+               || folder.path().GetBaseName() == U("1");
+    });
+    std::set<CPath> visited = Walk(&walker, CPath(U("/")));
+    // pruned folders are visited, but not their content:
+    EXPECT_EQ(3u, visited.size());
+    EXPECT_EQ(1u, visited.count(CPath(U("/a"))));
+    EXPECT_EQ(1u, visited.count(CPath(U("/b/blob"))));
+
+    // walked folder itself is never pruned:
+    visited = Walk(&walker, CPath(U("/a")));
+    EXPECT_EQ(3u + 2 * 3 + 2 * 2, visited.size());
+    EXPECT_EQ(0u, visited.count(CPath(U("/a/1/0"))));
+    EXPECT_EQ(0u, visited.count(CPath(U("/a/0/1/blob"))));
+}
+
+TEST_F(TreeWalkerTest, TestErrors) {
+    BuildTree();
+    TreeWalker walker(&storage_);
+    // Missing folder:
+    EXPECT_FALSE(walker.Walk(CPath(U("/c")), [](std::shared_ptr<CFile>) {
+        FAIL();
+    }));
+    // Not a folder:
+    EXPECT_THROW(walker.Walk(CPath(U("/b/blob")), [](std::shared_ptr<CFile>) {
+                                FAIL();
+                            }),
+                 CInvalidFileTypeException);
+    // Visitor errors stop the walk:
+    int nb_visited = 0;
+    EXPECT_THROW(walker.Walk(CPath(U("/")), [&](std::shared_ptr<CFile>) {
+                                if (++nb_visited == 5) {
+                                    throw std::runtime_error("visitor");
+                                }
+                            }),
+                 std::runtime_error);
+    EXPECT_EQ(5, nb_visited);
+}
+
+}  // namespace pcs_api
@@ -14,9 +14,12 @@
  * limitations under the License.
  */
 
+#include <chrono>
+
 #include "gtest/gtest.h"
 
 #include "pcs_api/types.h"
+#include "pcs_api/internal/lru_cache.h"
 #include "pcs_api/internal/uri_utils.h"
 #include "pcs_api/internal/utilities.h"
 
@@ -77,4 +80,43 @@ TEST(UtilitiesTest, TestEscapeXml) {
               utilities::EscapeXml("\'&amp;<><"));
 }
 
+namespace {
+
+// keys are spread into shards by their value, modulo number of shards:
+struct IdentityHash {
+    size_t operator()(int key) const {
+        return static_cast<size_t>(key);
+    }
+};
+
+}  // namespace
+
+TEST(LruCacheTest, TestGenerationPerShard) {
+    LruCache<int, int, IdentityHash> cache(100, std::chrono::minutes(1));
+    int value;
+
+    LruCacheGeneration generation = cache.generation();
+    // removal in another shard does not reject values:
+    cache.Erase(2);
+    EXPECT_TRUE(cache.Put(1, 10, generation));
+    EXPECT_TRUE(cache.Get(1, &value));
+    EXPECT_EQ(10, value);
+
+    // removal of another key in same shard rejects values:
+    generation = cache.generation();
+    cache.Erase(17);
+    EXPECT_FALSE(cache.Put(1, 11, generation));
+    EXPECT_TRUE(cache.Get(1, &value));
+    EXPECT_EQ(10, value);
+
+    // removals in all shards reject values:
+    generation = cache.generation();
+    cache.EraseIf([](const int& key) { return key == 2; });
+    EXPECT_FALSE(cache.Put(3, 30, generation));
+    EXPECT_FALSE(cache.Get(3, &value));
+    EXPECT_TRUE(cache.Put(3, 30, cache.generation()));
+    EXPECT_TRUE(cache.Get(3, &value));
+    EXPECT_EQ(30, value);
+}
+
 }  // namespace pcs_api